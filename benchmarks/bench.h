@@ -0,0 +1,47 @@
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <stdint.h>
+
+/*
+ * Minimal benchmark harness. Benchmarks are grouped in suites, like the CUnit
+ * tests; a suite may have init and close functions for shared fixtures, and
+ * if init fails all of its benchmarks are reported as skipped.
+ *
+ * Every benchmark is run once to warm up and then a number of times for the
+ * results. A run times only what is between bench_begin and bench_end, so
+ * setup work can be left out, and reports how many operations it did.
+ */
+
+#define BENCH_MAX_RUNS 100
+
+typedef struct bench_t bench;
+typedef void (*bench_func)(bench *b);
+typedef int (*bench_suite_func)(void);
+
+struct bench_t {
+    const char *suite;
+    const char *name;
+    bench_func func;
+    int skipped;
+    uint64_t start;
+    uint64_t ticks; // Timed ticks in the current run
+    unsigned int ops; // Operations in the current run
+    int runs;
+    double ns_per_op[BENCH_MAX_RUNS];
+};
+
+void bench_begin(bench *b);
+void bench_end(bench *b, unsigned int ops);
+
+int bench_add_suite(const char *name, bench_suite_func init, bench_suite_func close);
+void bench_add(const char *name, bench_func func);
+
+/* Options shared with the benchmarks */
+int bench_scenario_ticks();
+
+void utils_bench_suite();
+void video_bench_suite();
+void game_bench_suite();
+
+#endif // _BENCH_H
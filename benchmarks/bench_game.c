@@ -0,0 +1,189 @@
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "game/game_state.h"
+#include "game/game_player.h"
+#include "game/common_defines.h"
+#include "game/protos/player.h"
+#include "controller/controller.h"
+#include "controller/ai_controller.h"
+#include "resources/pilots.h"
+#include "resources/languages.h"
+#include "resources/fonts.h"
+#include "resources/palette.h"
+#include "video/video.h"
+#include "utils/random.h"
+#include "utils/mem_pool.h"
+#include "utils/mem_arena.h"
+
+#define FIGHT_SEED 2097
+#define FIGHT_WARMUP_TICKS 300 // Gets the HARs out of their intro poses
+#define SNAPSHOT_ITERATIONS 2000
+
+static int game_bench_init() {
+    video_init_headless();
+    if(lang_init()) {
+        goto error_0;
+    }
+    if(fonts_init()) {
+        goto error_1;
+    }
+    if(altpals_init()) {
+        goto error_2;
+    }
+    return 0;
+
+error_2:
+    fonts_close();
+error_1:
+    lang_close();
+error_0:
+    return 1;
+}
+
+static int game_bench_close() {
+    altpals_close();
+    fonts_close();
+    lang_close();
+    mem_pool_shared_close();
+    mem_arena_scene_close();
+    return 0;
+}
+
+// Same setup as a tournament match, with fixed HARs, pilots and seed
+static game_state* fight_create() {
+    engine_init_flags flags;
+    memset(&flags, 0, sizeof(engine_init_flags));
+    flags.net_mode = NET_MODE_NONE;
+    rand_seed_streams(FIGHT_SEED);
+
+    game_state *gs = malloc(sizeof(game_state));
+    game_state_create_headless(gs, &flags);
+    for(int i = 0; i < 2; i++) {
+        game_player *player = game_state_get_player(gs, i);
+        controller *ctrl = malloc(sizeof(controller));
+        controller_init(ctrl);
+        ai_controller_create(ctrl, AI_DIFFICULTY_VETERAN);
+        game_player_set_ctrl(player, ctrl);
+        player->har_id = (i == 0) ? HAR_JAGUAR : HAR_SHADOW;
+        player->pilot_id = i;
+        chr_score_reset(&player->score, 1);
+
+        pilot pilot_info;
+        pilot_get_info(&pilot_info, player->pilot_id);
+        player->colors[0] = pilot_info.colors[0];
+        player->colors[1] = pilot_info.colors[1];
+        player->colors[2] = pilot_info.colors[2];
+    }
+    if(game_load_new(gs, SCENE_ARENA0)) {
+        game_state_free(gs);
+        free(gs);
+        return NULL;
+    }
+    return gs;
+}
+
+static void fight_free(game_state *gs) {
+    game_state_free(gs);
+    free(gs);
+}
+
+static int fight_running(game_state *gs) {
+    return gs->run && gs->next_id == gs->this_id;
+}
+
+// One static tick worth of the engine loop, without rendering
+static void fight_tick(game_state *gs, int *dynamic_wait) {
+    game_state_tick_controllers(gs);
+    game_state_static_tick(gs);
+    *dynamic_wait += 10;
+    while(*dynamic_wait > game_state_ms_per_dyntick(gs) && fight_running(gs)) {
+        game_state_dynamic_tick(gs);
+        *dynamic_wait -= game_state_ms_per_dyntick(gs);
+    }
+}
+
+// Creates a fight, runs it for a while and snapshots it
+static game_state* fight_snapshot(serial *snapshot) {
+    game_state *gs = fight_create();
+    if(gs == NULL) {
+        return NULL;
+    }
+    int dynamic_wait = 0;
+    for(int i = 0; i < FIGHT_WARMUP_TICKS && fight_running(gs); i++) {
+        fight_tick(gs, &dynamic_wait);
+    }
+    serial_create(snapshot);
+    if(!fight_running(gs) || game_state_snapshot(gs, snapshot)) {
+        serial_free(snapshot);
+        fight_free(gs);
+        return NULL;
+    }
+    return gs;
+}
+
+static void bench_player_run(bench *b) {
+    serial snapshot;
+    game_state *gs = fight_snapshot(&snapshot);
+    if(gs == NULL) {
+        return;
+    }
+    for(int i = 0; i < SNAPSHOT_ITERATIONS; i++) {
+        game_state_restore(gs, &snapshot);
+        object *har0 = game_state_get_player(gs, 0)->har;
+        object *har1 = game_state_get_player(gs, 1)->har;
+        bench_begin(b);
+        player_run(har0);
+        player_run(har1);
+        bench_end(b, 2);
+    }
+    serial_free(&snapshot);
+    fight_free(gs);
+}
+
+static void bench_call_collide(bench *b) {
+    serial snapshot;
+    game_state *gs = fight_snapshot(&snapshot);
+    if(gs == NULL) {
+        return;
+    }
+    for(int i = 0; i < SNAPSHOT_ITERATIONS; i++) {
+        game_state_restore(gs, &snapshot);
+        bench_begin(b);
+        game_state_call_collide(gs);
+        bench_end(b, 1);
+    }
+    serial_free(&snapshot);
+    fight_free(gs);
+}
+
+// Ticks of AI-vs-AI fighting; a new fight is started whenever one ends
+static void bench_arena_fight(bench *b) {
+    int ticks = bench_scenario_ticks();
+    while(ticks > 0) {
+        game_state *gs = fight_create();
+        if(gs == NULL) {
+            return;
+        }
+        int done = 0;
+        int dynamic_wait = 0;
+        bench_begin(b);
+        while(done < ticks && fight_running(gs)) {
+            fight_tick(gs, &dynamic_wait);
+            done++;
+        }
+        bench_end(b, done);
+        fight_free(gs);
+        if(done == 0) {
+            return;
+        }
+        ticks -= done;
+    }
+}
+
+void game_bench_suite() {
+    if(bench_add_suite("game", game_bench_init, game_bench_close)) { return; }
+    bench_add("player_run", bench_player_run);
+    bench_add("game_state_call_collide", bench_call_collide);
+    bench_add("arena_fight_ticks", bench_arena_fight);
+}
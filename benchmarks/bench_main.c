@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include <argtable2.h>
+#include "bench.h"
+#include "utils/log.h"
+#include "resources/pathmanager.h"
+#include "game/utils/settings.h"
+
+#define MAX_SUITES 16
+#define MAX_BENCHES 64
+#define DEFAULT_RUNS 5
+#define DEFAULT_SCENARIO_TICKS 3000
+
+#ifndef SHA1_HASH
+    const char *git_sha1_hash = "";
+#else
+    const char *git_sha1_hash = SHA1_HASH;
+#endif
+
+typedef struct bench_suite_t {
+    const char *name;
+    bench_suite_func init;
+    bench_suite_func close;
+    int first;
+    int count;
+} bench_suite;
+
+static bench_suite suites[MAX_SUITES];
+static bench benches[MAX_BENCHES];
+static int suite_count = 0;
+static int bench_count = 0;
+static int scenario_ticks = DEFAULT_SCENARIO_TICKS;
+
+void bench_begin(bench *b) {
+    b->start = SDL_GetPerformanceCounter();
+}
+
+void bench_end(bench *b, unsigned int ops) {
+    b->ticks += SDL_GetPerformanceCounter() - b->start;
+    b->ops += ops;
+}
+
+int bench_add_suite(const char *name, bench_suite_func init, bench_suite_func close) {
+    if(suite_count >= MAX_SUITES) {
+        return 1;
+    }
+    bench_suite *s = &suites[suite_count++];
+    s->name = name;
+    s->init = init;
+    s->close = close;
+    s->first = bench_count;
+    s->count = 0;
+    return 0;
+}
+
+void bench_add(const char *name, bench_func func) {
+    if(suite_count == 0 || bench_count >= MAX_BENCHES) {
+        return;
+    }
+    bench *b = &benches[bench_count++];
+    memset(b, 0, sizeof(bench));
+    b->suite = suites[suite_count-1].name;
+    b->name = name;
+    b->func = func;
+    suites[suite_count-1].count++;
+}
+
+int bench_scenario_ticks() {
+    return scenario_ticks;
+}
+
+static int bench_matches(bench *b, const char *filter) {
+    if(filter == NULL) {
+        return 1;
+    }
+    char full[128];
+    snprintf(full, sizeof(full), "%s/%s", b->suite, b->name);
+    return strstr(full, filter) != NULL;
+}
+
+static void bench_run(bench *b, int runs) {
+    // First run is for warming up caches and is not recorded
+    for(int i = 0; i <= runs; i++) {
+        b->ticks = 0;
+        b->ops = 0;
+        b->func(b);
+        if(b->ops == 0) {
+            b->skipped = 1;
+            return;
+        }
+        if(i > 0) {
+            b->ns_per_op[b->runs++] = b->ticks * 1e9 / SDL_GetPerformanceFrequency() / b->ops;
+        }
+    }
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void bench_write(FILE *fp, int json) {
+    if(json) {
+        fprintf(fp, "{\n  \"git\": \"%s\",\n  \"benchmarks\": [\n", git_sha1_hash);
+    } else {
+        fprintf(fp, "suite,name,status,runs,ops,min_ns,median_ns,max_ns\n");
+    }
+    int first = 1;
+    for(int i = 0; i < bench_count; i++) {
+        bench *b = &benches[i];
+        if(b->func == NULL) {
+            continue; // Filtered out
+        }
+        double min = 0, median = 0, max = 0;
+        if(!b->skipped) {
+            qsort(b->ns_per_op, b->runs, sizeof(double), cmp_double);
+            min = b->ns_per_op[0];
+            median = b->ns_per_op[b->runs / 2];
+            max = b->ns_per_op[b->runs - 1];
+        }
+        const char *status = b->skipped ? "skipped" : "ok";
+        if(json) {
+            fprintf(fp, "%s    {\"suite\": \"%s\", \"name\": \"%s\", \"status\": \"%s\", \"runs\": %d, \"ops\": %u, "
+                        "\"min_ns\": %.2f, \"median_ns\": %.2f, \"max_ns\": %.2f}",
+                    first ? "" : ",\n", b->suite, b->name, status, b->runs, b->ops, min, median, max);
+        } else {
+            fprintf(fp, "%s,%s,%s,%d,%u,%.2f,%.2f,%.2f\n",
+                    b->suite, b->name, status, b->runs, b->ops, min, median, max);
+        }
+        first = 0;
+    }
+    if(json) {
+        fprintf(fp, "\n  ]\n}\n");
+    }
+}
+
+int main(int argc, char *argv[]) {
+    struct arg_lit *help = arg_lit0("h", "help", "print this help and exit");
+    struct arg_lit *list = arg_lit0("l", "list", "list the benchmarks and exit");
+    struct arg_str *filter = arg_str0("f", "filter", "<text>", "Only run benchmarks whose suite/name contains the text");
+    struct arg_int *runs = arg_int0("r", "runs", "<n>", "Timed runs per benchmark (default: 5)");
+    struct arg_int *ticks = arg_int0(NULL, "ticks", "<n>", "Ticks in scenario benchmarks (default: 3000)");
+    struct arg_lit *json = arg_lit0(NULL, "json", "Write results as JSON instead of CSV");
+    struct arg_file *out = arg_file0("o", "output", "<file>", "Write results to a file instead of stdout");
+    struct arg_file *logfile = arg_file0(NULL, "log", "<file>", "Write the log to a file");
+    struct arg_end *end = arg_end(20);
+    void* argtable[] = {help, list, filter, runs, ticks, json, out, logfile, end};
+    const char* progname = "openomf_bench";
+    int ret = 1;
+
+    if(arg_nullcheck(argtable) != 0) {
+        fprintf(stderr, "Error: insufficient memory\n");
+        return 1;
+    }
+    int nerrors = arg_parse(argc, argv, argtable);
+    if(help->count > 0) {
+        fprintf(stderr, "Usage: %s", progname);
+        arg_print_syntax(stderr, argtable, "\n");
+        fprintf(stderr, "\nArguments:\n");
+        arg_print_glossary(stderr, argtable, "%-25s %s\n");
+        ret = 0;
+        goto exit_0;
+    }
+    if(nerrors > 0) {
+        arg_print_errors(stderr, end, progname);
+        fprintf(stderr, "Try '%s --help' for more information.\n", progname);
+        goto exit_0;
+    }
+    int run_count = (runs->count > 0) ? runs->ival[0] : DEFAULT_RUNS;
+    if(run_count < 1 || run_count > BENCH_MAX_RUNS) {
+        fprintf(stderr, "Error: runs must be between 1 and %d\n", BENCH_MAX_RUNS);
+        goto exit_0;
+    }
+    if(ticks->count > 0) {
+        scenario_ticks = ticks->ival[0];
+    }
+
+    utils_bench_suite();
+    video_bench_suite();
+    game_bench_suite();
+
+    if(list->count > 0) {
+        for(int i = 0; i < bench_count; i++) {
+            printf("%s/%s\n", benches[i].suite, benches[i].name);
+        }
+        ret = 0;
+        goto exit_0;
+    }
+
+    // Stdout is kept for the results; the log only goes to a file if asked
+    if(logfile->count > 0 && log_init(logfile->filename[0])) {
+        fprintf(stderr, "Error while initializing log '%s'!\n", logfile->filename[0]);
+        goto exit_0;
+    }
+    if(pm_init() != 0) {
+        fprintf(stderr, "Error: %s.\n", pm_get_errormsg());
+        goto exit_1;
+    }
+
+    // Default settings, so that results don't depend on the user's config
+    if(settings_init("openomf_bench.conf")) {
+        fprintf(stderr, "Error: Failed to initialize settings.\n");
+        goto exit_2;
+    }
+    settings_load();
+    if(SDL_Init(SDL_INIT_TIMER)) {
+        fprintf(stderr, "Error: SDL2 initialization failed: %s\n", SDL_GetError());
+        goto exit_3;
+    }
+
+    const char *match = (filter->count > 0) ? filter->sval[0] : NULL;
+    for(int i = 0; i < suite_count; i++) {
+        bench_suite *s = &suites[i];
+        int wanted = 0;
+        for(int k = s->first; k < s->first + s->count; k++) {
+            if(bench_matches(&benches[k], match)) {
+                wanted++;
+            } else {
+                benches[k].func = NULL;
+            }
+        }
+        if(wanted == 0) {
+            continue;
+        }
+        int ok = (s->init == NULL || s->init() == 0);
+        for(int k = s->first; k < s->first + s->count; k++) {
+            if(benches[k].func == NULL) {
+                continue;
+            }
+            if(!ok) {
+                benches[k].skipped = 1;
+                continue;
+            }
+            fprintf(stderr, "Running %s/%s\n", s->name, benches[k].name);
+            bench_run(&benches[k], run_count);
+        }
+        if(ok && s->close != NULL) {
+            s->close();
+        }
+    }
+
+    FILE *fp = stdout;
+    if(out->count > 0) {
+        fp = fopen(out->filename[0], "w");
+        if(fp == NULL) {
+            fprintf(stderr, "Error: Unable to open '%s' for writing.\n", out->filename[0]);
+            goto exit_4;
+        }
+    }
+    bench_write(fp, json->count > 0);
+    if(fp != stdout) {
+        fclose(fp);
+    }
+    ret = 0;
+
+exit_4:
+    SDL_Quit();
+exit_3:
+    settings_free();
+exit_2:
+    pm_free();
+exit_1:
+    log_close();
+exit_0:
+    arg_freetable(argtable, sizeof(argtable)/sizeof(argtable[0]));
+    return ret;
+}
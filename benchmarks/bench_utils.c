@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include "bench.h"
+#include "utils/hashmap.h"
+#include "utils/flatmap.h"
+#include "game/utils/serial.h"
+
+#define MAP_KEYS 1000
+#define MAP_ROUNDS 200
+#define MAP_KEY(i) (((i) * 7919) % MAP_KEYS) // Looks up the keys out of insertion order
+#define SERIAL_RECORDS 10000
+
+// Results are stored here, so that the work can't be optimized out
+static volatile int sink;
+
+static void bench_hashmap_put(bench *b) {
+    for(int r = 0; r < MAP_ROUNDS / 10; r++) {
+        hashmap h;
+        hashmap_create(&h, 10);
+        bench_begin(b);
+        for(unsigned int i = 0; i < MAP_KEYS; i++) {
+            hashmap_iput(&h, i, &i, sizeof(unsigned int));
+        }
+        bench_end(b, MAP_KEYS);
+        hashmap_free(&h);
+    }
+}
+
+static void bench_hashmap_get(bench *b) {
+    hashmap h;
+    void *val;
+    unsigned int len;
+    unsigned int sum = 0;
+    hashmap_create(&h, 10);
+    for(unsigned int i = 0; i < MAP_KEYS; i++) {
+        hashmap_iput(&h, i, &i, sizeof(unsigned int));
+    }
+    bench_begin(b);
+    for(int r = 0; r < MAP_ROUNDS; r++) {
+        for(unsigned int k = 0; k < MAP_KEYS; k++) {
+            if(hashmap_iget(&h, MAP_KEY(k), &val, &len) == 0) {
+                sum += *(unsigned int*)val;
+            }
+        }
+    }
+    bench_end(b, MAP_ROUNDS * MAP_KEYS);
+    hashmap_free(&h);
+    sink = sum;
+}
+
+static void bench_flatmap_put(bench *b) {
+    for(int r = 0; r < MAP_ROUNDS / 10; r++) {
+        flatmap f;
+        flatmap_create(&f, sizeof(unsigned int), sizeof(unsigned int));
+        bench_begin(b);
+        for(unsigned int i = 0; i < MAP_KEYS; i++) {
+            flatmap_iput(&f, i, &i);
+        }
+        bench_end(b, MAP_KEYS);
+        flatmap_free(&f);
+    }
+}
+
+static void bench_flatmap_get(bench *b) {
+    flatmap f;
+    unsigned int *val;
+    unsigned int sum = 0;
+    flatmap_create(&f, sizeof(unsigned int), sizeof(unsigned int));
+    for(unsigned int i = 0; i < MAP_KEYS; i++) {
+        flatmap_iput(&f, i, &i);
+    }
+    bench_begin(b);
+    for(int r = 0; r < MAP_ROUNDS; r++) {
+        for(unsigned int k = 0; k < MAP_KEYS; k++) {
+            if((val = flatmap_iget(&f, MAP_KEY(k))) != NULL) {
+                sum += *val;
+            }
+        }
+    }
+    bench_end(b, MAP_ROUNDS * MAP_KEYS);
+    flatmap_free(&f);
+    sink = sum;
+}
+
+// One record is roughly what an object writes per field group
+static void serial_write_records(serial *s) {
+    for(int i = 0; i < SERIAL_RECORDS; i++) {
+        serial_write_int8(s, i);
+        serial_write_int16(s, i);
+        serial_write_int32(s, i);
+        serial_write_float(s, i * 0.5f);
+    }
+}
+
+static void bench_serial_write(bench *b) {
+    serial s;
+    serial_create(&s);
+    serial_write_records(&s); // Grow the buffer first; snapshots reuse theirs
+    serial_reset(&s);
+    bench_begin(b);
+    serial_write_records(&s);
+    bench_end(b, SERIAL_RECORDS);
+    serial_free(&s);
+}
+
+static void bench_serial_read(bench *b) {
+    serial s;
+    int32_t sum = 0;
+    serial_create(&s);
+    serial_write_records(&s);
+    bench_begin(b);
+    for(int i = 0; i < SERIAL_RECORDS; i++) {
+        sum += serial_read_int8(&s);
+        sum += serial_read_int16(&s);
+        sum += serial_read_int32(&s);
+        sum += serial_read_float(&s);
+    }
+    bench_end(b, SERIAL_RECORDS);
+    serial_free(&s);
+    sink = sum;
+}
+
+void utils_bench_suite() {
+    if(bench_add_suite("utils", NULL, NULL)) { return; }
+    bench_add("hashmap_put", bench_hashmap_put);
+    bench_add("hashmap_get", bench_hashmap_get);
+    bench_add("flatmap_put", bench_flatmap_put);
+    bench_add("flatmap_get", bench_flatmap_get);
+    bench_add("serial_write", bench_serial_write);
+    bench_add("serial_read", bench_serial_read);
+}
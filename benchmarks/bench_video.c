@@ -0,0 +1,177 @@
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "bench.h"
+#include "video/surface.h"
+#include "video/tcache.h"
+#include "resources/palette.h"
+#include "utils/random.h"
+
+#define SCREEN_W 320
+#define SCREEN_H 200
+#define SPRITE_W 64
+#define SPRITE_H 64
+#define FRAMES 200
+#define BLITS 16 // Sprites per frame
+#define CACHED_SURFACES 64
+
+static screen_palette pal;
+static palette remap_pal;
+static surface screen_pal;
+static surface screen_rgba;
+static surface sprite_pal;
+static surface sprite_rgba;
+static surface cached[CACHED_SURFACES];
+static SDL_Surface *target = NULL;
+static SDL_Renderer *renderer = NULL;
+
+// Sprite-like content: a transparent border around noisy pixels
+static void fill_sprite(surface *s, struct random_t *rnd) {
+    for(int y = 0; y < s->h; y++) {
+        for(int x = 0; x < s->w; x++) {
+            int visible = (x > 4 && y > 4 && x < s->w - 4 && y < s->h - 4);
+            int i = x + y * s->w;
+            if(s->type == SURFACE_TYPE_PALETTE) {
+                s->data[i] = visible ? random_int(rnd, 16) : 0; // Low indexes stay in the remap tables
+                s->stencil[i] = visible;
+            } else {
+                s->data[i*4+0] = random_int(rnd, 256);
+                s->data[i*4+1] = random_int(rnd, 256);
+                s->data[i*4+2] = random_int(rnd, 256);
+                s->data[i*4+3] = visible ? 255 : 0;
+            }
+        }
+    }
+}
+
+static int video_bench_init() {
+    struct random_t rnd;
+    random_seed(&rnd, 1234);
+    for(int i = 0; i < 256; i++) {
+        pal.data[i][0] = random_int(&rnd, 256);
+        pal.data[i][1] = random_int(&rnd, 256);
+        pal.data[i][2] = random_int(&rnd, 256);
+    }
+    pal.version = 1;
+    for(int i = 0; i < 19; i++) {
+        for(int k = 0; k < 256; k++) {
+            remap_pal.remaps[i][k] = random_int(&rnd, 256);
+        }
+    }
+
+    surface_create(&screen_pal, SURFACE_TYPE_PALETTE, SCREEN_W, SCREEN_H);
+    surface_create(&screen_rgba, SURFACE_TYPE_RGBA, SCREEN_W, SCREEN_H);
+    surface_create(&sprite_pal, SURFACE_TYPE_PALETTE, SPRITE_W, SPRITE_H);
+    surface_create(&sprite_rgba, SURFACE_TYPE_RGBA, SPRITE_W, SPRITE_H);
+    fill_sprite(&screen_pal, &rnd);
+    memset(screen_pal.stencil, 1, SCREEN_W * SCREEN_H);
+    fill_sprite(&sprite_pal, &rnd);
+    fill_sprite(&sprite_rgba, &rnd);
+    for(int i = 0; i < CACHED_SURFACES; i++) {
+        surface_create(&cached[i], SURFACE_TYPE_PALETTE, SPRITE_W, SPRITE_H);
+        fill_sprite(&cached[i], &rnd);
+    }
+
+    // The software renderer needs no display, so this also works on a GPU-less box
+    target = SDL_CreateRGBSurface(0, SCREEN_W, SCREEN_H, 32, 0, 0, 0, 0);
+    if(target == NULL) {
+        return 1;
+    }
+    renderer = SDL_CreateSoftwareRenderer(target);
+    if(renderer == NULL) {
+        SDL_FreeSurface(target);
+        return 1;
+    }
+    tcache_init(renderer, 1, NULL);
+    return 0;
+}
+
+static int video_bench_close() {
+    tcache_close();
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(target);
+    surface_free(&screen_pal);
+    surface_free(&screen_rgba);
+    surface_free(&sprite_pal);
+    surface_free(&sprite_rgba);
+    for(int i = 0; i < CACHED_SURFACES; i++) {
+        surface_free(&cached[i]);
+    }
+    return 0;
+}
+
+// Blit positions walk over the screen, partly offscreen at the edges
+#define BLIT_X(i) ((i) * 37 % (SCREEN_W + SPRITE_W) - SPRITE_W / 2)
+#define BLIT_Y(i) ((i) * 23 % (SCREEN_H + SPRITE_H) - SPRITE_H / 2)
+
+static void bench_surface_to_rgba(bench *b) {
+    char *dst = malloc(SCREEN_W * SCREEN_H * 4);
+    bench_begin(b);
+    for(int i = 0; i < FRAMES / 4; i++) {
+        surface_to_rgba(&screen_pal, dst, &pal, NULL, 0);
+    }
+    bench_end(b, FRAMES / 4);
+    free(dst);
+}
+
+static void bench_surface_sub(bench *b) {
+    bench_begin(b);
+    for(int i = 0; i < FRAMES * BLITS; i++) {
+        int x = (i * 37) % (SCREEN_W - SPRITE_W);
+        int y = (i * 23) % (SCREEN_H - SPRITE_H);
+        surface_sub(&screen_pal, &sprite_pal, x, y, 0, 0, SPRITE_W, SPRITE_H,
+                    (i & 1) ? SUB_METHOD_MIRROR : SUB_METHOD_NONE);
+    }
+    bench_end(b, FRAMES * BLITS);
+}
+
+static void bench_surface_alpha_blit(bench *b) {
+    bench_begin(b);
+    for(int i = 0; i < FRAMES * BLITS; i++) {
+        surface_alpha_blit(&screen_pal, &sprite_pal, BLIT_X(i), BLIT_Y(i),
+                           (i & 1) ? SDL_FLIP_HORIZONTAL : SDL_FLIP_NONE);
+    }
+    bench_end(b, FRAMES * BLITS);
+}
+
+static void bench_surface_additive_blit(bench *b) {
+    bench_begin(b);
+    for(int i = 0; i < FRAMES * BLITS; i++) {
+        surface_additive_blit(&screen_pal, &sprite_pal, BLIT_X(i), BLIT_Y(i), &remap_pal, SDL_FLIP_NONE);
+    }
+    bench_end(b, FRAMES * BLITS);
+}
+
+static void bench_surface_rgba_blit(bench *b) {
+    bench_begin(b);
+    for(int i = 0; i < FRAMES * BLITS; i++) {
+        surface_rgba_blit(&screen_rgba, &sprite_rgba, BLIT_X(i), BLIT_Y(i));
+    }
+    bench_end(b, FRAMES * BLITS);
+}
+
+static void bench_tcache_get_hit(bench *b) {
+    // Fill the cache, then every lookup is a hit
+    for(int i = 0; i < CACHED_SURFACES; i++) {
+        if(tcache_get(&cached[i], &pal, NULL, 0) == NULL) {
+            return;
+        }
+    }
+    bench_begin(b);
+    for(int r = 0; r < FRAMES; r++) {
+        for(int i = 0; i < CACHED_SURFACES; i++) {
+            tcache_get(&cached[(i * 7) % CACHED_SURFACES], &pal, NULL, 0);
+        }
+    }
+    bench_end(b, FRAMES * CACHED_SURFACES);
+}
+
+void video_bench_suite() {
+    if(bench_add_suite("video", video_bench_init, video_bench_close)) { return; }
+    bench_add("surface_to_rgba", bench_surface_to_rgba);
+    bench_add("surface_sub", bench_surface_sub);
+    bench_add("surface_alpha_blit", bench_surface_alpha_blit);
+    bench_add("surface_additive_blit", bench_surface_additive_blit);
+    bench_add("surface_rgba_blit", bench_surface_rgba_blit);
+    bench_add("tcache_get_hit", bench_tcache_get_hit);
+}
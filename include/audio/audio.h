@@ -14,7 +14,8 @@ const char* audio_get_sink_name(int id);
 int audio_is_sink_available(const char* sink_name);
 const char* audio_get_first_sink_name();
 int audio_init(const char* sink_name);
-void audio_render();
+/* ticks is the game clock in milliseconds since audio started */
+void audio_render(unsigned int ticks);
 void audio_close();
 
 audio_sink* audio_get_sink();
@@ -8,6 +8,9 @@ typedef struct {
 	const char *name;
 } module_source;
 
+/* Sets up the music cache; call after the audio sink is up */
+void music_init();
+void music_close();
 int music_play(unsigned int id);
 /* Equivalent to music_stop() + music_play() */
 int music_reload();
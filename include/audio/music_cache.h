@@ -0,0 +1,41 @@
+#ifndef _MUSIC_CACHE_H
+#define _MUSIC_CACHE_H
+
+#include "audio/source.h"
+
+/*
+ * Cache of pre-rendered module music. The first time a module is played it
+ * streams as usual, while a background thread renders one full pass of it to
+ * PCM in memory. Later plays with the same settings read from that buffer
+ * instead of running the module renderer, and loop back to the start
+ * without a gap.
+ *
+ * Entries are keyed by file, module library, frequency, channels and resampler.
+ * The total size is bounded; the least recently played entries are dropped
+ * first, and a module that doesn't fit at all is not cached.
+ */
+
+#define MUSIC_CACHE_MAX_MB 1024 // Sizes are kept in unsigned ints, with room to add up
+
+typedef struct music_cache_key_t {
+    char file[256];
+    int library;
+    int frequency;
+    int channels;
+    int resampler;
+} music_cache_key;
+
+/* Opens a streaming source for the key. Runs on the render thread. */
+typedef int (*music_cache_open_cb)(audio_source *src, const music_cache_key *key);
+
+/* A max_bytes of 0 disables the cache */
+void music_cache_init(unsigned int max_bytes, music_cache_open_cb open);
+void music_cache_close();
+
+/* Returns 0 and sets up src to play from the cache, or 1 if the key is not cached (yet) */
+int music_cache_source_init(audio_source *src, const music_cache_key *key);
+
+/* Starts rendering the key in the background, unless it is cached already or the render thread is busy */
+void music_cache_request(const music_cache_key *key);
+
+#endif // _MUSIC_CACHE_H
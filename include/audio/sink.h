@@ -1,7 +1,7 @@
 #ifndef _SINK_H
 #define _SINK_H
 
-#include "utils/hashmap.h"
+#include "utils/flatmap.h"
 #include "audio/stream.h"
 #include "audio/source.h"
 
@@ -23,23 +23,40 @@ typedef struct audio_source_t audio_source;
 
 typedef void (*sink_format_stream_cb)(audio_sink *sink, audio_stream *stream);
 typedef void (*sink_close_cb)(audio_sink *sink);
+typedef void (*sink_render_cb)(audio_sink *sink, unsigned int ticks);
+
+// Optional sample playback. Sinks that support it get every sound effect uploaded
+// once, and play them from a fixed voice pool instead of creating a stream per sound.
+typedef int (*sink_upload_sample_cb)(audio_sink *sink, int id, const char *buf, int len);
+typedef void (*sink_play_sample_cb)(audio_sink *sink, int id, float volume, float panning, float pitch);
+typedef int (*sink_sample_playing_cb)(audio_sink *sink, int id);
 
 struct audio_sink_t {
-    hashmap streams;
+    flatmap streams;
     void *userdata;
     sink_close_cb close;
+    sink_render_cb render; // Optional; called after the streams have been updated
     sink_format_stream_cb format_stream;
+    sink_upload_sample_cb upload_sample;
+    sink_play_sample_cb play_sample;
+    sink_sample_playing_cb sample_playing;
 };
 
 void sink_init(audio_sink *sink);
 void sink_play(audio_sink *sink, audio_source *src, int id, float volume, float panning, float pitch);
 void sink_stop(audio_sink *sink, int sid);
 void sink_free(audio_sink *sink);
-void sink_render(audio_sink *sink);
+/* ticks is the game clock in milliseconds since audio started */
+void sink_render(audio_sink *sink, unsigned int ticks);
 void sink_format_stream(audio_sink *sink, audio_stream *stream);
 
 int sink_is_playing(audio_sink *sink, int sid);
 
+int sink_has_samples(audio_sink *sink);
+int sink_upload_sample(audio_sink *sink, int id, const char *buf, int len);
+void sink_play_sample(audio_sink *sink, int id, float volume, float panning, float pitch);
+int sink_is_sample_playing(audio_sink *sink, int id);
+
 void sink_set_stream_panning(audio_sink *sink, int sid, float panning);
 void sink_set_stream_volume(audio_sink *sink, int sid, float volume);
 void sink_set_stream_pitch(audio_sink *sink, int sid, float pitch);
@@ -51,6 +68,10 @@ float sink_get_stream_pitch(audio_sink *sink, int sid);
 void sink_set_userdata(audio_sink *sink, void *userdata);
 void* sink_get_userdata(audio_sink *sink);
 void sink_set_close_cb(audio_sink *sink, sink_close_cb cbfunc);
+void sink_set_render_cb(audio_sink *sink, sink_render_cb cbfunc);
 void sink_set_format_stream_cb(audio_sink *sink, sink_format_stream_cb cbfunc);
+void sink_set_upload_sample_cb(audio_sink *sink, sink_upload_sample_cb cbfunc);
+void sink_set_play_sample_cb(audio_sink *sink, sink_play_sample_cb cbfunc);
+void sink_set_sample_playing_cb(audio_sink *sink, sink_sample_playing_cb cbfunc);
 
 #endif // _SINK_H
@@ -0,0 +1,33 @@
+#ifndef _MIXER_H
+#define _MIXER_H
+
+#include <stdint.h>
+#include "audio/sink.h"
+
+/*
+ * Software mixer for sinks that have no mixing of their own. Streams and
+ * preloaded samples are resampled to the output rate, mixed with volume, pan
+ * and pitch, and written out as interleaved signed 16-bit stereo.
+ *
+ * mixer_sink_init installs all stream and sample callbacks on the sink. The
+ * backend (SDL device, WAV file, ...) only has to call mixer_render whenever it
+ * needs more output. Rendering may happen on another thread; the mixer locks
+ * itself around every change made from the sink callbacks.
+ */
+
+#define MIXER_VOICES 32
+#define MIXER_MAX_SAMPLES 512
+#define MIXER_BLOCK_FRAMES 256
+
+typedef struct mixer_t mixer;
+
+typedef void (*mixer_backend_close_cb)(mixer *m);
+
+int mixer_sink_init(audio_sink *sink, int frequency, void *backend, mixer_backend_close_cb close);
+mixer* mixer_sink_get(audio_sink *sink);
+
+void mixer_render(mixer *m, int16_t *out, int frames);
+int mixer_get_frequency(mixer *m);
+void* mixer_get_backend(mixer *m);
+
+#endif // _MIXER_H
@@ -0,0 +1,12 @@
+#ifndef _SDL_SINK_H
+#define _SDL_SINK_H
+
+#ifdef USE_SDLAUDIO
+
+#include "audio/sink.h"
+
+int sdl_sink_init(audio_sink *sink);
+
+#endif // USE_SDLAUDIO
+
+#endif // _SDL_SINK_H
@@ -0,0 +1,17 @@
+#ifndef _WAV_SINK_H
+#define _WAV_SINK_H
+
+#include "audio/sink.h"
+
+/*
+ * Offline sinks. Both run the software mixer in step with the game clock
+ * instead of an audio device. The "wav" sink writes the mix into WAV_SINK_FILE
+ * in the working directory; the "null" sink throws it away.
+ */
+
+#define WAV_SINK_FILE "openomf.wav"
+
+int null_sink_init(audio_sink *sink);
+int wav_sink_init(audio_sink *sink);
+
+#endif // _WAV_SINK_H
@@ -5,6 +5,7 @@
 #include "game/objects/har.h"
 #include "game/utils/serial.h"
 #include "utils/list.h"
+#include "utils/random.h"
 
 enum {
     ACT_STOP = 0x01,
@@ -30,7 +31,9 @@ enum {
     EVENT_TYPE_ACTION,
     EVENT_TYPE_SYNC,
     EVENT_TYPE_HB,
-    EVENT_TYPE_CLOSE
+    EVENT_TYPE_CLOSE,
+    EVENT_TYPE_INPUT, // Network only; see net_input.h
+    EVENT_TYPE_START // Network only; see game/match_start.h
 };
 
 typedef struct ctrl_event_t ctrl_event;
@@ -61,6 +64,7 @@ struct controller_t {
     int type;
     int rtt;
     int repeat;
+    struct random_t rand_state;
 };
 
 void controller_init(controller* ctrl);
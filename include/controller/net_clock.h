@@ -0,0 +1,63 @@
+#ifndef _NET_CLOCK_H
+#define _NET_CLOCK_H
+
+/*
+ * Clock synchronisation with the network peer. Every heartbeat round trip
+ * gives a sample of the round trip time and of the offset between the peer's
+ * tick and ours. The clock keeps a window of recent samples and estimates:
+ *
+ *  - RTT percentiles, for the jitter.
+ *  - The offset, from the least delayed samples, since queueing delay only
+ *    ever makes a sample worse. Its drift is measured against the first
+ *    estimate, once enough time has passed for it to show.
+ *  - The input delay: the one-way 95th percentile plus a margin, so that
+ *    nearly all of our input reaches the peer before it is due. The delay
+ *    goes up as soon as the jitter does, but only comes down after it has
+ *    been too long for a while.
+ *
+ * All times are in ticks.
+ */
+
+#define NET_CLOCK_SAMPLES 64
+#define NET_CLOCK_READY 16 // Samples needed before the estimates are used
+#define NET_CLOCK_DELAY_MARGIN 1
+#define NET_CLOCK_MAX_DELAY 12
+#define NET_CLOCK_DELAY_HOLD 32 // Samples the input delay has to be too long for before it is lowered
+#define NET_CLOCK_DRIFT_SPAN 3000
+
+typedef struct net_clock_sample_t {
+    int local; // Our tick at the midpoint of the round trip
+    int rtt;
+    float offset; // Peer tick minus our tick
+} net_clock_sample;
+
+typedef struct net_clock_t {
+    net_clock_sample samples[NET_CLOCK_SAMPLES];
+    unsigned int pos;
+    unsigned int count;
+
+    int rtt_min;
+    int rtt_median;
+    int rtt_p95;
+    float offset; // At the last sample
+    float drift; // Offset change per 1000 ticks
+    int anchored;
+    float anchor_local;
+    float anchor_offset;
+    int input_delay;
+    int delay_hold;
+} net_clock;
+
+void net_clock_create(net_clock *c);
+/* Adds a heartbeat that we sent at tick sent and got back at tick arrival, stamped with the peer's tick */
+void net_clock_add(net_clock *c, int sent, int arrival, int peer_tick);
+int net_clock_ready(const net_clock *c);
+
+/* The peer's tick at our given tick */
+int net_clock_peer_tick(const net_clock *c, int local_tick);
+/* Typical time a message from the peer spends underway */
+int net_clock_oneway(const net_clock *c);
+/* How far behind a message from the peer is, given the ticks it waited for us after arriving */
+int net_clock_catchup(const net_clock *c, int waited);
+
+#endif // _NET_CLOCK_H
@@ -2,15 +2,34 @@
 #define _NET_CONTROLLER_H
 
 #include "controller/controller.h"
+#include "controller/net_clock.h"
+#include "controller/net_thread.h"
+#include "controller/net_mux.h"
 #include <SDL2/SDL.h>
 #include <enet/enet.h>
 
-void net_controller_create(controller *ctrl, ENetHost *host, ENetPeer *peer, int id);
+/*
+ * Start connecting or listening in the background, with the network emulator
+ * from the settings. Once the thread is connected, net_controller_create takes
+ * it over; until then, net_thread_free cancels it without waiting.
+ */
+net_thread* net_controller_connect(const char *addr, int port, int id);
+net_thread* net_controller_listen(int port, int id);
+void net_controller_create(controller *ctrl, net_thread *thread, int id);
+/* For a peer on a shared server host; the controller closes the link when it is freed */
+void net_controller_create_link(controller *ctrl, net_link *link, int id);
 void net_controller_free(controller *ctrl);
 int net_controller_get_rtt(controller *ctrl);
 void net_controller_har_hook(int action, void *cb_data);
 
 int net_controller_ready(controller *ctrl);
 int net_controller_tick_offset(controller *ctrl);
+/* Ticks our own moves are held back so the peer gets them in time */
+int net_controller_input_delay(controller *ctrl);
+/* Ticks to run a state sync from the peer forward, to bring it up to now */
+int net_controller_catchup(controller *ctrl);
+const net_clock* net_controller_get_clock(controller *ctrl);
+/* Copies the host's start message (see game/match_start.h) into ser. Returns 0 until it has come. */
+int net_controller_get_start(controller *ctrl, serial *ser);
 
 #endif // _NET_CONTROLLER_H
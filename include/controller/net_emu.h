@@ -0,0 +1,60 @@
+#ifndef _NET_EMU_H
+#define _NET_EMU_H
+
+#include <stdint.h>
+#include "controller/net_thread.h"
+
+/*
+ * Network condition emulator. Sits in the net thread between the game and
+ * ENet and holds messages back to emulate latency and jitter, or drops,
+ * duplicates and reorders them. All decisions come from a random stream
+ * seeded from the config, so the same seed gives the same packet fates.
+ *
+ * The emulator works on messages above ENet, so it keeps ENet's guarantees:
+ * reliable messages are never dropped, a lost one is delayed by a retransmit
+ * instead, and messages that aren't unsequenced stay in order per channel.
+ * Only unsequenced messages are duplicated or reordered.
+ *
+ * It applies to both directions at the end where it is enabled, so enabling
+ * it on one peer is enough. Latency and jitter are one-way, in milliseconds;
+ * loss, duplicate and reorder are in percent.
+ */
+
+#define NET_EMU_RETRANSMIT_MS 100 // Extra delay for a "lost" reliable message, on top of a round trip
+#define NET_EMU_REORDER_MS 30 // Reordered messages are held back this much longer
+
+typedef struct net_emu_config_t {
+    int latency;
+    int jitter;
+    int loss;
+    int duplicate;
+    int reorder;
+    int seed;
+} net_emu_config;
+
+typedef struct net_emu_stats_t {
+    unsigned int messages;
+    unsigned int dropped;
+    unsigned int retransmitted;
+    unsigned int duplicated;
+    unsigned int reordered;
+} net_emu_stats;
+
+typedef struct net_emu_t net_emu;
+
+int net_emu_config_enabled(const net_emu_config *conf);
+/* Reads a "latency=80,jitter=20,loss=5,duplicate=1,reorder=2,seed=1" spec. Missing keys are left as they are. */
+int net_emu_config_parse(net_emu_config *conf, const char *spec);
+
+net_emu* net_emu_create(const net_emu_config *conf, uint32_t salt);
+void net_emu_free(net_emu *e);
+
+/* Takes over the message */
+void net_emu_push(net_emu *e, net_msg *msg, uint32_t now);
+/* Returns 1 and the next message that is due at the given time, if any */
+int net_emu_pop(net_emu *e, net_msg *msg, uint32_t now);
+/* Same, but doesn't wait for the message to be due */
+int net_emu_pop_any(net_emu *e, net_msg *msg);
+void net_emu_get_stats(net_emu *e, net_emu_stats *stats);
+
+#endif // _NET_EMU_H
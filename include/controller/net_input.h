@@ -0,0 +1,54 @@
+#ifndef _NET_INPUT_H
+#define _NET_INPUT_H
+
+#include <stdint.h>
+#include "game/utils/serial.h"
+
+/*
+ * Redundant input stream for network games. Local actions are collected into
+ * numbered input frames, one per tick that had any input. Every input packet
+ * carries up to NET_INPUT_REDUNDANCY of the oldest frames the peer hasn't
+ * acknowledged yet, plus an ack for the frames we got from the peer. The
+ * packets are sent unsequenced and unreliable; a lost packet is made up for
+ * by the next one, instead of waiting for a retransmit.
+ *
+ * Packet: int8 EVENT_TYPE_INPUT, int32 ack, int32 first seq, int8 frame count,
+ * and for every frame an int8 action count followed by int16 actions.
+ */
+
+#define NET_INPUT_REDUNDANCY 8
+#define NET_INPUT_HISTORY 64 // Unacknowledged frames we keep around
+#define NET_INPUT_MAX_ACTIONS 8 // Per frame; a full frame is committed early
+
+typedef struct net_input_frame_t {
+    int count;
+    int16_t actions[NET_INPUT_MAX_ACTIONS];
+} net_input_frame;
+
+typedef struct net_input_t {
+    // Sending side. Frames from acked+1 on are kept until the peer acknowledges them.
+    net_input_frame frames[NET_INPUT_HISTORY];
+    uint32_t acked; // Last frame the peer has acknowledged
+    uint32_t next_seq; // Sequence number of the frame being filled
+    net_input_frame current;
+    unsigned int overflows;
+
+    // Receiving side
+    uint32_t received; // Last frame we got from the peer, in order
+    int ack_pending;
+} net_input;
+
+void net_input_create(net_input *in);
+void net_input_add(net_input *in, int action);
+void net_input_commit(net_input *in);
+
+/* Writes a packet if there are frames or an ack to send. Returns 1 if a packet was written. */
+int net_input_write(net_input *in, serial *ser);
+
+/*
+ * Reads a packet (past the event type byte) and applies its ack. The actions of
+ * frames we haven't seen yet are stored in order. Returns the number of actions.
+ */
+int net_input_read(net_input *in, serial *ser, int *actions, int max_actions);
+
+#endif // _NET_INPUT_H
@@ -0,0 +1,41 @@
+#ifndef _NET_MUX_H
+#define _NET_MUX_H
+
+#include <stdint.h>
+#include <enet/enet.h>
+#include "controller/net_thread.h"
+
+/*
+ * One ENet host for many peers, for the standalone server. Like net_thread,
+ * a network thread services the host; every connected peer gets a link with
+ * its own inbound and outbound queues, which the game side uses from any one
+ * thread. Heartbeats from a peer are bounced from the network thread with the
+ * last tick published on its link.
+ *
+ * New links are handed out by net_mux_accept. The game side owns a link until
+ * it calls net_link_close; the network thread then disconnects the peer and
+ * frees the link. A link whose inbound queue is full drops what arrives.
+ */
+
+#define NET_MUX_SERVICE_MS 1
+#define NET_MUX_DISCONNECT_MS 1000
+
+typedef struct net_mux_t net_mux;
+typedef struct net_link_t net_link;
+
+net_mux* net_mux_create(int port, int max_peers, int hb_id);
+/* Closes every link and destroys the host. Links handed out must not be used after this. */
+void net_mux_free(net_mux *m);
+/* Returns the link of a newly connected peer, or NULL if there is none */
+net_link* net_mux_accept(net_mux *m);
+int net_mux_links(net_mux *m);
+
+int net_link_send(net_link *l, uint8_t channel, const char *data, unsigned int len, unsigned int flags);
+/* Returns 1 if a message was taken from the queue. The caller frees it with net_msg_free. */
+int net_link_recv(net_link *l, net_msg *msg);
+void net_link_set_tick(net_link *l, int tick);
+int net_link_is_connected(net_link *l);
+unsigned int net_link_get_dropped(net_link *l);
+void net_link_close(net_link *l);
+
+#endif // _NET_MUX_H
@@ -0,0 +1,67 @@
+#ifndef _NET_RELAY_H
+#define _NET_RELAY_H
+
+#include <stdint.h>
+#include <enet/enet.h>
+#include "game/utils/serial.h"
+#include "utils/vector.h"
+
+/*
+ * Spectator relay. The host of a network match streams the match moves to
+ * read-only spectators. The relay has its own ENet host and thread, so it
+ * stays out of the way of the players' connection; the game thread only
+ * appends moves to a batch.
+ *
+ * Moves are batched over NET_RELAY_BATCH_TICKS ticks, and each batch is one
+ * packet that ENet shares between all spectators. A batch also tells how far
+ * the match has got, so spectators know when they can simulate a tick.
+ * Spectators that join late get the match header and every batch so far first.
+ *
+ * Packets are a sequence of records:
+ *   NET_RELAY_HEADER: int16 length, then the header from net_relay_create
+ *   NET_RELAY_MOVES:  int32 last tick covered, int16 count, then per move
+ *                     int32 tick, int8 player, int8 action (SD_ACT_* flags)
+ *   NET_RELAY_END:    the match is over
+ */
+
+#define NET_RELAY_BATCH_TICKS 5
+#define NET_RELAY_DEFAULT_PORT 2098
+#define NET_RELAY_SERVICE_MS 5
+#define NET_RELAY_DISCONNECT_MS 1000
+
+enum {
+    NET_RELAY_HEADER = 1,
+    NET_RELAY_MOVES,
+    NET_RELAY_END
+};
+
+typedef struct net_relay_move_t {
+    uint32_t tick;
+    uint8_t player_id;
+    uint8_t action;
+} net_relay_move;
+
+typedef struct net_relay_t net_relay;
+
+net_relay* net_relay_create(int port, int max_spectators, const serial *header);
+/*
+ * Returns at once. The relay thread sends anything still queued, disconnects
+ * the spectators and frees the relay in the background (see net_thread_wait_closed).
+ */
+void net_relay_free(net_relay *r);
+
+void net_relay_add(net_relay *r, uint32_t tick, int player_id, int action);
+/* Call at the end of every tick. Sends the batch once it covers enough finished ticks. */
+void net_relay_flush(net_relay *r, uint32_t tick);
+/* Sends the last batch and tells the spectators that the match is over */
+void net_relay_end(net_relay *r, uint32_t tick);
+int net_relay_spectators(net_relay *r);
+
+/*
+ * Reads the next record of a relay packet and returns its type, or 0 at the end
+ * of the packet. The header is copied into header, and moves are appended to
+ * moves (net_relay_move) with upto set to the last tick they cover.
+ */
+int net_relay_read(serial *ser, serial *header, vector *moves, uint32_t *upto);
+
+#endif // _NET_RELAY_H
@@ -0,0 +1,95 @@
+#ifndef _NET_THREAD_H
+#define _NET_THREAD_H
+
+#include <stdint.h>
+#include <SDL2/SDL.h>
+#include <enet/enet.h>
+
+/*
+ * Network I/O thread. Once started, the thread owns the ENet host: it services
+ * the host continuously and exchanges messages with the game thread through
+ * two bounded queues. Messages are stamped with SDL_GetTicks() when they arrive
+ * from the network or are queued for sending, so latency measurements no longer
+ * include the time the game thread spends rendering.
+ *
+ * Heartbeats from the peer are bounced straight from the network thread, with
+ * the last game tick the game thread published. If the inbound queue is full,
+ * the thread stops reading from the host until the game thread catches up.
+ *
+ * If a network emulator config is given, traffic in both directions passes
+ * through the emulator (see net_emu.h) on the network thread.
+ *
+ * The thread can also set up the connection itself: net_thread_connect and
+ * net_thread_listen return right away, and the game thread polls the state
+ * until it is connected or closed. Freeing never waits either; the thread
+ * finishes the graceful disconnect in the background and then frees itself.
+ * The disconnect takes at most NET_THREAD_DISCONNECT_MS, after which the peer
+ * is reset.
+ */
+
+#define NET_THREAD_QUEUE_SIZE 256
+#define NET_THREAD_SERVICE_MS 1 // Longest wait for traffic before queued sends go out
+#define NET_THREAD_CONNECT_MS 5000
+#define NET_THREAD_DISCONNECT_MS 3000
+
+enum {
+    NET_MSG_RECEIVE = 0,
+    NET_MSG_DISCONNECT
+};
+
+enum {
+    NET_THREAD_CONNECTING = 0,
+    NET_THREAD_LISTENING,
+    NET_THREAD_CONNECTED,
+    NET_THREAD_CLOSED // The peer left, or we never got one
+};
+
+typedef struct net_msg_t {
+    int type;
+    uint32_t timestamp;
+    uint8_t channel;
+    unsigned int flags; // ENet packet flags
+    unsigned int len;
+    char *data;
+} net_msg;
+
+typedef struct net_thread_t net_thread;
+struct net_emu_config_t;
+
+/* Takes over the host. hb_id is our own id in heartbeat packets. emu may be NULL. */
+net_thread* net_thread_create(ENetHost *host, ENetPeer *peer, int hb_id, const struct net_emu_config_t *emu);
+/* Looks up the address and connects to it on the network thread */
+net_thread* net_thread_connect(const char *addr, int port, int hb_id, const struct net_emu_config_t *emu);
+/* Waits on the network thread for one peer to connect to the port */
+net_thread* net_thread_listen(int port, int hb_id, const struct net_emu_config_t *emu);
+/* Returns at once. The thread disconnects the peer, destroys the host and frees itself in the background. */
+void net_thread_free(net_thread *t);
+/*
+ * Waits up to timeout ms for the threads that are still closing, then cuts the
+ * rest short and joins them all. No network thread is running once this returns.
+ * Returns how many did not close cleanly in time.
+ */
+int net_thread_wait_closed(unsigned int timeout);
+/*
+ * For other network threads that finish on their own after their owner lets go
+ * (see net_relay.h). net_thread_wait_closed waits for these too; the thread
+ * calls net_thread_closing_end once it has freed everything, and gives up on
+ * saying goodbye as soon as net_thread_closing_aborted returns 1.
+ */
+void net_thread_closing_begin(SDL_Thread *thread);
+void net_thread_closing_end();
+int net_thread_closing_aborted();
+
+int net_thread_send(net_thread *t, uint8_t channel, const char *data, unsigned int len, unsigned int flags);
+/* Returns 1 if a message was taken from the queue. The caller frees it with net_msg_free. */
+int net_thread_recv(net_thread *t, net_msg *msg);
+void net_msg_free(net_msg *msg);
+/* If msg is a heartbeat from the peer, builds the answer carrying our tick and returns 1 */
+int net_msg_hb_reply(const net_msg *msg, int hb_id, int tick, net_msg *reply);
+
+void net_thread_set_tick(net_thread *t, int tick);
+int net_thread_get_state(net_thread *t);
+int net_thread_is_connected(net_thread *t);
+unsigned int net_thread_get_dropped(net_thread *t);
+
+#endif // _NET_THREAD_H
@@ -2,9 +2,17 @@
 #define _REC_CONTROLLER_H
 
 #include "controller/controller.h"
-#include "utils/hashmap.h"
 
 void rec_controller_create(controller *ctrl, int player, sd_rec_file *rec);
 void rec_controller_free(controller *ctrl);
 
+/* Live playback: moves are added in tick order as they come in, and the controller stays open until an end is set */
+void rec_controller_create_live(controller *ctrl, int player);
+void rec_controller_add(controller *ctrl, unsigned int tick, int action);
+void rec_controller_set_end(controller *ctrl, int tick);
+
+/* Moves the playback position so that the next dynamic tick played is 'tick' */
+void rec_controller_seek(controller *ctrl, int tick);
+int rec_controller_get_max_tick(controller *ctrl);
+
 #endif // _REC_CONTROLLER_H
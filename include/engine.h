@@ -1,13 +1,24 @@
 #ifndef _ENGINE_H
 #define _ENGINE_H
 
+#define MAX_RENDER_SCENES 32
+
 typedef struct engine_init_flags_t {
     unsigned int net_mode;
     unsigned int record;
     char rec_file[255];
+    char capture_file[255];
+    int hash_mode;
+    int hash_interval;
+    char hash_file[255];
+    char trace_file[255];
+    char render_report[255]; // Renders offscreen and writes a frame report here, if set
+    int render_frames;
+    int render_scenes[MAX_RENDER_SCENES];
+    int render_scene_count;
 } engine_init_flags;
 
-int engine_init(); // Init window, audiodevice, etc.
+int engine_init(engine_init_flags *init_flags); // Init window, audiodevice, etc.
 void engine_run(engine_init_flags *init_flags); // Run game
 void engine_close(); // Kill window, audiodev
 
@@ -52,6 +52,7 @@ enum {
     AI_DIFFICULTY_CHAMPION,
     AI_DIFFICULTY_DEADLY,
     AI_DIFFICULTY_ULTIMATE,
+    AI_DIFFICULTY_LOOKAHEAD,
     NUMBER_OF_AI_DIFFICULTY_TYPES,
 };
 
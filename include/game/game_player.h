@@ -8,6 +8,7 @@
 #include "controller/keyboard.h"
 #include "controller/net_controller.h"
 #include "controller/ai_controller.h"
+#include "controller/rec_controller.h"
 #include "video/surface.h"
 #include "game/utils/score.h"
 #include "game/utils/har_screencap.h"
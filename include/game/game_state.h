@@ -2,6 +2,7 @@
 #define _GAME_STATE_H
 
 #include <SDL2/SDL.h>
+#include <shadowdive/rec.h>
 #include "utils/vector.h"
 #include "utils/random.h"
 #include "game/utils/serial.h"
@@ -12,6 +13,8 @@ typedef struct game_player_t game_player;
 typedef struct object_t object;
 
 int game_state_create(game_state *gs, engine_init_flags *init_flags);
+int game_state_create_headless(game_state *gs, engine_init_flags *init_flags);
+int game_load_new(game_state *gs, int scene_id);
 void game_state_free(game_state *gs);
 int game_state_handle_event(game_state *gs, SDL_Event *event);
 void game_state_render(game_state *gs);
@@ -31,7 +34,12 @@ void game_state_init_demo(game_state *gs);
 int game_state_ms_per_dyntick(game_state *gs);
 ticktimer* game_state_get_ticktimer(game_state *gs);
 int game_state_serialize(game_state *gs, serial *ser);
-int game_state_unserialize(game_state *gs, serial *ser, int rtt);
+int game_state_unserialize(game_state *gs, serial *ser, int catchup);
+int game_state_snapshot(game_state *gs, serial *ser);
+int game_state_restore(game_state *gs, serial *ser);
+void game_state_simulate(game_state *gs, int ticks);
+void game_state_call_collide(game_state *gs);
+void game_state_setup_rec(game_state *gs, sd_rec_file *rec);
 
 void _setup_keyboard(game_state *gs, int player_id);
 void _setup_ai(game_state *gs, int player_id);
@@ -1,6 +1,7 @@
 #ifndef _GAME_STATE_TYPE_H
 #define _GAME_STATE_TYPE_H
 
+#include <stdint.h>
 #include "utils/vector.h"
 #include "engine.h"
 
@@ -18,12 +19,14 @@ enum {
 enum {
     NET_MODE_NONE,
     NET_MODE_CLIENT,
-    NET_MODE_SERVER
+    NET_MODE_SERVER,
+    NET_MODE_SPECTATOR
 };
 
 typedef struct scene_t scene;
 typedef struct game_player_t game_player;
 typedef struct ticktimer_t ticktimer;
+typedef struct particles_t particles;
 
 typedef struct game_state_t {
     unsigned int run;
@@ -35,6 +38,7 @@ typedef struct game_state_t {
     unsigned int int_tick; // never adjusted, used in ping calculation
     unsigned int role;
     unsigned int speed;
+    uint32_t scene_seed; // Game random stream when the current scene was created
     engine_init_flags *init_flags;
 
     // For screen shaking
@@ -50,9 +54,11 @@ typedef struct game_state_t {
     int this_wait_ticks;
 
     int next_requires_refresh; // If next frame requires a texture refresh, this should be set to 1
-    int net_mode; // NET_MODE_NONE, NET_MODE_CLIENT, NET_MODE_SERVER
+    int net_mode; // NET_MODE_NONE, NET_MODE_CLIENT, NET_MODE_SERVER, NET_MODE_SPECTATOR
+    int headless; // Simulation only; no video, audio or console (tournament runner)
     scene *sc;
     vector objects;
+    particles *particles; // Scrap and oil debris
     game_player *players[2];
 } game_state;
 
@@ -0,0 +1,39 @@
+#ifndef _MATCH_SERVER_H
+#define _MATCH_SERVER_H
+
+#include <stdint.h>
+
+/*
+ * Standalone multi-match server. One ENet host (see controller/net_mux.h)
+ * takes every connection, and clients are paired up in the order they
+ * arrive. Each pair gets a match with its own game_state, in which both
+ * players are network controllers and the server is authoritative. The
+ * first client of a pair plays player 1; both are sent the arena, HARs,
+ * seed and their player slot in a start message (see match_start.h).
+ *
+ * Matches are spread over a pool of worker threads; a worker runs all of its
+ * matches in real time. The RNG streams, scene arena and palette are per
+ * thread, so each match keeps its own and they are swapped in whenever the
+ * match runs. No video or audio is used.
+ *
+ * The CPU time and memory of each match are logged when it ends, and also go
+ * into a CSV report if one is given. The server runs until interrupted.
+ */
+
+typedef struct match_server_config_t {
+    int port;
+    int max_matches; // More pairs than this are turned away
+    int threads; // Worker threads, or 0 for one per CPU core
+    int max_ticks; // End a match after this many ticks
+    uint32_t seed;
+    char report_file[255];
+} match_server_config;
+
+#define MATCH_SERVER_DEFAULT_MATCHES 64
+#define MATCH_SERVER_DEFAULT_MAX_TICKS 60000
+#define MATCH_SERVER_MAX_CATCHUP 5 // Most ticks a late match runs in one pass
+#define MATCH_SERVER_STATUS_MS 10000
+
+int match_server_run(match_server_config *conf);
+
+#endif // _MATCH_SERVER_H
@@ -0,0 +1,34 @@
+#ifndef _MATCH_START_H
+#define _MATCH_START_H
+
+#include <stdint.h>
+#include "game/utils/serial.h"
+
+/*
+ * Start message of a network match, sent by the host to each client once the
+ * match is set up (see controller/net_controller.h for how clients get it).
+ * It tells the client which player it controls and which scene to go to.
+ * A peer hosting from the menus sends SCENE_MELEE, and the HARs are picked
+ * there as usual. The standalone server (see match_server.h) picks the arena
+ * and the HARs itself, and the client goes straight into the arena with the
+ * players and the random seed from the message.
+ */
+
+typedef struct match_start_player_t {
+    int har_id;
+    int pilot_id;
+    int colors[3];
+} match_start_player;
+
+typedef struct match_start_t {
+    int slot; // The player the client controls
+    int scene_id; // SCENE_MELEE, or an arena
+    uint32_t seed; // Game random seed the arena scene is created with
+    match_start_player players[2];
+} match_start;
+
+void match_start_write(serial *ser, const match_start *start);
+/* Returns 1 if the message is a valid start message */
+int match_start_read(serial *ser, match_start *start);
+
+#endif // _MATCH_START_H
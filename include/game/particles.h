@@ -0,0 +1,40 @@
+#ifndef _PARTICLES_H
+#define _PARTICLES_H
+
+#include "resources/animation.h"
+#include "utils/vec.h"
+
+/*
+ * Debris, ie. scrap metal and burning oil. Heavy hits spawn these by the
+ * dozen, so instead of full objects they live in a fixed size pool owned by
+ * the game state, and are moved, ticked and rendered in one pass each.
+ *
+ * A particle plays its animation like an object would, but only the tags
+ * debris uses are read: sprites and frame lengths, the 'd' rewind, blending,
+ * flips, offsets and the 'h' hover. Each animation string is decoded once and
+ * cached until the pool is cleared.
+ *
+ * Particles fall with gravity and bounce off the walls and the floor. Once
+ * one comes to rest, it stops rewinding and is gone when its animation ends.
+ * When the pool is full, new particles are dropped.
+ */
+
+#define PARTICLES_MAX 512
+#define PARTICLES_MAX_TRACKS 16
+
+typedef struct particles_t particles;
+
+particles* particles_create();
+void particles_free(particles *p);
+/* Removes all particles and forgets the cached animations */
+void particles_clear(particles *p);
+
+/* Returns 1 if the particle was dropped */
+int particles_spawn(particles *p, animation *ani, vec2i pos, vec2f vel, float gravity, int pal_offset, int shadow, int layer);
+void particles_move(particles *p);
+void particles_tick(particles *p);
+void particles_render(particles *p, int layer);
+void particles_render_shadows(particles *p);
+unsigned int particles_count(const particles *p);
+
+#endif // _PARTICLES_H
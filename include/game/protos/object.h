@@ -125,6 +125,10 @@ struct object_t {
     object_palette_transform_cb pal_transform;
 };
 
+/* Game objects come from a pool; object_dealloc after object_free to give the memory back */
+object* object_alloc();
+void object_dealloc(object *obj);
+
 void object_create(object *obj, game_state *gs, vec2i pos, vec2f vel);
 void object_render(object *obj);
 void object_render_shadow(object *obj);
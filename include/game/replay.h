@@ -0,0 +1,29 @@
+#ifndef _REPLAY_H
+#define _REPLAY_H
+
+#include <stdint.h>
+#include "game/game_state.h"
+
+/*
+ * REC playback with seeking. While a recording plays, the game state is saved
+ * as a keyframe every REPLAY_KEYFRAME_INTERVAL ticks of fighting. Keyframes are
+ * stored in an index file next to the recording ("<file>.idx") and loaded again
+ * on later playbacks. Seeking restores the closest keyframe before the target
+ * and simulates the rest of the way without rendering.
+ */
+
+#define REPLAY_KEYFRAME_INTERVAL 250
+#define REPLAY_SEEK_STEP 500 // Ticks skipped per seek key press
+
+/* Call before the game state for the recording is created */
+int replay_init(const char *rec_file);
+void replay_tick(game_state *gs);
+void replay_close();
+int replay_is_active();
+
+int replay_seek(game_state *gs, unsigned int tick);
+
+/* Plays a recording headless and as fast as possible. Returns the state hash and tick count at the end. */
+int replay_verify(const char *rec_file, uint32_t *hash, unsigned int *ticks);
+
+#endif // _REPLAY_H
@@ -16,4 +16,8 @@ palette* arena_get_player_palette(scene *scene, int player);
 void arena_toggle_rein(scene *scene);
 void maybe_install_har_hooks(scene *scene);
 
+/* Round progress that is not part of the game objects, for replay keyframes */
+void arena_serialize(scene *scene, serial *ser);
+void arena_unserialize(scene *scene, serial *ser);
+
 #endif // _ARENA_H
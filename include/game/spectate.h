@@ -0,0 +1,34 @@
+#ifndef _SPECTATE_H
+#define _SPECTATE_H
+
+#include "game/game_state.h"
+#include "game/utils/serial.h"
+
+/*
+ * Watching a network match through the host's spectator relay (see
+ * controller/net_relay.h). The match plays back with live recording
+ * controllers that get the moves as they arrive. Ticks are only simulated
+ * once the stream has covered them; when the stream falls behind, playback
+ * waits until SPECTATE_BUFFER_TICKS are in hand again.
+ */
+
+#define SPECTATE_CONNECT_MS 5000
+#define SPECTATE_BUFFER_TICKS 10
+
+/* Call before the game state is created. Connects and waits for the match header. */
+int spectate_init(const char *host, int port);
+void spectate_close();
+int spectate_is_active();
+
+/* The arena scene the match is played in, and the game random seed it started from */
+int spectate_get_scene();
+uint32_t spectate_get_seed();
+/* Sets up the players of a new game state to follow the match, and applies the host's gameplay settings */
+void spectate_setup(game_state *gs);
+/* Call once per frame. Returns how many ticks the game may advance, or -1 once there is no limit. */
+int spectate_poll(game_state *gs);
+
+/* Match header for the relay, written by the host: scene, seed, gameplay settings and players */
+void spectate_write_header(serial *ser, game_state *gs, int scene_id);
+
+#endif // _SPECTATE_H
@@ -0,0 +1,28 @@
+#ifndef _TOURNAMENT_H
+#define _TOURNAMENT_H
+
+#include <stdint.h>
+
+/*
+ * Headless AI-vs-AI tournament runner. Plays every HAR pairing at each AI
+ * difficulty a number of times, spreading the matches over a pool of worker
+ * threads. Every match runs in its own game_state with its own RNG seed. No
+ * video or audio is used, and the matches run as fast as the CPU allows.
+ *
+ * Results go into a CSV report, or into JSON if the report filename ends in ".json".
+ */
+
+typedef struct tournament_config_t {
+    int repeats; // Matches per HAR pairing and difficulty
+    int difficulty; // Only this difficulty, or -1 for all of them
+    int threads; // Worker threads, or 0 for one per CPU core
+    int max_ticks; // Give up on a match after this many ticks
+    uint32_t seed;
+    char report_file[255];
+} tournament_config;
+
+#define TOURNAMENT_DEFAULT_MAX_TICKS 60000
+
+int tournament_run(tournament_config *conf);
+
+#endif // _TOURNAMENT_H
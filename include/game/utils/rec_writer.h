@@ -0,0 +1,30 @@
+#ifndef _REC_WRITER_H
+#define _REC_WRITER_H
+
+#include <shadowdive/shadowdive.h>
+
+/*
+ * Streaming match recorder. The REC header is written when the writer is
+ * opened. After that, moves go into an in-memory chunk, and a background
+ * thread appends the chunk to the file whenever it fills up, or at least
+ * every REC_WRITER_FLUSH_MS. There are only ever two chunks, one filling and
+ * one being written, so memory stays the same however long the session runs.
+ * If the game crashes, the file is still a complete REC up to the last flush.
+ *
+ * The moves are encoded by libShadowDive, so the file is the same as what
+ * sd_rec_save would have written for the whole recording.
+ */
+
+#define REC_WRITER_CHUNK_MOVES 256
+#define REC_WRITER_FLUSH_MS 1000
+
+typedef struct rec_writer_t rec_writer;
+
+/* Writes the header from rec; any moves in it are left out */
+rec_writer* rec_writer_open(const char *filename, const sd_rec_file *rec);
+void rec_writer_add(rec_writer *w, const sd_rec_move *move);
+/* Writes out the moves that are left and closes the file */
+void rec_writer_close(rec_writer *w);
+unsigned int rec_writer_get_moves(rec_writer *w);
+
+#endif // _REC_WRITER_H
@@ -7,6 +7,7 @@
 typedef struct serial_t {
     size_t len;
     size_t rpos;
+    size_t wsize; // Allocated size of data
     char *data;
 } serial;
 
@@ -20,6 +21,7 @@ void serial_write_float(serial *s, float v);
 size_t serial_len(serial *s);
 void serial_read(serial *s, char *buf, int len);
 void serial_free(serial *s);
+void serial_reset(serial *s);
 void serial_read_reset(serial *s);
 int8_t serial_read_int8(serial *s);
 int16_t serial_read_int16(serial *s);
@@ -20,7 +20,8 @@ typedef enum difficulty_t {
     WORLD_CLASS,
     CHAMPION,
     DEADLY,
-    ULTIMATE
+    ULTIMATE,
+    LOOKAHEAD
 } difficulty;
 
 typedef struct settings_sound_t {
@@ -29,6 +30,7 @@ typedef struct settings_sound_t {
     int music_frequency;
     int music_resampler;
     int music_library;
+    int music_cache_size; // Megabytes of pre-rendered music; 0 disables the cache
     int sound_vol;
     int music_vol;
     char *music_arena0;
@@ -115,6 +117,15 @@ typedef struct settings_network_t {
     char *net_connect_ip;
     int net_connect_port;
     int net_listen_port;
+    // Network condition emulation for testing; see controller/net_emu.h
+    int net_emu_latency;
+    int net_emu_jitter;
+    int net_emu_loss;
+    int net_emu_duplicate;
+    int net_emu_reorder;
+    int net_emu_seed;
+    int net_relay_port; // Spectators of matches we host; 0 is off
+    int net_relay_spectators;
 } settings_network;
 
 
@@ -0,0 +1,32 @@
+#ifndef _STATEHASH_H
+#define _STATEHASH_H
+
+#include <stdint.h>
+#include "game/game_state.h"
+
+/*
+ * Determinism checker. Every N ticks of a fight, the serialized game state is
+ * hashed. In log mode the hashes are written to a file as "<tick> <hash>" lines.
+ * In verify mode they are compared against such a file, written by an earlier
+ * run or by the other peer, and the first divergent tick is reported.
+ */
+
+enum {
+    STATEHASH_OFF = 0,
+    STATEHASH_LOG,
+    STATEHASH_VERIFY
+};
+
+#define STATEHASH_DEFAULT_INTERVAL 10
+
+int statehash_init(int mode, const char *filename, int interval);
+void statehash_tick(game_state *gs);
+void statehash_close();
+
+uint32_t statehash_compute(game_state *gs);
+uint32_t statehash_data(const char *buf, unsigned int len);
+
+/* Returns the first tick at which the state diverged, or -1 if it hasn't */
+int statehash_divergent_tick();
+
+#endif // _STATEHASH_H
@@ -2,18 +2,21 @@
 #define _BK_H
 
 #include "resources/bk_info.h"
-#include "utils/hashmap.h"
+#include "utils/flatmap.h"
 #include "utils/vector.h"
 
+#define BK_MAX_INFOS 50
+
 typedef struct bk_t {
     int file_id;
     surface background;
-    hashmap infos;
+    flatmap infos;
     vector palettes;
     char sound_translation_table[30];
 } bk;
 
 void bk_create(bk *b, void *src);
+/* NULL if there is no animation with this id. Walk ids upwards where order matters. */
 bk_info* bk_get_info(bk *b, int id);
 palette* bk_get_palette(bk *b, int id);
 char* bk_get_stl(bk *b);
@@ -3,6 +3,7 @@
 
 int sounds_loader_init();
 int sounds_loader_get(int id, char **buffer, int *len);
+int sounds_loader_count();
 void sounds_loader_close();
 
 #endif // _SOUNDS_LOADER_H
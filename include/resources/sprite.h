@@ -5,10 +5,15 @@
 #include "video/surface.h"
 #include "utils/vec.h"
 
+// Shadows are squashed to this fraction of the sprite height
+#define SPRITE_SHADOW_SCALE 0.25f
+#define SPRITE_SHADOW_OPACITY 50
+
 typedef struct sprite_t {
     int id;
     vec2i pos;
     surface *data;
+    surface *shadows[4]; // Shadow masks by flip mode, built when first needed
 } sprite;
 
 void sprite_create(sprite *sp, void *src, int id);
@@ -16,6 +21,8 @@ void sprite_create_custom(sprite *sp, vec2i pos, surface *sur);
 void sprite_free(sprite *sp);
 
 vec2i sprite_get_size(sprite *s);
+/* Returns NULL if the shadow would be less than a pixel high */
+surface* sprite_get_shadow(sprite *sp, unsigned int flip_mode);
 sprite* sprite_copy(sprite *src);
 
 #endif // _SPRITE_H
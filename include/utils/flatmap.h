@@ -0,0 +1,54 @@
+#ifndef _FLATMAP_H
+#define _FLATMAP_H
+
+#include "utils/iterator.h"
+#include "utils/allocator.h"
+
+/*
+ * Open addressing hashmap with fixed size keys and values, stored inline in a
+ * single slot array. Collisions are resolved with Robin Hood linear probing,
+ * and deletes shift the following entries back, so there are no tombstones.
+ * The capacity doubles whenever the map would get more than 7/8 full.
+ *
+ * The i-functions are a faster path for maps created with unsigned int keys.
+ *
+ * Values may move on any put or delete, so pointers returned by the map are
+ * only valid until the next change. Iteration works like with the hashmap,
+ * and entries may be removed while iterating with flatmap_delete, but not
+ * added. A map can only have one iterator running at a time.
+ */
+
+typedef struct flatmap_pair_t {
+    unsigned int keylen, vallen;
+    void *key, *val;
+} flatmap_pair;
+
+typedef struct flatmap_t {
+    char *slots;
+    unsigned int capacity; // Power of two
+    unsigned int reserved;
+    unsigned int keylen;
+    unsigned int vallen;
+    unsigned int valoffset;
+    unsigned int slotlen;
+    flatmap_pair cursor; // Pair returned by the iterator
+    allocator alloc;
+} flatmap;
+
+void flatmap_create(flatmap *fm, unsigned int keylen, unsigned int vallen);
+void flatmap_create_with_allocator(flatmap *fm, unsigned int keylen, unsigned int vallen, allocator alloc);
+void flatmap_free(flatmap *fm);
+void flatmap_clear(flatmap *fm);
+void flatmap_reserve(flatmap *fm, unsigned int count);
+unsigned int flatmap_size(const flatmap *fm);
+unsigned int flatmap_reserved(const flatmap *fm);
+void* flatmap_put(flatmap *fm, const void *key, const void *val);
+void* flatmap_get(const flatmap *fm, const void *key);
+int flatmap_del(flatmap *fm, const void *key);
+void* flatmap_iput(flatmap *fm, unsigned int key, const void *val);
+void* flatmap_iget(const flatmap *fm, unsigned int key);
+int flatmap_idel(flatmap *fm, unsigned int key);
+void flatmap_iter_begin(flatmap *fm, iterator *iter);
+int flatmap_delete(flatmap *fm, iterator *iter);
+
+#endif // _FLATMAP_H
@@ -16,8 +16,20 @@
 #define LOGTICK(x) _log_tick = x;
 extern unsigned int _log_tick;
 
+/*
+ * Lines are formatted on the calling thread into a bounded ring buffer, and
+ * written out by a background thread. If the ring is full, lines are dropped
+ * and the number of dropped lines is logged instead.
+ */
 void log_print(char mode, const char* fn, const char *fmt, ...);
 int log_init(const char *filename);
 void log_close();
 
+/* Runtime filtering. Level is 'D', 'I' or 'E'; lines below it are skipped. */
+void log_set_level(char mode);
+char log_get_level();
+/* Skips debug builds' lines from functions whose name starts with prefix (eg. "har_") */
+int log_mute(const char *prefix);
+int log_unmute(const char *prefix);
+
 #endif // _LOG_H
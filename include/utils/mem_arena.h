@@ -0,0 +1,45 @@
+#ifndef _MEM_ARENA_H
+#define _MEM_ARENA_H
+
+#include <stddef.h>
+#include "utils/allocator.h"
+#include "utils/mem_pool.h"
+
+/*
+ * Bump allocator. Allocations are taken from the end of the current chunk,
+ * and can't be freed one by one; everything goes at once on reset. Reset
+ * keeps the first chunk around for the next round.
+ */
+
+typedef struct mem_arena_chunk_t mem_arena_chunk;
+
+typedef struct mem_arena_t {
+    mem_arena_chunk *chunks; // Newest first
+    size_t chunk_size;
+    mem_stats stats;
+} mem_arena;
+
+void mem_arena_create(mem_arena *arena, size_t chunk_size);
+void mem_arena_free(mem_arena *arena);
+void* mem_arena_alloc(mem_arena *arena, size_t size);
+void mem_arena_reset(mem_arena *arena);
+const mem_stats* mem_arena_get_stats(const mem_arena *arena);
+
+/*
+ * Per thread arena for memory that lives as long as the current scene. The
+ * game state resets it whenever it switches scenes. Freeing memory from the
+ * allocator does nothing.
+ */
+allocator mem_arena_scene_allocator();
+void mem_arena_scene_reset();
+void mem_arena_scene_stats(mem_stats *stats);
+void mem_arena_scene_close();
+
+/*
+ * Puts another scene arena in place on this thread and returns the old one,
+ * for running several game states on one thread. NULL makes a new arena on
+ * first use.
+ */
+mem_arena* mem_arena_scene_swap(mem_arena *arena);
+
+#endif // _MEM_ARENA_H
@@ -0,0 +1,66 @@
+#ifndef _MEM_POOL_H
+#define _MEM_POOL_H
+
+#include <stddef.h>
+#include "utils/allocator.h"
+
+/*
+ * Fixed size memory pools. Items are carved out of blocks that are allocated
+ * as needed and kept until the pool is freed; released items go on a free
+ * list and are handed out again before the pool grows.
+ *
+ * Releasing a pointer that did not come from the pool passes it to free(),
+ * so call sites can move over to a pool one at a time.
+ */
+
+typedef struct mem_stats_t {
+    unsigned int allocs;
+    unsigned int frees;
+    unsigned int in_use;
+    unsigned int peak;
+    size_t reserved; // Bytes held from the system
+} mem_stats;
+
+typedef struct mem_pool_t {
+    unsigned int item_size;
+    unsigned int per_block;
+    void *free_list;
+    char **blocks;
+    unsigned int block_count;
+    int tag; // Memory tracking tag for the blocks
+    mem_stats stats;
+} mem_pool;
+
+void mem_pool_create(mem_pool *pool, unsigned int item_size, unsigned int per_block);
+void mem_pool_free(mem_pool *pool);
+void* mem_pool_alloc(mem_pool *pool);
+void mem_pool_release(mem_pool *pool, void *ptr);
+int mem_pool_owns(const mem_pool *pool, const void *ptr);
+const mem_stats* mem_pool_get_stats(const mem_pool *pool);
+
+/*
+ * Shared pools. Every thread gets its own set, created on first use; memory
+ * must be released on the thread that allocated it. The node pools back
+ * mem_pool_allocator(), which serves small allocations from size classes
+ * and anything larger from malloc. Nodes remember their pool, so a node
+ * handed off to another thread still goes back to the right pool once the
+ * owning thread is done with it; the pools themselves are not locked.
+ */
+enum {
+    MEM_POOL_OBJECT = 0,
+    MEM_POOL_CTRL_EVENT,
+    MEM_POOL_NODE_32,
+    MEM_POOL_NODE_64,
+    MEM_POOL_NODE_128,
+    MEM_POOL_COUNT
+};
+
+mem_pool* mem_pool_shared(int id, unsigned int item_size);
+void mem_pool_shared_stats(int id, mem_stats *stats);
+const char* mem_pool_shared_name(int id);
+void mem_pool_shared_close();
+
+/* For lists, hashmaps and other containers that allocate many small nodes */
+allocator mem_pool_allocator();
+
+#endif // _MEM_POOL_H
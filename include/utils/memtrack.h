@@ -0,0 +1,73 @@
+#ifndef _MEMTRACK_H
+#define _MEMTRACK_H
+
+#include <stdlib.h>
+
+/*
+ * Allocation tracking. Call sites that own a buffer allocate and free it with
+ * MEM_ALLOC/MEM_REALLOC/MEM_FREE and a subsystem tag; memory that lives
+ * outside of the heap (eg. textures on the GPU) is reported with
+ * MEM_EXTERNAL. Everything compiles down to plain malloc and free unless the
+ * USE_MEMTRACK build option is set.
+ *
+ * Memory from MEM_ALLOC must go back through MEM_FREE and vice versa; the
+ * tracked allocator keeps a small header in front of every block.
+ *
+ * MEM_TAG_SCOPE is for shared helpers like surfaces. It charges the memory to
+ * the innermost MEM_SCOPE_BEGIN tag on the current thread, or to
+ * MEM_TAG_VIDEO when no scope is open, so that eg. sprites decoded by the AF
+ * loader are counted as resources.
+ */
+
+enum {
+    MEM_TAG_OTHER = 0,
+    MEM_TAG_VIDEO,
+    MEM_TAG_TEXTURES, // Estimate, from texture sizes
+    MEM_TAG_RESOURCES,
+    MEM_TAG_AUDIO,
+    MEM_TAG_OBJECTS,
+    MEM_TAG_GUI,
+    MEM_TAG_NET,
+    MEM_TAG_COUNT,
+    MEM_TAG_SCOPE = MEM_TAG_COUNT
+};
+
+#ifdef USE_MEMTRACK
+#define MEM_ALLOC(tag, size) memtrack_malloc(tag, size)
+#define MEM_REALLOC(tag, ptr, size) memtrack_realloc(tag, ptr, size)
+#define MEM_FREE(ptr) memtrack_free(ptr)
+#define MEM_EXTERNAL(tag, bytes) memtrack_external(tag, bytes)
+#define MEM_SCOPE_BEGIN(tag) memtrack_scope_begin(tag)
+#define MEM_SCOPE_END() memtrack_scope_end()
+#else
+#define MEM_ALLOC(tag, size) malloc(size)
+#define MEM_REALLOC(tag, ptr, size) realloc(ptr, size)
+#define MEM_FREE(ptr) free(ptr)
+#define MEM_EXTERNAL(tag, bytes)
+#define MEM_SCOPE_BEGIN(tag)
+#define MEM_SCOPE_END()
+#endif
+
+typedef struct memtrack_stats_t {
+    long live; // Bytes
+    long peak;
+    unsigned int allocs;
+    unsigned int frees;
+} memtrack_stats;
+
+void* memtrack_malloc(int tag, size_t size);
+void* memtrack_realloc(int tag, void *ptr, size_t size);
+void memtrack_free(void *ptr);
+void memtrack_external(int tag, long bytes);
+void memtrack_scope_begin(int tag);
+void memtrack_scope_end();
+
+/* Returns 0 when tracking is not compiled in */
+int memtrack_enabled();
+const char* memtrack_tag_name(int tag);
+void memtrack_get_stats(int tag, memtrack_stats *stats);
+
+/* Logs every tag that still has live memory; call when everything is closed */
+void memtrack_report();
+
+#endif // _MEMTRACK_H
@@ -0,0 +1,47 @@
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+/*
+ * Frame profiler. Code is instrumented with PROFILE_BEGIN/PROFILE_END pairs,
+ * which compile to nothing unless the USE_PROFILER build option is set. Only
+ * the thread that called profiler_init records anything, so code that also
+ * runs on worker threads (eg. the game state in tournaments) can be instrumented.
+ *
+ * Zone times are averaged over PROFILER_WINDOW frames for the overlay. If a
+ * trace file is given, every zone is also written out in the Chrome trace
+ * event format, for chrome://tracing or Perfetto.
+ */
+
+#define PROFILER_MAX_ZONES 32
+#define PROFILER_MAX_DEPTH 16
+#define PROFILER_WINDOW 60
+
+#ifdef USE_PROFILER
+#define PROFILE_BEGIN(name) profiler_begin(name)
+#define PROFILE_END() profiler_end()
+#define PROFILE_FRAME() profiler_frame()
+#else
+#define PROFILE_BEGIN(name)
+#define PROFILE_END()
+#define PROFILE_FRAME()
+#endif
+
+typedef struct profiler_zone_stats_t {
+    const char *name;
+    int depth;
+    float avg_ms; // Per frame
+    float max_ms; // Slowest frame in the window
+} profiler_zone_stats;
+
+int profiler_init(const char *trace_file);
+void profiler_close();
+
+/* Zone names must be string constants; zones are told apart by the pointer */
+void profiler_begin(const char *name);
+void profiler_end();
+void profiler_frame();
+
+/* Stats for the last full window, in the order the zones were first seen */
+int profiler_get_stats(const profiler_zone_stats **stats);
+
+#endif // _PROFILER_H
@@ -22,7 +22,25 @@ uint32_t random_intmax(struct random_t *r);
 float random_float(struct random_t *r);
 
 
-/* Same as the above but keeps an internal state
+/* Independent global streams (one set per thread). Anything that must stay in lockstep across
+ * replays and network peers draws from RAND_STREAM_GAME, which is also the one
+ * serialized with the game state. Menus, cutscenes and the like use
+ * RAND_STREAM_MENU, so that they can't shift gameplay outcomes. Controllers are
+ * seeded from RAND_STREAM_CONTROLLER and then keep their own state.
+ */
+enum {
+    RAND_STREAM_GAME = 0,
+    RAND_STREAM_MENU,
+    RAND_STREAM_CONTROLLER,
+    RAND_STREAM_COUNT
+};
+
+struct random_t* rand_stream(int stream);
+
+/* Seeds all streams from one value */
+void rand_seed_streams(uint32_t seed);
+
+/* Same as the above but keeps an internal state (RAND_STREAM_GAME)
  * Use as a replacement for rand()
 */
 void rand_seed(uint32_t seed);
@@ -0,0 +1,44 @@
+#ifndef _CAPTURE_H
+#define _CAPTURE_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * Gameplay capture. Every rendered frame is read back at native resolution
+ * and handed to a background writer thread through a bounded queue. The writer
+ * delta-encodes the frame against the previous one, compresses it (if zlib is
+ * available) and appends it to the capture stream file.
+ *
+ * If the writer falls behind, frames are dropped instead of stalling the game.
+ * Dropped frames are written to the stream as empty FRAME_DROPPED records,
+ * so that the gaps stay visible to any tool that reads the stream.
+ *
+ * If the file name has a frame number in it (eg. "frames/%06u.png"), every
+ * frame is written as its own image instead, with the screenshot writers in
+ * video/image.h: PNG if available, otherwise TGA. Dropped frames then show up
+ * as gaps in the numbering.
+ */
+
+#define CAPTURE_MAGIC "OMFCAP01"
+#define CAPTURE_QUEUE_SIZE 8
+#define CAPTURE_KEYFRAME_INTERVAL 60
+
+enum {
+    CAPTURE_FRAME_KEY = 0,
+    CAPTURE_FRAME_DELTA,
+    CAPTURE_FRAME_DROPPED
+};
+
+enum {
+    CAPTURE_COMPRESSION_NONE = 0,
+    CAPTURE_COMPRESSION_DEFLATE
+};
+
+int capture_start(const char *filename);
+void capture_stop();
+int capture_is_running();
+void capture_grab(SDL_Renderer *renderer, int scale_factor);
+unsigned int capture_get_frames();
+unsigned int capture_get_dropped();
+
+#endif // _CAPTURE_H
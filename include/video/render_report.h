@@ -0,0 +1,20 @@
+#ifndef _RENDER_REPORT_H
+#define _RENDER_REPORT_H
+
+#include <stdint.h>
+
+/*
+ * Frame report for offscreen rendering. Every rendered frame is recorded with
+ * its render time and a hash of the finished image. On stop, the frames are
+ * written to a CSV file, or to a JSON file with a summary if the file name ends
+ * in ".json". The sequence hash covers the hashes of all frames, so two runs
+ * produced the same pixels only if it matches.
+ */
+
+#define RENDER_REPORT_DEFAULT_FRAMES 300 // Frames per scene in scripted runs
+
+int render_report_start(const char *filename);
+void render_report_frame(unsigned int scene_id, unsigned int tick, double render_ms, uint32_t hash);
+void render_report_stop();
+
+#endif // _RENDER_REPORT_H
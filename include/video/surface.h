@@ -41,6 +41,7 @@ void surface_sub(surface *dst,
                  int src_x, int src_y,
                  int w, int h,
                  int method);
+void surface_create_shadow(surface *dst, const surface *src, int h, SDL_RendererFlip flip, uint8_t alpha);
 void surface_convert_to_rgba(surface *sur, screen_palette *pal, int pal_offset);
 int surface_get_type(surface *sur);
 void surface_to_rgba(surface *sur,
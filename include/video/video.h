@@ -38,6 +38,13 @@ int video_reinit(int window_w,
                  int vsync,
                  const char* scaler_name,
                  int scale_factor);
+void video_init_headless();
+
+/* Renders into a surface with the software renderer; no window or display is needed */
+int video_init_offscreen(const char* scaler_name, int scale_factor);
+int video_is_offscreen();
+/* Hash of the last finished offscreen frame, as composited to the screen */
+uint32_t video_offscreen_hash();
 void video_reinit_renderer();
 void video_get_state(int *w, int *h, int *fs, int *vsync);
 void video_move_target(int x, int y);
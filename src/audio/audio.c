@@ -3,6 +3,8 @@
 #include "audio/audio.h"
 #include "audio/sink.h"
 #include "audio/sinks/openal_sink.h"
+#include "audio/sinks/sdl_sink.h"
+#include "audio/sinks/wav_sink.h"
 #include "utils/log.h"
 
 audio_sink *_global_sink = NULL;
@@ -17,6 +19,8 @@ struct sink_info_t {
 #ifdef USE_SDLAUDIO
     {sdl_sink_init, "sdl"},
 #endif // USE_SDLAUDIO
+    {null_sink_init, "null"},
+    {wav_sink_init, "wav"},
     {0, 0}
 };
 
@@ -53,9 +57,9 @@ int audio_is_sink_available(const char* sink_name) {
     return 0;
 }
 
-void audio_render() {
+void audio_render(unsigned int ticks) {
     if(_global_sink != NULL) {
-        sink_render(_global_sink);
+        sink_render(_global_sink, ticks);
     }
 }
 
@@ -5,6 +5,7 @@
 #endif // __linux__
 #include "resources/pathmanager.h"
 #include "audio/music.h"
+#include "audio/music_cache.h"
 #include "audio/audio.h"
 #include "utils/log.h"
 #include "game/utils/settings.h"
@@ -15,10 +16,17 @@
 #include "audio/sources/vorbis_source.h"
 
 #ifdef STANDALONE_SERVER
-int music_play(const char *filename) { return 0; }
+void music_init() {}
+void music_close() {}
+int music_play(unsigned int id) { return 0; }
+int music_reload() { return 0; }
 void music_set_volume(float volume) {}
 void music_stop() {}
 int music_playing() { return 1; }
+unsigned int music_get_resource() { return 0; }
+module_source* music_get_module_sources() { return NULL; }
+audio_source_freq* music_module_get_freqs(int id) { return NULL; }
+audio_source_resampler* music_module_get_resamplers(int id) { return NULL; }
 #else // STANDALONE_SERVER
 
 struct music_override_t {
@@ -111,6 +119,39 @@ const char* get_file_or_override(unsigned int id) {
     return pm_get_resource_path(id);
 }
 
+static int music_open_module(audio_source *src, const music_cache_key *key) {
+    switch(key->library) {
+#ifdef USE_DUMB
+        case 0:
+            return dumb_source_init(src, key->file, key->channels, key->frequency, key->resampler);
+#endif
+#ifdef USE_MODPLUG
+        case 1:
+            return modplug_source_init(src, key->file, key->channels, key->frequency, key->resampler);
+#endif
+#ifdef USE_XMP
+        case 2:
+            return xmp_source_init(src, key->file, key->channels, key->frequency, key->resampler);
+#endif
+    }
+    return 1;
+}
+
+void music_init() {
+    int megabytes = settings_get()->sound.music_cache_size;
+    if(megabytes < 0) {
+        megabytes = 0;
+    }
+    if(megabytes > MUSIC_CACHE_MAX_MB) {
+        megabytes = MUSIC_CACHE_MAX_MB;
+    }
+    music_cache_init((size_t)megabytes * 1024 * 1024, music_open_module);
+}
+
+void music_close() {
+    music_cache_close();
+}
+
 int music_play(unsigned int id) {
     audio_sink *sink = audio_get_sink();
 
@@ -142,25 +183,23 @@ int music_play(unsigned int id) {
         goto error_0;
     }
 
-    // Try to open as module file
+    // Try to open as module file. Play it from the cache if it has been rendered
+    // already; otherwise stream it, and have it rendered for the next time.
     int failed = 1;
     if(strcasecmp(ext, "psm") == 0) {
-        switch(modlib) {
-#ifdef USE_DUMB
-            case 0:
-                failed = dumb_source_init(music_src, filename, channels, freq, resampler);
-                break;
-#endif
-#ifdef USE_MODPLUG
-            case 1:
-                failed = modplug_source_init(music_src, filename, channels, freq, resampler);
-                break;
-#endif
-#ifdef USE_XMP
-            case 2:
-                failed = xmp_source_init(music_src, filename, channels, freq, resampler);
-                break;
-#endif
+        music_cache_key key;
+        memset(&key, 0, sizeof(music_cache_key));
+        strncpy(key.file, filename, sizeof(key.file) - 1);
+        key.library = modlib;
+        key.frequency = freq;
+        key.channels = channels;
+        key.resampler = resampler;
+        failed = music_cache_source_init(music_src, &key);
+        if(failed) {
+            failed = music_open_module(music_src, &key);
+            if(!failed) {
+                music_cache_request(&key);
+            }
         }
     }
 
@@ -0,0 +1,273 @@
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "audio/music_cache.h"
+#include "utils/vector.h"
+#include "utils/log.h"
+#include "utils/memtrack.h"
+
+#define MUSIC_CACHE_CHUNK 4096 // Bytes rendered per source update
+#define MUSIC_CACHE_INITIAL_SIZE (1024*1024)
+
+typedef struct music_cache_entry_t {
+    music_cache_key key;
+    char *data;
+    unsigned int size;
+    unsigned int last_used;
+    int refs; // Sources playing from this entry, plus one while it is in the cache
+} music_cache_entry;
+
+typedef struct cache_source_t {
+    music_cache_entry *entry;
+    unsigned int pos;
+} cache_source;
+
+typedef struct music_cache_t {
+    SDL_mutex *lock;
+    vector entries; // music_cache_entry*
+    unsigned int max_bytes;
+    unsigned int used_bytes;
+    unsigned int use_count;
+    music_cache_open_cb open;
+
+    // Only one render runs at a time
+    SDL_Thread *worker;
+    SDL_atomic_t busy;
+    SDL_atomic_t abort;
+    music_cache_key job;
+} music_cache;
+
+static music_cache *cache = NULL;
+
+static void music_cache_unref(music_cache_entry *e) {
+    if(--e->refs == 0) {
+        MEM_FREE(e->data);
+        free(e);
+    }
+}
+
+static music_cache_entry* music_cache_find(const music_cache_key *key) {
+    iterator it;
+    music_cache_entry **e;
+    vector_iter_begin(&cache->entries, &it);
+    while((e = iter_next(&it)) != NULL) {
+        if(memcmp(&(*e)->key, key, sizeof(music_cache_key)) == 0) {
+            return *e;
+        }
+    }
+    return NULL;
+}
+
+// Drops the least recently used entries until "extra" more bytes fit
+static void music_cache_make_room(unsigned int extra) {
+    while(cache->used_bytes + extra > cache->max_bytes && vector_size(&cache->entries) > 0) {
+        iterator it;
+        music_cache_entry **e;
+        music_cache_entry *oldest = NULL;
+        vector_iter_begin(&cache->entries, &it);
+        while((e = iter_next(&it)) != NULL) {
+            if(oldest == NULL || (*e)->last_used < oldest->last_used) {
+                oldest = *e;
+            }
+        }
+        vector_iter_begin(&cache->entries, &it);
+        while((e = iter_next(&it)) != NULL) {
+            if(*e == oldest) {
+                vector_delete(&cache->entries, &it);
+                break;
+            }
+        }
+        DEBUG("Music cache: Dropped '%s' (%u bytes).", oldest->key.file, oldest->size);
+        cache->used_bytes -= oldest->size;
+        music_cache_unref(oldest);
+    }
+}
+
+static int music_cache_worker(void *data) {
+    music_cache_key *key = data;
+    unsigned int start = SDL_GetTicks();
+    audio_source src;
+    source_init(&src);
+    if(cache->open(&src, key)) {
+        PERROR("Music cache: Unable to open '%s' for rendering.", key->file);
+        goto exit_0;
+    }
+
+    // One pass through the module; the cached source does the looping
+    source_set_loop(&src, 0);
+    unsigned int size = 0;
+    unsigned int reserved = MUSIC_CACHE_INITIAL_SIZE;
+    char *buf = MEM_ALLOC(MEM_TAG_AUDIO, reserved);
+    while(!SDL_AtomicGet(&cache->abort)) {
+        if(reserved - size < MUSIC_CACHE_CHUNK) {
+            if(reserved >= cache->max_bytes) {
+                DEBUG("Music cache: '%s' does not fit in the cache.", key->file);
+                goto exit_1;
+            }
+            reserved *= 2;
+            buf = MEM_REALLOC(MEM_TAG_AUDIO, buf, reserved);
+        }
+        int ret = source_update(&src, buf + size, MUSIC_CACHE_CHUNK);
+        if(ret <= 0) {
+            break;
+        }
+        size += ret;
+    }
+    if(SDL_AtomicGet(&cache->abort) || size == 0 || size > cache->max_bytes) {
+        goto exit_1;
+    }
+
+    music_cache_entry *e = malloc(sizeof(music_cache_entry));
+    e->key = *key;
+    e->data = MEM_REALLOC(MEM_TAG_AUDIO, buf, size);
+    e->size = size;
+    e->refs = 1;
+
+    SDL_LockMutex(cache->lock);
+    music_cache_make_room(size);
+    e->last_used = cache->use_count++;
+    cache->used_bytes += size;
+    vector_append(&cache->entries, &e);
+    SDL_UnlockMutex(cache->lock);
+    INFO("Music cache: Rendered '%s' (%u bytes) in %u ms.", key->file, size, SDL_GetTicks() - start);
+    source_free(&src);
+    SDL_AtomicSet(&cache->busy, 0);
+    return 0;
+
+exit_1:
+    MEM_FREE(buf);
+    source_free(&src);
+exit_0:
+    SDL_AtomicSet(&cache->busy, 0);
+    return 1;
+}
+
+int cache_source_update(audio_source *src, char *buffer, int len) {
+    cache_source *local = source_get_userdata(src);
+    const music_cache_entry *e = local->entry;
+    int done = 0;
+    while(done < len) {
+        if(local->pos >= e->size) {
+            if(!source_get_loop(src)) {
+                break;
+            }
+            local->pos = 0;
+        }
+        unsigned int left = e->size - local->pos;
+        unsigned int n = (len - done < left) ? (unsigned int)(len - done) : left;
+        memcpy(buffer + done, e->data + local->pos, n);
+        local->pos += n;
+        done += n;
+    }
+    return done;
+}
+
+void cache_source_close(audio_source *src) {
+    cache_source *local = source_get_userdata(src);
+    if(cache != NULL) {
+        SDL_LockMutex(cache->lock);
+        music_cache_unref(local->entry);
+        SDL_UnlockMutex(cache->lock);
+    } else {
+        music_cache_unref(local->entry);
+    }
+    free(local);
+}
+
+int music_cache_source_init(audio_source *src, const music_cache_key *key) {
+    if(cache == NULL) {
+        return 1;
+    }
+    SDL_LockMutex(cache->lock);
+    music_cache_entry *e = music_cache_find(key);
+    if(e != NULL) {
+        e->refs++;
+        e->last_used = cache->use_count++;
+    }
+    SDL_UnlockMutex(cache->lock);
+    if(e == NULL) {
+        return 1;
+    }
+
+    cache_source *local = malloc(sizeof(cache_source));
+    local->entry = e;
+    local->pos = 0;
+
+    // Audio information
+    source_set_frequency(src, key->frequency);
+    source_set_bytes(src, 2);
+    source_set_channels(src, key->channels);
+    source_set_resampler(src, key->resampler);
+
+    // Set callbacks
+    source_set_userdata(src, local);
+    source_set_update_cb(src, cache_source_update);
+    source_set_close_cb(src, cache_source_close);
+
+    DEBUG("Music cache: Playing '%s' from the cache.", key->file);
+    return 0;
+}
+
+void music_cache_request(const music_cache_key *key) {
+    if(cache == NULL || SDL_AtomicGet(&cache->busy)) {
+        return;
+    }
+    SDL_LockMutex(cache->lock);
+    music_cache_entry *e = music_cache_find(key);
+    SDL_UnlockMutex(cache->lock);
+    if(e != NULL) {
+        return;
+    }
+
+    // Reap the previous render before starting the next one
+    if(cache->worker != NULL) {
+        SDL_WaitThread(cache->worker, NULL);
+        cache->worker = NULL;
+    }
+    cache->job = *key;
+    SDL_AtomicSet(&cache->busy, 1);
+    cache->worker = SDL_CreateThread(music_cache_worker, "music cache", &cache->job);
+    if(cache->worker == NULL) {
+        PERROR("Music cache: Unable to start render thread: %s", SDL_GetError());
+        SDL_AtomicSet(&cache->busy, 0);
+    }
+}
+
+void music_cache_init(unsigned int max_bytes, music_cache_open_cb open) {
+    if(max_bytes == 0) {
+        return;
+    }
+    cache = malloc(sizeof(music_cache));
+    memset(cache, 0, sizeof(music_cache));
+    cache->lock = SDL_CreateMutex();
+    cache->max_bytes = max_bytes;
+    cache->open = open;
+    vector_create(&cache->entries, sizeof(music_cache_entry*));
+    SDL_AtomicSet(&cache->busy, 0);
+    SDL_AtomicSet(&cache->abort, 0);
+    INFO("Music cache: Enabled with %u bytes.", max_bytes);
+}
+
+void music_cache_close() {
+    if(cache == NULL) {
+        return;
+    }
+    if(cache->worker != NULL) {
+        SDL_AtomicSet(&cache->abort, 1);
+        SDL_WaitThread(cache->worker, NULL);
+    }
+
+    // Entries that are still playing are freed by their sources
+    SDL_LockMutex(cache->lock);
+    iterator it;
+    music_cache_entry **e;
+    vector_iter_begin(&cache->entries, &it);
+    while((e = iter_next(&it)) != NULL) {
+        music_cache_unref(*e);
+    }
+    vector_free(&cache->entries);
+    SDL_UnlockMutex(cache->lock);
+    SDL_DestroyMutex(cache->lock);
+    free(cache);
+    cache = NULL;
+}
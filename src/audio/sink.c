@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include "audio/sink.h"
 #include "utils/log.h"
+#include "utils/memtrack.h"
 
 unsigned int _sink_global_id = 1;
 
@@ -11,10 +12,9 @@ unsigned int gid_gen() {
 audio_stream* sink_get_stream(audio_sink *sink, unsigned int sid) {
     if(sid == 0) return NULL;
     if(sink == NULL) return NULL;
-    audio_stream **s;
-    unsigned int len;
-    if(hashmap_iget(&sink->streams, sid, (void**)&s, &len) != 0) {
-    	return NULL;
+    audio_stream **s = flatmap_iget(&sink->streams, sid);
+    if(s == NULL) {
+        return NULL;
     }
     return *s;
 }
@@ -22,8 +22,12 @@ audio_stream* sink_get_stream(audio_sink *sink, unsigned int sid) {
 void sink_init(audio_sink *sink) {
     sink->userdata = NULL;
     sink->close = NULL;
+    sink->render = NULL;
     sink->format_stream = NULL;
-    hashmap_create(&sink->streams, 6);
+    sink->upload_sample = NULL;
+    sink->play_sample = NULL;
+    sink->sample_playing = NULL;
+    flatmap_create(&sink->streams, sizeof(unsigned int), sizeof(audio_stream*));
 }
 
 void sink_format_stream(audio_sink *sink, audio_stream *stream) {
@@ -37,20 +41,44 @@ int sink_is_playing(audio_sink *sink, int sid) {
     return 0;
 }
 
+int sink_has_samples(audio_sink *sink) {
+    return (sink->play_sample != NULL);
+}
+
+int sink_upload_sample(audio_sink *sink, int id, const char *buf, int len) {
+    if(sink->upload_sample != NULL) {
+        return sink->upload_sample(sink, id, buf, len);
+    }
+    return 1;
+}
+
+void sink_play_sample(audio_sink *sink, int id, float volume, float panning, float pitch) {
+    if(sink->play_sample != NULL) {
+        sink->play_sample(sink, id, volume, panning, pitch);
+    }
+}
+
+int sink_is_sample_playing(audio_sink *sink, int id) {
+    if(sink->sample_playing != NULL) {
+        return sink->sample_playing(sink, id);
+    }
+    return 0;
+}
+
 void sink_play(audio_sink *sink,
 			   audio_source *src,
                int id,
 			   float volume,
 			   float panning,
 			   float pitch) {
-    audio_stream *stream = malloc(sizeof(audio_stream));
+    audio_stream *stream = MEM_ALLOC(MEM_TAG_AUDIO, sizeof(audio_stream));
     stream_init(stream, sink, src);
     sink_format_stream(sink, stream);
     stream->volume = volume;
     stream->panning = panning;
     stream->pitch = pitch;
     stream_play(stream);
-    hashmap_iput(&sink->streams, id, &stream, sizeof(audio_stream*));
+    flatmap_iput(&sink->streams, id, &stream);
 }
 
 void sink_stop(audio_sink *sink, int sid) {
@@ -58,14 +86,14 @@ void sink_stop(audio_sink *sink, int sid) {
     audio_stream *s = sink_get_stream(sink, sid);
     stream_stop(s);
     stream_free(s);
-    free(s);
-    hashmap_idel(&sink->streams, sid);
+    MEM_FREE(s);
+    flatmap_idel(&sink->streams, sid);
 }
 
-void sink_render(audio_sink *sink) {
+void sink_render(audio_sink *sink, unsigned int ticks) {
     iterator it;
-    hashmap_iter_begin(&sink->streams, &it);
-    hashmap_pair *pair;
+    flatmap_iter_begin(&sink->streams, &it);
+    flatmap_pair *pair;
     while((pair = iter_next(&it)) != NULL) {
         audio_stream *stream = *((audio_stream**)pair->val);
         stream_render(stream);
@@ -74,24 +102,28 @@ void sink_render(audio_sink *sink) {
         if(stream_get_status(stream) == STREAM_STATUS_FINISHED) {
             stream_stop(stream);
             stream_free(stream);
-            free(stream);
-            hashmap_delete(&sink->streams, &it);
+            MEM_FREE(stream);
+            flatmap_delete(&sink->streams, &it);
         }
     }
+
+    if(sink->render != NULL) {
+        sink->render(sink, ticks);
+    }
 }
 
 void sink_free(audio_sink *sink) {
     // Free streams
     iterator it;
-    hashmap_iter_begin(&sink->streams, &it);
-    hashmap_pair *pair;
+    flatmap_iter_begin(&sink->streams, &it);
+    flatmap_pair *pair;
     while((pair = iter_next(&it)) != NULL) {
         audio_stream *stream = *((audio_stream**)pair->val);
         stream_stop(stream);
         stream_free(stream);
-        free(stream);
+        MEM_FREE(stream);
     }
-    hashmap_free(&sink->streams);
+    flatmap_free(&sink->streams);
 
     // Close sink
     if(sink->close != NULL) {
@@ -144,6 +176,22 @@ void sink_set_close_cb(audio_sink *sink, sink_close_cb cbfunc) {
     sink->close = cbfunc;
 }
 
+void sink_set_render_cb(audio_sink *sink, sink_render_cb cbfunc) {
+    sink->render = cbfunc;
+}
+
 void sink_set_format_stream_cb(audio_sink *sink, sink_format_stream_cb cbfunc) {
     sink->format_stream = cbfunc;
 }
+
+void sink_set_upload_sample_cb(audio_sink *sink, sink_upload_sample_cb cbfunc) {
+    sink->upload_sample = cbfunc;
+}
+
+void sink_set_play_sample_cb(audio_sink *sink, sink_play_sample_cb cbfunc) {
+    sink->play_sample = cbfunc;
+}
+
+void sink_set_sample_playing_cb(audio_sink *sink, sink_sample_playing_cb cbfunc) {
+    sink->sample_playing = cbfunc;
+}
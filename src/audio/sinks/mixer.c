@@ -0,0 +1,435 @@
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "audio/sinks/mixer.h"
+#include "audio/stream.h"
+#include "audio/source.h"
+#include "utils/log.h"
+#include "utils/memtrack.h"
+
+#define MIXER_SAMPLE_FREQUENCY 8000
+#define MIXER_STREAM_BYTES 8192 // Source data decoded per stream refill
+
+enum {
+    VOICE_FREE = 0,
+    VOICE_PLAYING,
+    VOICE_FINISHED
+};
+
+typedef struct mixer_sample_t {
+    float *data; // Mono, with two frames of silence at the end for interpolation
+    int frames;
+} mixer_sample;
+
+typedef struct mixer_voice_t {
+    int state;
+    audio_stream *stream; // NULL if this voice plays a sample
+    int sample_id;
+    double pos;
+    double step;
+    float gain_l;
+    float gain_r;
+    float priority;
+    unsigned int started;
+
+    // Streams only. Decoded source data as stereo frames. Frame 0 repeats the
+    // last frame of the previous refill, so that interpolation carries over.
+    float *buf;
+    int buf_frames;
+} mixer_voice;
+
+struct mixer_t {
+    SDL_mutex *lock;
+    int frequency;
+    void *backend;
+    mixer_backend_close_cb close;
+
+    mixer_sample samples[MIXER_MAX_SAMPLES];
+    mixer_voice voices[MIXER_VOICES];
+    unsigned int play_count;
+
+    // Scratch space for mixer_render
+    char decode[MIXER_STREAM_BYTES];
+    float mix[MIXER_BLOCK_FRAMES*2];
+    float tmp[MIXER_BLOCK_FRAMES*2];
+};
+
+static void mixer_voice_setup(mixer *m, mixer_voice *v, int src_freq, float volume, float panning, float pitch) {
+    v->gain_l = volume * ((panning > 0.0f) ? 1.0f - panning : 1.0f);
+    v->gain_r = volume * ((panning < 0.0f) ? 1.0f + panning : 1.0f);
+    v->step = (double)src_freq * pitch / m->frequency;
+}
+
+// Frames that can be produced before the position passes the given limit
+static int mixer_voice_span(mixer_voice *v, int limit, int frames) {
+    double left = (limit - v->pos) / v->step;
+    if(left <= 0) {
+        return 0;
+    }
+    int n = (int)left;
+    if(n < left) {
+        n++;
+    }
+    return (n < frames) ? n : frames;
+}
+
+// Decodes the next chunk of the stream source. Returns 1 if the source is done.
+static int mixer_voice_refill(mixer *m, mixer_voice *v) {
+    audio_source *src = v->stream->src;
+    int bytes = source_get_bytes(src);
+    int channels = source_get_channels(src);
+    int frame_size = bytes * channels;
+    int len = source_update(src, m->decode, MIXER_STREAM_BYTES - MIXER_STREAM_BYTES % frame_size);
+    int frames = len / frame_size;
+    if(frames <= 0) {
+        return 1;
+    }
+
+    float *buf = v->buf;
+    int last = v->buf_frames - 1;
+    buf[0] = buf[last*2];
+    buf[1] = buf[last*2+1];
+    for(int i = 0; i < frames; i++) {
+        float l, r;
+        if(bytes == 1) {
+            const unsigned char *in = (unsigned char*)m->decode + i * channels;
+            l = (in[0] - 128) / 128.0f;
+            r = (channels == 2) ? (in[1] - 128) / 128.0f : l;
+        } else {
+            const int16_t *in = (int16_t*)m->decode + i * channels;
+            l = in[0] / 32768.0f;
+            r = (channels == 2) ? in[1] / 32768.0f : l;
+        }
+        buf[(i+1)*2] = l;
+        buf[(i+1)*2+1] = r;
+    }
+    v->buf_frames = frames + 1;
+    v->pos -= last;
+    return 0;
+}
+
+// The loops below are kept free of branches and aliasing, so that the compiler
+// can vectorize them.
+static void mixer_resample_mono(float *restrict out, const float *restrict in, int frames,
+                                double pos, double step, float gain_l, float gain_r) {
+    for(int i = 0; i < frames; i++) {
+        double p = pos + i * step;
+        int idx = (int)p;
+        float frac = (float)(p - idx);
+        float x = in[idx] + (in[idx+1] - in[idx]) * frac;
+        out[i*2] = x * gain_l;
+        out[i*2+1] = x * gain_r;
+    }
+}
+
+static void mixer_resample_stereo(float *restrict out, const float *restrict in, int frames,
+                                  double pos, double step, float gain_l, float gain_r) {
+    for(int i = 0; i < frames; i++) {
+        double p = pos + i * step;
+        int idx = (int)p;
+        float frac = (float)(p - idx);
+        float l = in[idx*2] + (in[idx*2+2] - in[idx*2]) * frac;
+        float r = in[idx*2+1] + (in[idx*2+3] - in[idx*2+1]) * frac;
+        out[i*2] = l * gain_l;
+        out[i*2+1] = r * gain_r;
+    }
+}
+
+static void mixer_accumulate(float *restrict dst, const float *restrict src, int len) {
+    for(int i = 0; i < len; i++) {
+        dst[i] += src[i];
+    }
+}
+
+static void mixer_convert(int16_t *restrict dst, const float *restrict src, int len) {
+    for(int i = 0; i < len; i++) {
+        float x = src[i] * 32767.0f;
+        x = (x > 32767.0f) ? 32767.0f : x;
+        x = (x < -32768.0f) ? -32768.0f : x;
+        dst[i] = (int16_t)x;
+    }
+}
+
+// Renders up to "frames" frames of one voice into out. Returns the number of frames written.
+static int mixer_voice_render(mixer *m, mixer_voice *v, float *out, int frames) {
+    int done = 0;
+    if(v->stream == NULL) {
+        mixer_sample *s = &m->samples[v->sample_id];
+        done = mixer_voice_span(v, s->frames, frames);
+        mixer_resample_mono(out, s->data, done, v->pos, v->step, v->gain_l, v->gain_r);
+        v->pos += done * v->step;
+        if(done < frames) {
+            v->state = VOICE_FREE;
+        }
+        return done;
+    }
+
+    while(done < frames) {
+        int n = mixer_voice_span(v, v->buf_frames - 1, frames - done);
+        if(n == 0) {
+            if(mixer_voice_refill(m, v)) {
+                v->state = VOICE_FINISHED;
+                break;
+            }
+            continue;
+        }
+        mixer_resample_stereo(out + done*2, v->buf, n, v->pos, v->step, v->gain_l, v->gain_r);
+        v->pos += n * v->step;
+        done += n;
+    }
+    return done;
+}
+
+void mixer_render(mixer *m, int16_t *out, int frames) {
+    SDL_LockMutex(m->lock);
+    while(frames > 0) {
+        int n = (frames > MIXER_BLOCK_FRAMES) ? MIXER_BLOCK_FRAMES : frames;
+        memset(m->mix, 0, sizeof(float) * n * 2);
+        for(int i = 0; i < MIXER_VOICES; i++) {
+            mixer_voice *v = &m->voices[i];
+            if(v->state != VOICE_PLAYING) {
+                continue;
+            }
+            int got = mixer_voice_render(m, v, m->tmp, n);
+            mixer_accumulate(m->mix, m->tmp, got * 2);
+        }
+        mixer_convert(out, m->mix, n * 2);
+        out += n * 2;
+        frames -= n;
+    }
+    SDL_UnlockMutex(m->lock);
+}
+
+// Stream callbacks. The stream userdata is the voice it plays on, or NULL.
+
+void mixer_stream_apply(audio_stream *stream) {
+    mixer *m = sink_get_userdata(stream->sink);
+    mixer_voice *v = stream_get_userdata(stream);
+    if(v == NULL) {
+        return;
+    }
+    SDL_LockMutex(m->lock);
+    mixer_voice_setup(m, v, source_get_frequency(stream->src), stream->volume, stream->panning, stream->pitch);
+    SDL_UnlockMutex(m->lock);
+}
+
+void mixer_stream_play(audio_stream *stream) {
+    mixer *m = sink_get_userdata(stream->sink);
+    float *buf = MEM_ALLOC(MEM_TAG_AUDIO, sizeof(float) * (MIXER_STREAM_BYTES + 3) * 2);
+    memset(buf, 0, sizeof(float) * 2);
+
+    SDL_LockMutex(m->lock);
+    mixer_voice *v = NULL;
+    for(int i = 0; i < MIXER_VOICES; i++) {
+        if(m->voices[i].state == VOICE_FREE) {
+            v = &m->voices[i];
+            break;
+        }
+    }
+    if(v != NULL) {
+        v->stream = stream;
+        v->sample_id = -1;
+        v->pos = 0;
+        v->buf = buf;
+        v->buf_frames = 1;
+        mixer_voice_setup(m, v, source_get_frequency(stream->src), stream->volume, stream->panning, stream->pitch);
+        v->state = VOICE_PLAYING;
+    }
+    SDL_UnlockMutex(m->lock);
+
+    if(v == NULL) {
+        PERROR("Mixer: No free voices for stream!");
+        MEM_FREE(buf);
+    }
+    stream_set_userdata(stream, v);
+}
+
+void mixer_stream_stop(audio_stream *stream) {
+    mixer *m = sink_get_userdata(stream->sink);
+    mixer_voice *v = stream_get_userdata(stream);
+    if(v == NULL) {
+        return;
+    }
+    SDL_LockMutex(m->lock);
+    float *buf = v->buf;
+    v->state = VOICE_FREE;
+    v->stream = NULL;
+    v->buf = NULL;
+    SDL_UnlockMutex(m->lock);
+    MEM_FREE(buf);
+    stream_set_userdata(stream, NULL);
+}
+
+void mixer_stream_update(audio_stream *stream) {
+    mixer *m = sink_get_userdata(stream->sink);
+    mixer_voice *v = stream_get_userdata(stream);
+    int finished = 1;
+    if(v != NULL) {
+        SDL_LockMutex(m->lock);
+        finished = (v->state == VOICE_FINISHED);
+        SDL_UnlockMutex(m->lock);
+    }
+    if(finished) {
+        stream_set_finished(stream);
+    }
+}
+
+void mixer_sink_format_stream(audio_sink *sink, audio_stream *stream) {
+    stream_set_userdata(stream, NULL);
+    stream_set_play_cb(stream, mixer_stream_play);
+    stream_set_stop_cb(stream, mixer_stream_stop);
+    stream_set_update_cb(stream, mixer_stream_update);
+    stream_set_apply_cb(stream, mixer_stream_apply);
+    stream_set_close_cb(stream, mixer_stream_stop);
+}
+
+// Sample callbacks
+
+int mixer_sink_upload_sample(audio_sink *sink, int id, const char *buf, int len) {
+    mixer *m = sink_get_userdata(sink);
+    if(id < 0 || id >= MIXER_MAX_SAMPLES || len <= 0) {
+        return 1;
+    }
+    float *data = MEM_ALLOC(MEM_TAG_AUDIO, sizeof(float) * (len + 2));
+    for(int i = 0; i < len; i++) {
+        data[i] = ((unsigned char)buf[i] - 128) / 128.0f;
+    }
+    data[len] = 0.0f;
+    data[len+1] = 0.0f;
+
+    SDL_LockMutex(m->lock);
+    mixer_sample *s = &m->samples[id];
+    float *old = s->data;
+    s->data = data;
+    s->frames = len;
+    for(int i = 0; i < MIXER_VOICES; i++) {
+        if(m->voices[i].stream == NULL && m->voices[i].sample_id == id) {
+            m->voices[i].state = VOICE_FREE;
+        }
+    }
+    SDL_UnlockMutex(m->lock);
+    MEM_FREE(old);
+    return 0;
+}
+
+void mixer_sink_play_sample(audio_sink *sink, int id, float volume, float panning, float pitch) {
+    mixer *m = sink_get_userdata(sink);
+    if(id < 0 || id >= MIXER_MAX_SAMPLES || m->samples[id].data == NULL) {
+        return;
+    }
+
+    // Same voice selection as the OpenAL sink: restart the sample if it is
+    // already playing, else take a free voice, else steal the quietest sample
+    // voice (the oldest one on a tie). Stream voices are never stolen.
+    SDL_LockMutex(m->lock);
+    mixer_voice *voice = NULL;
+    mixer_voice *free_voice = NULL;
+    mixer_voice *victim = NULL;
+    for(int i = 0; i < MIXER_VOICES; i++) {
+        mixer_voice *v = &m->voices[i];
+        if(v->state == VOICE_FREE) {
+            if(free_voice == NULL) {
+                free_voice = v;
+            }
+            continue;
+        }
+        if(v->stream != NULL) {
+            continue;
+        }
+        if(v->sample_id == id) {
+            voice = v;
+            break;
+        }
+        if(victim == NULL
+           || v->priority < victim->priority
+           || (v->priority == victim->priority && v->started < victim->started)) {
+            victim = v;
+        }
+    }
+    if(voice == NULL) {
+        voice = free_voice;
+    }
+    if(voice == NULL && victim != NULL && victim->priority <= volume) {
+        voice = victim;
+    }
+    if(voice != NULL) {
+        voice->stream = NULL;
+        voice->sample_id = id;
+        voice->pos = 0;
+        voice->priority = volume;
+        voice->started = m->play_count++;
+        mixer_voice_setup(m, voice, MIXER_SAMPLE_FREQUENCY, volume, panning, pitch);
+        voice->state = VOICE_PLAYING;
+    }
+    SDL_UnlockMutex(m->lock);
+}
+
+int mixer_sink_sample_playing(audio_sink *sink, int id) {
+    mixer *m = sink_get_userdata(sink);
+    int playing = 0;
+    SDL_LockMutex(m->lock);
+    for(int i = 0; i < MIXER_VOICES; i++) {
+        mixer_voice *v = &m->voices[i];
+        if(v->state == VOICE_PLAYING && v->stream == NULL && v->sample_id == id) {
+            playing = 1;
+            break;
+        }
+    }
+    SDL_UnlockMutex(m->lock);
+    return playing;
+}
+
+void mixer_sink_close(audio_sink *sink) {
+    mixer *m = sink_get_userdata(sink);
+
+    // Stop the backend first, so that nothing renders while we tear down
+    if(m->close != NULL) {
+        m->close(m);
+    }
+    for(int i = 0; i < MIXER_VOICES; i++) {
+        MEM_FREE(m->voices[i].buf);
+    }
+    for(int i = 0; i < MIXER_MAX_SAMPLES; i++) {
+        MEM_FREE(m->samples[i].data);
+    }
+    SDL_DestroyMutex(m->lock);
+    free(m);
+    sink_set_userdata(sink, NULL);
+}
+
+int mixer_sink_init(audio_sink *sink, int frequency, void *backend, mixer_backend_close_cb close) {
+    mixer *m = malloc(sizeof(mixer));
+    memset(m, 0, sizeof(mixer));
+    m->lock = SDL_CreateMutex();
+    if(m->lock == NULL) {
+        PERROR("Mixer: Could not create lock: %s", SDL_GetError());
+        free(m);
+        return 1;
+    }
+    m->frequency = frequency;
+    m->backend = backend;
+    m->close = close;
+    for(int i = 0; i < MIXER_VOICES; i++) {
+        m->voices[i].sample_id = -1;
+    }
+
+    sink_set_userdata(sink, m);
+    sink_set_format_stream_cb(sink, mixer_sink_format_stream);
+    sink_set_upload_sample_cb(sink, mixer_sink_upload_sample);
+    sink_set_play_sample_cb(sink, mixer_sink_play_sample);
+    sink_set_sample_playing_cb(sink, mixer_sink_sample_playing);
+    sink_set_close_cb(sink, mixer_sink_close);
+    return 0;
+}
+
+mixer* mixer_sink_get(audio_sink *sink) {
+    return sink_get_userdata(sink);
+}
+
+int mixer_get_frequency(mixer *m) {
+    return m->frequency;
+}
+
+void* mixer_get_backend(mixer *m) {
+    return m->backend;
+}
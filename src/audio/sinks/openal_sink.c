@@ -10,17 +10,132 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
 #include "audio/sinks/openal_sink.h"
 #include "audio/sinks/openal_stream.h"
 #include "utils/log.h"
 
+#define OPENAL_MAX_SAMPLES 512
+#define OPENAL_VOICE_COUNT 16
+
+typedef struct {
+    unsigned int source;
+    int sample_id; // -1 if never used
+    float priority;
+    unsigned int started;
+} openal_voice;
+
 typedef struct {
     ALCdevice *device;
     ALCcontext *context;
+
+    // Sound effects. Each sample lives in its own buffer for the lifetime of the
+    // sink, and plays on one of a fixed set of sources.
+    unsigned int samples[OPENAL_MAX_SAMPLES];
+    openal_voice voices[OPENAL_VOICE_COUNT];
+    int voice_count;
+    unsigned int play_count;
 } openal_sink;
 
+static int openal_voice_busy(openal_voice *v) {
+    if(v->sample_id < 0) {
+        return 0;
+    }
+    ALint state;
+    alGetSourcei(v->source, AL_SOURCE_STATE, &state);
+    return (state == AL_PLAYING);
+}
+
+int openal_sink_upload_sample(audio_sink *sink, int id, const char *buf, int len) {
+    openal_sink *local = sink_get_userdata(sink);
+    if(id < 0 || id >= OPENAL_MAX_SAMPLES) {
+        return 1;
+    }
+    if(local->samples[id] == 0) {
+        alGenBuffers(1, &local->samples[id]);
+    }
+    alBufferData(local->samples[id], AL_FORMAT_MONO8, buf, len, 8000);
+    if(alGetError() != AL_NO_ERROR) {
+        PERROR("OpenAL Sink: Could not upload sample %d!", id);
+        alDeleteBuffers(1, &local->samples[id]);
+        local->samples[id] = 0;
+        return 1;
+    }
+    return 0;
+}
+
+void openal_sink_play_sample(audio_sink *sink, int id, float volume, float panning, float pitch) {
+    openal_sink *local = sink_get_userdata(sink);
+    if(id < 0 || id >= OPENAL_MAX_SAMPLES || local->samples[id] == 0) {
+        return;
+    }
+
+    // A sample that is already playing gets restarted. Otherwise take a free
+    // voice, or steal the one with the lowest priority (the oldest one on a tie).
+    // Priority is the playback volume, so quiet sounds are the first to go.
+    openal_voice *voice = NULL;
+    openal_voice *free_voice = NULL;
+    openal_voice *victim = NULL;
+    for(int i = 0; i < local->voice_count; i++) {
+        openal_voice *v = &local->voices[i];
+        int busy = openal_voice_busy(v);
+        if(busy && v->sample_id == id) {
+            voice = v;
+            break;
+        }
+        if(!busy) {
+            if(free_voice == NULL) {
+                free_voice = v;
+            }
+        } else if(victim == NULL
+                  || v->priority < victim->priority
+                  || (v->priority == victim->priority && v->started < victim->started)) {
+            victim = v;
+        }
+    }
+    if(voice == NULL) {
+        voice = free_voice;
+    }
+    if(voice == NULL) {
+        if(victim == NULL || victim->priority > volume) {
+            return;
+        }
+        voice = victim;
+    }
+
+    alSourceStop(voice->source);
+    alSourcei(voice->source, AL_BUFFER, local->samples[id]);
+    float pos[] = {panning, 0.0f, -1.0f};
+    alSourcefv(voice->source, AL_POSITION, pos);
+    alSourcef(voice->source, AL_GAIN, volume);
+    alSourcef(voice->source, AL_PITCH, pitch);
+    alSourcePlay(voice->source);
+    voice->sample_id = id;
+    voice->priority = volume;
+    voice->started = local->play_count++;
+}
+
+int openal_sink_sample_playing(audio_sink *sink, int id) {
+    openal_sink *local = sink_get_userdata(sink);
+    for(int i = 0; i < local->voice_count; i++) {
+        if(local->voices[i].sample_id == id && openal_voice_busy(&local->voices[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 void openal_sink_close(audio_sink *sink) {
     openal_sink *local = sink_get_userdata(sink);
+    for(int i = 0; i < local->voice_count; i++) {
+        alSourceStop(local->voices[i].source);
+        alDeleteSources(1, &local->voices[i].source);
+    }
+    for(int i = 0; i < OPENAL_MAX_SAMPLES; i++) {
+        if(local->samples[i] != 0) {
+            alDeleteBuffers(1, &local->samples[i]);
+        }
+    }
     alcMakeContextCurrent(0);
     alcDestroyContext(local->context);
     alcCloseDevice(local->device);
@@ -34,6 +149,7 @@ void openal_sink_format_stream(audio_sink *sink, audio_stream *stream) {
 
 int openal_sink_init(audio_sink *sink) {
     openal_sink *local = malloc(sizeof(openal_sink));
+    memset(local, 0, sizeof(openal_sink));
 
     // Open device and create context
     local->device = alcOpenDevice(0);
@@ -49,16 +165,34 @@ int openal_sink_init(audio_sink *sink) {
     // Good for panning
     alDistanceModel(AL_NONE);
 
+    // Create the sound effect voices. Fewer is fine, if the device runs out of sources.
+    while(alGetError() != AL_NO_ERROR);
+    for(int i = 0; i < OPENAL_VOICE_COUNT; i++) {
+        openal_voice *v = &local->voices[local->voice_count];
+        alGenSources(1, &v->source);
+        if(alGetError() != AL_NO_ERROR) {
+            break;
+        }
+        v->sample_id = -1;
+        local->voice_count++;
+    }
+
     // Set callbacks
     sink_set_userdata(sink, local);
     sink_set_close_cb(sink, openal_sink_close);
     sink_set_format_stream_cb(sink, openal_sink_format_stream);
+    if(local->voice_count > 0) {
+        sink_set_upload_sample_cb(sink, openal_sink_upload_sample);
+        sink_set_play_sample_cb(sink, openal_sink_play_sample);
+        sink_set_sample_playing_cb(sink, openal_sink_sample_playing);
+    }
 
     // Some log stuff
     INFO("OpenAL Audio Sink:");
     INFO(" * Vendor:      %s", alGetString(AL_VENDOR));
     INFO(" * Renderer:    %s", alGetString(AL_RENDERER));
     INFO(" * Version:     %s", alGetString(AL_VERSION));
+    INFO(" * SFX voices:  %d", local->voice_count);
 
     // All done
     return 0;
@@ -0,0 +1,71 @@
+#ifdef USE_SDLAUDIO
+
+#include <stdlib.h>
+#include <SDL2/SDL.h>
+#include "audio/sinks/sdl_sink.h"
+#include "audio/sinks/mixer.h"
+#include "game/utils/settings.h"
+#include "utils/log.h"
+
+#define SDL_SINK_BUFFER_FRAMES 1024
+
+typedef struct {
+    SDL_AudioDeviceID device;
+    mixer *mix;
+} sdl_sink;
+
+// Runs on the SDL audio thread
+static void sdl_sink_callback(void *userdata, Uint8 *stream, int len) {
+    sdl_sink *local = userdata;
+    mixer_render(local->mix, (int16_t*)stream, len / (sizeof(int16_t) * 2));
+}
+
+void sdl_sink_close(mixer *m) {
+    sdl_sink *local = mixer_get_backend(m);
+    SDL_CloseAudioDevice(local->device);
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    free(local);
+    INFO("SDL Sink: Closed.");
+}
+
+int sdl_sink_init(audio_sink *sink) {
+    if(SDL_InitSubSystem(SDL_INIT_AUDIO)) {
+        PERROR("SDL Sink: Could not initialize audio: %s", SDL_GetError());
+        return 1;
+    }
+    sdl_sink *local = malloc(sizeof(sdl_sink));
+    local->mix = NULL;
+
+    // The device starts out paused, so the callback won't run before the mixer exists.
+    // Ask for exactly this format; SDL converts if the hardware wants something else.
+    SDL_AudioSpec want, have;
+    SDL_memset(&want, 0, sizeof(want));
+    want.freq = settings_get()->sound.music_frequency;
+    want.format = AUDIO_S16SYS;
+    want.channels = 2;
+    want.samples = SDL_SINK_BUFFER_FRAMES;
+    want.callback = sdl_sink_callback;
+    want.userdata = local;
+    local->device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
+    if(local->device == 0) {
+        PERROR("SDL Sink: Could not open audio device: %s", SDL_GetError());
+        goto error_1;
+    }
+    if(mixer_sink_init(sink, want.freq, local, sdl_sink_close)) {
+        goto error_2;
+    }
+    local->mix = mixer_sink_get(sink);
+    SDL_PauseAudioDevice(local->device, 0);
+
+    INFO("SDL Sink: Initialized at %d Hz.", want.freq);
+    return 0;
+
+error_2:
+    SDL_CloseAudioDevice(local->device);
+error_1:
+    free(local);
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    return 1;
+}
+
+#endif // USE_SDLAUDIO
@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "audio/sinks/wav_sink.h"
+#include "audio/sinks/mixer.h"
+#include "game/utils/settings.h"
+#include "utils/log.h"
+
+#define WAV_HEADER_SIZE 44
+
+typedef struct {
+    FILE *fp; // NULL for the null sink
+    uint64_t frames; // Frames rendered so far
+    int16_t buf[MIXER_BLOCK_FRAMES*2];
+} wav_sink;
+
+static void wav_put_u16(unsigned char *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static void wav_put_u32(unsigned char *p, uint32_t v) {
+    wav_put_u16(p, v & 0xFFFF);
+    wav_put_u16(p + 2, (v >> 16) & 0xFFFF);
+}
+
+static void wav_write_header(FILE *fp, int frequency, uint32_t data_len) {
+    unsigned char h[WAV_HEADER_SIZE];
+    memcpy(h, "RIFF", 4);
+    wav_put_u32(h + 4, 36 + data_len);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    wav_put_u32(h + 16, 16); // fmt chunk size
+    wav_put_u16(h + 20, 1); // PCM
+    wav_put_u16(h + 22, 2); // Channels
+    wav_put_u32(h + 24, frequency);
+    wav_put_u32(h + 28, frequency * 4); // Bytes per second
+    wav_put_u16(h + 32, 4); // Bytes per frame
+    wav_put_u16(h + 34, 16); // Bits per sample
+    memcpy(h + 36, "data", 4);
+    wav_put_u32(h + 40, data_len);
+    fseek(fp, 0, SEEK_SET);
+    fwrite(h, WAV_HEADER_SIZE, 1, fp);
+}
+
+// Mixes as much audio as the game clock says should have played by now
+void wav_sink_render(audio_sink *sink, unsigned int ticks) {
+    mixer *m = mixer_sink_get(sink);
+    wav_sink *local = mixer_get_backend(m);
+    uint64_t target = (uint64_t)ticks * mixer_get_frequency(m) / 1000;
+    while(local->frames < target) {
+        int n = MIXER_BLOCK_FRAMES;
+        if(target - local->frames < (uint64_t)n) {
+            n = target - local->frames;
+        }
+        mixer_render(m, local->buf, n);
+        if(local->fp != NULL) {
+            fwrite(local->buf, sizeof(int16_t) * 2, n, local->fp);
+        }
+        local->frames += n;
+    }
+}
+
+void wav_sink_close(mixer *m) {
+    wav_sink *local = mixer_get_backend(m);
+    if(local->fp != NULL) {
+        wav_write_header(local->fp, mixer_get_frequency(m), local->frames * sizeof(int16_t) * 2);
+        fclose(local->fp);
+        INFO("WAV Sink: Wrote %u frames to '%s'.", (unsigned int)local->frames, WAV_SINK_FILE);
+    }
+    free(local);
+}
+
+static int wav_sink_create(audio_sink *sink, int write_file) {
+    int frequency = settings_get()->sound.music_frequency;
+    wav_sink *local = malloc(sizeof(wav_sink));
+    local->fp = NULL;
+    local->frames = 0;
+    if(write_file) {
+        local->fp = fopen(WAV_SINK_FILE, "wb");
+        if(local->fp == NULL) {
+            PERROR("WAV Sink: Could not open '%s' for writing.", WAV_SINK_FILE);
+            goto error_0;
+        }
+        // Sizes are filled in when the sink closes
+        wav_write_header(local->fp, frequency, 0);
+    }
+    if(mixer_sink_init(sink, frequency, local, wav_sink_close)) {
+        goto error_1;
+    }
+    sink_set_render_cb(sink, wav_sink_render);
+    return 0;
+
+error_1:
+    if(local->fp != NULL) {
+        fclose(local->fp);
+    }
+error_0:
+    free(local);
+    return 1;
+}
+
+int null_sink_init(audio_sink *sink) {
+    return wav_sink_create(sink, 0);
+}
+
+int wav_sink_init(audio_sink *sink) {
+    return wav_sink_create(sink, 1);
+}
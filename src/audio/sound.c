@@ -5,12 +5,33 @@
 #include "audio/sink.h"
 #include "audio/sound.h"
 #include "resources/sounds_loader.h"
+#include "utils/log.h"
 
 static float _sound_volume = VOLUME_DEFAULT;
 
 #ifdef STANDALONE_SERVER
+void sound_preload() {}
 void sound_play(int id, float volume, float panning, float pitch) {}
 #else
+void sound_preload() {
+    audio_sink *sink = audio_get_sink();
+    if(sink == NULL || !sink_has_samples(sink)) {
+        return;
+    }
+
+    int uploaded = 0;
+    for(int id = 0; id < sounds_loader_count(); id++) {
+        char *buf;
+        int len;
+        if(sounds_loader_get(id, &buf, &len) == 0 && len > 0) {
+            if(sink_upload_sample(sink, id, buf, len) == 0) {
+                uploaded++;
+            }
+        }
+    }
+    DEBUG("Uploaded %d sound samples to the audio sink.", uploaded);
+}
+
 void sound_play(int id, float volume, float panning, float pitch) {
     audio_sink *sink = audio_get_sink();
 
@@ -19,6 +40,12 @@ void sound_play(int id, float volume, float panning, float pitch) {
         return;
     }
 
+    // Preloaded samples need no streams or allocations
+    if(sink_has_samples(sink)) {
+        sink_play_sample(sink, id, volume * _sound_volume, panning, pitch);
+        return;
+    }
+
     // If the sound is already playing, stop it.
     if(sink_is_playing(sink, id)) {
         sink_stop(sink, id);
@@ -44,6 +71,9 @@ int sound_playing(unsigned int id) {
     if(sink == NULL) {
         return 0;
     }
+    if(sink_has_samples(sink)) {
+        return sink_is_sample_playing(sink, id);
+    }
     return sink_is_playing(sink, id);
 }
 
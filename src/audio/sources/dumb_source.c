@@ -15,7 +15,6 @@ typedef struct dumb_source_t {
     long sig_samples_size;
     DUH *data;
     long vlen;
-    long vpos;
 } dumb_source;
 
 audio_source_freq dumb_freqs[] = {
@@ -43,6 +42,15 @@ audio_source_resampler* dumb_get_resamplers() {
     return dumb_resamplers;
 }
 
+// Called by DUMB when the module is about to loop back
+static int dumb_source_loop(void *data) {
+    audio_source *src = data;
+
+    // If looping is off, stop the renderer right at the loop point. The
+    // render in progress comes back short, and the ones after it empty.
+    return source_get_loop(src) ? 0 : 1;
+}
+
 int dumb_source_update(audio_source *src, char *buffer, int len) {
     dumb_source *local = source_get_userdata(src);
 
@@ -50,14 +58,6 @@ int dumb_source_update(audio_source *src, char *buffer, int len) {
     float delta = 65536.0f / source_get_frequency(src);
     int bps = source_get_channels(src) * source_get_bytes(src);
 
-    // If looping is off, and if we have played the whole file, stop here.
-    long pos = duh_sigrenderer_get_position(local->renderer);
-    if(pos < local->vpos && !src->loop) {
-        return 0;
-    }
-    local->vpos = pos;
-
-    // ... otherwise get more data.
     int ret = duh_render_int(
             local->renderer,
             &local->sig_samples,
@@ -106,12 +106,12 @@ int dumb_source_init(audio_source *src, const char* file, int channels, int freq
     }
     local->renderer = duh_start_sigrenderer(local->data, 0, channels, 0);
     local->vlen = duh_get_length(local->data);
-    local->vpos = 0;
     local->sig_samples = NULL;
     local->sig_samples_size = 0;
 
     // Set resampler here
     dumb_it_set_resampling_quality(duh_get_it_sigrenderer(local->renderer), resampler);
+    dumb_it_set_loop_callback(duh_get_it_sigrenderer(local->renderer), dumb_source_loop, src);
 
     // Audio information
     source_set_frequency(src, freq);
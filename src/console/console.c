@@ -4,6 +4,7 @@
 #include "game/gui/menu_background.h"
 #include "game/utils/settings.h"
 #include "video/video.h"
+#include "utils/mem_pool.h"
 
 #define HISTORY_MAX 100
 #define BUFFER_INC(b) (((b) + 1) % sizeof(con->output))
@@ -209,8 +210,8 @@ int console_init() {
     con->output_overflowing = 0;
     con->histpos = -1;
     con->histpos_changed = 0;
-    list_create(&con->history);
-    hashmap_create(&con->cmds, 8);
+    list_create_with_allocator(&con->history, mem_pool_allocator());
+    hashmap_create_with_allocator(&con->cmds, 8, mem_pool_allocator());
     menu_background_create(&con->background, 322, 101);
 
     console_init_cmd();
@@ -350,6 +351,10 @@ void console_remove_cmd(const char *name) {
 }
 
 int console_window_is_open() {
+    // Console is not initialized in headless runs
+    if(con == NULL) {
+        return 0;
+    }
     return con->isopen;
 }
 
@@ -4,6 +4,11 @@
 #include "console/console_type.h"
 #include "resources/ids.h"
 #include "video/video.h"
+#include "controller/net_controller.h"
+#include "utils/log.h"
+#include "utils/memtrack.h"
+#include "utils/mem_pool.h"
+#include "utils/mem_arena.h"
 
 // utils
 int strtoint(char *input, int *output) {
@@ -107,13 +112,13 @@ int console_cmd_har(game_state *gs, int argc, char **argv) {
             vec2i pos = object_get_pos(har_obj);
             int hd = object_get_direction(har_obj);
 
-            object *obj = malloc(sizeof(object));
+            object *obj = object_alloc();
             object_create(obj, gs, pos, vec2f_create(0,0));
             player->har_id = i;
 
             if(har_create(obj, game_state_get_scene(gs)->af_data[0], hd, player->har_id, player->pilot_id, 0)) {
                 object_free(obj);
-                free(obj);
+                object_dealloc(obj);
                 return 1;
             }
 
@@ -228,6 +233,98 @@ int console_cmd_ez_destruct(game_state *gs, int argc, char **argv) {
     return 0;
 }
 
+int console_cmd_log(game_state *gs, int argc, char **argv) {
+    char buf[64];
+    if(argc == 1) {
+        sprintf(buf, "Log level %c", log_get_level());
+        console_output_addline(buf);
+        return 0;
+    }
+    if(argc == 3 && strcmp(argv[1], "level") == 0) {
+        if(strcmp(argv[2], "D") == 0 || strcmp(argv[2], "I") == 0 || strcmp(argv[2], "E") == 0) {
+            log_set_level(argv[2][0]);
+            return 0;
+        }
+    }
+    if(argc == 3 && strcmp(argv[1], "mute") == 0) {
+        return log_mute(argv[2]);
+    }
+    if(argc == 3 && strcmp(argv[1], "unmute") == 0) {
+        return log_unmute(argv[2]);
+    }
+    return 1;
+}
+
+int console_cmd_mem(game_state *gs, int argc, char **argv) {
+    static unsigned int last_ticks = 0;
+    static unsigned int last_allocs[MEM_TAG_COUNT];
+    char buf[64];
+    mem_stats pool;
+    if(argc == 2 && strcmp(argv[1], "pools") == 0) {
+        console_output_addline("pool      used   peak    size");
+        for(int i = 0; i < MEM_POOL_COUNT; i++) {
+            mem_pool_shared_stats(i, &pool);
+            sprintf(buf, "%-9s%5u %6u %6uK", mem_pool_shared_name(i),
+                pool.in_use, pool.peak, (unsigned int)(pool.reserved / 1024));
+            console_output_addline(buf);
+        }
+        mem_arena_scene_stats(&pool);
+        sprintf(buf, "%-9s%5u %6u %6uK", "scene", pool.in_use, pool.peak, (unsigned int)(pool.reserved / 1024));
+        console_output_addline(buf);
+        return 0;
+    }
+    if(argc != 1) {
+        return 1;
+    }
+    if(!memtrack_enabled()) {
+        console_output_addline("Memory tracking not compiled in");
+        return 0;
+    }
+
+    // Allocation rate is counted from the previous dump
+    unsigned int now = SDL_GetTicks();
+    float secs = (now > last_ticks) ? (now - last_ticks) / 1000.0f : 0.001f;
+    memtrack_stats stats;
+    console_output_addline("tag        live    peak  allocs/s");
+    for(int i = 0; i < MEM_TAG_COUNT; i++) {
+        memtrack_get_stats(i, &stats);
+        sprintf(buf, "%-9s%6ldK %6ldK %7.0f", memtrack_tag_name(i),
+            stats.live / 1024, stats.peak / 1024, (stats.allocs - last_allocs[i]) / secs);
+        console_output_addline(buf);
+        last_allocs[i] = stats.allocs;
+    }
+    last_ticks = now;
+    return 0;
+}
+
+int console_cmd_net(game_state *gs, int argc, char **argv) {
+    char buf[64];
+    int found = 0;
+    if(argc != 1) {
+        return 1;
+    }
+    for(int i = 0; i < game_state_num_players(gs); i++) {
+        controller *ctrl = game_player_get_ctrl(game_state_get_player(gs, i));
+        if(ctrl == NULL || ctrl->type != CTRL_TYPE_NETWORK) {
+            continue;
+        }
+        const net_clock *clock = net_controller_get_clock(ctrl);
+        sprintf(buf, "player %d: %u samples%s", i + 1, clock->count, net_clock_ready(clock) ? "" : " (not ready)");
+        console_output_addline(buf);
+        sprintf(buf, "rtt min %d median %d p95 %d", clock->rtt_min, clock->rtt_median, clock->rtt_p95);
+        console_output_addline(buf);
+        sprintf(buf, "offset %.1f drift %.2f/1000", clock->offset, clock->drift);
+        console_output_addline(buf);
+        sprintf(buf, "input delay %d catchup %d", net_controller_input_delay(ctrl), net_controller_catchup(ctrl));
+        console_output_addline(buf);
+        found = 1;
+    }
+    if(!found) {
+        console_output_addline("No network game");
+    }
+    return 0;
+}
+
 void console_init_cmd() {
     // Add console commands
     console_add_cmd("h",     &console_cmd_history,  "show command history");
@@ -246,4 +343,7 @@ void console_init_cmd() {
     console_add_cmd("god",   &console_cmd_god,  "Enable god mode");
     console_add_cmd("kreissack",   &console_kreissack,  "Fight Kreissack");
     console_add_cmd("ez-destruct",  &console_cmd_ez_destruct,  "Punch = destruction, kick = scrap");
+    console_add_cmd("log",   &console_cmd_log,   "log level D|I|E, log mute <prefix>, log unmute <prefix>");
+    console_add_cmd("mem",   &console_cmd_mem,   "memory use per subsystem, mem pools for the shared pools");
+    console_add_cmd("net",   &console_cmd_net,   "network clock estimates (ticks) for network players");
 }
@@ -1,21 +1,27 @@
 #include <math.h>
 #include "controller/ai_controller.h"
 #include "game/objects/har.h"
-#include "game/objects/scrap.h"
 #include "game/objects/projectile.h"
 #include "game/protos/intersect.h"
 #include "game/protos/object_specializer.h"
 #include "game/scenes/arena.h"
 #include "game/game_state.h"
+#include "game/common_defines.h"
 #include "game/utils/serial.h"
 #include "resources/af_loader.h"
 #include "resources/ids.h"
 #include "resources/animation.h"
 #include "controller/controller.h"
 #include "utils/log.h"
+#include "utils/mem_arena.h"
 #include "utils/vec.h"
 #include "utils/random.h"
 
+// Lookahead search tuning
+#define AI_SEARCH_TICKS 30 // How far ahead each candidate move is played out
+#define AI_SEARCH_INTERVAL 4 // Ticks between searches
+#define AI_SEARCH_BUDGET_US 2000 // Time allowed for one search
+
 typedef struct move_stat_t {
     int max_hit_dist;
     int min_hit_dist;
@@ -41,6 +47,17 @@ typedef struct ai_t {
 
     // all projectiles currently on screen (vector of projectile object*)
     vector active_projectiles;
+
+    // Lookahead search. The shadow state is a headless copy of the arena that
+    // gets rewound to a snapshot of the real game for every candidate move.
+    // It has its own scene arena, so that loading and freeing it can't reset
+    // the one the real game keeps its HAR hooks in.
+    game_state *shadow;
+    mem_arena *shadow_arena;
+    engine_init_flags shadow_flags;
+    serial snapshot;
+    int search_timer;
+    int search_offset;
 } ai;
 
 
@@ -134,9 +151,31 @@ int ai_har_event(controller *ctrl, har_event event) {
 }
 
 
+// Must be called with the shadow arena in place
+static void ai_shadow_free(ai *a) {
+    if(a->shadow) {
+        game_state_free(a->shadow);
+        free(a->shadow);
+        a->shadow = NULL;
+    }
+}
+
+static void ai_search_free(ai *a) {
+    if(a->shadow == NULL && a->shadow_arena == NULL) {
+        return;
+    }
+    mem_arena *live = mem_arena_scene_swap(a->shadow_arena);
+    ai_shadow_free(a);
+    mem_arena_scene_close();
+    a->shadow_arena = NULL;
+    mem_arena_scene_swap(live);
+}
+
 void ai_controller_free(controller *ctrl) {
     ai *a = ctrl->data;
     vector_free(&a->active_projectiles);
+    ai_search_free(a);
+    serial_free(&a->snapshot);
     free(a);
 }
 
@@ -209,9 +248,9 @@ int is_valid_move(af_move *move, har *h) {
     return 0;
 }
 
-int maybe(int difficulty) {
+int maybe(controller *ctrl, int difficulty) {
     // make chance of blocking exponentially better as the difficulty inreases
-    int a = rand_int(49);
+    int a = random_int(&ctrl->rand_state, 49);
     int b = difficulty*difficulty;
     /*DEBUG("maybe %d, %d < %d : %s", difficulty, a, b, a < b ? "true" : "false");*/
     if(a < b) {
@@ -230,7 +269,7 @@ int ai_block_har(controller *ctrl, ctrl_event **ev) {
 
     // XXX TODO get maximum move distance from the animation object
     if(fabsf(o_enemy->pos.x - o->pos.x) < 100) {
-        if(h_enemy->executing_move && maybe(a->difficulty)) {
+        if(h_enemy->executing_move && maybe(ctrl, a->difficulty)) {
             if(har_is_crouching(h_enemy)) {
                 a->cur_act = (o->direction == OBJECT_FACE_RIGHT ? ACT_DOWN|ACT_LEFT : ACT_DOWN|ACT_RIGHT);
                 controller_cmd(ctrl, a->cur_act, ev);
@@ -256,7 +295,7 @@ int ai_block_projectile(controller *ctrl, ctrl_event **ev) {
         if(projectile_get_owner(o_prj) == o)  {
             continue;
         }
-        if(o_prj->cur_sprite && maybe(a->difficulty)) {
+        if(o_prj->cur_sprite && maybe(ctrl, a->difficulty)) {
             vec2i pos_prj = vec2i_add(object_get_pos(o_prj), o_prj->cur_sprite->pos);
             vec2i size_prj = object_get_size(o_prj);
             if (object_get_direction(o_prj) == OBJECT_FACE_LEFT) {
@@ -274,6 +313,137 @@ int ai_block_projectile(controller *ctrl, ctrl_event **ev) {
     return 0;
 }
 
+// Builds the shadow arena matching the real one. Only done once per scene.
+// Must be called with the shadow arena in place.
+static int ai_search_prepare(ai *a, game_state *gs) {
+    if(a->shadow) {
+        return 0;
+    }
+
+    memset(&a->shadow_flags, 0, sizeof(engine_init_flags));
+    a->shadow_flags.net_mode = NET_MODE_NONE;
+    a->shadow = malloc(sizeof(game_state));
+    if(game_state_create_headless(a->shadow, &a->shadow_flags)) {
+        free(a->shadow);
+        a->shadow = NULL;
+        return 1;
+    }
+    for(int i = 0; i < 2; i++) {
+        game_player *src = game_state_get_player(gs, i);
+        game_player *dst = game_state_get_player(a->shadow, i);
+        controller *c = malloc(sizeof(controller));
+        controller_init(c);
+        ai_controller_create(c, AI_DIFFICULTY_PUNCHING_BAG); // Never polled
+        game_player_set_ctrl(dst, c);
+        dst->har_id = src->har_id;
+        dst->pilot_id = src->pilot_id;
+        memcpy(dst->colors, src->colors, sizeof(dst->colors));
+    }
+    if(game_load_new(a->shadow, gs->this_id)) {
+        ai_shadow_free(a);
+        return 1;
+    }
+    arena_set_state(game_state_get_scene(a->shadow), ARENA_STATE_FIGHTING);
+    DEBUG("AI lookahead: created shadow state for scene %d", gs->this_id);
+    return 0;
+}
+
+// Plays out a move (or standing still, if move is NULL) in the shadow state, and
+// returns the damage dealt minus the damage taken.
+static int ai_search_evaluate(ai *a, int player_id, af_move *move) {
+    game_state *gs = a->shadow;
+    if(game_state_restore(gs, &a->snapshot)) {
+        return 0;
+    }
+    object *o = game_state_get_player(gs, player_id)->har;
+    object *o_enemy = game_state_get_player(gs, player_id == 1 ? 0 : 1)->har;
+    har *h = object_get_userdata(o);
+    har *h_enemy = object_get_userdata(o_enemy);
+    int health = h->health;
+    int enemy_health = h_enemy->health;
+
+    // Feed the move string in the same way the poll function does
+    int pos = move ? (int)str_size(&move->move_string) - 1 : -1;
+    int lag = a->input_lag;
+    for(int t = 0; t < AI_SEARCH_TICKS; t++) {
+        if(pos >= 0) {
+            object_act(o, char_to_act(str_at(&move->move_string, pos), o->direction));
+            if(lag-- <= 0) {
+                lag = a->input_lag;
+                pos--;
+            }
+        } else {
+            object_act(o, ACT_STOP);
+        }
+        game_state_simulate(gs, 1);
+    }
+    return (enemy_health - h_enemy->health) - (health - h->health);
+}
+
+// Picks the move that does best over the next AI_SEARCH_TICKS ticks, or NULL
+// if nothing beats standing still.
+static af_move* ai_search_move(controller *ctrl) {
+    ai *a = ctrl->data;
+    object *o = ctrl->har;
+    har *h = object_get_userdata(o);
+    Uint64 start = SDL_GetPerformanceCounter();
+    Uint64 budget = SDL_GetPerformanceFrequency() * AI_SEARCH_BUDGET_US / 1000000;
+
+    // The shadow state draws from the same random streams as the real game.
+    // Put them back afterwards, so that searching can't change the outcome of a replay.
+    struct random_t streams[RAND_STREAM_COUNT];
+    for(int i = 0; i < RAND_STREAM_COUNT; i++) {
+        streams[i] = *rand_stream(i);
+    }
+
+    // Scene changed, so the shadow needs to be built again
+    if(a->shadow && a->shadow->this_id != o->gs->this_id) {
+        ai_search_free(a);
+    }
+    mem_arena *live = mem_arena_scene_swap(a->shadow_arena);
+
+    af_move *best = NULL;
+    if(ai_search_prepare(a, o->gs) == 0 && game_state_snapshot(o->gs, &a->snapshot) == 0) {
+        int best_score = ai_search_evaluate(a, h->player_id, NULL);
+
+        // Start from a different move every time, so that the budget
+        // doesn't always cut off the same ones.
+        a->search_offset = (a->search_offset + 7) % 70;
+        for(int n = 0; n < 70; n++) {
+            if(SDL_GetPerformanceCounter() - start > budget) {
+                break;
+            }
+            af_move *move = af_get_move(h->af_data, (a->search_offset + n) % 70);
+            if(move == NULL || !is_valid_move(move, h)) {
+                continue;
+            }
+            int score = ai_search_evaluate(a, h->player_id, move);
+            if(score > best_score) {
+                best = move;
+                best_score = score;
+            }
+        }
+    }
+
+    a->shadow_arena = mem_arena_scene_swap(live);
+    for(int i = 0; i < RAND_STREAM_COUNT; i++) {
+        *rand_stream(i) = streams[i];
+    }
+    return best;
+}
+
+static void ai_select_move(ai *a, af_move *selected_move, object *o, object *o_enemy) {
+    a->move_stats[selected_move->id].attempts++;
+    a->move_stats[selected_move->id].consecutive++;
+
+    // do the move
+    a->selected_move = selected_move;
+    a->move_str_pos = str_size(&selected_move->move_string)-1;
+    a->move_stats[a->selected_move->id].last_dist = abs(o->pos.x - o_enemy->pos.x);
+    a->blocked = 0;
+    DEBUG("AI selected move %s", str_c(&selected_move->move_string));
+}
+
 int ai_controller_poll(controller *ctrl, ctrl_event **ev) {
     ai *a = ctrl->data;
     object *o = ctrl->har;
@@ -325,7 +495,13 @@ int ai_controller_poll(controller *ctrl, ctrl_event **ev) {
         int ch = str_at(&a->selected_move->move_string, a->move_str_pos);
         controller_cmd(ctrl, char_to_act(ch, o->direction), ev);
 
-    } else if(rand_int(100) < a->difficulty) {
+    } else if(a->difficulty == AI_DIFFICULTY_LOOKAHEAD+1 && --a->search_timer <= 0) {
+        a->search_timer = AI_SEARCH_INTERVAL;
+        af_move *selected_move = ai_search_move(ctrl);
+        if(selected_move) {
+            ai_select_move(a, selected_move, o, o_enemy);
+        }
+    } else if(random_int(&ctrl->rand_state, 100) < a->difficulty) {
         af_move *selected_move = NULL;
         int top_value = 0;
 
@@ -335,7 +511,7 @@ int ai_controller_poll(controller *ctrl, ctrl_event **ev) {
             if((move = af_get_move(h->af_data, i))) {
                 move_stat *ms = &a->move_stats[i];
                 if(is_valid_move(move, h)) {
-                    int value = ms->value + rand_int(10);
+                    int value = ms->value + random_int(&ctrl->rand_state, 10);
                     if (ms->min_hit_dist != -1){
                         if (ms->last_dist < ms->max_hit_dist+5 && ms->last_dist > ms->min_hit_dist+5){
                             value += 2;
@@ -347,7 +523,7 @@ int ai_controller_poll(controller *ctrl, ctrl_event **ev) {
                     value -= ms->attempts/2;
                     value -= ms->consecutive*2;
 
-                    if (is_special_move(move) && !maybe(a->difficulty)) {
+                    if (is_special_move(move) && !maybe(ctrl, a->difficulty)) {
                         DEBUG("skipping special move %s because of difficulty", str_c(&move->move_string));
                         continue;
                     }
@@ -366,20 +542,12 @@ int ai_controller_poll(controller *ctrl, ctrl_event **ev) {
             a->move_stats[i].consecutive /= 2;
         }
         if(selected_move) {
-            a->move_stats[selected_move->id].attempts++;
-            a->move_stats[selected_move->id].consecutive++;
-
-            // do the move
-            a->selected_move = selected_move;
-            a->move_str_pos = str_size(&selected_move->move_string)-1;
-            a->move_stats[a->selected_move->id].last_dist = abs(o->pos.x - o_enemy->pos.x);
-            a->blocked = 0;
-            DEBUG("AI selected move %s", str_c(&selected_move->move_string));
+            ai_select_move(a, selected_move, o, o_enemy);
         }
     } else {
         // Change action after 30 ticks
-        if(a->act_timer <= 0 && rand_int(100) > 88){
-            int p = rand_int(100);
+        if(a->act_timer <= 0 && random_int(&ctrl->rand_state, 100) > 88){
+            int p = random_int(&ctrl->rand_state, 100);
             if(p > 40){
                 // walk forward
                 a->cur_act = (o->direction == OBJECT_FACE_RIGHT ? ACT_RIGHT : ACT_LEFT);
@@ -401,7 +569,7 @@ int ai_controller_poll(controller *ctrl, ctrl_event **ev) {
         }
 
         // Jump once in a while
-        if(rand_int(100) == 88){
+        if(random_int(&ctrl->rand_state, 100) == 88){
             if(o->vel.x < 0) {
                 controller_cmd(ctrl, ACT_UP|ACT_LEFT, ev);
             } else if(o->vel.x > 0) {
@@ -432,6 +600,11 @@ void ai_controller_create(controller *ctrl, int difficulty) {
     }
     a->blocked = 0;
     vector_create(&a->active_projectiles, sizeof(object*));
+    a->shadow = NULL;
+    a->shadow_arena = NULL;
+    serial_create(&a->snapshot);
+    a->search_timer = 0;
+    a->search_offset = 0;
 
     ctrl->data = a;
     ctrl->type = CTRL_TYPE_AI;
@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include "utils/log.h"
+#include "utils/mem_pool.h"
 #include "controller/controller.h"
 
 typedef struct hook_function_t {
@@ -7,8 +8,13 @@ typedef struct hook_function_t {
     controller *source;
 } hook_function;
 
+// Events are created and freed every tick, so they come from a pool
+static ctrl_event* controller_event_alloc() {
+    return mem_pool_alloc(mem_pool_shared(MEM_POOL_CTRL_EVENT, sizeof(ctrl_event)));
+}
+
 void controller_init(controller *ctrl) {
-    list_create(&ctrl->hooks);
+    list_create_with_allocator(&ctrl->hooks, mem_pool_allocator());
     ctrl->extra_events = NULL;
     ctrl->har = NULL;
     ctrl->poll_fun = NULL;
@@ -19,6 +25,7 @@ void controller_init(controller *ctrl) {
     ctrl->rumble_fun = NULL;
     ctrl->rtt = 0;
     ctrl->repeat = 0;
+    random_seed(&ctrl->rand_state, random_intmax(rand_stream(RAND_STREAM_CONTROLLER)));
 }
 
 void controller_add_hook(controller *ctrl, controller *source, void(*fp)(controller *ctrl, int act_type)) {
@@ -47,7 +54,7 @@ void controller_free_chain(ctrl_event *ev) {
             serial_free(ev->event_data.ser);
             free(ev->event_data.ser);
         }
-        free(ev);
+        mem_pool_release(mem_pool_shared(MEM_POOL_CTRL_EVENT, sizeof(ctrl_event)), ev);
     }
 }
 
@@ -62,14 +69,14 @@ void controller_cmd(controller* ctrl, int action, ctrl_event **ev) {
         ((*p)->fp)((*p)->source, action);
     }
     if (*ev == NULL) {
-        *ev = malloc(sizeof(ctrl_event));
+        *ev = controller_event_alloc();
         (*ev)->type = EVENT_TYPE_ACTION;
         (*ev)->event_data.action = action;
         (*ev)->next = NULL;
     } else {
         i = *ev;
         while (i->next) { i = i->next; }
-        i->next = malloc(sizeof(ctrl_event));
+        i->next = controller_event_alloc();
         i->next->type = EVENT_TYPE_ACTION;
         i->next->event_data.action = action;
         i->next->next = NULL;
@@ -81,7 +88,7 @@ void controller_sync(controller *ctrl, serial *ser, ctrl_event **ev) {
         // a sync event obsoletes all previous events
         controller_free_chain(*ev);
     }
-    *ev = malloc(sizeof(ctrl_event));
+    *ev = controller_event_alloc();
     (*ev)->type = EVENT_TYPE_SYNC;
     (*ev)->event_data.ser = ser;
     (*ev)->next = NULL;
@@ -92,7 +99,7 @@ void controller_close(controller *ctrl, ctrl_event **ev) {
         // a close event obsoletes all previous events
         controller_free_chain(*ev);
     }
-    *ev = malloc(sizeof(ctrl_event));
+    *ev = controller_event_alloc();
     (*ev)->type = EVENT_TYPE_CLOSE;
     (*ev)->next = NULL;
 }
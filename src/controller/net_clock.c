@@ -0,0 +1,107 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "controller/net_clock.h"
+
+void net_clock_create(net_clock *c) {
+    memset(c, 0, sizeof(net_clock));
+}
+
+static int compare_int(const void *a, const void *b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+static void net_clock_update_rtt(net_clock *c) {
+    int rtts[NET_CLOCK_SAMPLES];
+    for(unsigned int i = 0; i < c->count; i++) {
+        rtts[i] = c->samples[i].rtt;
+    }
+    qsort(rtts, c->count, sizeof(int), compare_int);
+    c->rtt_min = rtts[0];
+    c->rtt_median = rtts[(c->count - 1) / 2];
+    c->rtt_p95 = rtts[(c->count - 1) * 95 / 100];
+}
+
+// Averages the offsets of the trips that were held up the least; their delays are the most symmetric
+static void net_clock_update_offset(net_clock *c) {
+    const net_clock_sample *last = &c->samples[(c->pos + NET_CLOCK_SAMPLES - 1) % NET_CLOCK_SAMPLES];
+    int limit = (c->rtt_min + c->rtt_median) / 2;
+    float local = 0, offset = 0;
+    int n = 0;
+    for(unsigned int i = 0; i < c->count; i++) {
+        const net_clock_sample *s = &c->samples[i];
+        if(s->rtt <= limit) {
+            local += s->local - last->local;
+            offset += s->offset;
+            n++;
+        }
+    }
+    local = last->local + local / n;
+    offset /= n;
+
+    // Drift is far too small to see within the window, so measure it against the first estimate
+    if(!c->anchored) {
+        if(net_clock_ready(c)) {
+            c->anchor_local = local;
+            c->anchor_offset = offset;
+            c->anchored = 1;
+        }
+    } else if(local - c->anchor_local >= NET_CLOCK_DRIFT_SPAN) {
+        c->drift = (offset - c->anchor_offset) * 1000.0f / (local - c->anchor_local);
+    }
+    c->offset = offset + c->drift * (last->local - local) / 1000.0f;
+}
+
+static void net_clock_update_delay(net_clock *c) {
+    int target = (int)ceilf(c->rtt_p95 / 2.0f) + NET_CLOCK_DELAY_MARGIN;
+    if(target > NET_CLOCK_MAX_DELAY) {
+        target = NET_CLOCK_MAX_DELAY;
+    }
+    if(target >= c->input_delay) {
+        c->input_delay = target;
+        c->delay_hold = 0;
+    } else if(++c->delay_hold >= NET_CLOCK_DELAY_HOLD) {
+        // Come down one tick at a time, so a quiet moment doesn't undo it all
+        c->input_delay--;
+        c->delay_hold = 0;
+    }
+}
+
+void net_clock_add(net_clock *c, int sent, int arrival, int peer_tick) {
+    net_clock_sample *s = &c->samples[c->pos];
+    s->rtt = abs(arrival - sent);
+    s->local = sent + s->rtt / 2;
+    s->offset = peer_tick - (sent + s->rtt / 2.0f);
+    c->pos = (c->pos + 1) % NET_CLOCK_SAMPLES;
+    if(c->count < NET_CLOCK_SAMPLES) {
+        c->count++;
+    }
+    net_clock_update_rtt(c);
+    net_clock_update_offset(c);
+    net_clock_update_delay(c);
+}
+
+int net_clock_ready(const net_clock *c) {
+    return c->count >= NET_CLOCK_READY;
+}
+
+int net_clock_peer_tick(const net_clock *c, int local_tick) {
+    if(c->count == 0) {
+        return local_tick;
+    }
+    const net_clock_sample *last = &c->samples[(c->pos + NET_CLOCK_SAMPLES - 1) % NET_CLOCK_SAMPLES];
+    float offset = c->offset + c->drift * (local_tick - last->local) / 1000.0f;
+    return local_tick + (int)lroundf(offset);
+}
+
+int net_clock_oneway(const net_clock *c) {
+    int oneway = (int)ceilf(c->rtt_median / 2.0f);
+    return (oneway > NET_CLOCK_MAX_DELAY) ? NET_CLOCK_MAX_DELAY : oneway;
+}
+
+int net_clock_catchup(const net_clock *c, int waited) {
+    // A message that sat in the queue for long (a loading stall, say) must not
+    // make us fast forward through the whole wait
+    int catchup = net_clock_oneway(c) + (waited > 0 ? waited : 0);
+    return (catchup > NET_CLOCK_MAX_DELAY) ? NET_CLOCK_MAX_DELAY : catchup;
+}
@@ -1,54 +1,61 @@
 #include <stdio.h>
 
 #include "controller/net_controller.h"
+#include "controller/net_thread.h"
+#include "controller/net_mux.h"
+#include "controller/net_input.h"
+#include "controller/net_emu.h"
+#include "controller/net_clock.h"
+#include "game/utils/settings.h"
 #include "utils/log.h"
+#include "utils/profiler.h"
+#include "utils/memtrack.h"
+
+#define NET_MS_PER_TICK 10 // Controllers are ticked once per static tick
 
 typedef struct wtf_t {
-    ENetHost *host;
-    ENetPeer *peer;
+    net_thread *thread;
+    net_link *link; // Instead of the thread, on the standalone server
     int id;
     int last_hb;
     int last_action;
+    net_input input;
     int outstanding_hb;
     int disconnected;
-    int rttbuf[100];
-    int rttpos;
-    int rttfilled;
+    net_clock clock;
     int tick_offset;
+    int catchup;
+    unsigned int syncs_sent;
+    unsigned int syncs_received;
+    serial start; // Start message from the host, if it came yet
 } wtf;
 
-// simple standard deviation calculation
-float stddev(float average, int data[], int n) {
-    float variance = 0.0f;
-    for (int i=0; i < n; i++) {
-        variance = (data[i] - average)*(data[i] - average);
+// The peer is either behind our own network thread or a link on the server's shared host
+static int net_controller_connected(wtf *data) {
+    if(data->link != NULL) {
+        return net_link_is_connected(data->link);
     }
-    return sqrtf(variance/n);
+    return data->thread != NULL && net_thread_is_connected(data->thread);
 }
 
-// calculate average round trip time, ignoring outliers outside 1 standard deviation
-int avg_rtt(int data[], int n) {
-    float average = 0.0f;
-    float result = 0.0f;
-    int j = 0;;
-    for (int i=0; i < n; i++) {
-        average += data[i];
+static void net_controller_send(wtf *data, uint8_t channel, const char *buf, unsigned int len, unsigned int flags) {
+    if(data->link != NULL) {
+        net_link_send(data->link, channel, buf, len, flags);
+    } else {
+        net_thread_send(data->thread, channel, buf, len, flags);
     }
-    average = average/n;
+}
 
-    float sd = stddev(average, data, n);
-    for (int i=0; i < n; i++) {
-        if (abs(data[i] - average) <= sd) {
-            result += data[i];
-            j++;
-        }
+static int net_controller_recv(wtf *data, net_msg *msg) {
+    if(data->link != NULL) {
+        return net_link_recv(data->link, msg);
     }
-    return trunc(result/j);
+    return net_thread_recv(data->thread, msg);
 }
 
 int net_controller_ready(controller *ctrl) {
     wtf *data = ctrl->data;
-    return data->rttfilled;
+    return net_clock_ready(&data->clock);
 }
 
 int net_controller_tick_offset(controller *ctrl) {
@@ -56,55 +63,100 @@ int net_controller_tick_offset(controller *ctrl) {
     return data->tick_offset;
 }
 
+int net_controller_input_delay(controller *ctrl) {
+    wtf *data = ctrl->data;
+    return net_clock_ready(&data->clock) ? data->clock.input_delay : 0;
+}
+
+int net_controller_catchup(controller *ctrl) {
+    wtf *data = ctrl->data;
+    return data->catchup;
+}
+
+const net_clock* net_controller_get_clock(controller *ctrl) {
+    wtf *data = ctrl->data;
+    return &data->clock;
+}
+
+int net_controller_get_start(controller *ctrl, serial *ser) {
+    wtf *data = ctrl->data;
+    if(data->start.len == 0) {
+        return 0;
+    }
+    serial_write(ser, data->start.data, data->start.len);
+    return 1;
+}
+
 void net_controller_free(controller *ctrl) {
     wtf *data = ctrl->data;
-    ENetEvent event;
-    if (!data->disconnected) {
-        DEBUG("closing connection");
-        enet_peer_disconnect(data->peer, 0);
-
-        while (enet_host_service(data->host, &event, 3000) > 0) {
-            switch (event.type) {
-                case ENET_EVENT_TYPE_RECEIVE:
-                    enet_packet_destroy(event.packet);
-                    break;
-                case ENET_EVENT_TYPE_DISCONNECT:
-                    DEBUG("got disconnect notice");
-                    // peer has acknowledged the disconnect
-                    goto done;
-                    break;
-                default:
-                    break;
-            }
-        }
+    if(data == NULL) {
+        return;
     }
-done:
-    if(data->host) {
-        enet_host_destroy(data->host);
-        data->host = NULL;
+    // Netcode health numbers, to compare runs under the network emulator
+    INFO("Net controller: %u syncs sent, %u syncs received, rtt %d ticks (p95 %d), tick offset %d, input delay %d",
+         data->syncs_sent, data->syncs_received, ctrl->rtt, data->clock.rtt_p95, data->tick_offset,
+         data->clock.input_delay);
+    if(data->link != NULL) {
+        net_link_close(data->link);
     }
-    if(ctrl->data) {
-        free(ctrl->data);
-        ctrl->data = NULL;
+    net_thread_free(data->thread);
+    serial_free(&data->start);
+    MEM_FREE(ctrl->data);
+    ctrl->data = NULL;
+}
+
+// Sends the unacknowledged input frames and our ack, if there is anything to send
+static void net_controller_flush_input(wtf *data) {
+    serial ser;
+    net_input_commit(&data->input);
+    if (!net_controller_connected(data)) {
+        return;
     }
+    serial_create(&ser);
+    if (net_input_write(&data->input, &ser)) {
+        net_controller_send(data, 0, ser.data, ser.len, ENET_PACKET_FLAG_UNSEQUENCED);
+    }
+    serial_free(&ser);
 }
 
 int net_controller_tick(controller *ctrl, int ticks, ctrl_event **ev) {
-    ENetEvent event;
     wtf *data = ctrl->data;
-    ENetHost *host = data->host;
-    ENetPeer *peer = data->peer;
+    net_msg msg;
     serial *ser;
     /*int handled = 0;*/
-    while (enet_host_service(host, &event, 0) > 0) {
-        switch (event.type) {
-            case ENET_EVENT_TYPE_RECEIVE:
+    if(data->thread == NULL && data->link == NULL) {
+        data->disconnected = 1;
+        controller_close(ctrl, ev);
+        return 1;
+    }
+    if(data->link != NULL) {
+        net_link_set_tick(data->link, ticks);
+    } else {
+        net_thread_set_tick(data->thread, ticks);
+    }
+    PROFILE_BEGIN("net service");
+    while(net_controller_recv(data, &msg)) {
+        switch(msg.type) {
+            case NET_MSG_RECEIVE:
+                // The serial takes over the message buffer
                 ser = malloc(sizeof(serial));
                 serial_create(ser);
-                ser->data = malloc(event.packet->dataLength);
-                ser->len = event.packet->dataLength;
-                memcpy(ser->data, event.packet->data, event.packet->dataLength);
+                ser->data = msg.data;
+                ser->len = msg.len;
+                ser->wsize = msg.len;
+                msg.data = NULL;
                 switch(serial_read_int8(ser)) {
+                    case EVENT_TYPE_INPUT:
+                        {
+                            int actions[NET_INPUT_REDUNDANCY * NET_INPUT_MAX_ACTIONS];
+                            int count = net_input_read(&data->input, ser, actions, NET_INPUT_REDUNDANCY * NET_INPUT_MAX_ACTIONS);
+                            for(int i = 0; i < count; i++) {
+                                controller_cmd(ctrl, actions[i], ev);
+                            }
+                            serial_free(ser);
+                            free(ser);
+                        }
+                        break;
                     case EVENT_TYPE_ACTION:
                         {
                             // dispatch keypress to scene
@@ -117,82 +169,84 @@ int net_controller_tick(controller *ctrl, int ticks, ctrl_event **ev) {
                         break;
                     case EVENT_TYPE_HB:
                         {
-                            // got a tick
+                            // Our heartbeat came back. Peer heartbeats are bounced by the net thread.
                             int id = serial_read_int8(ser);
                             if (id == data->id) {
                                 int start = serial_read_int32(ser);
                                 int peerticks = serial_read_int32(ser);
-                                int newrtt = abs(start - ticks);
-                                data->rttbuf[data->rttpos++] = newrtt;
-                                if (data->rttpos >= 100) {
-                                    data->rttpos = 0;
-                                    data->rttfilled = 1;
-                                }
-                                if (data->rttfilled == 1) {
-                                    ctrl->rtt = avg_rtt(data->rttbuf, 100);
-                                    data->tick_offset = (peerticks + (ctrl->rtt/2)) - ticks;
+                                // Time it on arrival, not on when we got around to reading it
+                                int arrival = ticks - (int)(SDL_GetTicks() - msg.timestamp) / NET_MS_PER_TICK;
+                                net_clock_add(&data->clock, start, arrival, peerticks);
+                                if (net_clock_ready(&data->clock)) {
+                                    ctrl->rtt = data->clock.rtt_median;
+                                    data->tick_offset = net_clock_peer_tick(&data->clock, arrival) - arrival;
                                     /*DEBUG("I am %d ticks away from server: %d %d", data->tick_offset, ticks, peerticks);*/
                                 }
                                 data->outstanding_hb = 0;
                                 data->last_hb = ticks;
-                                serial_free(ser);
-                            } else {
-                                // a heartbeat from the peer, bounce it back
-                                ENetPacket *packet;
-                                // write our own ticks into it
-                                serial_write_int32(ser, ticks);
-                                packet = enet_packet_create(ser->data, ser->len, ENET_PACKET_FLAG_UNSEQUENCED);
-                                if (peer) {
-                                    enet_peer_send(peer, 0, packet);
-                                    enet_host_flush (host);
-                                }
                             }
+                            serial_free(ser);
                             free(ser);
                         }
                         break;
                     case EVENT_TYPE_SYNC:
+                        // The state is as old as its trip here plus the time it waited for us
+                        data->catchup = net_clock_catchup(&data->clock,
+                            (int)(SDL_GetTicks() - msg.timestamp) / NET_MS_PER_TICK);
+                        data->syncs_received++;
                         controller_sync(ctrl, ser, ev);
                         /*handled = 1;*/
                         break;
+                    case EVENT_TYPE_START:
+                        // Kept whole for the menus, which decide where the match begins
+                        serial_free(&data->start);
+                        data->start = *ser;
+                        data->start.rpos = 0;
+                        free(ser);
+                        break;
                     default:
                         serial_free(ser);
                         free(ser);
                 }
-                enet_packet_destroy(event.packet);
                 break;
-            case ENET_EVENT_TYPE_DISCONNECT:
+            case NET_MSG_DISCONNECT:
                 DEBUG("peer disconnected!");
                 data->disconnected = 1;
                 controller_close(ctrl, ev);
+                PROFILE_END();
                 return 1; // bail the fuck out
                 break;
             default:
                 break;
         }
+        net_msg_free(&msg);
     }
 
+    PROFILE_END();
+
+    // Input goes out every tick until the peer has acked it
+    net_controller_flush_input(data);
+
     int tick_interval = 5;
-    if (data->rttfilled) {
+    if (net_clock_ready(&data->clock)) {
         tick_interval = 20;
     }
 
     if ((data->last_hb == -1 || ticks - data->last_hb > tick_interval) || !data->outstanding_hb) {
         data->outstanding_hb = 1;
         serial ser;
-        ENetPacket *packet;
         serial_create(&ser);
         serial_write_int8(&ser, EVENT_TYPE_HB);
         serial_write_int8(&ser, data->id);
         serial_write_int32(&ser, ticks);
-        packet = enet_packet_create(ser.data, ser.len, ENET_PACKET_FLAG_UNSEQUENCED);
-        if (peer) {
-            enet_peer_send(peer, 0, packet);
-            enet_host_flush (host);
+        if (net_controller_connected(data)) {
+            net_controller_send(data, 0, ser.data, ser.len, ENET_PACKET_FLAG_UNSEQUENCED);
         } else {
             DEBUG("peer is null~");
             data->disconnected = 1;
             controller_close(ctrl, ev);
         }
+        serial_free(&ser);
     }
 
     /*if(!handled) {*/
@@ -203,96 +257,63 @@ int net_controller_tick(controller *ctrl, int ticks, ctrl_event **ev) {
 
 int net_controller_update(controller *ctrl, serial *serial) {
     wtf *data = ctrl->data;
-    ENetPeer *peer = data->peer;
-    ENetHost *host = data->host;
-    ENetPacket *packet;
     uint8_t et = EVENT_TYPE_SYNC;
-    char *buf = malloc(serial->len+sizeof(et));
+    char *buf = MEM_ALLOC(MEM_TAG_NET, serial->len+sizeof(et));
 
     memcpy(buf, (char*)&et, sizeof(et));
-    // need to copy here because enet will free this packet
     memcpy(buf+sizeof(et), serial->data, serial->len);
 
-    packet = enet_packet_create(buf, serial->len+4, 0);
-    free(buf);
-    if (peer) {
-        enet_peer_send(peer, 1, packet);
-        enet_host_flush(host);
+    if (net_controller_connected(data)) {
+        net_controller_send(data, 1, buf, serial->len+sizeof(et), 0);
+        data->syncs_sent++;
     } else {
         DEBUG("peer is null~");
     }
+    MEM_FREE(buf);
 
     return 0;
 }
 
 void controller_hook(controller *ctrl, int action) {
-    serial ser;
     wtf *data = ctrl->data;
-    ENetPeer *peer = data->peer;
-    ENetHost *host = data->host;
-    ENetPacket *packet;
     if (action == ACT_STOP && data->last_action == ACT_STOP) {
         data->last_action = -1;
         return;
     }
     data->last_action = action;
-    serial_create(&ser);
-    serial_write_int8(&ser, EVENT_TYPE_ACTION);
-    serial_write_int16(&ser, action);
     /*DEBUG("controller hook fired with %d", action);*/
-    /*sprintf(buf, "k%d", action);*/
-    packet = enet_packet_create(ser.data, ser.len, ENET_PACKET_FLAG_RELIABLE);
-    if (peer) {
-        enet_peer_send(peer, 1, packet);
-        enet_host_flush (host);
-    } else {
-        DEBUG("peer is null~");
-    }
+    net_input_add(&data->input, action);
 }
 
 void net_controller_har_hook(int action, void *cb_data) {
     controller *ctrl = cb_data;
     wtf *data = ctrl->data;
-    serial ser;
-    ENetPeer *peer = data->peer;
-    ENetHost *host = data->host;
-    ENetPacket *packet;
     if (action == ACT_STOP && data->last_action == ACT_STOP) {
         data->last_action = -1;
         return;
     }
     if (action == ACT_FLUSH) {
-        enet_host_flush(host);
+        // End of the HAR's tick; don't wait for the next controller tick
+        net_controller_flush_input(data);
         return;
     }
     data->last_action = action;
-    serial_create(&ser);
-    serial_write_int8(&ser, EVENT_TYPE_ACTION);
-    serial_write_int16(&ser, action);
-    /*DEBUG("controller hook fired with %d", action);*/
-    /*sprintf(buf, "k%d", action);*/
-    packet = enet_packet_create(ser.data, ser.len, ENET_PACKET_FLAG_RELIABLE);
-    if (peer) {
-        enet_peer_send(peer, 1, packet);
-        /*enet_host_flush (host);*/
-    } else {
-        DEBUG("peer is null~");
-    }
+    net_input_add(&data->input, action);
 }
 
-void net_controller_create(controller *ctrl, ENetHost *host, ENetPeer *peer, int id) {
-    wtf *data = malloc(sizeof(wtf));
+static void net_controller_init(controller *ctrl, wtf *data, int id) {
     data->id = id;
-    data->host = host;
-    data->peer = peer;
     data->last_hb = -1;
     data->last_action = ACT_STOP;
+    net_input_create(&data->input);
     data->outstanding_hb = 0;
     data->disconnected = 0;
-    data->rttpos = 0;
+    net_clock_create(&data->clock);
     data->tick_offset = 0;
-    memset(data->rttbuf, 0, sizeof(int)*100);
-    data->rttfilled = 0;
+    data->catchup = 0;
+    data->syncs_sent = 0;
+    data->syncs_received = 0;
+    serial_create(&data->start);
     ctrl->data = data;
     ctrl->type = CTRL_TYPE_NETWORK;
     ctrl->tick_fun = &net_controller_tick;
@@ -300,4 +321,41 @@ void net_controller_create(controller *ctrl, ENetHost *host, ENetPeer *peer, int
     ctrl->controller_hook = &controller_hook;
 }
 
+// The network emulator is set up from the settings, on whichever end enables it
+static void net_controller_emu_config(net_emu_config *emu) {
+    settings_network *net = &settings_get()->net;
+    emu->latency = net->net_emu_latency;
+    emu->jitter = net->net_emu_jitter;
+    emu->loss = net->net_emu_loss;
+    emu->duplicate = net->net_emu_duplicate;
+    emu->reorder = net->net_emu_reorder;
+    emu->seed = net->net_emu_seed;
+}
+
+net_thread* net_controller_connect(const char *addr, int port, int id) {
+    net_emu_config emu;
+    net_controller_emu_config(&emu);
+    return net_thread_connect(addr, port, id, &emu);
+}
+
+net_thread* net_controller_listen(int port, int id) {
+    net_emu_config emu;
+    net_controller_emu_config(&emu);
+    return net_thread_listen(port, id, &emu);
+}
+
+void net_controller_create(controller *ctrl, net_thread *thread, int id) {
+    wtf *data = MEM_ALLOC(MEM_TAG_NET, sizeof(wtf));
+    data->link = NULL;
+    data->thread = thread;
+    net_controller_init(ctrl, data, id);
+}
+
+void net_controller_create_link(controller *ctrl, net_link *link, int id) {
+    wtf *data = MEM_ALLOC(MEM_TAG_NET, sizeof(wtf));
+    data->link = link;
+    data->thread = NULL;
+    net_controller_init(ctrl, data, id);
+}
+
 
@@ -0,0 +1,180 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "controller/net_emu.h"
+#include "utils/random.h"
+#include "utils/log.h"
+#include "utils/memtrack.h"
+
+#define NET_EMU_CHANNELS 256
+
+typedef struct net_emu_held_t {
+    uint32_t release;
+    uint32_t order; // Keeps messages due at the same time in push order
+    net_msg msg;
+} net_emu_held;
+
+struct net_emu_t {
+    net_emu_config conf;
+    struct random_t rand;
+    net_emu_held *held;
+    unsigned int held_count;
+    unsigned int held_size;
+    uint32_t order;
+    uint32_t channel_release[NET_EMU_CHANNELS]; // Last release time of ordered messages, per channel
+    net_emu_stats stats;
+};
+
+int net_emu_config_enabled(const net_emu_config *conf) {
+    return conf != NULL
+        && (conf->latency > 0 || conf->jitter > 0 || conf->loss > 0 || conf->duplicate > 0 || conf->reorder > 0);
+}
+
+int net_emu_config_parse(net_emu_config *conf, const char *spec) {
+    char key[32];
+    int value;
+    int read;
+    while(*spec) {
+        if(sscanf(spec, " %31[a-z] = %d%n", key, &value, &read) != 2 || value < 0) {
+            PERROR("Net emulator: Bad spec at '%s'", spec);
+            return 1;
+        }
+        if(strcmp(key, "latency") == 0) {
+            conf->latency = value;
+        } else if(strcmp(key, "jitter") == 0) {
+            conf->jitter = value;
+        } else if(strcmp(key, "loss") == 0) {
+            conf->loss = value;
+        } else if(strcmp(key, "duplicate") == 0) {
+            conf->duplicate = value;
+        } else if(strcmp(key, "reorder") == 0) {
+            conf->reorder = value;
+        } else if(strcmp(key, "seed") == 0) {
+            conf->seed = value;
+        } else {
+            PERROR("Net emulator: Unknown key '%s'", key);
+            return 1;
+        }
+        spec += read;
+        if(*spec == ',') {
+            spec++;
+        }
+    }
+    return 0;
+}
+
+net_emu* net_emu_create(const net_emu_config *conf, uint32_t salt) {
+    net_emu *e = MEM_ALLOC(MEM_TAG_NET, sizeof(net_emu));
+    memset(e, 0, sizeof(net_emu));
+    e->conf = *conf;
+    random_seed(&e->rand, conf->seed * 2654435761u + salt);
+    return e;
+}
+
+void net_emu_free(net_emu *e) {
+    if(e == NULL) {
+        return;
+    }
+    for(unsigned int i = 0; i < e->held_count; i++) {
+        net_msg_free(&e->held[i].msg);
+    }
+    MEM_FREE(e->held);
+    MEM_FREE(e);
+}
+
+static int net_emu_roll(net_emu *e, int percent) {
+    return percent > 0 && (int)random_int(&e->rand, 100) < percent;
+}
+
+static uint32_t net_emu_delay(net_emu *e) {
+    int delay = e->conf.latency;
+    if(e->conf.jitter > 0) {
+        delay += (int)random_int(&e->rand, e->conf.jitter * 2 + 1) - e->conf.jitter;
+    }
+    return delay > 0 ? delay : 0;
+}
+
+static void net_emu_hold(net_emu *e, net_msg *msg, uint32_t release) {
+    if(e->held_count >= e->held_size) {
+        e->held_size = e->held_size ? e->held_size * 2 : 64;
+        e->held = MEM_REALLOC(MEM_TAG_NET, e->held, e->held_size * sizeof(net_emu_held));
+    }
+    net_emu_held *h = &e->held[e->held_count++];
+    h->release = release;
+    h->order = e->order++;
+    h->msg = *msg;
+}
+
+void net_emu_push(net_emu *e, net_msg *msg, uint32_t now) {
+    uint32_t release = now + net_emu_delay(e);
+    e->stats.messages++;
+
+    // ENet retransmits reliable messages and holds back sequenced ones, so only delay those
+    if(msg->flags & ENET_PACKET_FLAG_RELIABLE) {
+        if(net_emu_roll(e, e->conf.loss)) {
+            release += e->conf.latency * 2 + NET_EMU_RETRANSMIT_MS;
+            e->stats.retransmitted++;
+        }
+    } else if(net_emu_roll(e, e->conf.loss)) {
+        e->stats.dropped++;
+        net_msg_free(msg);
+        return;
+    }
+
+    if(!(msg->flags & ENET_PACKET_FLAG_UNSEQUENCED)) {
+        uint32_t *last = &e->channel_release[msg->channel];
+        if((int32_t)(release - *last) < 0) {
+            release = *last;
+        }
+        *last = release;
+        net_emu_hold(e, msg, release);
+        return;
+    }
+
+    if(net_emu_roll(e, e->conf.reorder)) {
+        release += NET_EMU_REORDER_MS;
+        e->stats.reordered++;
+    }
+    if(net_emu_roll(e, e->conf.duplicate)) {
+        net_msg copy = *msg;
+        copy.data = malloc(msg->len);
+        memcpy(copy.data, msg->data, msg->len);
+        net_emu_hold(e, &copy, now + net_emu_delay(e));
+        e->stats.duplicated++;
+    }
+    net_emu_hold(e, msg, release);
+}
+
+static int net_emu_take(net_emu *e, net_msg *msg, uint32_t now, int any) {
+    int found = -1;
+    for(unsigned int i = 0; i < e->held_count; i++) {
+        net_emu_held *h = &e->held[i];
+        if(!any && (int32_t)(now - h->release) < 0) {
+            continue;
+        }
+        if(found < 0
+           || (int32_t)(h->release - e->held[found].release) < 0
+           || (h->release == e->held[found].release && h->order < e->held[found].order)) {
+            found = i;
+        }
+    }
+    if(found < 0) {
+        return 0;
+    }
+    *msg = e->held[found].msg;
+    e->held[found] = e->held[--e->held_count];
+    return 1;
+}
+
+int net_emu_pop(net_emu *e, net_msg *msg, uint32_t now) {
+    return net_emu_take(e, msg, now, 0);
+}
+
+int net_emu_pop_any(net_emu *e, net_msg *msg) {
+    return net_emu_take(e, msg, 0, 1);
+}
+
+void net_emu_get_stats(net_emu *e, net_emu_stats *stats) {
+    *stats = e->stats;
+}
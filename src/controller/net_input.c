@@ -0,0 +1,98 @@
+#include <string.h>
+#include "controller/net_input.h"
+#include "controller/controller.h"
+#include "utils/log.h"
+
+void net_input_create(net_input *in) {
+    memset(in, 0, sizeof(net_input));
+    in->next_seq = 1;
+}
+
+void net_input_commit(net_input *in) {
+    if(in->current.count == 0) {
+        return;
+    }
+    // If the peer has stopped acking, forget the oldest frame. The peer will see a gap.
+    if(in->next_seq - in->acked > NET_INPUT_HISTORY) {
+        in->acked++;
+        if(in->overflows++ == 0) {
+            DEBUG("Net input: Peer is not acknowledging input; dropping old frames.");
+        }
+    }
+    in->frames[in->next_seq % NET_INPUT_HISTORY] = in->current;
+    in->next_seq++;
+    in->current.count = 0;
+}
+
+void net_input_add(net_input *in, int action) {
+    if(in->current.count >= NET_INPUT_MAX_ACTIONS) {
+        net_input_commit(in);
+    }
+    in->current.actions[in->current.count++] = action;
+}
+
+int net_input_write(net_input *in, serial *ser) {
+    uint32_t unacked = in->next_seq - 1 - in->acked;
+    if(unacked == 0 && !in->ack_pending) {
+        return 0;
+    }
+    int count = (unacked > NET_INPUT_REDUNDANCY) ? NET_INPUT_REDUNDANCY : unacked;
+    serial_write_int8(ser, EVENT_TYPE_INPUT);
+    serial_write_int32(ser, in->received);
+    serial_write_int32(ser, in->acked + 1);
+    serial_write_int8(ser, count);
+    for(int i = 0; i < count; i++) {
+        net_input_frame *f = &in->frames[(in->acked + 1 + i) % NET_INPUT_HISTORY];
+        serial_write_int8(ser, f->count);
+        for(int k = 0; k < f->count; k++) {
+            serial_write_int16(ser, f->actions[k]);
+        }
+    }
+    in->ack_pending = 0;
+    return 1;
+}
+
+int net_input_read(net_input *in, serial *ser, int *actions, int max_actions) {
+    if(serial_len(ser) - ser->rpos < 9) {
+        return 0;
+    }
+    uint32_t ack = serial_read_int32(ser);
+    uint32_t first = serial_read_int32(ser);
+    int count = (uint8_t)serial_read_int8(ser);
+
+    // Acks may arrive out of order; only move forward
+    if(ack > in->acked && ack < in->next_seq) {
+        in->acked = ack;
+    }
+
+    int got = 0;
+    for(int i = 0; i < count; i++) {
+        if(serial_len(ser) - ser->rpos < 1) {
+            break;
+        }
+        uint32_t seq = first + i;
+        int n = (uint8_t)serial_read_int8(ser);
+        if(n > NET_INPUT_MAX_ACTIONS || serial_len(ser) - ser->rpos < (size_t)n * 2) {
+            break;
+        }
+        // Frames we already have are resends. If there's no room left, the rest come again later.
+        if(seq <= in->received) {
+            ser->rpos += n * 2;
+            continue;
+        }
+        if(got + n > max_actions) {
+            break;
+        }
+        if(seq > in->received + 1) {
+            DEBUG("Net input: Frames %u-%u were lost.", in->received + 1, seq - 1);
+        }
+        for(int k = 0; k < n; k++) {
+            actions[got++] = serial_read_int16(ser);
+        }
+        in->received = seq;
+    }
+    if(count > 0) {
+        in->ack_pending = 1;
+    }
+    return got;
+}
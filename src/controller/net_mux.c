@@ -0,0 +1,332 @@
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "controller/net_mux.h"
+#include "utils/vector.h"
+#include "utils/log.h"
+#include "utils/memtrack.h"
+
+struct net_link_t {
+    ENetPeer *peer; // Network thread only
+    SDL_mutex *lock;
+    SDL_atomic_t connected;
+    SDL_atomic_t closed;
+    SDL_atomic_t tick;
+
+    // Guarded by the lock
+    vector inbound;
+    vector outbound;
+    unsigned int dropped;
+};
+
+struct net_mux_t {
+    ENetHost *host;
+    int hb_id;
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    SDL_atomic_t running;
+    SDL_atomic_t links;
+
+    vector accepted; // Guarded by the lock; links not yet taken by the game side
+    vector live; // Network thread only; every link that is not freed yet
+};
+
+// Takes the oldest entry off a queue
+static int net_mux_pop(vector *queue, void *item, unsigned int size) {
+    iterator it;
+    void *first;
+    vector_iter_begin(queue, &it);
+    if((first = iter_next(&it)) == NULL) {
+        return 0;
+    }
+    memcpy(item, first, size);
+    vector_delete(queue, &it);
+    return 1;
+}
+
+static void net_link_clear(vector *queue) {
+    iterator it;
+    net_msg *msg;
+    vector_iter_begin(queue, &it);
+    while((msg = iter_next(&it)) != NULL) {
+        net_msg_free(msg);
+    }
+    vector_clear(queue);
+}
+
+static net_link* net_link_create(ENetPeer *peer) {
+    net_link *l = MEM_ALLOC(MEM_TAG_NET, sizeof(net_link));
+    memset(l, 0, sizeof(net_link));
+    if((l->lock = SDL_CreateMutex()) == NULL) {
+        MEM_FREE(l);
+        return NULL;
+    }
+    l->peer = peer;
+    SDL_AtomicSet(&l->connected, 1);
+    SDL_AtomicSet(&l->closed, 0);
+    SDL_AtomicSet(&l->tick, 0);
+    vector_create(&l->inbound, sizeof(net_msg));
+    vector_create(&l->outbound, sizeof(net_msg));
+    return l;
+}
+
+static void net_link_free(net_link *l) {
+    net_link_clear(&l->inbound);
+    net_link_clear(&l->outbound);
+    vector_free(&l->inbound);
+    vector_free(&l->outbound);
+    SDL_DestroyMutex(l->lock);
+    MEM_FREE(l);
+}
+
+static void net_link_push_inbound(net_link *l, net_msg *msg) {
+    SDL_LockMutex(l->lock);
+    int full = (vector_size(&l->inbound) >= NET_THREAD_QUEUE_SIZE);
+    if(full) {
+        l->dropped++;
+    } else {
+        vector_append(&l->inbound, msg);
+    }
+    SDL_UnlockMutex(l->lock);
+    if(full) {
+        net_msg_free(msg);
+    }
+}
+
+static void net_mux_receive(net_mux *m, net_link *l, ENetEvent *event) {
+    net_msg msg, reply;
+    msg.type = NET_MSG_RECEIVE;
+    msg.timestamp = SDL_GetTicks();
+    msg.channel = event->channelID;
+    msg.flags = event->packet->flags;
+    msg.len = event->packet->dataLength;
+    msg.data = malloc(msg.len);
+    memcpy(msg.data, event->packet->data, msg.len);
+    if(net_msg_hb_reply(&msg, m->hb_id, SDL_AtomicGet(&l->tick), &reply)) {
+        enet_peer_send(l->peer, reply.channel, enet_packet_create(reply.data, reply.len, reply.flags));
+        enet_host_flush(m->host);
+        net_msg_free(&reply);
+        net_msg_free(&msg);
+        return;
+    }
+    net_link_push_inbound(l, &msg);
+}
+
+static void net_mux_handle_event(net_mux *m, ENetEvent *event) {
+    net_link *l = (event->peer != NULL) ? event->peer->data : NULL;
+    net_msg msg;
+    switch(event->type) {
+        case ENET_EVENT_TYPE_CONNECT:
+            if((l = net_link_create(event->peer)) == NULL) {
+                enet_peer_disconnect(event->peer, 0);
+                break;
+            }
+            event->peer->data = l;
+            vector_append(&m->live, &l);
+            SDL_AtomicAdd(&m->links, 1);
+            SDL_LockMutex(m->lock);
+            vector_append(&m->accepted, &l);
+            SDL_UnlockMutex(m->lock);
+            DEBUG("Net mux: Peer connected, %d links.", SDL_AtomicGet(&m->links));
+            break;
+        case ENET_EVENT_TYPE_RECEIVE:
+            if(l != NULL && l->peer != NULL) {
+                net_mux_receive(m, l, event);
+            }
+            enet_packet_destroy(event->packet);
+            break;
+        case ENET_EVENT_TYPE_DISCONNECT:
+            if(l == NULL) {
+                break;
+            }
+            event->peer->data = NULL;
+            l->peer = NULL;
+            SDL_AtomicSet(&l->connected, 0);
+            memset(&msg, 0, sizeof(net_msg));
+            msg.type = NET_MSG_DISCONNECT;
+            msg.timestamp = SDL_GetTicks();
+            net_link_push_inbound(l, &msg);
+            break;
+        default:
+            break;
+    }
+}
+
+// Sends what the game side has queued, and lets go of the links it is done with
+static void net_mux_send_queued(net_mux *m) {
+    iterator it;
+    net_link **lp;
+    net_msg *msg;
+    int sent = 0;
+    vector_iter_begin(&m->live, &it);
+    while((lp = iter_next(&it)) != NULL) {
+        net_link *l = *lp;
+        SDL_LockMutex(l->lock);
+        if(l->peer != NULL) {
+            iterator mit;
+            vector_iter_begin(&l->outbound, &mit);
+            while((msg = iter_next(&mit)) != NULL) {
+                enet_peer_send(l->peer, msg->channel, enet_packet_create(msg->data, msg->len, msg->flags));
+                sent = 1;
+            }
+        }
+        net_link_clear(&l->outbound);
+        SDL_UnlockMutex(l->lock);
+
+        if(SDL_AtomicGet(&l->closed)) {
+            if(l->peer != NULL) {
+                l->peer->data = NULL;
+                enet_peer_disconnect_later(l->peer, 0);
+            }
+            net_link_free(l);
+            vector_delete(&m->live, &it);
+            SDL_AtomicAdd(&m->links, -1);
+        }
+    }
+    if(sent) {
+        enet_host_flush(m->host);
+    }
+}
+
+static int net_mux_run(void *userdata) {
+    net_mux *m = userdata;
+    ENetEvent event;
+    while(SDL_AtomicGet(&m->running)) {
+        net_mux_send_queued(m);
+        int timeout = NET_MUX_SERVICE_MS;
+        while(enet_host_service(m->host, &event, timeout) > 0) {
+            net_mux_handle_event(m, &event);
+            timeout = 0;
+        }
+    }
+    return 0;
+}
+
+net_mux* net_mux_create(int port, int max_peers, int hb_id) {
+    ENetAddress address;
+    net_mux *m = MEM_ALLOC(MEM_TAG_NET, sizeof(net_mux));
+    memset(m, 0, sizeof(net_mux));
+    address.host = ENET_HOST_ANY;
+    address.port = port;
+    if((m->host = enet_host_create(&address, max_peers, 2, 0, 0)) == NULL) {
+        PERROR("Net mux: Unable to listen on port %d.", port);
+        goto error_0;
+    }
+    m->hb_id = hb_id;
+    vector_create(&m->accepted, sizeof(net_link*));
+    vector_create(&m->live, sizeof(net_link*));
+    SDL_AtomicSet(&m->running, 1);
+    SDL_AtomicSet(&m->links, 0);
+    if((m->lock = SDL_CreateMutex()) == NULL) {
+        goto error_1;
+    }
+    if((m->thread = SDL_CreateThread(net_mux_run, "mux", m)) == NULL) {
+        goto error_2;
+    }
+    INFO("Net mux: Listening for up to %d peers on port %d.", max_peers, port);
+    return m;
+
+error_2:
+    SDL_DestroyMutex(m->lock);
+error_1:
+    PERROR("Net mux: Unable to start: %s", SDL_GetError());
+    vector_free(&m->live);
+    vector_free(&m->accepted);
+    enet_host_destroy(m->host);
+error_0:
+    MEM_FREE(m);
+    return NULL;
+}
+
+void net_mux_free(net_mux *m) {
+    ENetEvent event;
+    iterator it;
+    net_link **lp;
+    if(m == NULL) {
+        return;
+    }
+    SDL_AtomicSet(&m->running, 0);
+    SDL_WaitThread(m->thread, NULL);
+
+    // The host is ours again; send what is left and say goodbye to everyone
+    vector_iter_begin(&m->live, &it);
+    while((lp = iter_next(&it)) != NULL) {
+        SDL_AtomicSet(&(*lp)->closed, 1);
+    }
+    net_mux_send_queued(m);
+    unsigned int start = SDL_GetTicks();
+    while(m->host->connectedPeers > 0 && SDL_GetTicks() - start < NET_MUX_DISCONNECT_MS) {
+        if(enet_host_service(m->host, &event, 1) > 0 && event.type == ENET_EVENT_TYPE_RECEIVE) {
+            enet_packet_destroy(event.packet);
+        }
+    }
+    enet_host_destroy(m->host);
+    vector_free(&m->live);
+    vector_free(&m->accepted);
+    SDL_DestroyMutex(m->lock);
+    MEM_FREE(m);
+}
+
+net_link* net_mux_accept(net_mux *m) {
+    net_link *l;
+    SDL_LockMutex(m->lock);
+    int got = net_mux_pop(&m->accepted, &l, sizeof(net_link*));
+    SDL_UnlockMutex(m->lock);
+    return got ? l : NULL;
+}
+
+int net_mux_links(net_mux *m) {
+    return SDL_AtomicGet(&m->links);
+}
+
+int net_link_send(net_link *l, uint8_t channel, const char *data, unsigned int len, unsigned int flags) {
+    net_msg msg;
+    msg.type = NET_MSG_RECEIVE;
+    msg.timestamp = SDL_GetTicks();
+    msg.channel = channel;
+    msg.flags = flags;
+    msg.len = len;
+    msg.data = malloc(len);
+    memcpy(msg.data, data, len);
+
+    SDL_LockMutex(l->lock);
+    int full = (vector_size(&l->outbound) >= NET_THREAD_QUEUE_SIZE);
+    if(full) {
+        l->dropped++;
+    } else {
+        vector_append(&l->outbound, &msg);
+    }
+    SDL_UnlockMutex(l->lock);
+    if(full) {
+        net_msg_free(&msg);
+        return 1;
+    }
+    return 0;
+}
+
+int net_link_recv(net_link *l, net_msg *msg) {
+    SDL_LockMutex(l->lock);
+    int got = net_mux_pop(&l->inbound, msg, sizeof(net_msg));
+    SDL_UnlockMutex(l->lock);
+    return got;
+}
+
+void net_link_set_tick(net_link *l, int tick) {
+    SDL_AtomicSet(&l->tick, tick);
+}
+
+int net_link_is_connected(net_link *l) {
+    return SDL_AtomicGet(&l->connected);
+}
+
+unsigned int net_link_get_dropped(net_link *l) {
+    SDL_LockMutex(l->lock);
+    unsigned int dropped = l->dropped;
+    SDL_UnlockMutex(l->lock);
+    return dropped;
+}
+
+void net_link_close(net_link *l) {
+    SDL_AtomicSet(&l->closed, 1);
+}
@@ -0,0 +1,320 @@
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "controller/net_relay.h"
+#include "controller/net_thread.h"
+#include "utils/log.h"
+#include "utils/memtrack.h"
+
+typedef struct net_relay_chunk_t {
+    char *data;
+    unsigned int len;
+} net_relay_chunk;
+
+struct net_relay_t {
+    ENetHost *host;
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    SDL_atomic_t running;
+    SDL_atomic_t spectators;
+    int max_spectators;
+    serial header; // Ready to send, as a header record
+
+    // Game thread only
+    serial batch;
+    unsigned int batch_count;
+    uint32_t batch_upto;
+
+    // Guarded by the lock
+    vector pending;
+
+    // Relay thread only
+    ENetPeer **peers;
+    serial log;
+    unsigned int batches;
+    uint64_t bytes_sent;
+};
+
+static void net_relay_send_pending(net_relay *r) {
+    vector chunks;
+    iterator it;
+    net_relay_chunk *c;
+    int spectators = SDL_AtomicGet(&r->spectators);
+
+    // Take the whole queue, so the game thread doesn't wait on the sends
+    SDL_LockMutex(r->lock);
+    if(vector_size(&r->pending) == 0) {
+        SDL_UnlockMutex(r->lock);
+        return;
+    }
+    chunks = r->pending;
+    vector_create(&r->pending, sizeof(net_relay_chunk));
+    SDL_UnlockMutex(r->lock);
+
+    vector_iter_begin(&chunks, &it);
+    while((c = iter_next(&it)) != NULL) {
+        serial_write(&r->log, c->data, c->len);
+        if(spectators > 0) {
+            // One packet for everyone; ENet frees it once the last spectator has it
+            enet_host_broadcast(r->host, 0, enet_packet_create(c->data, c->len, ENET_PACKET_FLAG_RELIABLE));
+            r->bytes_sent += (uint64_t)c->len * spectators;
+        }
+        r->batches++;
+        free(c->data);
+    }
+    if(spectators > 0) {
+        enet_host_flush(r->host);
+    }
+    vector_free(&chunks);
+}
+
+static void net_relay_connect(net_relay *r, ENetPeer *peer) {
+    int slot = -1;
+    for(int i = 0; i < r->max_spectators; i++) {
+        if(r->peers[i] == NULL) {
+            slot = i;
+            break;
+        }
+    }
+    if(slot < 0) {
+        enet_peer_disconnect(peer, 0);
+        return;
+    }
+    r->peers[slot] = peer;
+    SDL_AtomicAdd(&r->spectators, 1);
+
+    // Catch up with the match so far, then the live batches follow
+    enet_peer_send(peer, 0, enet_packet_create(r->header.data, r->header.len, ENET_PACKET_FLAG_RELIABLE));
+    if(r->log.len > 0) {
+        enet_peer_send(peer, 0, enet_packet_create(r->log.data, r->log.len, ENET_PACKET_FLAG_RELIABLE));
+    }
+    enet_host_flush(r->host);
+    r->bytes_sent += r->header.len + r->log.len;
+    INFO("Net relay: Spectator joined, %d watching.", SDL_AtomicGet(&r->spectators));
+}
+
+static void net_relay_disconnect(net_relay *r, ENetPeer *peer) {
+    for(int i = 0; i < r->max_spectators; i++) {
+        if(r->peers[i] == peer) {
+            r->peers[i] = NULL;
+            SDL_AtomicAdd(&r->spectators, -1);
+            INFO("Net relay: Spectator left, %d watching.", SDL_AtomicGet(&r->spectators));
+            return;
+        }
+    }
+}
+
+static void net_relay_handle_event(net_relay *r, ENetEvent *event) {
+    switch(event->type) {
+        case ENET_EVENT_TYPE_CONNECT:
+            net_relay_connect(r, event->peer);
+            break;
+        case ENET_EVENT_TYPE_DISCONNECT:
+            net_relay_disconnect(r, event->peer);
+            break;
+        case ENET_EVENT_TYPE_RECEIVE:
+            // Spectators have nothing to say
+            enet_packet_destroy(event->packet);
+            break;
+        default:
+            break;
+    }
+}
+
+// Lets the spectators have what they were sent before saying goodbye, then lets go of everything
+static void net_relay_close(net_relay *r) {
+    ENetEvent event;
+    net_relay_send_pending(r);
+    for(int i = 0; i < r->max_spectators; i++) {
+        if(r->peers[i] != NULL) {
+            enet_peer_disconnect_later(r->peers[i], 0);
+        }
+    }
+    unsigned int start = SDL_GetTicks();
+    while(SDL_AtomicGet(&r->spectators) > 0 && !net_thread_closing_aborted()
+        && SDL_GetTicks() - start < NET_RELAY_DISCONNECT_MS) {
+        if(enet_host_service(r->host, &event, 1) > 0) {
+            net_relay_handle_event(r, &event);
+        }
+    }
+    INFO("Net relay: Closed after %u batches, %llu bytes sent.", r->batches, (unsigned long long)r->bytes_sent);
+
+    enet_host_destroy(r->host);
+    SDL_DestroyMutex(r->lock);
+    vector_free(&r->pending);
+    serial_free(&r->log);
+    serial_free(&r->batch);
+    serial_free(&r->header);
+    MEM_FREE(r->peers);
+    MEM_FREE(r);
+    net_thread_closing_end();
+}
+
+static int net_relay_run(void *userdata) {
+    net_relay *r = userdata;
+    ENetEvent event;
+    while(SDL_AtomicGet(&r->running)) {
+        int timeout = NET_RELAY_SERVICE_MS;
+        while(enet_host_service(r->host, &event, timeout) > 0) {
+            net_relay_handle_event(r, &event);
+            timeout = 0;
+        }
+        net_relay_send_pending(r);
+    }
+    net_relay_close(r);
+    return 0;
+}
+
+net_relay* net_relay_create(int port, int max_spectators, const serial *header) {
+    ENetAddress address;
+    net_relay *r = MEM_ALLOC(MEM_TAG_NET, sizeof(net_relay));
+    memset(r, 0, sizeof(net_relay));
+    address.host = ENET_HOST_ANY;
+    address.port = port;
+    if((r->host = enet_host_create(&address, max_spectators, 1, 0, 0)) == NULL) {
+        PERROR("Net relay: Unable to listen on port %d.", port);
+        goto error_0;
+    }
+    r->max_spectators = max_spectators;
+    r->peers = MEM_ALLOC(MEM_TAG_NET, sizeof(ENetPeer*) * max_spectators);
+    memset(r->peers, 0, sizeof(ENetPeer*) * max_spectators);
+    serial_create(&r->header);
+    serial_write_int8(&r->header, NET_RELAY_HEADER);
+    serial_write_int16(&r->header, header->len);
+    serial_write(&r->header, header->data, header->len);
+    serial_create(&r->batch);
+    serial_create(&r->log);
+    vector_create(&r->pending, sizeof(net_relay_chunk));
+    SDL_AtomicSet(&r->running, 1);
+    SDL_AtomicSet(&r->spectators, 0);
+    if((r->lock = SDL_CreateMutex()) == NULL) {
+        goto error_1;
+    }
+    if((r->thread = SDL_CreateThread(net_relay_run, "relay", r)) == NULL) {
+        goto error_2;
+    }
+    INFO("Net relay: Listening for up to %d spectators on port %d.", max_spectators, port);
+    return r;
+
+error_2:
+    SDL_DestroyMutex(r->lock);
+error_1:
+    PERROR("Net relay: Unable to start: %s", SDL_GetError());
+    vector_free(&r->pending);
+    serial_free(&r->log);
+    serial_free(&r->batch);
+    serial_free(&r->header);
+    MEM_FREE(r->peers);
+    enet_host_destroy(r->host);
+error_0:
+    MEM_FREE(r);
+    return NULL;
+}
+
+void net_relay_free(net_relay *r) {
+    if(r == NULL) {
+        return;
+    }
+    // From here on the thread owns the relay; it is gone once the spectators are
+    net_thread_closing_begin(r->thread);
+    SDL_AtomicSet(&r->running, 0);
+}
+
+void net_relay_add(net_relay *r, uint32_t tick, int player_id, int action) {
+    serial_write_int32(&r->batch, tick);
+    serial_write_int8(&r->batch, player_id);
+    serial_write_int8(&r->batch, action);
+    r->batch_count++;
+}
+
+static void net_relay_queue(net_relay *r, serial *record) {
+    net_relay_chunk c;
+    c.len = record->len;
+    c.data = malloc(c.len);
+    memcpy(c.data, record->data, c.len);
+    SDL_LockMutex(r->lock);
+    vector_append(&r->pending, &c);
+    SDL_UnlockMutex(r->lock);
+}
+
+static void net_relay_send_batch(net_relay *r, uint32_t tick) {
+    serial record;
+    serial_create(&record);
+    serial_write_int8(&record, NET_RELAY_MOVES);
+    serial_write_int32(&record, tick);
+    serial_write_int16(&record, r->batch_count);
+    serial_write(&record, r->batch.data, r->batch.len);
+    net_relay_queue(r, &record);
+    serial_free(&record);
+    serial_reset(&r->batch);
+    r->batch_count = 0;
+    r->batch_upto = tick;
+}
+
+void net_relay_flush(net_relay *r, uint32_t tick) {
+    // The current tick may still get moves, so the batch only covers the ticks before it
+    if(tick > r->batch_upto + NET_RELAY_BATCH_TICKS) {
+        net_relay_send_batch(r, tick - 1);
+    }
+}
+
+void net_relay_end(net_relay *r, uint32_t tick) {
+    serial record;
+    net_relay_send_batch(r, tick);
+    serial_create(&record);
+    serial_write_int8(&record, NET_RELAY_END);
+    net_relay_queue(r, &record);
+    serial_free(&record);
+}
+
+int net_relay_spectators(net_relay *r) {
+    return SDL_AtomicGet(&r->spectators);
+}
+
+int net_relay_read(serial *ser, serial *header, vector *moves, uint32_t *upto) {
+    if(serial_len(ser) - ser->rpos < 1) {
+        return 0;
+    }
+    int type = serial_read_int8(ser);
+    switch(type) {
+        case NET_RELAY_HEADER:
+            {
+                if(serial_len(ser) - ser->rpos < 2) {
+                    return 0;
+                }
+                unsigned int len = (uint16_t)serial_read_int16(ser);
+                if(serial_len(ser) - ser->rpos < len) {
+                    return 0;
+                }
+                serial_reset(header);
+                serial_write(header, ser->data + ser->rpos, len);
+                ser->rpos += len;
+            }
+            return type;
+        case NET_RELAY_MOVES:
+            {
+                if(serial_len(ser) - ser->rpos < 6) {
+                    return 0;
+                }
+                uint32_t last = serial_read_int32(ser);
+                unsigned int count = (uint16_t)serial_read_int16(ser);
+                if(serial_len(ser) - ser->rpos < count * 6) {
+                    return 0;
+                }
+                for(unsigned int i = 0; i < count; i++) {
+                    net_relay_move m;
+                    m.tick = serial_read_int32(ser);
+                    m.player_id = serial_read_int8(ser);
+                    m.action = serial_read_int8(ser);
+                    vector_append(moves, &m);
+                }
+                *upto = last;
+            }
+            return type;
+        case NET_RELAY_END:
+            return type;
+        default:
+            return 0;
+    }
+}
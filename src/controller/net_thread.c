@@ -0,0 +1,526 @@
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "controller/net_thread.h"
+#include "controller/net_emu.h"
+#include "controller/controller.h"
+#include "game/utils/serial.h"
+#include "utils/log.h"
+#include "utils/memtrack.h"
+#include "utils/vector.h"
+
+typedef struct net_queue_t {
+    net_msg msgs[NET_THREAD_QUEUE_SIZE];
+    unsigned int head;
+    unsigned int count;
+} net_queue;
+
+struct net_thread_t {
+    ENetHost *host; // Only touched by the network thread
+    ENetPeer *peer; // Only touched by the network thread
+    int hb_id;
+    char addr[256]; // Where to connect to, or empty to listen
+    int port;
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    SDL_atomic_t closing;
+    SDL_atomic_t state;
+    SDL_atomic_t tick;
+
+    // Both queues are guarded by the lock
+    net_queue inbound;
+    net_queue outbound;
+    unsigned int dropped;
+
+    // Network condition emulation, if enabled. Only touched by the network thread while it runs.
+    net_emu *emu_in;
+    net_emu *emu_out;
+};
+
+// Threads that were let go but not joined yet
+static SDL_atomic_t closing_threads;
+static SDL_atomic_t closing_abort;
+static SDL_SpinLock closing_lock;
+static vector closing_list; // SDL_Thread*, guarded by the lock
+static int closing_list_created;
+
+static int net_queue_push(net_queue *q, const net_msg *msg) {
+    if(q->count >= NET_THREAD_QUEUE_SIZE) {
+        return 1;
+    }
+    q->msgs[(q->head + q->count) % NET_THREAD_QUEUE_SIZE] = *msg;
+    q->count++;
+    return 0;
+}
+
+static int net_queue_pop(net_queue *q, net_msg *msg) {
+    if(q->count == 0) {
+        return 0;
+    }
+    *msg = q->msgs[q->head];
+    q->head = (q->head + 1) % NET_THREAD_QUEUE_SIZE;
+    q->count--;
+    return 1;
+}
+
+static void net_queue_clear(net_queue *q) {
+    net_msg msg;
+    while(net_queue_pop(q, &msg)) {
+        net_msg_free(&msg);
+    }
+}
+
+static void net_thread_push_inbound(net_thread *t, net_msg *msg) {
+    SDL_LockMutex(t->lock);
+    int full = net_queue_push(&t->inbound, msg);
+    SDL_UnlockMutex(t->lock);
+    if(full) {
+        // Only disconnect notices can get here with a full queue; the reader waits for room otherwise
+        net_msg_free(msg);
+    }
+}
+
+static int net_thread_inbound_full(net_thread *t) {
+    SDL_LockMutex(t->lock);
+    int full = (t->inbound.count >= NET_THREAD_QUEUE_SIZE);
+    SDL_UnlockMutex(t->lock);
+    return full;
+}
+
+// Hands a message to ENet, through the emulator if there is one. Takes over the message.
+static int net_thread_transmit(net_thread *t, net_msg *msg) {
+    int sent = 0;
+    if(t->emu_out != NULL) {
+        net_emu_push(t->emu_out, msg, SDL_GetTicks());
+        return 0;
+    }
+    if(t->peer != NULL) {
+        enet_peer_send(t->peer, msg->channel, enet_packet_create(msg->data, msg->len, msg->flags));
+        sent = 1;
+    }
+    net_msg_free(msg);
+    return sent;
+}
+
+// Peer heartbeats are answered right here, so that our frame time doesn't show up in the peer's RTT
+static int net_thread_bounce_hb(net_thread *t, net_msg *msg) {
+    net_msg reply;
+    if(!net_msg_hb_reply(msg, t->hb_id, SDL_AtomicGet(&t->tick), &reply)) {
+        return 0;
+    }
+    net_thread_transmit(t, &reply);
+    enet_host_flush(t->host);
+    net_msg_free(msg);
+    return 1;
+}
+
+static void net_thread_deliver(net_thread *t, net_msg *msg) {
+    if(!net_thread_bounce_hb(t, msg)) {
+        net_thread_push_inbound(t, msg);
+    }
+}
+
+static void net_thread_handle_event(net_thread *t, ENetEvent *event) {
+    net_msg msg;
+    switch(event->type) {
+        case ENET_EVENT_TYPE_RECEIVE:
+            msg.type = NET_MSG_RECEIVE;
+            msg.timestamp = SDL_GetTicks();
+            msg.channel = event->channelID;
+            msg.flags = event->packet->flags;
+            msg.len = event->packet->dataLength;
+            msg.data = malloc(msg.len);
+            memcpy(msg.data, event->packet->data, msg.len);
+            if(t->emu_in != NULL) {
+                net_emu_push(t->emu_in, &msg, msg.timestamp);
+            } else {
+                net_thread_deliver(t, &msg);
+            }
+            enet_packet_destroy(event->packet);
+            break;
+        case ENET_EVENT_TYPE_DISCONNECT:
+            DEBUG("Net thread: Peer disconnected.");
+            t->peer = NULL;
+            SDL_AtomicSet(&t->state, NET_THREAD_CLOSED);
+            memset(&msg, 0, sizeof(net_msg));
+            msg.type = NET_MSG_DISCONNECT;
+            msg.timestamp = SDL_GetTicks();
+            net_thread_push_inbound(t, &msg);
+            break;
+        default:
+            break;
+    }
+}
+
+static void net_thread_send_queued(net_thread *t) {
+    net_msg msg;
+    int sent = 0;
+    while(1) {
+        SDL_LockMutex(t->lock);
+        int got = net_queue_pop(&t->outbound, &msg);
+        SDL_UnlockMutex(t->lock);
+        if(!got) {
+            break;
+        }
+        sent |= net_thread_transmit(t, &msg);
+    }
+    if(sent) {
+        enet_host_flush(t->host);
+    }
+}
+
+// Lets through the emulated messages that are due
+static void net_thread_release_emulated(net_thread *t) {
+    net_msg msg;
+    uint32_t now = SDL_GetTicks();
+    int sent = 0;
+    while(net_emu_pop(t->emu_out, &msg, now)) {
+        if(t->peer != NULL) {
+            enet_peer_send(t->peer, msg.channel, enet_packet_create(msg.data, msg.len, msg.flags));
+            sent = 1;
+        }
+        net_msg_free(&msg);
+    }
+    if(sent) {
+        enet_host_flush(t->host);
+    }
+    while(!net_thread_inbound_full(t) && net_emu_pop(t->emu_in, &msg, now)) {
+        // Stamp it with the emulated arrival time
+        msg.timestamp = now;
+        net_thread_deliver(t, &msg);
+    }
+}
+
+static void net_thread_log_emulated(const char *dir, net_emu *e) {
+    net_emu_stats stats;
+    net_emu_get_stats(e, &stats);
+    INFO("Net emulator %s: %u messages, %u dropped, %u retransmitted, %u duplicated, %u reordered",
+         dir, stats.messages, stats.dropped, stats.retransmitted, stats.duplicated, stats.reordered);
+}
+
+// Sets up the connection, unless we are told to close first
+static void net_thread_establish(net_thread *t) {
+    ENetAddress address;
+    ENetEvent event;
+    ENetPeer *pending = NULL;
+    int listening = (t->addr[0] == 0);
+    address.host = ENET_HOST_ANY;
+    address.port = t->port;
+    if(listening) {
+        if((t->host = enet_host_create(&address, 1, 2, 0, 0)) != NULL) {
+            enet_socket_set_option(t->host->socket, ENET_SOCKOPT_REUSEADDR, 1);
+        }
+    } else if(enet_address_set_host(&address, t->addr) == 0) {
+        // The lookup may take a while, which is why this isn't done on the game thread
+        if((t->host = enet_host_create(NULL, 1, 2, 0, 0)) != NULL) {
+            pending = enet_host_connect(t->host, &address, 2, 0);
+        }
+    }
+    if(t->host == NULL || (!listening && pending == NULL)) {
+        if(listening) {
+            PERROR("Net thread: Unable to listen on port %d.", t->port);
+        } else {
+            PERROR("Net thread: Unable to connect to %s:%d.", t->addr, t->port);
+        }
+        SDL_AtomicSet(&t->state, NET_THREAD_CLOSED);
+        return;
+    }
+
+    unsigned int start = SDL_GetTicks();
+    while(!SDL_AtomicGet(&t->closing)) {
+        if(!listening && SDL_GetTicks() - start > NET_THREAD_CONNECT_MS) {
+            DEBUG("Net thread: Connection to %s:%d timed out.", t->addr, t->port);
+            break;
+        }
+        if(enet_host_service(t->host, &event, NET_THREAD_SERVICE_MS) <= 0) {
+            continue;
+        }
+        if(event.type == ENET_EVENT_TYPE_CONNECT) {
+            DEBUG("Net thread: Peer connected.");
+            t->peer = event.peer;
+            SDL_AtomicSet(&t->state, NET_THREAD_CONNECTED);
+            return;
+        } else if(event.type == ENET_EVENT_TYPE_RECEIVE) {
+            enet_packet_destroy(event.packet);
+        } else if(event.type == ENET_EVENT_TYPE_DISCONNECT && !listening) {
+            DEBUG("Net thread: Connection to %s:%d refused.", t->addr, t->port);
+            pending = NULL;
+            break;
+        }
+    }
+    if(pending != NULL) {
+        enet_peer_disconnect_now(pending, 0);
+    }
+    SDL_AtomicSet(&t->state, NET_THREAD_CLOSED);
+}
+
+// Says goodbye properly so the peer doesn't have to time out, then lets go of everything
+static void net_thread_close(net_thread *t) {
+    if(t->peer != NULL) {
+        ENetEvent event;
+        DEBUG("Net thread: Closing connection.");
+        net_thread_send_queued(t);
+        if(t->emu_out != NULL) {
+            // Whatever is still held back goes out now, so the goodbye doesn't overtake it
+            net_msg msg;
+            while(net_emu_pop_any(t->emu_out, &msg)) {
+                enet_peer_send(t->peer, msg.channel, enet_packet_create(msg.data, msg.len, msg.flags));
+                net_msg_free(&msg);
+            }
+        }
+        enet_peer_disconnect(t->peer, 0);
+        int gone = 0;
+        unsigned int start = SDL_GetTicks();
+        while(!gone && !net_thread_closing_aborted() && SDL_GetTicks() - start < NET_THREAD_DISCONNECT_MS) {
+            if(enet_host_service(t->host, &event, NET_THREAD_SERVICE_MS) <= 0) {
+                continue;
+            }
+            if(event.type == ENET_EVENT_TYPE_RECEIVE) {
+                enet_packet_destroy(event.packet);
+            } else if(event.type == ENET_EVENT_TYPE_DISCONNECT) {
+                gone = 1;
+            }
+        }
+        if(!gone) {
+            DEBUG("Net thread: Peer did not answer the disconnect.");
+            enet_peer_reset(t->peer);
+        }
+    }
+    if(t->emu_out != NULL) {
+        net_thread_log_emulated("in", t->emu_in);
+        net_thread_log_emulated("out", t->emu_out);
+        net_emu_free(t->emu_in);
+        net_emu_free(t->emu_out);
+    }
+    if(t->host != NULL) {
+        enet_host_destroy(t->host);
+    }
+    net_queue_clear(&t->inbound);
+    net_queue_clear(&t->outbound);
+    SDL_DestroyMutex(t->lock);
+    MEM_FREE(t);
+    net_thread_closing_end();
+}
+
+static int net_thread_run(void *userdata) {
+    net_thread *t = userdata;
+    ENetEvent event;
+    int state = SDL_AtomicGet(&t->state);
+    if(state == NET_THREAD_CONNECTING || state == NET_THREAD_LISTENING) {
+        net_thread_establish(t);
+    }
+    while(!SDL_AtomicGet(&t->closing)) {
+        net_thread_send_queued(t);
+        if(t->emu_out != NULL) {
+            net_thread_release_emulated(t);
+        }
+        if(t->peer == NULL || net_thread_inbound_full(t)) {
+            SDL_Delay(NET_THREAD_SERVICE_MS);
+            continue;
+        }
+
+        // Wait a moment for traffic, then drain whatever else arrived without waiting
+        int timeout = NET_THREAD_SERVICE_MS;
+        while(t->peer != NULL && enet_host_service(t->host, &event, timeout) > 0) {
+            net_thread_handle_event(t, &event);
+            if(net_thread_inbound_full(t)) {
+                break;
+            }
+            timeout = 0;
+        }
+    }
+    net_thread_close(t);
+    return 0;
+}
+
+// Starts the thread on a filled in net_thread; frees it on failure
+static net_thread* net_thread_start(net_thread *t, const net_emu_config *emu) {
+    SDL_AtomicSet(&t->closing, 0);
+    SDL_AtomicSet(&t->tick, 0);
+    if(net_emu_config_enabled(emu)) {
+        // Each direction gets its own stream, and so does each end
+        t->emu_in = net_emu_create(emu, t->hb_id * 2);
+        t->emu_out = net_emu_create(emu, t->hb_id * 2 + 1);
+        INFO("Net emulator: latency %dms, jitter %dms, loss %d%%, duplicate %d%%, reorder %d%%, seed %d",
+             emu->latency, emu->jitter, emu->loss, emu->duplicate, emu->reorder, emu->seed);
+    }
+    if((t->lock = SDL_CreateMutex()) == NULL) {
+        goto error_0;
+    }
+    if((t->thread = SDL_CreateThread(net_thread_run, "net", t)) == NULL) {
+        goto error_1;
+    }
+    DEBUG("Net thread: Started.");
+    return t;
+
+error_1:
+    SDL_DestroyMutex(t->lock);
+error_0:
+    PERROR("Net thread: Unable to start: %s", SDL_GetError());
+    net_emu_free(t->emu_in);
+    net_emu_free(t->emu_out);
+    MEM_FREE(t);
+    return NULL;
+}
+
+static net_thread* net_thread_alloc(int hb_id, int state) {
+    net_thread *t = MEM_ALLOC(MEM_TAG_NET, sizeof(net_thread));
+    memset(t, 0, sizeof(net_thread));
+    t->hb_id = hb_id;
+    SDL_AtomicSet(&t->state, state);
+    return t;
+}
+
+net_thread* net_thread_create(ENetHost *host, ENetPeer *peer, int hb_id, const net_emu_config *emu) {
+    net_thread *t = net_thread_alloc(hb_id, peer != NULL ? NET_THREAD_CONNECTED : NET_THREAD_CLOSED);
+    t->host = host;
+    t->peer = peer;
+    return net_thread_start(t, emu);
+}
+
+net_thread* net_thread_connect(const char *addr, int port, int hb_id, const net_emu_config *emu) {
+    net_thread *t = net_thread_alloc(hb_id, NET_THREAD_CONNECTING);
+    strncpy(t->addr, addr, sizeof(t->addr) - 1);
+    t->port = port;
+    if(t->addr[0] == 0) {
+        PERROR("Net thread: No address to connect to.");
+        MEM_FREE(t);
+        return NULL;
+    }
+    return net_thread_start(t, emu);
+}
+
+net_thread* net_thread_listen(int port, int hb_id, const net_emu_config *emu) {
+    net_thread *t = net_thread_alloc(hb_id, NET_THREAD_LISTENING);
+    t->port = port;
+    return net_thread_start(t, emu);
+}
+
+void net_thread_free(net_thread *t) {
+    if(t == NULL) {
+        return;
+    }
+    // From here on the thread owns itself; it is gone once the disconnect is done
+    net_thread_closing_begin(t->thread);
+    SDL_AtomicSet(&t->closing, 1);
+}
+
+void net_thread_closing_begin(SDL_Thread *thread) {
+    SDL_AtomicAdd(&closing_threads, 1);
+    SDL_AtomicLock(&closing_lock);
+    if(!closing_list_created) {
+        vector_create(&closing_list, sizeof(SDL_Thread*));
+        closing_list_created = 1;
+    }
+    vector_append(&closing_list, &thread);
+    SDL_AtomicUnlock(&closing_lock);
+}
+
+void net_thread_closing_end() {
+    SDL_AtomicAdd(&closing_threads, -1);
+}
+
+int net_thread_closing_aborted() {
+    return SDL_AtomicGet(&closing_abort);
+}
+
+int net_thread_wait_closed(unsigned int timeout) {
+    unsigned int start = SDL_GetTicks();
+    while(SDL_AtomicGet(&closing_threads) > 0 && SDL_GetTicks() - start < timeout) {
+        SDL_Delay(1);
+    }
+    int left = SDL_AtomicGet(&closing_threads);
+
+    // Cut short whatever is still going, so that none of the threads outlives this
+    vector threads;
+    SDL_AtomicLock(&closing_lock);
+    if(!closing_list_created) {
+        SDL_AtomicUnlock(&closing_lock);
+        return left;
+    }
+    threads = closing_list;
+    closing_list_created = 0;
+    SDL_AtomicUnlock(&closing_lock);
+
+    iterator it;
+    SDL_Thread **thread;
+    SDL_AtomicSet(&closing_abort, 1);
+    vector_iter_begin(&threads, &it);
+    while((thread = iter_next(&it)) != NULL) {
+        SDL_WaitThread(*thread, NULL);
+    }
+    SDL_AtomicSet(&closing_abort, 0);
+    vector_free(&threads);
+    return left;
+}
+
+int net_thread_send(net_thread *t, uint8_t channel, const char *data, unsigned int len, unsigned int flags) {
+    net_msg msg;
+    msg.type = NET_MSG_RECEIVE;
+    msg.timestamp = SDL_GetTicks();
+    msg.channel = channel;
+    msg.flags = flags;
+    msg.len = len;
+    msg.data = malloc(len);
+    memcpy(msg.data, data, len);
+
+    SDL_LockMutex(t->lock);
+    int full = net_queue_push(&t->outbound, &msg);
+    if(full) {
+        t->dropped++;
+    }
+    SDL_UnlockMutex(t->lock);
+    if(full) {
+        net_msg_free(&msg);
+        return 1;
+    }
+    return 0;
+}
+
+int net_thread_recv(net_thread *t, net_msg *msg) {
+    SDL_LockMutex(t->lock);
+    int got = net_queue_pop(&t->inbound, msg);
+    SDL_UnlockMutex(t->lock);
+    return got;
+}
+
+void net_msg_free(net_msg *msg) {
+    free(msg->data);
+    msg->data = NULL;
+}
+
+int net_msg_hb_reply(const net_msg *msg, int hb_id, int tick, net_msg *reply) {
+    if(msg->len < 2 || msg->data[0] != EVENT_TYPE_HB || msg->data[1] == hb_id) {
+        return 0;
+    }
+    serial ser;
+    serial_create(&ser);
+    serial_write(&ser, msg->data, msg->len);
+    serial_write_int32(&ser, tick);
+    *reply = *msg;
+    reply->channel = 0;
+    reply->flags = ENET_PACKET_FLAG_UNSEQUENCED;
+    reply->len = ser.len;
+    reply->data = ser.data; // The reply takes over the serial buffer
+    return 1;
+}
+
+void net_thread_set_tick(net_thread *t, int tick) {
+    SDL_AtomicSet(&t->tick, tick);
+}
+
+int net_thread_get_state(net_thread *t) {
+    return SDL_AtomicGet(&t->state);
+}
+
+int net_thread_is_connected(net_thread *t) {
+    return SDL_AtomicGet(&t->state) == NET_THREAD_CONNECTED;
+}
+
+unsigned int net_thread_get_dropped(net_thread *t) {
+    SDL_LockMutex(t->lock);
+    unsigned int dropped = t->dropped;
+    SDL_UnlockMutex(t->lock);
+    return dropped;
+}
@@ -1,18 +1,44 @@
+#include <stdlib.h>
+#include <limits.h>
 #include "controller/rec_controller.h"
+#include "utils/vector.h"
 #include "utils/log.h"
 
+typedef struct rec_action_t {
+    unsigned int tick;
+    unsigned int seq; // Order in the file, for actions on the same tick
+    int action; // SD_ACT_* flags
+} rec_action;
+
 typedef struct wtf_t {
     int id;
     int last_tick;
     int last_action;
     int max_tick;
-    hashmap tick_lookup;
+    vector actions; // rec_action, sorted by tick
+    unsigned int pos; // Next action to play
 } wtf;
 
+// Direction part of a recorded action, as an ACT_* value
+static int rec_action_direction(int rec_action) {
+    int action = 0;
+    if(rec_action & SD_ACT_UP) {
+        action |= ACT_UP;
+    }
+    if(rec_action & SD_ACT_DOWN) {
+        action |= ACT_DOWN;
+    }
+    if(rec_action & SD_ACT_LEFT) {
+        action |= ACT_LEFT;
+    }
+    if(rec_action & SD_ACT_RIGHT) {
+        action |= ACT_RIGHT;
+    }
+    return (action != 0) ? action : ACT_STOP;
+}
+
 int rec_controller_tick(controller *ctrl, int ticks, ctrl_event **ev) {
     wtf *data = ctrl->data;
-    sd_rec_move *move;
-    unsigned int len;
     if (ticks > data->max_tick) {
         DEBUG("closing controller");
         controller_close(ctrl, ev);
@@ -20,7 +46,18 @@ int rec_controller_tick(controller *ctrl, int ticks, ctrl_event **ev) {
     }
 
     if (data->last_tick != ticks) {
-        if (hashmap_iget(&data->tick_lookup, ticks, (void**)(&move), &len) == 0) {
+        // Skip anything we have passed. If there are several actions for
+        // this tick, the last one wins.
+        rec_action *move = NULL;
+        rec_action *tmp;
+        while((tmp = vector_get(&data->actions, data->pos)) != NULL && tmp->tick <= (unsigned int)ticks) {
+            if(tmp->tick == (unsigned int)ticks) {
+                move = tmp;
+            }
+            data->pos++;
+        }
+
+        if (move != NULL) {
             if (move->action == SD_ACT_NONE) {
                 controller_cmd(ctrl, ACT_STOP, ev);
                 data->last_action = ACT_STOP;
@@ -31,28 +68,11 @@ int rec_controller_tick(controller *ctrl, int ticks, ctrl_event **ev) {
                     controller_cmd(ctrl, ACT_KICK, ev);
                 }
 
-                int action = 0;
-                if (move->action & SD_ACT_UP) {
-                    action |= ACT_UP;
-                }
-
-                if (move->action & SD_ACT_DOWN) {
-                    action |= ACT_DOWN;
-                }
-
-                if (move->action & SD_ACT_LEFT) {
-                    action |= ACT_LEFT;
-                }
-
-                if (move->action & SD_ACT_RIGHT) {
-                    action |= ACT_RIGHT;
-                }
-                if (action != 0) {
+                int action = rec_action_direction(move->action);
+                if (action != ACT_STOP) {
                     controller_cmd(ctrl, action, ev);
-                    data->last_action = action;
-                } else {
-                    data->last_action = ACT_STOP;
                 }
+                data->last_action = action;
             }
         } else {
             controller_cmd(ctrl, data->last_action, ev);
@@ -62,19 +82,110 @@ int rec_controller_tick(controller *ctrl, int ticks, ctrl_event **ev) {
     return 0;
 }
 
+void rec_controller_seek(controller *ctrl, int tick) {
+    wtf *data = ctrl->data;
+
+    // Binary search for the first action at or after the tick
+    unsigned int lo = 0;
+    unsigned int hi = vector_size(&data->actions);
+    while(lo < hi) {
+        unsigned int mid = (lo + hi) / 2;
+        rec_action *a = vector_get(&data->actions, mid);
+        if(a->tick < (unsigned int)tick) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    data->pos = lo;
+
+    // The held direction is whatever the previous action left it at
+    data->last_action = ACT_STOP;
+    if(lo > 0) {
+        rec_action *prev = vector_get(&data->actions, lo - 1);
+        data->last_action = rec_action_direction(prev->action);
+    }
+    data->last_tick = tick - 1;
+}
+
+int rec_controller_get_max_tick(controller *ctrl) {
+    wtf *data = ctrl->data;
+    return data->max_tick;
+}
+
+static int rec_action_compare(const void *a, const void *b) {
+    const rec_action *ra = a;
+    const rec_action *rb = b;
+    if(ra->tick != rb->tick) {
+        return (ra->tick < rb->tick) ? -1 : 1;
+    }
+    return (ra->seq < rb->seq) ? -1 : (ra->seq > rb->seq);
+}
+
 void rec_controller_create(controller *ctrl, int player, sd_rec_file *rec) {
     wtf *data = malloc(sizeof(wtf));
     data->last_action = ACT_STOP;
     data->last_tick = 0;
-    hashmap_create(&data->tick_lookup, 9);
+    data->pos = 0;
+    vector_create(&data->actions, sizeof(rec_action));
     for(unsigned int i = 0; i < rec->move_count; i++) {
         if (rec->moves[i].player_id == player && rec->moves[i].lookup_id == 2) {
-            hashmap_iput(&data->tick_lookup, rec->moves[i].tick, &rec->moves[i], sizeof(sd_rec_move));
+            rec_action a;
+            a.tick = rec->moves[i].tick;
+            a.seq = i;
+            a.action = rec->moves[i].action;
+            vector_append(&data->actions, &a);
         }
     }
-    data->max_tick = rec->moves[rec->move_count-1].tick;
-    DEBUG("max tick is %d", data->last_tick);
+
+    // Moves are normally stored in order already; make sure of it, since playback
+    // and seeking walk the list sequentially.
+    int sorted = 1;
+    for(unsigned int i = 1; i < vector_size(&data->actions); i++) {
+        if(rec_action_compare(vector_get(&data->actions, i - 1), vector_get(&data->actions, i)) > 0) {
+            sorted = 0;
+            break;
+        }
+    }
+    if(!sorted) {
+        vector_sort(&data->actions, &rec_action_compare);
+    }
+
+    data->max_tick = (rec->move_count > 0) ? rec->moves[rec->move_count-1].tick : 0;
+    DEBUG("max tick is %d", data->max_tick);
     ctrl->data = data;
     ctrl->type = CTRL_TYPE_REC;
     ctrl->dyntick_fun = &rec_controller_tick;
 }
+
+void rec_controller_create_live(controller *ctrl, int player) {
+    sd_rec_file rec;
+    sd_rec_create(&rec);
+    rec_controller_create(ctrl, player, &rec);
+    sd_rec_free(&rec);
+    wtf *data = ctrl->data;
+    data->max_tick = INT_MAX;
+}
+
+void rec_controller_add(controller *ctrl, unsigned int tick, int action) {
+    wtf *data = ctrl->data;
+    rec_action a;
+    a.tick = tick;
+    a.seq = vector_size(&data->actions);
+    a.action = action;
+    vector_append(&data->actions, &a);
+}
+
+void rec_controller_set_end(controller *ctrl, int tick) {
+    wtf *data = ctrl->data;
+    data->max_tick = tick;
+}
+
+void rec_controller_free(controller *ctrl) {
+    wtf *data = ctrl->data;
+    if(data) {
+        vector_free(&data->actions);
+        free(data);
+        ctrl->data = NULL;
+    }
+}
@@ -1,21 +1,36 @@
 #include <stdio.h>
+#include <string.h>
 #include <signal.h> // signal()
 #include <SDL2/SDL.h>
 #include "engine.h"
 #include "utils/log.h"
 #include "utils/config.h"
+#include "utils/profiler.h"
+#include "utils/mem_pool.h"
+#include "utils/mem_arena.h"
 #include "audio/audio.h"
 #include "audio/music.h"
 #include "resources/sounds_loader.h"
 #include "video/surface.h"
 #include "video/video.h"
+#include "video/capture.h"
+#include "video/render_report.h"
 #include "resources/languages.h"
 #include "game/game_state.h"
+#include "game/replay.h"
+#include "game/spectate.h"
+#include "controller/net_relay.h"
 #include "game/utils/settings.h"
+#include "game/utils/statehash.h"
 #include "game/utils/ticktimer.h"
 #include "game/gui/text_render.h"
 #include "console/console.h"
 
+// Time per rendered frame that is spent simulating while fast-forwarding a replay
+#define FAST_FORWARD_FRAME_MS 15
+// Game time per frame when rendering offscreen; fixed so that runs render the same frames
+#define OFFSCREEN_FRAME_MS 16
+
 static int run = 0;
 static int start_timeout = 30;
 #ifndef STANDALONE_SERVER
@@ -28,7 +43,7 @@ void exit_handler(int s) {
     run = 0;
 }
 
-int engine_init() {
+int engine_init(engine_init_flags *init_flags) {
 #ifndef STANDALONE_SERVER
     settings *setting = settings_get();
 
@@ -40,11 +55,16 @@ int engine_init() {
     char *scaler = setting->video.scaler;
     const char *audiosink = setting->sound.sink;
 
-    // Initialize everything.
-    if(video_init(w, h, fs, vsync, scaler, scale_factor)) {
+    // Initialize everything. Offscreen runs are silent, so that they don't need an audio device either.
+    if(init_flags->render_report[0] != 0) {
+        if(video_init_offscreen(scaler, scale_factor)) {
+            goto exit_0;
+        }
+        audiosink = NULL;
+    } else if(video_init(w, h, fs, vsync, scaler, scale_factor)) {
         goto exit_0;
     }
-    if(!audio_is_sink_available(audiosink)) {
+    if(audiosink != NULL && !audio_is_sink_available(audiosink)) {
         const char *prev_sink = audiosink;
         audiosink = audio_get_first_sink_name();
         if(audiosink == NULL) {
@@ -56,6 +76,7 @@ int engine_init() {
     if(audio_init(audiosink)) {
         goto exit_1;
     }
+    music_init();
     sound_set_volume(setting->sound.sound_vol/10.0f);
     music_set_volume(setting->sound.music_vol/10.0f);
 #endif
@@ -63,6 +84,9 @@ int engine_init() {
     if(sounds_loader_init()) {
         goto exit_2;
     }
+#ifndef STANDALONE_SERVER
+    sound_preload();
+#endif
     if(lang_init()) {
         goto exit_3;
     }
@@ -94,26 +118,103 @@ exit_3:
 exit_2:
 #ifndef STANDALONE_SERVER
     audio_close();
-#endif
+    music_close();
 
 exit_1:
-#ifndef STANDALONE_SERVER
     video_close();
-#endif
 
 exit_0:
+#endif
     return 1;
 }
 
+// Runs all static and dynamic ticks that the waited time allows
+static void engine_tick(game_state *gs, int *static_wait, int *dynamic_wait) {
+    while(*static_wait > 10) {
+        // Static tick for gamestate
+        game_state_static_tick(gs);
+
+        // Tick console
+        console_tick();
+
+        // Tick video (tcache)
+        video_tick();
+
+        *static_wait -= 10;
+    }
+    while(*dynamic_wait > game_state_ms_per_dyntick(gs)) {
+        // Tick scene
+        game_state_dynamic_tick(gs);
+        replay_tick(gs);
+
+        // Handle waiting period leftover time
+        *dynamic_wait -= game_state_ms_per_dyntick(gs);
+    }
+}
+
+#ifndef STANDALONE_SERVER
+// Steps the offscreen scene script after a rendered frame. Returns 1 when the run is done.
+static int engine_offscreen_step(game_state *gs, engine_init_flags *init_flags, int frame) {
+    if(init_flags->render_scene_count > 0) {
+        if(frame % init_flags->render_frames != 0) {
+            return 0;
+        }
+        int next = frame / init_flags->render_frames;
+        if(next >= init_flags->render_scene_count) {
+            return 1;
+        }
+        game_state_set_next(gs, init_flags->render_scenes[next]);
+        return 0;
+    }
+    if(init_flags->render_frames > 0 && frame >= init_flags->render_frames) {
+        return 1;
+    }
+    // Recordings are done once the fight is over
+    return replay_is_active() && gs->next_id != gs->this_id;
+}
+#endif
+
+#ifdef USE_PROFILER
+static void engine_render_profiler() {
+    const profiler_zone_stats *stats;
+    int count = profiler_get_stats(&stats);
+    char buf[64];
+    font_render_shadowed(&font_small, "zone             avg   max", 2, 2, color_create(255, 255, 0, 255), TEXT_SHADOW_RIGHT|TEXT_SHADOW_BOTTOM);
+    for(int i = 0; i < count; i++) {
+        snprintf(buf, sizeof(buf), "%*s%-*s %5.2f %5.2f",
+                 stats[i].depth, "", 14 - stats[i].depth, stats[i].name,
+                 stats[i].avg_ms, stats[i].max_ms);
+        font_render_shadowed(&font_small, buf, 2, 2 + (i + 1) * font_small.h, color_create(255, 255, 255, 255), TEXT_SHADOW_RIGHT|TEXT_SHADOW_BOTTOM);
+    }
+}
+#endif
+
 void engine_run(engine_init_flags *init_flags) {
+#ifndef STANDALONE_SERVER
     SDL_Event e;
+    int debugger_render = 0;
+#endif
     int visual_debugger = 0;
     int debugger_proceed = 0;
-    int debugger_render = 0;
 
+    // Recording playback controls
+    int replay_ff = 0;
+    int replay_paused = 0;
+    int replay_step = 0;
+
+#ifdef USE_PROFILER
+    int profiler_overlay = 0;
+#endif
+
+#ifndef STANDALONE_SERVER
     //if mouse_visible_ticks <= 0, hide mouse
     int mouse_visible_ticks = 1000;
 
+    // Offscreen runs advance the game by a fixed time per frame and record every frame
+    int offscreen = video_is_offscreen();
+    int offscreen_frames = 0;
+#endif
+
     INFO(" --- BEGIN GAME LOG ---");
 
 #ifdef STANDALONE_SERVER
@@ -125,7 +226,7 @@ void engine_run(engine_init_flags *init_flags) {
     // Game start timeout.
     // Wait a moment so that people are mentally prepared
     // (with the recording software on) for the game to start :)
-    if(!settings_get()->video.crossfade_on) {
+    if(!settings_get()->video.crossfade_on || offscreen) {
         start_timeout = 0;
     }
     while(start_timeout > 0) {
@@ -144,20 +245,55 @@ void engine_run(engine_init_flags *init_flags) {
     sound_set_volume(settings_get()->sound.sound_vol/10.0f);
 #endif
 
-    // Set up game
+    // Set up game. Recordings can be seeked, so set that up before the arena exists.
+    if(strlen(init_flags->rec_file) > 0 && init_flags->record == 0) {
+        replay_init(init_flags->rec_file);
+    }
+    if(init_flags->net_mode == NET_MODE_SPECTATOR) {
+        settings_network *net = &settings_get()->net;
+        int port = (net->net_relay_port > 0) ? net->net_relay_port : NET_RELAY_DEFAULT_PORT;
+        if(spectate_init(net->net_connect_ip, port)) {
+            return;
+        }
+    }
     game_state *gs = malloc(sizeof(game_state));
     if(game_state_create(gs, init_flags)) {
+        replay_close();
+        spectate_close();
         return;
     }
 
+    // Start the determinism checker, if requested
+    statehash_init(init_flags->hash_mode, init_flags->hash_file, init_flags->hash_interval);
+
+#ifndef STANDALONE_SERVER
+    // Start frame capture, if requested
+    if(init_flags->capture_file[0] != 0) {
+        capture_start(init_flags->capture_file);
+    }
+    if(offscreen) {
+        render_report_start(init_flags->render_report);
+        if(engine_offscreen_step(gs, init_flags, 0)) {
+            run = 0;
+        }
+    }
+#endif
+
+#ifdef USE_PROFILER
+    profiler_init(init_flags->trace_file);
+#endif
+
     // Game loop
     int frame_start = SDL_GetTicks();
+    unsigned int audio_ticks = 0;
     int dynamic_wait = 0;
     int static_wait = 0;
     while(run && game_state_is_running(gs)) {
+        PROFILE_FRAME();
 
 #ifndef STANDALONE_SERVER
         // Handle events
+        PROFILE_BEGIN("events");
         int check_fs;
         while(SDL_PollEvent(&e)) {
             // Handle other events
@@ -178,6 +314,29 @@ void engine_run(engine_init_flags *init_flags) {
                     if(e.key.keysym.sym == SDLK_F6) {
                         debugger_render = !debugger_render;
                     }
+#ifdef USE_PROFILER
+                    if(e.key.keysym.sym == SDLK_F4) {
+                        profiler_overlay = !profiler_overlay;
+                    }
+#endif
+                    if(replay_is_active()) {
+                        if(e.key.keysym.sym == SDLK_F7) {
+                            replay_ff = !replay_ff;
+                        }
+                        if(e.key.keysym.sym == SDLK_F8) {
+                            replay_paused = !replay_paused;
+                        }
+                        if(e.key.keysym.sym == SDLK_F9 && replay_paused) {
+                            replay_step = 1;
+                        }
+                        if(e.key.keysym.sym == SDLK_F10) {
+                            unsigned int tick = game_state_get_tick(gs);
+                            replay_seek(gs, (tick > REPLAY_SEEK_STEP) ? tick - REPLAY_SEEK_STEP : 0);
+                        }
+                        if(e.key.keysym.sym == SDLK_F11) {
+                            replay_seek(gs, game_state_get_tick(gs) + REPLAY_SEEK_STEP);
+                        }
+                    }
                     break;
                 case SDL_MOUSEMOTION:
                     mouse_visible_ticks = 1000;
@@ -237,6 +396,7 @@ void engine_run(engine_init_flags *init_flags) {
                 game_state_handle_event(gs, &e);
             }
         }
+        PROFILE_END();
 
         // hide mouse after n ticks
         if(mouse_visible_ticks > 0) {
@@ -247,12 +407,44 @@ void engine_run(engine_init_flags *init_flags) {
         }
 #endif
         // Tick controllers
+        PROFILE_BEGIN("controllers");
         game_state_tick_controllers(gs);
+        PROFILE_END();
 
         // Render scene
         int dt = (SDL_GetTicks() - frame_start);
         frame_start = SDL_GetTicks(); // Reset timer
-        if(!visual_debugger) {
+#ifndef STANDALONE_SERVER
+        if(offscreen) {
+            dt = OFFSCREEN_FRAME_MS;
+        }
+#endif
+        if(replay_paused) {
+            // Frame step runs exactly one dynamic tick
+            if(replay_step) {
+                game_state_dynamic_tick(gs);
+                replay_tick(gs);
+                replay_step = 0;
+            }
+        } else if(replay_ff) {
+            // Simulate for as long as one frame allows; only the last state gets rendered
+            unsigned int ff_start = SDL_GetTicks();
+            while(SDL_GetTicks() - ff_start < FAST_FORWARD_FRAME_MS && game_state_is_running(gs)) {
+                dynamic_wait += 10;
+                static_wait += 10;
+                engine_tick(gs, &static_wait, &dynamic_wait);
+            }
+        } else if(spectate_is_active()) {
+            // Only simulate as far as the match stream has got
+            int ready = spectate_poll(gs);
+            if(ready != 0) {
+                dynamic_wait += dt;
+                static_wait += dt;
+            }
+            if(ready > 0 && static_wait > ready * 10) {
+                static_wait = ready * 10 + 1;
+            }
+        } else if(!visual_debugger) {
             dynamic_wait += dt;
             static_wait += dt;
         } else if(debugger_proceed) {
@@ -260,42 +452,45 @@ void engine_run(engine_init_flags *init_flags) {
             static_wait += 20;
             debugger_proceed = 0;
         }
-        while(static_wait > 10) {
-            // Static tick for gamestate
-            game_state_static_tick(gs);
-
-            // Tick console
-            console_tick();
-
-            // Tick video (tcache)
-            video_tick();
-
-            static_wait -= 10;
-        }
-        while(dynamic_wait > game_state_ms_per_dyntick(gs)) {
-            // Tick scene
-            game_state_dynamic_tick(gs);
-
-            // Handle waiting period leftover time
-            dynamic_wait -= game_state_ms_per_dyntick(gs);
-        }
+        engine_tick(gs, &static_wait, &dynamic_wait);
 
 #ifndef STANDALONE_SERVER
         // Handle audio
         if(!visual_debugger) {
-            audio_render();
+            PROFILE_BEGIN("audio");
+            audio_ticks += dt;
+            audio_render(audio_ticks);
+            PROFILE_END();
         }
 
         // Do the actual video rendering jobs
         if(enable_screen_updates) {
 
+            uint64_t render_start = SDL_GetPerformanceCounter();
+            PROFILE_BEGIN("render");
             video_render_prepare();
             game_state_render(gs);
             if(debugger_render) {
                 game_state_debug(gs);
             }
             console_render();
+#ifdef USE_PROFILER
+            if(profiler_overlay) {
+                engine_render_profiler();
+            }
+#endif
+            PROFILE_END();
+            PROFILE_BEGIN("present");
             video_render_finish();
+            PROFILE_END();
+
+            if(offscreen) {
+                double render_ms = (SDL_GetPerformanceCounter() - render_start) * 1000.0 / SDL_GetPerformanceFrequency();
+                render_report_frame(gs->this_id, game_state_get_tick(gs), render_ms, video_offscreen_hash());
+                if(engine_offscreen_step(gs, init_flags, ++offscreen_frames)) {
+                    run = 0;
+                }
+            }
 
             // If screenshot requested, do it here.
             if(take_screenshot) {
@@ -330,6 +525,19 @@ void engine_run(engine_init_flags *init_flags) {
 #endif // STANDALONE_SERVER
     }
 
+#ifndef STANDALONE_SERVER
+    // Flush any queued frames before tearing down
+    capture_stop();
+    render_report_stop();
+#endif
+
+    statehash_close();
+    replay_close();
+    spectate_close();
+#ifdef USE_PROFILER
+    profiler_close();
+#endif
+
     // Free scene object
     game_state_free(gs);
     free(gs);
@@ -345,7 +553,10 @@ void engine_close() {
     sounds_loader_close();
 #ifndef STANDALONE_SERVER
     audio_close();
+    music_close();
     video_close();
 #endif
+    mem_pool_shared_close();
+    mem_arena_scene_close();
     INFO("Engine deinit successful.");
 }
@@ -11,6 +11,7 @@ const char *ai_difficulty_names[] = {
     "CHAMPION",
     "DEADLY",
     "ULTIMATE",
+    "LOOKAHEAD",
 };
 
 const char *round_type_names[] = {
@@ -74,7 +75,7 @@ const char *scene_type_names[] = {
 };
 
 int rand_arena() {
-   return SCENE_ARENA0 + rand_int(5);
+   return SCENE_ARENA0 + random_int(rand_stream(RAND_STREAM_MENU), 5);
 }
 
 const char* ai_difficulty_get_name(unsigned int id) {
@@ -6,7 +6,9 @@
 #include "controller/joystick.h"
 #include "controller/rec_controller.h"
 #include "utils/log.h"
+#include "utils/profiler.h"
 #include "utils/miscmath.h"
+#include "utils/mem_arena.h"
 #include "game/utils/serial.h"
 #include "resources/ids.h"
 #include "resources/pilots.h"
@@ -14,9 +16,12 @@
 #include "video/video.h"
 #include "video/tcache.h"
 #include "game/game_state.h"
+#include "game/particles.h"
 #include "game/common_defines.h"
 #include "game/utils/settings.h"
 #include "game/utils/ticktimer.h"
+#include "game/utils/statehash.h"
+#include "game/spectate.h"
 #include "game/protos/scene.h"
 #include "game/protos/object.h"
 #include "game/protos/intersect.h"
@@ -53,7 +58,7 @@ typedef struct {
     object *obj;
 } render_obj;
 
-int game_state_create(game_state *gs, engine_init_flags *init_flags) {
+static void game_state_init(game_state *gs, engine_init_flags *init_flags) {
     gs->run = 1;
     gs->paused = 0;
     gs->tick = 0;
@@ -62,8 +67,11 @@ int game_state_create(game_state *gs, engine_init_flags *init_flags) {
     gs->next_requires_refresh = 0;
     gs->net_mode = init_flags->net_mode;
     gs->speed = settings_get()->gameplay.speed + 5;
+    gs->scene_seed = rand_get_seed();
     gs->init_flags = init_flags;
+    gs->headless = 0;
     vector_create(&gs->objects, sizeof(render_obj));
+    gs->particles = particles_create();
 
     // For screen shake
     gs->screen_shake_horizontal = 0;
@@ -78,11 +86,15 @@ int game_state_create(game_state *gs, engine_init_flags *init_flags) {
     gs->this_wait_ticks = 0;
 
     // Set up players
-    gs->sc = malloc(sizeof(scene));
     for(int i = 0; i < 2; i++) {
         gs->players[i] = malloc(sizeof(game_player));
         game_player_create(gs->players[i]);
     }
+}
+
+int game_state_create(game_state *gs, engine_init_flags *init_flags) {
+    game_state_init(gs, init_flags);
+    gs->sc = malloc(sizeof(scene));
 
     reconfigure_controller(gs);
     int nscene;
@@ -103,18 +115,23 @@ int game_state_create(game_state *gs, engine_init_flags *init_flags) {
             goto error_0;
         }
 
-        // set the HAR colors, pilot, har type
-        for(int i = 0; i < 2; i++) {
-            gs->players[i]->colors[0] = rec.pilots[i].info.color_3;
-            gs->players[i]->colors[1] = rec.pilots[i].info.color_2;
-            gs->players[i]->colors[2] = rec.pilots[i].info.color_1;
-            gs->players[i]->har_id = HAR_JAGUAR + rec.pilots[i].info.har_id;
-            gs->players[i]->pilot_id = rec.pilots[i].info.pilot_id;
+        game_state_setup_rec(gs, &rec);
+        sd_rec_free(&rec);
+        if(arena_create(gs->sc)) {
+            PERROR("Error while creating arena scene.");
+            goto error_1;
         }
-
-        // XXX use playback controller once it exista
-        _setup_rec_controller(gs, 0, &rec);
-        _setup_rec_controller(gs, 1, &rec);
+    } else if(spectate_is_active()) {
+        // Like a recording, except that the moves are still coming in.
+        // Start from the host's seed, so that the arena hazards come out the same.
+        rand_seed(spectate_get_seed());
+        gs->scene_seed = rand_get_seed();
+        nscene = spectate_get_scene();
+        if(!is_arena(nscene) || scene_create(gs->sc, gs, nscene)) {
+            PERROR("Error while loading scene %d.", nscene);
+            goto error_0;
+        }
+        spectate_setup(gs);
         if(arena_create(gs->sc)) {
             PERROR("Error while creating arena scene.");
             goto error_1;
@@ -153,9 +170,21 @@ error_1:
 error_0:
     free(gs->sc);
     vector_free(&gs->objects);
+    particles_free(gs->particles);
     return 1;
 }
 
+// Creates a game state without any scene or controllers. Caller sets up the
+// players and then loads a scene with game_load_new().
+int game_state_create_headless(game_state *gs, engine_init_flags *init_flags) {
+    game_state_init(gs, init_flags);
+    gs->headless = 1;
+    gs->sc = NULL;
+    gs->this_id = SCENE_NONE;
+    gs->next_id = SCENE_NONE;
+    return 0;
+}
+
 /*
  * \param game_state gs Game state object
  * \param obj Object to add
@@ -218,7 +247,7 @@ void game_state_del_animation(game_state *gs, int anim_id) {
         animation *ani = object_get_animation(robj->obj);
         if(ani != NULL && ani->id == anim_id) {
             object_free(robj->obj);
-            free(robj->obj);
+            object_dealloc(robj->obj);
             vector_delete(&gs->objects, &it);
             DEBUG("Deleted animation %i from game_state.", anim_id);
             return;
@@ -234,7 +263,7 @@ void game_state_del_object(game_state *gs, object *target) {
     while((robj = iter_next(&it)) != NULL) {
         if(target == robj->obj) {
             object_free(robj->obj);
-            free(robj->obj);
+            object_dealloc(robj->obj);
             vector_delete(&gs->objects, &it);
             return;
         }
@@ -259,7 +288,7 @@ void game_state_clear_hazards_projectiles(game_state *gs) {
     while((robj = iter_next(&it)) != NULL) {
         if(object_get_group(robj->obj) == GROUP_PROJECTILE) {
             object_free(robj->obj);
-            free(robj->obj);
+            object_dealloc(robj->obj);
             vector_delete(&gs->objects, &it);
         }
     }
@@ -341,12 +370,14 @@ void game_state_render(game_state *gs) {
             object_render(robj->obj);
         }
     }
+    particles_render(gs->particles, RENDER_LAYER_BOTTOM);
 
     // cast object shadows (scrap, projectiles, etc)
     vector_iter_begin(&gs->objects, &it);
     while((robj = iter_next(&it)) != NULL) {
         object_render_shadow(robj->obj);
     }
+    particles_render_shadows(gs->particles);
 
     // Render passive HARs here
     for(int i = 0; i < 2; i++) {
@@ -381,6 +412,7 @@ void game_state_render(game_state *gs) {
             object_render(robj->obj);
         }
     }
+    particles_render(gs->particles, RENDER_LAYER_TOP);
 
     // Render scene overlay (menus, etc.)
     scene_render_overlay(gs->sc);
@@ -400,11 +432,15 @@ void game_state_debug(game_state *gs) {
 
 int game_load_new(game_state *gs, int scene_id) {
     // Free old scene
-    scene_free(gs->sc);
-    free(gs->sc);
+    if(gs->sc != NULL) {
+        scene_free(gs->sc);
+        free(gs->sc);
+    }
 
     // Clear up old video cache objects
-    tcache_clear();
+    if(!gs->headless) {
+        tcache_clear();
+    }
 
     // Remove old objects
     render_obj *robj;
@@ -413,12 +449,17 @@ int game_load_new(game_state *gs, int scene_id) {
     while((robj = iter_next(&it)) != NULL) {
         if(!robj->persistent) {
             object_free(robj->obj);
-            free(robj->obj);
+            object_dealloc(robj->obj);
             vector_delete(&gs->objects, &it);
         }
     }
+    particles_clear(gs->particles);
+
+    // Nothing from the old scene is left in the scene arena now
+    mem_arena_scene_reset();
 
     // Initialize new scene with BK data etc.
+    gs->scene_seed = rand_get_seed();
     gs->sc = malloc(sizeof(scene));
     if(scene_create(gs->sc, gs, scene_id)) {
         PERROR("Error while loading scene %d.", scene_id);
@@ -512,6 +553,7 @@ error_1:
     scene_free(gs->sc);
 error_0:
     free(gs->sc);
+    gs->sc = NULL;
     return 1;
 }
 
@@ -539,7 +581,7 @@ void game_state_cleanup(game_state *gs) {
         if(object_finished(robj->obj)) {
             /*DEBUG("Animation object %d is finished, removing.", robj->obj->cur_animation->id);*/
             object_free(robj->obj);
-            free(robj->obj);
+            object_dealloc(robj->obj);
             vector_delete(&gs->objects, &it);
         }
     }
@@ -609,8 +651,20 @@ void game_state_call_tick(game_state *gs, int mode) {
     }
 }
 
+// Advance all objects by one dynamic tick
+static void game_state_step(game_state *gs) {
+    game_state_cleanup(gs);
+    game_state_call_move(gs);
+    particles_move(gs->particles);
+    game_state_call_collide(gs);
+    game_state_call_tick(gs, TICK_DYNAMIC);
+    particles_tick(gs->particles);
+    gs->tick++;
+}
+
 // This function is always called with the same interval, and game speed does not affect it
 void game_state_static_tick(game_state *gs) {
+    PROFILE_BEGIN("static tick");
     // Set scene crossfade values
     if(gs->next_wait_ticks > 0) {
         gs->next_wait_ticks--;
@@ -626,23 +680,31 @@ void game_state_static_tick(game_state *gs) {
 
     // Call static tick functions
     game_state_call_tick(gs, TICK_STATIC);
+    PROFILE_END();
 }
 
 // This function is called when the game speed requires it
 void game_state_dynamic_tick(game_state *gs) {
+    PROFILE_BEGIN("dynamic tick");
+
     // We want to load another scene
     if(gs->this_id != gs->next_id && (gs->next_wait_ticks <= 1 || !settings_get()->video.crossfade_on)) {
         // If this is the end, set run to 0 so that engine knows to close here
         if(gs->next_id == SCENE_NONE) {
             DEBUG("Next ID is SCENE_NONE! bailing.");
             gs->run = 0;
+            PROFILE_END();
             return;
         }
 
         // Load up new scene
-        if(game_load_new(gs, gs->next_id)) {
+        PROFILE_BEGIN("scene load");
+        int failed = game_load_new(gs, gs->next_id);
+        PROFILE_END();
+        if(failed) {
             PERROR("Error while loading new scene! bailing.");
             gs->run = 0;
+            PROFILE_END();
             return;
         }
         if(settings_get()->video.crossfade_on) {
@@ -690,20 +752,37 @@ void game_state_dynamic_tick(game_state *gs) {
 
     if(!game_state_is_paused(gs)) {
         // Clean up objects
+        PROFILE_BEGIN("cleanup");
         game_state_cleanup(gs);
+        PROFILE_END();
 
         // Call object_move for all objects
+        PROFILE_BEGIN("move");
         game_state_call_move(gs);
+        particles_move(gs->particles);
+        PROFILE_END();
 
         // Handle physics for all pairs of objects
+        PROFILE_BEGIN("collide");
         game_state_call_collide(gs);
+        PROFILE_END();
 
         // Tick all objects
+        PROFILE_BEGIN("objects");
         game_state_call_tick(gs, TICK_DYNAMIC);
+        PROFILE_END();
+
+        // Tick debris
+        PROFILE_BEGIN("particles");
+        particles_tick(gs->particles);
+        PROFILE_END();
 
         // Increment tick
         gs->tick++;
         LOGTICK(gs->tick);
+
+        // Hash the state for determinism checks
+        statehash_tick(gs);
     }
 
     // Free extra controller events
@@ -711,6 +790,7 @@ void game_state_dynamic_tick(game_state *gs) {
 
     // int_tick is used for ping calculation so it shouldn't be touched
     gs->int_tick++;
+    PROFILE_END();
 }
 
 unsigned int game_state_get_tick(game_state *gs) {
@@ -798,6 +878,20 @@ void _setup_rec_controller(game_state *gs, int player_id, sd_rec_file *rec) {
     game_player_set_ctrl(player, ctrl);
 }
 
+// Sets up both players to play back a recording. The recording can be freed afterwards.
+void game_state_setup_rec(game_state *gs, sd_rec_file *rec) {
+    // set the HAR colors, pilot, har type
+    for(int i = 0; i < 2; i++) {
+        gs->players[i]->colors[0] = rec->pilots[i].info.color_3;
+        gs->players[i]->colors[1] = rec->pilots[i].info.color_2;
+        gs->players[i]->colors[2] = rec->pilots[i].info.color_1;
+        gs->players[i]->har_id = HAR_JAGUAR + rec->pilots[i].info.har_id;
+        gs->players[i]->pilot_id = rec->pilots[i].info.pilot_id;
+    }
+    _setup_rec_controller(gs, 0, rec);
+    _setup_rec_controller(gs, 1, rec);
+}
+
 void reconfigure_controller(game_state *gs) {
     settings_keyboard *k = &settings_get()->keys;
     if (k->ctrl_type1 == CTRL_TYPE_KEYBOARD) {
@@ -825,8 +919,8 @@ void game_state_init_demo(game_state *gs) {
         game_player_set_selectable(player, 1);
 
         // select random pilot and har
-        player->pilot_id = rand_int(10);
-        player->har_id = rand_int(11);
+        player->pilot_id = random_int(rand_stream(RAND_STREAM_MENU), 10);
+        player->har_id = random_int(rand_stream(RAND_STREAM_MENU), 11);
         chr_score_reset(&player->score, 1);
 
         // set proper color
@@ -845,14 +939,17 @@ void game_state_free(game_state *gs) {
     vector_iter_begin(&gs->objects, &it);
     while((robj = iter_next(&it)) != NULL) {
         object_free(robj->obj);
-        free(robj->obj);
+        object_dealloc(robj->obj);
         vector_delete(&gs->objects, &it);
     }
     vector_free(&gs->objects);
+    particles_free(gs->particles);
 
     // Free scene
-    scene_free(gs->sc);
-    free(gs->sc);
+    if(gs->sc != NULL) {
+        scene_free(gs->sc);
+        free(gs->sc);
+    }
 
     // Free players
     for(int i = 0; i < 2; i++) {
@@ -860,6 +957,7 @@ void game_state_free(game_state *gs) {
         game_player_free(gs->players[i]);
         free(gs->players[i]);
     }
+    mem_arena_scene_reset();
 }
 
 int game_state_ms_per_dyntick(game_state *gs) {
@@ -915,12 +1013,8 @@ int game_state_serialize(game_state *gs, serial *ser) {
     return 0;
 }
 
-int game_state_unserialize(game_state *gs, serial *ser, int rtt) {
-#ifdef DEBUGMODE
-    int oldtick = gs->tick;
-#endif
+static int game_state_unserialize_objects(game_state *gs, serial *ser) {
     gs->tick = serial_read_int32(ser);
-    int endtick = gs->tick + ceil(rtt / 2.0f);
     rand_seed(serial_read_int32(ser));
     game_state_set_paused(gs, serial_read_int32(ser));
 
@@ -928,7 +1022,7 @@ int game_state_unserialize(game_state *gs, serial *ser, int rtt) {
         // Declare some vars
         game_player *player = game_state_get_player(gs, i);
         game_state_del_object(gs, player->har);
-        object *obj = malloc(sizeof(object));
+        object *obj = object_alloc();
 
         // Create object and specialize it as HAR.
         // Errors are unlikely here, but check anyway.
@@ -959,7 +1053,7 @@ int game_state_unserialize(game_state *gs, serial *ser, int rtt) {
     while((robj = iter_next(&it)) != NULL) {
         if (robj->obj->group == GROUP_PROJECTILE) {
             object_free(robj->obj);
-            free(robj->obj);
+            object_dealloc(robj->obj);
             vector_delete(&gs->objects, &it);
         }
     }
@@ -967,7 +1061,7 @@ int game_state_unserialize(game_state *gs, serial *ser, int rtt) {
     uint8_t count = serial_read_int8(ser);
 
     for (int i = 0; i < count; i++) {
-        object *obj = malloc(sizeof(object));
+        object *obj = object_alloc();
         int layer = serial_read_int8(ser);
         object_create(obj, gs, vec2i_create(0, 0), vec2f_create(0,0));
         object_unserialize(obj, ser, gs);
@@ -978,18 +1072,44 @@ int game_state_unserialize(game_state *gs, serial *ser, int rtt) {
 
     chr_score_unserialize(game_player_get_score(game_state_get_player(gs, 0)), ser);
     chr_score_unserialize(game_player_get_score(game_state_get_player(gs, 1)), ser);
+    return 0;
+}
+
+int game_state_unserialize(game_state *gs, serial *ser, int catchup) {
+#ifdef DEBUGMODE
+    int oldtick = gs->tick;
+#endif
+    game_state_unserialize_objects(gs, ser);
+    int endtick = gs->tick + catchup;
 
     // tick things back to the current time
     DEBUG("replaying %d ticks", endtick - gs->tick);
-    DEBUG("adjusting clock from %d to %d (%d)", oldtick, endtick, ceil(rtt / 2.0f));
+    DEBUG("adjusting clock from %d to %d (%d)", oldtick, endtick, catchup);
     while (gs->tick <= endtick) {
-        game_state_cleanup(gs);
-        game_state_call_move(gs);
-        game_state_call_collide(gs);
-        game_state_call_tick(gs, TICK_DYNAMIC);
-        gs->tick++;
+        game_state_step(gs);
     }
     DEBUG("replay done");
 
     return 0;
 }
+
+/*
+ * Snapshots are the serialized state kept in memory. The serial buffer is
+ * reused between snapshots, so taking one does not allocate in the common case.
+ */
+int game_state_snapshot(game_state *gs, serial *ser) {
+    serial_reset(ser);
+    return game_state_serialize(gs, ser);
+}
+
+int game_state_restore(game_state *gs, serial *ser) {
+    serial_read_reset(ser);
+    return game_state_unserialize_objects(gs, ser);
+}
+
+// Runs the object simulation forward without scene logic, input or rendering
+void game_state_simulate(game_state *gs, int ticks) {
+    for(int i = 0; i < ticks; i++) {
+        game_state_step(gs);
+    }
+}
@@ -2,6 +2,7 @@
 
 #include "game/gui/component.h"
 #include "utils/log.h"
+#include "utils/memtrack.h"
 
 void component_tick(component *c) {
     if(c->tick) {
@@ -120,7 +121,7 @@ void component_set_find_cb(component *c, component_find_cb cb) {
 }
 
 component* component_create() {
-    component *c = malloc(sizeof(component));
+    component *c = MEM_ALLOC(MEM_TAG_GUI, sizeof(component));
     memset(c, 0, sizeof(component));
     c->x_hint = -1;
     c->y_hint = -1;
@@ -136,5 +137,5 @@ void component_free(component *c) {
     if(c->free != NULL) {
         c->free(c);
     }
-    free(c);
+    MEM_FREE(c);
 }
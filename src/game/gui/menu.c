@@ -6,6 +6,7 @@
 #include "audio/sound.h"
 #include "utils/vector.h"
 #include "utils/log.h"
+#include "utils/memtrack.h"
 
 void menu_select(component *c, component *sc) {
     sizer *s = component_get_obj(c);
@@ -269,7 +270,7 @@ static void menu_free(component *c) {
     if(m->free) {
         m->free(c); // Free menu userdata
     }
-    free(m);
+    MEM_FREE(m);
 }
 
 static component* menu_find(component *c, int id) {
@@ -283,7 +284,7 @@ static component* menu_find(component *c, int id) {
 component* menu_create(int obj_h) {
     component *c = sizer_create();
 
-    menu* m = malloc(sizeof(menu));
+    menu* m = MEM_ALLOC(MEM_TAG_GUI, sizeof(menu));
     memset(m, 0, sizeof(menu));
     m->margin_top = 8;
     m->obj_h = obj_h;
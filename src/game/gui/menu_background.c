@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include "game/gui/menu_background.h"
 #include "utils/log.h"
+#include "utils/memtrack.h"
 #include "video/color.h"
 #include "video/image.h"
 
@@ -22,7 +23,9 @@ void menu_background_create(surface *s, int w, int h) {
         image_line(&img, 0, y, w-1, y, COLOR_MENU_LINE);
     }
     image_rect(&img, 0, 0, w-1, h-1, COLOR_MENU_BORDER);
+    MEM_SCOPE_BEGIN(MEM_TAG_GUI);
     surface_create_from_image(s, &img);
+    MEM_SCOPE_END();
     image_free(&img);
 }
 
@@ -39,7 +42,9 @@ void menu_background2_create(surface *s, int w, int h) {
     }
     image_rect(&img, 1, 1, w-2, h-2, COLOR_MENU_BORDER2);
     image_rect(&img, 0, 0, w-2, h-2, COLOR_MENU_BORDER1);
+    MEM_SCOPE_BEGIN(MEM_TAG_GUI);
     surface_create_from_image(s, &img);
+    MEM_SCOPE_END();
     image_free(&img);
 }
 
@@ -49,6 +54,8 @@ void menu_background_border_create(surface *s, int w, int h) {
     image_create(&img, w, h);
     image_clear(&img, color_create(0,0,0,0));
     image_rect(&img, 0, 0, w-1, h-1, COLOR_MENU_BORDER);
+    MEM_SCOPE_BEGIN(MEM_TAG_GUI);
     surface_create_from_image(s, &img);
+    MEM_SCOPE_END();
     image_free(&img);
 }
@@ -0,0 +1,474 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <SDL2/SDL.h>
+#include "game/match_server.h"
+#include "game/match_start.h"
+#include "game/game_state.h"
+#include "game/game_player.h"
+#include "game/common_defines.h"
+#include "controller/net_controller.h"
+#include "controller/net_mux.h"
+#include "resources/ids.h"
+#include "resources/pilots.h"
+#include "resources/languages.h"
+#include "resources/fonts.h"
+#include "resources/palette.h"
+#include "video/video.h"
+#include "utils/random.h"
+#include "utils/vector.h"
+#include "utils/log.h"
+#include "utils/mem_pool.h"
+#include "utils/mem_arena.h"
+
+#define NUMBER_OF_ARENAS 5
+#define MS_PER_TICK 10
+
+typedef struct server_match_t {
+    int id;
+    uint32_t seed;
+    int arena;
+    int har[2];
+    net_link *links[2]; // Until the controllers take them over
+    game_state *gs;
+    int failed;
+    int winner;
+
+    // Per thread state of this match, swapped in while it runs
+    mem_arena *scene_arena;
+    struct random_t rand[RAND_STREAM_COUNT];
+    palette pal;
+
+    // Real time pacing
+    uint32_t start;
+    int ticks;
+    int dynamic_wait;
+
+    // Cost
+    uint64_t cpu; // Performance counter units
+    uint64_t cpu_max; // Slowest tick
+    unsigned int peak_objects;
+    size_t peak_arena;
+} server_match;
+
+typedef struct server_worker_t {
+    struct match_server_t *server;
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    vector incoming; // server_match*, guarded by the lock
+    vector matches; // server_match*, worker only
+    SDL_atomic_t count; // Incoming and running
+    SDL_atomic_t busy_us; // Since the last status line
+} server_worker;
+
+typedef struct match_server_t {
+    match_server_config *conf;
+    net_mux *mux;
+    server_worker *workers;
+    int worker_count;
+    uint64_t freq;
+    struct random_t sched;
+    int next_id;
+    SDL_atomic_t done;
+
+    SDL_mutex *lock; // Guards the report
+    FILE *report;
+} match_server;
+
+// Polled by the workers as well, so it is atomic rather than just volatile
+static SDL_atomic_t server_running;
+
+static void match_server_stop(int sig) {
+    SDL_AtomicSet(&server_running, 0);
+}
+
+// The match's view of the per thread state goes in and out with it
+static void server_match_enter(server_match *m) {
+    mem_arena_scene_swap(m->scene_arena);
+    for(int i = 0; i < RAND_STREAM_COUNT; i++) {
+        *rand_stream(i) = m->rand[i];
+    }
+    video_set_base_palette(&m->pal);
+}
+
+static void server_match_leave(server_match *m) {
+    m->scene_arena = mem_arena_scene_swap(NULL);
+    for(int i = 0; i < RAND_STREAM_COUNT; i++) {
+        m->rand[i] = *rand_stream(i);
+    }
+    memcpy(&m->pal, video_get_base_palette(), sizeof(palette));
+}
+
+// Each client learns its player slot, and sets up the same arena with the same seed
+static void server_match_send_start(server_match *m, net_link **links) {
+    match_start start;
+    serial ser;
+    start.scene_id = m->arena;
+    start.seed = m->gs->scene_seed;
+    for(int i = 0; i < 2; i++) {
+        game_player *player = game_state_get_player(m->gs, i);
+        start.players[i].har_id = player->har_id;
+        start.players[i].pilot_id = player->pilot_id;
+        for(int k = 0; k < 3; k++) {
+            start.players[i].colors[k] = player->colors[k];
+        }
+    }
+    for(int i = 0; i < 2; i++) {
+        start.slot = i;
+        serial_create(&ser);
+        match_start_write(&ser, &start);
+        // Same channel as the state syncs, so that none of them gets there first
+        net_link_send(links[i], 1, ser.data, ser.len, ENET_PACKET_FLAG_RELIABLE);
+        serial_free(&ser);
+    }
+}
+
+// On failure the match is marked failed, and ends with its links closed
+static void server_match_start(server_match *m) {
+    engine_init_flags flags;
+    memset(&flags, 0, sizeof(engine_init_flags));
+    flags.net_mode = NET_MODE_SERVER;
+
+    server_match_enter(m);
+    rand_seed_streams(m->seed);
+    m->gs = malloc(sizeof(game_state));
+    if(game_state_create_headless(m->gs, &flags)) {
+        PERROR("Server: Unable to create a game state for match %d.", m->id);
+        free(m->gs);
+        m->gs = NULL;
+        m->failed = 1;
+        mem_arena_scene_close();
+        server_match_leave(m);
+        return;
+    }
+    m->gs->role = ROLE_SERVER;
+    game_state_set_speed(m->gs, 10);
+
+    // The controllers own the links from here on, but the start message still has to go out
+    net_link *links[2] = {m->links[0], m->links[1]};
+    for(int i = 0; i < 2; i++) {
+        game_player *player = game_state_get_player(m->gs, i);
+        controller *ctrl = malloc(sizeof(controller));
+        controller_init(ctrl);
+        net_controller_create_link(ctrl, m->links[i], ROLE_SERVER);
+        m->links[i] = NULL;
+        game_player_set_ctrl(player, ctrl);
+        game_player_set_selectable(player, 1);
+        player->har_id = m->har[i];
+        player->pilot_id = 0;
+        chr_score_reset(&player->score, 1);
+
+        pilot pilot_info;
+        pilot_get_info(&pilot_info, player->pilot_id);
+        player->colors[0] = pilot_info.colors[0];
+        player->colors[1] = pilot_info.colors[1];
+        player->colors[2] = pilot_info.colors[2];
+    }
+    if(game_load_new(m->gs, m->arena)) {
+        PERROR("Server: Unable to load arena for match %d.", m->id);
+        m->failed = 1;
+    } else {
+        server_match_send_start(m, links);
+    }
+    m->start = SDL_GetTicks();
+    server_match_leave(m);
+}
+
+// Runs the ticks that are due. Returns 1 once the match is over.
+static int server_match_step(match_server *s, server_match *m) {
+    game_state *gs = m->gs;
+    int due = (SDL_GetTicks() - m->start) / MS_PER_TICK;
+    int over = m->failed;
+    if(over || m->ticks >= due) {
+        return over;
+    }
+
+    server_match_enter(m);
+    uint64_t begin = SDL_GetPerformanceCounter();
+    for(int steps = 0; m->ticks < due && steps < MATCH_SERVER_MAX_CATCHUP && !over; steps++) {
+        uint64_t tick_begin = SDL_GetPerformanceCounter();
+        game_state_tick_controllers(gs);
+        game_state_static_tick(gs);
+        m->dynamic_wait += MS_PER_TICK;
+        while(m->dynamic_wait > game_state_ms_per_dyntick(gs) && gs->next_id == gs->this_id) {
+            game_state_dynamic_tick(gs);
+            m->dynamic_wait -= game_state_ms_per_dyntick(gs);
+        }
+        uint64_t cost = SDL_GetPerformanceCounter() - tick_begin;
+        if(cost > m->cpu_max) {
+            m->cpu_max = cost;
+        }
+        m->ticks++;
+
+        // The arena moves on when the match is decided or a player has left
+        over = (!gs->run || gs->next_id != gs->this_id || gs->tick >= s->conf->max_ticks);
+    }
+    m->cpu += SDL_GetPerformanceCounter() - begin;
+    if(vector_size(&gs->objects) > m->peak_objects) {
+        m->peak_objects = vector_size(&gs->objects);
+    }
+    server_match_leave(m);
+
+    if(m->scene_arena != NULL && mem_arena_get_stats(m->scene_arena)->reserved > m->peak_arena) {
+        m->peak_arena = mem_arena_get_stats(m->scene_arena)->reserved;
+    }
+    return over;
+}
+
+static void server_match_end(match_server *s, server_match *m) {
+    // Unpaired links, if the match never started
+    for(int i = 0; i < 2; i++) {
+        if(m->links[i] != NULL) {
+            net_link_close(m->links[i]);
+        }
+    }
+    if(m->gs != NULL) {
+        server_match_enter(m);
+        m->winner = -1;
+        for(int i = 0; i < 2; i++) {
+            if(game_player_get_score(game_state_get_player(m->gs, i))->wins > 0) {
+                m->winner = i;
+            }
+        }
+        game_state_free(m->gs);
+        free(m->gs);
+        mem_arena_scene_close(); // The match's own arena
+    }
+
+    double cpu_ms = (double)m->cpu * 1000.0 / s->freq;
+    double tick_us = m->ticks ? cpu_ms * 1000.0 / m->ticks : 0.0;
+    double max_us = (double)m->cpu_max * 1000000.0 / s->freq;
+    INFO("Server: Match %d over after %d ticks; cpu %.1f ms (%.1f us/tick, slowest %.1f us), "
+         "%u objects, %lu bytes of scene memory.",
+         m->id, m->ticks, cpu_ms, tick_us, max_us, m->peak_objects, (unsigned long)m->peak_arena);
+    if(s->report != NULL) {
+        SDL_LockMutex(s->lock);
+        fprintf(s->report, "%d,%u,%d,%s,%s,%d,%d,%.3f,%.3f,%.3f,%u,%lu\n",
+                m->id, m->seed, m->arena - SCENE_ARENA0, har_get_name(m->har[0]), har_get_name(m->har[1]),
+                m->winner + 1, m->ticks, cpu_ms, tick_us, max_us, m->peak_objects, (unsigned long)m->peak_arena);
+        fflush(s->report);
+        SDL_UnlockMutex(s->lock);
+    }
+    SDL_AtomicAdd(&s->done, 1);
+    free(m);
+}
+
+static int server_worker_run(void *userdata) {
+    server_worker *w = userdata;
+    match_server *s = w->server;
+    iterator it;
+    server_match **mp;
+    server_match *m;
+    while(SDL_AtomicGet(&server_running)) {
+        SDL_LockMutex(w->lock);
+        vector_iter_begin(&w->incoming, &it);
+        while((mp = iter_next(&it)) != NULL) {
+            vector_append(&w->matches, mp);
+        }
+        vector_clear(&w->incoming);
+        SDL_UnlockMutex(w->lock);
+
+        uint64_t begin = SDL_GetPerformanceCounter();
+        vector_iter_begin(&w->matches, &it);
+        while((mp = iter_next(&it)) != NULL) {
+            m = *mp;
+            if(m->gs == NULL && !m->failed) {
+                server_match_start(m);
+            }
+            if(server_match_step(s, m)) {
+                vector_delete(&w->matches, &it);
+                server_match_end(s, m);
+                SDL_AtomicAdd(&w->count, -1);
+            }
+        }
+        SDL_AtomicAdd(&w->busy_us, (int)((SDL_GetPerformanceCounter() - begin) * 1000000 / s->freq));
+        SDL_Delay(1);
+    }
+
+    // Shutting down; whatever is still running ends here
+    vector_iter_begin(&w->incoming, &it);
+    while((mp = iter_next(&it)) != NULL) {
+        server_match_end(s, *mp);
+    }
+    vector_iter_begin(&w->matches, &it);
+    while((mp = iter_next(&it)) != NULL) {
+        server_match_end(s, *mp);
+    }
+    vector_clear(&w->incoming);
+    vector_clear(&w->matches);
+
+    // Pools are per thread
+    mem_stats stats;
+    mem_pool_shared_stats(MEM_POOL_OBJECT, &stats);
+    DEBUG("Server: Worker used %u objects at most, %lu bytes reserved.", stats.peak, (unsigned long)stats.reserved);
+    mem_pool_shared_close();
+    mem_arena_scene_close();
+    return 0;
+}
+
+// Pairs go to the worker with the fewest matches
+static void match_server_pair(match_server *s, net_link *a, net_link *b) {
+    int total = 0;
+    server_worker *w = &s->workers[0];
+    for(int i = 0; i < s->worker_count; i++) {
+        int count = SDL_AtomicGet(&s->workers[i].count);
+        total += count;
+        if(count < SDL_AtomicGet(&w->count)) {
+            w = &s->workers[i];
+        }
+    }
+    if(total >= s->conf->max_matches) {
+        INFO("Server: Full, turning a pair away.");
+        net_link_close(a);
+        net_link_close(b);
+        return;
+    }
+
+    server_match *m = malloc(sizeof(server_match));
+    memset(m, 0, sizeof(server_match));
+    m->id = s->next_id++;
+    m->seed = random_intmax(&s->sched);
+    m->arena = SCENE_ARENA0 + random_int(&s->sched, NUMBER_OF_ARENAS);
+    m->har[0] = HAR_JAGUAR + random_int(&s->sched, NUMBER_OF_HAR_TYPES);
+    m->har[1] = HAR_JAGUAR + random_int(&s->sched, NUMBER_OF_HAR_TYPES);
+    m->links[0] = a;
+    m->links[1] = b;
+
+    SDL_AtomicAdd(&w->count, 1);
+    SDL_LockMutex(w->lock);
+    vector_append(&w->incoming, &m);
+    SDL_UnlockMutex(w->lock);
+    INFO("Server: Match %d started, %s vs %s.", m->id, har_get_name(m->har[0]), har_get_name(m->har[1]));
+}
+
+static void match_server_status(match_server *s, unsigned int elapsed) {
+    int live = 0;
+    int busy = 0;
+    for(int i = 0; i < s->worker_count; i++) {
+        live += SDL_AtomicGet(&s->workers[i].count);
+        busy += SDL_AtomicSet(&s->workers[i].busy_us, 0);
+    }
+    float load = elapsed ? (float)busy / (elapsed * 10.0f * s->worker_count) : 0.0f;
+    INFO("Server: %d matches running, %d done, %d peers, worker load %.1f%%.",
+         live, SDL_AtomicGet(&s->done), net_mux_links(s->mux), load);
+}
+
+int match_server_run(match_server_config *conf) {
+    match_server s;
+    memset(&s, 0, sizeof(match_server));
+    s.conf = conf;
+    s.freq = SDL_GetPerformanceFrequency();
+    random_seed(&s.sched, conf->seed);
+    SDL_AtomicSet(&s.done, 0);
+
+    // Shared resources are only read by the workers
+    video_init_headless();
+    if(lang_init()) {
+        goto error_0;
+    }
+    if(fonts_init()) {
+        goto error_1;
+    }
+    if(altpals_init()) {
+        goto error_2;
+    }
+    if(conf->report_file[0] != 0) {
+        if((s.report = fopen(conf->report_file, "w")) == NULL) {
+            PERROR("Server: Unable to open report file '%s'.", conf->report_file);
+            goto error_3;
+        }
+        fprintf(s.report, "match,seed,arena,har1,har2,winner,ticks,cpu_ms,us_per_tick,max_tick_us,objects,scene_bytes\n");
+    }
+    if((s.mux = net_mux_create(conf->port, conf->max_matches * 2, ROLE_SERVER)) == NULL) {
+        goto error_4;
+    }
+    s.lock = SDL_CreateMutex();
+
+    s.worker_count = (conf->threads > 0) ? conf->threads : SDL_GetCPUCount();
+    s.workers = malloc(sizeof(server_worker) * s.worker_count);
+    memset(s.workers, 0, sizeof(server_worker) * s.worker_count);
+    for(int i = 0; i < s.worker_count; i++) {
+        server_worker *w = &s.workers[i];
+        w->server = &s;
+        w->lock = SDL_CreateMutex();
+        vector_create(&w->incoming, sizeof(server_match*));
+        vector_create(&w->matches, sizeof(server_match*));
+        SDL_AtomicSet(&w->count, 0);
+        SDL_AtomicSet(&w->busy_us, 0);
+    }
+    SDL_AtomicSet(&server_running, 1);
+    for(int i = 0; i < s.worker_count; i++) {
+        server_worker *w = &s.workers[i];
+        if((w->thread = SDL_CreateThread(server_worker_run, "server worker", w)) == NULL) {
+            PERROR("Server: Unable to start worker thread: %s", SDL_GetError());
+            SDL_AtomicSet(&server_running, 0);
+        }
+    }
+    signal(SIGINT, match_server_stop);
+    INFO("Server: Hosting up to %d matches on port %d with %d workers.",
+         conf->max_matches, conf->port, s.worker_count);
+
+    // Pair up the clients as they come in
+    net_link *waiting = NULL;
+    net_link *l;
+    unsigned int last_status = SDL_GetTicks();
+    while(SDL_AtomicGet(&server_running)) {
+        while((l = net_mux_accept(s.mux)) != NULL) {
+            if(waiting == NULL) {
+                waiting = l;
+            } else {
+                match_server_pair(&s, waiting, l);
+                waiting = NULL;
+            }
+        }
+        if(waiting != NULL && !net_link_is_connected(waiting)) {
+            net_link_close(waiting);
+            waiting = NULL;
+        }
+        unsigned int now = SDL_GetTicks();
+        if(now - last_status >= MATCH_SERVER_STATUS_MS) {
+            match_server_status(&s, now - last_status);
+            last_status = now;
+        }
+        SDL_Delay(10);
+    }
+    INFO("Server: Shutting down.");
+
+    for(int i = 0; i < s.worker_count; i++) {
+        server_worker *w = &s.workers[i];
+        if(w->thread != NULL) {
+            SDL_WaitThread(w->thread, NULL);
+        }
+        vector_free(&w->incoming);
+        vector_free(&w->matches);
+        SDL_DestroyMutex(w->lock);
+    }
+    free(s.workers);
+    if(waiting != NULL) {
+        net_link_close(waiting);
+    }
+    net_mux_free(s.mux);
+    SDL_DestroyMutex(s.lock);
+    INFO("Server: %d matches played.", SDL_AtomicGet(&s.done));
+    if(s.report != NULL) {
+        fclose(s.report);
+    }
+    altpals_close();
+    fonts_close();
+    lang_close();
+    return 0;
+
+error_4:
+    if(s.report != NULL) {
+        fclose(s.report);
+    }
+error_3:
+    altpals_close();
+error_2:
+    fonts_close();
+error_1:
+    lang_close();
+error_0:
+    return 1;
+}
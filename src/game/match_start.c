@@ -0,0 +1,46 @@
+#include <string.h>
+#include "game/match_start.h"
+#include "game/common_defines.h"
+#include "controller/controller.h"
+
+#define MATCH_START_LEN 17
+
+void match_start_write(serial *ser, const match_start *start) {
+    serial_write_int8(ser, EVENT_TYPE_START);
+    serial_write_int8(ser, start->slot);
+    serial_write_int8(ser, start->scene_id);
+    serial_write_int32(ser, start->seed);
+    for(int i = 0; i < 2; i++) {
+        const match_start_player *player = &start->players[i];
+        serial_write_int8(ser, player->har_id);
+        serial_write_int8(ser, player->pilot_id);
+        for(int k = 0; k < 3; k++) {
+            serial_write_int8(ser, player->colors[k]);
+        }
+    }
+}
+
+int match_start_read(serial *ser, match_start *start) {
+    memset(start, 0, sizeof(match_start));
+    if(serial_len(ser) - ser->rpos < MATCH_START_LEN || serial_read_int8(ser) != EVENT_TYPE_START) {
+        return 0;
+    }
+    start->slot = serial_read_int8(ser);
+    start->scene_id = serial_read_int8(ser);
+    start->seed = serial_read_int32(ser);
+    for(int i = 0; i < 2; i++) {
+        match_start_player *player = &start->players[i];
+        player->har_id = serial_read_int8(ser);
+        player->pilot_id = serial_read_int8(ser);
+        for(int k = 0; k < 3; k++) {
+            player->colors[k] = (uint8_t)serial_read_int8(ser);
+        }
+        if(player->har_id < HAR_JAGUAR || player->har_id >= NUMBER_OF_HAR_TYPES) {
+            return 0;
+        }
+    }
+    if(start->slot != 0 && start->slot != 1) {
+        return 0;
+    }
+    return (start->scene_id == SCENE_MELEE || (start->scene_id >= SCENE_ARENA0 && start->scene_id <= SCENE_ARENA4));
+}
@@ -4,13 +4,13 @@
 #include <math.h>
 
 #include "game/objects/har.h"
-#include "game/objects/scrap.h"
 #include "game/objects/projectile.h"
 #include "game/objects/arena_constraints.h"
 #include "game/protos/intersect.h"
 #include "game/protos/object_specializer.h"
 #include "game/scenes/arena.h"
 #include "game/game_state.h"
+#include "game/particles.h"
 #include "game/common_defines.h"
 #include "game/utils/serial.h"
 #include "resources/af_loader.h"
@@ -18,6 +18,8 @@
 #include "resources/pilots.h"
 #include "controller/controller.h"
 #include "utils/log.h"
+#include "utils/mem_arena.h"
+#include "utils/memtrack.h"
 #include "utils/random.h"
 #include "utils/miscmath.h"
 #include "audio/sound.h"
@@ -36,7 +38,7 @@ void har_free(object *obj) {
 #ifdef DEBUGMODE
     surface_free(&h->cd_debug);
 #endif
-    free(h);
+    MEM_FREE(h);
 }
 
 /* hooks */
@@ -351,7 +353,7 @@ void cb_har_spawn_object(object *parent, int id, vec2i pos, int g, void *userdat
     // ... otherwise expect it is a projectile
     af_move *move = af_get_move(h->af_data, id);
     if(move != NULL) {
-        object *obj = malloc(sizeof(object));
+        object *obj = object_alloc();
         object_create(obj, parent->gs, pos, vec2f_create(0,0));
         object_set_userdata(obj, h);
         object_set_stl(obj, object_get_stl(parent));
@@ -398,7 +400,7 @@ void har_floor_landing_effects(object *obj) {
     for(int i = 0; i < amount; i++) {
         int variance = rand_int(20) - 10;
         vec2i coord = vec2i_create(obj->pos.x + variance + i*10, obj->pos.y);
-        object *dust = malloc(sizeof(object));
+        object *dust = object_alloc();
         object_create(dust, obj->gs, coord, vec2f_create(0,0));
         object_set_stl(dust, object_get_stl(obj));
         object_set_animation(dust, &bk_get_info(&game_state_get_scene(obj->gs)->bk_data, 26)->ani);
@@ -408,7 +410,9 @@ void har_floor_landing_effects(object *obj) {
     // Landing sound
     float d = ((float)obj->pos.x) / 640.0f;
     float pos_pan = d - 0.25f;
-    sound_play(56, 0.3f, pos_pan, 2.2f);
+    if(!obj->gs->headless) {
+        sound_play(56, 0.3f, pos_pan, 2.2f);
+    }
 }
 
 void har_move(object *obj) {
@@ -614,17 +618,9 @@ void har_spawn_oil(object *obj, vec2i pos, int amount, float gravity, int layer)
         // (to prevent floating scrap objects)
         if(vely < 0.1 && vely > -0.1) vely += 0.21;
 
-        // Create the object
-        object *scrap = malloc(sizeof(object));
         int anim_no = ANIM_BURNING_OIL;
-        object_create(scrap, obj->gs, pos, vec2f_create(velx, vely));
-        object_set_animation(scrap, &af_get_move(h->af_data, anim_no)->ani);
-        object_set_stl(scrap, object_get_stl(obj));
-        object_set_gravity(scrap, gravity);
-        object_set_layers(scrap, LAYER_SCRAP);
-        object_dynamic_tick(scrap);
-        scrap_create(scrap);
-        game_state_add_object(obj->gs, scrap, layer, 0, 0);
+        particles_spawn(obj->gs->particles, &af_get_move(h->af_data, anim_no)->ani,
+                        pos, vec2f_create(velx, vely), gravity, 0, 0, layer);
     }
 }
 
@@ -672,19 +668,9 @@ void har_spawn_scrap(object *obj, vec2i pos, int amount) {
         // (to prevent floating scrap objects)
         if(vely < 0.1 && vely > -0.1) vely += 0.21;
 
-        // Create the object
-        object *scrap = malloc(sizeof(object));
         int anim_no = rand_int(3) + ANIM_SCRAP_METAL;
-        object_create(scrap, obj->gs, pos, vec2f_create(velx, vely));
-        object_set_animation(scrap, &af_get_move(h->af_data, anim_no)->ani);
-        object_set_stl(scrap, object_get_stl(obj));
-        object_set_gravity(scrap, 1);
-        object_set_pal_offset(scrap, object_get_pal_offset(obj));
-        object_set_layers(scrap, LAYER_SCRAP);
-        object_dynamic_tick(scrap);
-        object_set_shadow(scrap, 1);
-        scrap_create(scrap);
-        game_state_add_object(obj->gs, scrap, RENDER_LAYER_TOP, 0, 0);
+        particles_spawn(obj->gs->particles, &af_get_move(h->af_data, anim_no)->ani,
+                        pos, vec2f_create(velx, vely), 1, object_get_pal_offset(obj), 1, RENDER_LAYER_TOP);
     }
 }
 
@@ -704,7 +690,7 @@ void har_block(object *obj, vec2i hit_coord) {
         // don't make another scrape
         return;
     }
-    object *scrape = malloc(sizeof(object));
+    object *scrape = object_alloc();
     object_create(scrape, obj->gs, hit_coord, vec2f_create(0, 0));
     object_set_animation(scrape, &af_get_move(h->af_data, ANIM_BLOCKING_SCRAPE)->ani);
     object_set_stl(scrape, object_get_stl(obj));
@@ -714,7 +700,9 @@ void har_block(object *obj, vec2i hit_coord) {
     object_set_layers(scrape, LAYER_SCRAP);
     object_dynamic_tick(scrape);
     object_dynamic_tick(scrape);
-    sound_play(3, 0.7f, 0.5f, 1.0f);
+    if(!obj->gs->headless) {
+        sound_play(3, 0.7f, 0.5f, 1.0f);
+    }
     game_state_add_object(obj->gs, scrape, RENDER_LAYER_MIDDLE, 0, 0);
     h->damage_received = 1;
     if (h->state == STATE_CROUCHBLOCK) {
@@ -1401,7 +1389,7 @@ void har_tick(object *obj) {
     if(player_frame_isset(obj, "ub")) {
         if(obj->age % 2 == 0) {
             sprite *nsp = sprite_copy(obj->cur_sprite);
-            object *nobj = malloc(sizeof(object));
+            object *nobj = object_alloc();
             object_create(nobj, obj->gs, object_get_pos(obj), vec2f_create(0,0));
             object_set_stl(nobj, object_get_stl(obj));
             object_set_animation(nobj, create_animation_from_single(nsp, obj->cur_animation->start_pos));
@@ -2081,7 +2069,7 @@ void har_copy_actions(object *new, object *old) {
 
 int har_create(object *obj, af *af_data, int dir, int har_id, int pilot_id, int player_id) {
     // Create local data
-    har *local = malloc(sizeof(har));
+    har *local = MEM_ALLOC(MEM_TAG_OBJECTS, sizeof(har));
     object_set_userdata(obj, local);
     har_bootstrap(obj);
 
@@ -2130,7 +2118,8 @@ int har_create(object *obj, af *af_data, int dir, int har_id, int pilot_id, int
     /*local->hook_cb = NULL;*/
     /*local->hook_cb_data = NULL;*/
 
-    list_create(&local->har_hooks);
+    // Hooks live as long as the HAR, which never outlives the scene
+    list_create_with_allocator(&local->har_hooks, mem_arena_scene_allocator());
 
     local->stun_timer = 0;
 
@@ -0,0 +1,335 @@
+#include <stdlib.h>
+#include <string.h>
+#include <shadowdive/script.h>
+
+#include "game/particles.h"
+#include "game/game_state_type.h"
+#include "game/objects/arena_constraints.h"
+#include "video/video.h"
+#include "utils/log.h"
+#include "utils/memtrack.h"
+#include "utils/random.h"
+
+#define IS_ZERO(n) (n < 0.1 && n > -0.1)
+
+// Everything a particle needs from one frame of the animation string
+typedef struct particle_frame_t {
+    sprite *sprite; // NULL if the frame shows nothing
+    int start; // First tick of the frame
+    int len;
+    int rewind; // 'd' tag, or -1
+    int hover;
+    int blendmode;
+    int flipmode;
+    uint8_t blend_start;
+    uint8_t blend_finish;
+    vec2i o_correction;
+} particle_frame;
+
+typedef struct particle_track_t {
+    const animation *ani;
+    particle_frame *frames;
+    int frame_count;
+} particle_track;
+
+typedef struct particle_t {
+    const particle_track *track;
+    const particle_frame *frame; // Last frame entered
+    vec2i pos;
+    vec2f vel;
+    float gravity;
+    int pal_offset;
+    int shadow;
+    int layer;
+    int resting;
+    int tick;
+    int previous_tick;
+    int timer; // Ticks since the frame was entered
+} particle;
+
+struct particles_t {
+    // Live particles are kept at the front, in the order they were spawned
+    particle items[PARTICLES_MAX];
+    unsigned int count;
+    particle_track tracks[PARTICLES_MAX_TRACKS];
+    unsigned int track_count;
+};
+
+static int particle_track_load(particle_track *t, animation *ani) {
+    sd_script script;
+    const sd_script_frame *f;
+    int err_pos;
+    sd_script_create(&script);
+    int ret = sd_script_decode(&script, str_c(&ani->animation_string), &err_pos);
+    if(ret != SD_SUCCESS) {
+        PERROR("Decoder error %s at position %d in string \"%s\"",
+            sd_get_error(ret), err_pos, str_c(&ani->animation_string));
+        sd_script_free(&script);
+        return 1;
+    }
+
+    int count = 0;
+    while(sd_script_get_frame(&script, count) != NULL) {
+        count++;
+    }
+    t->ani = ani;
+    t->frame_count = count;
+    t->frames = MEM_ALLOC(MEM_TAG_OBJECTS, (count > 0 ? count : 1) * sizeof(particle_frame));
+
+    // Same handling as player_run, for the tags that matter to debris
+    int start = 0;
+    for(int i = 0; i < count; i++) {
+        particle_frame *pf = &t->frames[i];
+        f = sd_script_get_frame(&script, i);
+        memset(pf, 0, sizeof(particle_frame));
+        pf->start = start;
+        pf->len = f->tick_len;
+        pf->rewind = sd_script_isset(f, "d") ? sd_script_get(f, "d") : -1;
+        pf->hover = sd_script_isset(f, "h");
+        pf->blend_start = 0xFF;
+        pf->blend_finish = 0xFF;
+        if(sd_script_isset(f, "bb")) { pf->blend_finish = sd_script_get(f, "bb"); }
+        if(sd_script_isset(f, "bf")) { pf->blend_finish = sd_script_get(f, "bf"); }
+        if(sd_script_isset(f, "bl")) { pf->blend_finish = sd_script_get(f, "bl"); }
+        if(sd_script_isset(f, "bm")) { pf->blend_finish = sd_script_get(f, "bm"); }
+        if(sd_script_isset(f, "bj")) { pf->blend_finish = sd_script_get(f, "bj"); }
+        if(sd_script_isset(f, "bs")) { pf->blend_start = sd_script_get(f, "bs"); }
+        pf->o_correction.x = sd_script_isset(f, "ox") ? sd_script_get(f, "ox") : 0;
+        pf->o_correction.y = sd_script_isset(f, "oy") ? sd_script_get(f, "oy") : 0;
+        pf->blendmode = BLEND_ALPHA;
+        pf->flipmode = FLIP_NONE;
+        pf->sprite = (f->sprite < 25) ? animation_get_sprite(ani, f->sprite) : NULL;
+        if(pf->sprite != NULL) {
+            pf->blendmode = sd_script_isset(f, "br") ? BLEND_ADDITIVE : BLEND_ALPHA;
+            if(sd_script_isset(f, "r")) {
+                pf->flipmode ^= FLIP_HORIZONTAL;
+            }
+            if(sd_script_isset(f, "f")) {
+                pf->flipmode ^= FLIP_VERTICAL;
+            }
+        }
+        start += f->tick_len;
+    }
+    sd_script_free(&script);
+    return 0;
+}
+
+static const particle_track* particles_get_track(particles *p, animation *ani) {
+    for(unsigned int i = 0; i < p->track_count; i++) {
+        if(p->tracks[i].ani == ani) {
+            return &p->tracks[i];
+        }
+    }
+    if(p->track_count >= PARTICLES_MAX_TRACKS) {
+        DEBUG("Particles: No room for animation %d.", ani->id);
+        return NULL;
+    }
+    if(particle_track_load(&p->tracks[p->track_count], ani)) {
+        return NULL;
+    }
+    return &p->tracks[p->track_count++];
+}
+
+static int particle_frame_at(const particle_track *t, int tick) {
+    for(int i = 0; i < t->frame_count; i++) {
+        if(tick >= t->frames[i].start && tick < t->frames[i].start + t->frames[i].len) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Same steps as player_run for an object that does not repeat.
+// Returns 1 when the animation has ended.
+static int particle_run(particle *pt) {
+    int cur = particle_frame_at(pt->track, pt->tick);
+    if(cur < 0) {
+        return 1;
+    }
+    if(pt->tick != pt->previous_tick && cur != particle_frame_at(pt->track, pt->previous_tick)) {
+        pt->frame = &pt->track->frames[cur];
+        pt->timer = 0;
+        if(pt->frame->rewind >= 0 && !pt->resting) {
+            pt->previous_tick = pt->frame->rewind - 1;
+            pt->tick = pt->frame->rewind;
+        }
+    }
+    pt->previous_tick = pt->tick;
+    pt->tick++;
+    pt->timer++;
+    return 0;
+}
+
+// This is the old scrap object movement
+static void particle_move(particle *pt) {
+    if(pt->frame != NULL && pt->frame->hover) {
+        pt->vel = vec2f_create(0, 0);
+    }
+    if(pt->resting) {
+        return;
+    }
+
+    pt->pos.x += pt->vel.x;
+    pt->vel.y += pt->gravity;
+    pt->pos.y += pt->vel.y;
+
+    float dampen = 0.4;
+
+    if(pt->pos.x < ARENA_LEFT_WALL) {
+        pt->pos.x = ARENA_LEFT_WALL;
+        pt->vel.x = -pt->vel.x * dampen;
+    }
+    if(pt->pos.x > ARENA_RIGHT_WALL) {
+        pt->pos.x = ARENA_RIGHT_WALL;
+        pt->vel.x = -pt->vel.x * dampen;
+    }
+    if(pt->pos.y > ARENA_FLOOR) {
+        pt->pos.y = ARENA_FLOOR;
+        pt->vel.y = -pt->vel.y * dampen;
+        pt->vel.x = pt->vel.x * dampen;
+    }
+    if(IS_ZERO(pt->vel.x)) pt->vel.x = 0;
+
+    // If the particle is at rest, let the animation play out
+    if(pt->pos.y >= (ARENA_FLOOR-5) &&
+        IS_ZERO(pt->vel.x) &&
+        pt->vel.y < pt->gravity * 1.1 &&
+        pt->vel.y > pt->gravity * -1.1)
+    {
+        pt->resting = 1;
+    }
+}
+
+particles* particles_create() {
+    particles *p = MEM_ALLOC(MEM_TAG_OBJECTS, sizeof(particles));
+    p->count = 0;
+    p->track_count = 0;
+    return p;
+}
+
+void particles_free(particles *p) {
+    if(p == NULL) {
+        return;
+    }
+    particles_clear(p);
+    MEM_FREE(p);
+}
+
+void particles_clear(particles *p) {
+    for(unsigned int i = 0; i < p->track_count; i++) {
+        MEM_FREE(p->tracks[i].frames);
+    }
+    p->track_count = 0;
+    p->count = 0;
+}
+
+int particles_spawn(particles *p, animation *ani, vec2i pos, vec2f vel, float gravity, int pal_offset, int shadow, int layer) {
+    // Objects draw a random seed when created. Do the same, so that the
+    // random sequence stays the same as before, even when particles are dropped.
+    rand_intmax();
+
+    if(p->count >= PARTICLES_MAX) {
+        return 1;
+    }
+    const particle_track *t = particles_get_track(p, ani);
+    if(t == NULL) {
+        return 1;
+    }
+
+    particle *pt = &p->items[p->count];
+    pt->track = t;
+    pt->frame = NULL;
+    pt->pos = pos;
+    pt->vel = vel;
+    pt->gravity = gravity;
+    pt->pal_offset = pal_offset;
+    pt->shadow = shadow;
+    pt->layer = layer;
+    pt->resting = 0;
+    pt->tick = 0;
+    pt->previous_tick = -1;
+    pt->timer = 0;
+
+    // Enter the first frame right away, like object_dynamic_tick would
+    if(particle_run(pt)) {
+        return 0;
+    }
+    p->count++;
+    return 0;
+}
+
+void particles_move(particles *p) {
+    for(unsigned int i = 0; i < p->count; i++) {
+        particle_move(&p->items[i]);
+    }
+}
+
+void particles_tick(particles *p) {
+    unsigned int live = 0;
+    for(unsigned int i = 0; i < p->count; i++) {
+        if(particle_run(&p->items[i])) {
+            continue;
+        }
+        if(live != i) {
+            p->items[live] = p->items[i];
+        }
+        live++;
+    }
+    p->count = live;
+}
+
+void particles_render(particles *p, int layer) {
+    color tint = color_create(0xFF, 0xFF, 0xFF, 0xFF);
+    for(unsigned int i = 0; i < p->count; i++) {
+        const particle *pt = &p->items[i];
+        const particle_frame *f = pt->frame;
+        if(pt->layer != layer || f == NULL || f->sprite == NULL) {
+            continue;
+        }
+
+        // Blend start / blend finish
+        uint8_t opacity = f->blend_finish;
+        if(f->len > 0) {
+            float moment = (float)pt->timer / (float)f->len;
+            float d = ((float)f->blend_finish - (float)f->blend_start) * moment;
+            opacity = f->blend_start + d;
+        }
+
+        video_render_sprite_flip_scale_opacity_tint(
+            f->sprite->data,
+            pt->pos.x + f->sprite->pos.x + f->o_correction.x,
+            pt->pos.y + f->sprite->pos.y + f->o_correction.y,
+            f->blendmode,
+            pt->pal_offset,
+            f->flipmode,
+            1.0f,
+            opacity,
+            tint);
+    }
+}
+
+void particles_render_shadows(particles *p) {
+    // Same as object_render_shadow
+    for(unsigned int i = 0; i < p->count; i++) {
+        const particle *pt = &p->items[i];
+        const particle_frame *f = pt->frame;
+        if(!pt->shadow || f == NULL || f->sprite == NULL) {
+            continue;
+        }
+        surface *shadow = sprite_get_shadow(f->sprite, f->flipmode);
+        if(shadow == NULL) {
+            continue;
+        }
+
+        int x = pt->pos.x + f->sprite->pos.x + f->o_correction.x;
+        int h = sprite_get_size(f->sprite).y;
+        float temp = h * SPRITE_SHADOW_SCALE;
+        int y = 190 - temp - (h - temp) / 2;
+        y += (h - (shadow->h - 1)) / 2;
+        video_render_sprite(shadow, x, y, BLEND_ALPHA, 0);
+    }
+}
+
+unsigned int particles_count(const particles *p) {
+    return p->count;
+}
@@ -8,9 +8,18 @@
 #include "video/video.h"
 #include "utils/log.h"
 #include "utils/miscmath.h"
+#include "utils/mem_pool.h"
 
 #define UNUSED(x) (void)(x)
 
+object* object_alloc() {
+    return mem_pool_alloc(mem_pool_shared(MEM_POOL_OBJECT, sizeof(object)));
+}
+
+void object_dealloc(object *obj) {
+    mem_pool_release(mem_pool_shared(MEM_POOL_OBJECT, sizeof(object)), obj);
+}
+
 /** \brief Creates a new, empty object.
   * \param obj Object handle
   * \param gs Game state handle
@@ -400,10 +409,6 @@ void object_render_shadow(object *obj) {
         return;
     }
 
-    // Scale of the sprite on Y axis should be less than the
-    // height of the sprite because of light position
-    float scale_y = 0.25f;
-
     // Determine X
     int flipmode = obj->sprite_state.flipmode;
     int x = obj->pos.x + obj->cur_sprite->pos.x + obj->sprite_state.o_correction.x;
@@ -412,23 +417,19 @@ void object_render_shadow(object *obj) {
         flipmode ^= FLIP_HORIZONTAL;
     }
 
-    // Determine Y
-    float temp = object_h(obj) * scale_y;
+    // The sprite squashed down and drawn twice with different offsets, so that
+    // the shadows seem a bit blobbier and shadow-y. This is cached with the sprite.
+    surface *shadow = sprite_get_shadow(obj->cur_sprite, flipmode);
+    if(shadow == NULL) {
+        return;
+    }
+
+    // Determine Y. The squashed shadow sits in the middle of where the sprite would be.
+    float temp = object_h(obj) * SPRITE_SHADOW_SCALE;
     int y = 190 - temp - (object_h(obj) - temp) / 2;
+    y += (object_h(obj) - (shadow->h - 1)) / 2;
 
-    // Render shadow object twice with different offsets, so that
-    // the shadows seem a bit blobbier and shadow-y
-    for(int i = 0; i < 2; i++) {
-        video_render_sprite_flip_scale_opacity_tint(
-            obj->cur_sprite->data,
-            x+i, y+i,
-            BLEND_ALPHA,
-            obj->pal_offset,
-            flipmode,
-            scale_y,
-            50,
-            color_create(0,0,0,255));
-    }
+    video_render_sprite(shadow, x, y, BLEND_ALPHA, 0);
 }
 
 int object_act(object *obj, int action) {
@@ -305,20 +305,21 @@ void player_run(object *obj) {
                 state->destroy(obj, sd_script_get(frame, "md"), state->destroy_userdata);
             }
 
-            // Music playback
-            if(sd_script_isset(frame, "smo")) {
+            // Music playback. Headless states stay silent.
+            int audible = !obj->gs->headless;
+            if(audible && sd_script_isset(frame, "smo")) {
                 if(sd_script_get(frame, "smo") == 0) {
                     music_stop();
                     return;
                 }
                 music_play(PSM_END + (sd_script_get(frame, "smo") - 1));
             }
-            if(sd_script_isset(frame, "smf")) {
+            if(audible && sd_script_isset(frame, "smf")) {
                 music_stop();
             }
 
             // Sound playback
-            if(sd_script_isset(frame, "s")) {
+            if(audible && sd_script_isset(frame, "s")) {
                 float pitch = PITCH_DEFAULT;
                 float volume = VOLUME_DEFAULT * (settings_get()->sound.sound_vol/10.0f);
                 float panning = PANNING_DEFAULT;
@@ -8,6 +8,7 @@
 #include "utils/vec.h"
 #include "game/game_player.h"
 #include "game/game_state_type.h"
+#include "game/particles.h"
 
 // Some internal functions
 void cb_scene_spawn_object(object *parent, int id, vec2i pos, int g, void *userdata);
@@ -44,8 +45,10 @@ int scene_create(scene *scene, game_state *gs, int scene_id) {
     scene->startup = NULL;
     scene->prio_override = NULL;
 
-    // Set base palette
-    video_set_base_palette(bk_get_palette(&scene->bk_data, 0));
+    // Set base palette. Headless states must not touch the screen.
+    if(!gs->headless) {
+        video_set_base_palette(bk_get_palette(&scene->bk_data, 0));
+    }
 
     // All done.
     DEBUG("Loaded scene %s (%s).",
@@ -74,6 +77,8 @@ void har_fix_sprite_coords(animation *ani, int fix_x, int fix_y) {
 
 int scene_load_har(scene *scene, int player_id, int har_id) {
     if(scene->af_data[player_id]) {
+        // Debris still refers to the old HAR's sprites
+        particles_clear(scene->gs->particles);
         af_free(scene->af_data[player_id]);
         free(scene->af_data[player_id]);
     }
@@ -100,19 +105,20 @@ void scene_init(scene *scene) {
     int m_load;
     int m_repeat;
 
-    // Bootstrap animations
-    iterator it;
-    hashmap_iter_begin(&scene->bk_data.infos, &it);
-    hashmap_pair *pair = NULL;
-    while((pair = iter_next(&it)) != NULL) {
-        bk_info *info = (bk_info*)pair->val;
+    // Bootstrap animations. Go by id, so that the objects draw their
+    // random seeds in the same order every time.
+    for(int id = 0; id < BK_MAX_INFOS; id++) {
+        bk_info *info = bk_get_info(&scene->bk_data, id);
+        if(info == NULL) {
+            continue;
+        }
 
         // Ask scene if this animation should be played on start
         scene_startup(scene, info->ani.id, &m_load, &m_repeat);
 
         // Start up animations
         if(m_load) {
-            object *obj = malloc(sizeof(object));
+            object *obj = object_alloc();
             object_create(obj, scene->gs, info->ani.start_pos, vec2f_create(0,0));
             object_set_stl(obj, scene->bk_data.sound_translation_table);
             object_set_animation(obj, &info->ani);
@@ -281,7 +287,7 @@ void cb_scene_spawn_object(object *parent, int id, vec2i pos, int g, void *userd
     // Get next animation
     bk_info *info = bk_get_info(&s->bk_data, id);
     if(info != NULL) {
-        object *obj = malloc(sizeof(object));
+        object *obj = object_alloc();
         object_create(obj, parent->gs, vec2i_add(pos, info->ani.start_pos), vec2f_create(0,0));
         object_set_stl(obj, object_get_stl(parent));
         object_set_animation(obj, &info->ani);
@@ -0,0 +1,335 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "game/replay.h"
+#include "game/game_player.h"
+#include "game/scenes/arena.h"
+#include "game/utils/statehash.h"
+#include "controller/rec_controller.h"
+#include "resources/ids.h"
+#include "resources/languages.h"
+#include "resources/fonts.h"
+#include "resources/palette.h"
+#include "video/video.h"
+#include "utils/vector.h"
+#include "utils/random.h"
+#include "utils/log.h"
+
+#define REPLAY_INDEX_MAGIC "OMFRIDX"
+#define REPLAY_INDEX_VERSION 1
+
+typedef struct __attribute__ ((__packed__)) replay_index_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t rec_size;
+    uint32_t rec_hash;
+    uint32_t interval;
+    uint32_t count;
+} replay_index_header;
+
+typedef struct keyframe_t {
+    unsigned int tick;
+    serial data;
+} keyframe;
+
+typedef struct replay_t {
+    char index_file[260];
+    uint32_t rec_size;
+    uint32_t rec_hash;
+    uint32_t start_seed; // Game random stream when the arena was created
+    int scene_id;
+    vector keyframes; // keyframe, sorted by tick
+    int dirty;
+} replay;
+
+static replay *rp = NULL;
+
+// Size and hash of the recording, so that a stale index is never used
+static int replay_hash_rec(const char *rec_file, uint32_t *size, uint32_t *hash) {
+    FILE *fp = fopen(rec_file, "rb");
+    if(fp == NULL) {
+        return 1;
+    }
+    fseek(fp, 0, SEEK_END);
+    long len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *buf = malloc(len);
+    if(fread(buf, 1, len, fp) != (size_t)len) {
+        free(buf);
+        fclose(fp);
+        return 1;
+    }
+    *size = len;
+    *hash = statehash_data(buf, len);
+    free(buf);
+    fclose(fp);
+    return 0;
+}
+
+static void replay_free_keyframes() {
+    iterator it;
+    keyframe *k;
+    vector_iter_begin(&rp->keyframes, &it);
+    while((k = iter_next(&it)) != NULL) {
+        serial_free(&k->data);
+    }
+    vector_clear(&rp->keyframes);
+}
+
+static int replay_load_index() {
+    FILE *fp = fopen(rp->index_file, "rb");
+    if(fp == NULL) {
+        return 1;
+    }
+    replay_index_header header;
+    if(fread(&header, sizeof(replay_index_header), 1, fp) != 1
+        || memcmp(header.magic, REPLAY_INDEX_MAGIC, sizeof(header.magic)) != 0
+        || header.version != REPLAY_INDEX_VERSION
+        || header.rec_size != rp->rec_size
+        || header.rec_hash != rp->rec_hash) {
+        DEBUG("Replay: Index '%s' does not match the recording; rebuilding it.", rp->index_file);
+        goto error_0;
+    }
+    for(unsigned int i = 0; i < header.count; i++) {
+        uint32_t tick, len;
+        if(fread(&tick, sizeof(uint32_t), 1, fp) != 1 || fread(&len, sizeof(uint32_t), 1, fp) != 1) {
+            goto error_1;
+        }
+        keyframe k;
+        k.tick = tick;
+        serial_create(&k.data);
+        char *buf = malloc(len);
+        if(fread(buf, len, 1, fp) != 1) {
+            free(buf);
+            serial_free(&k.data);
+            goto error_1;
+        }
+        serial_write(&k.data, buf, len);
+        free(buf);
+        vector_append(&rp->keyframes, &k);
+    }
+    fclose(fp);
+    DEBUG("Replay: Loaded %u keyframes from '%s'.", header.count, rp->index_file);
+    return 0;
+
+error_1:
+    PERROR("Replay: Index '%s' is truncated; rebuilding it.", rp->index_file);
+    replay_free_keyframes();
+error_0:
+    fclose(fp);
+    return 1;
+}
+
+static int replay_save_index() {
+    FILE *fp = fopen(rp->index_file, "wb");
+    if(fp == NULL) {
+        PERROR("Replay: Unable to open '%s' for writing.", rp->index_file);
+        return 1;
+    }
+    replay_index_header header;
+    memcpy(header.magic, REPLAY_INDEX_MAGIC, sizeof(header.magic));
+    header.version = REPLAY_INDEX_VERSION;
+    header.rec_size = rp->rec_size;
+    header.rec_hash = rp->rec_hash;
+    header.interval = REPLAY_KEYFRAME_INTERVAL;
+    header.count = vector_size(&rp->keyframes);
+    fwrite(&header, sizeof(replay_index_header), 1, fp);
+
+    iterator it;
+    keyframe *k;
+    vector_iter_begin(&rp->keyframes, &it);
+    while((k = iter_next(&it)) != NULL) {
+        uint32_t tick = k->tick;
+        uint32_t len = serial_len(&k->data);
+        fwrite(&tick, sizeof(uint32_t), 1, fp);
+        fwrite(&len, sizeof(uint32_t), 1, fp);
+        fwrite(k->data.data, len, 1, fp);
+    }
+    fclose(fp);
+    DEBUG("Replay: Wrote %u keyframes to '%s'.", header.count, rp->index_file);
+    return 0;
+}
+
+int replay_init(const char *rec_file) {
+    rp = malloc(sizeof(replay));
+    memset(rp, 0, sizeof(replay));
+    snprintf(rp->index_file, sizeof(rp->index_file), "%s.idx", rec_file);
+    rp->start_seed = rand_get_seed();
+    rp->scene_id = SCENE_NONE;
+    vector_create(&rp->keyframes, sizeof(keyframe));
+    if(replay_hash_rec(rec_file, &rp->rec_size, &rp->rec_hash)) {
+        PERROR("Replay: Unable to read recording '%s'.", rec_file);
+        vector_free(&rp->keyframes);
+        free(rp);
+        rp = NULL;
+        return 1;
+    }
+    replay_load_index();
+    return 0;
+}
+
+void replay_close() {
+    if(rp == NULL) {
+        return;
+    }
+    if(rp->dirty) {
+        replay_save_index();
+    }
+    replay_free_keyframes();
+    vector_free(&rp->keyframes);
+    free(rp);
+    rp = NULL;
+}
+
+int replay_is_active() {
+    return (rp != NULL);
+}
+
+// Called after every dynamic tick. Records keyframes we don't have yet.
+void replay_tick(game_state *gs) {
+    if(rp == NULL || !is_arena(gs->this_id)) {
+        return;
+    }
+    if(rp->scene_id == SCENE_NONE) {
+        rp->scene_id = gs->this_id;
+    }
+
+    // Only take keyframes mid-fight. Round intros are driven by animation
+    // objects that are not part of the serialized state.
+    if(gs->tick % REPLAY_KEYFRAME_INTERVAL != 0 || arena_get_state(gs->sc) != ARENA_STATE_FIGHTING) {
+        return;
+    }
+    keyframe *last = vector_get(&rp->keyframes, vector_size(&rp->keyframes) - 1);
+    if(last != NULL && last->tick >= gs->tick) {
+        return;
+    }
+
+    keyframe k;
+    k.tick = gs->tick;
+    serial_create(&k.data);
+    game_state_serialize(gs, &k.data);
+    arena_serialize(gs->sc, &k.data);
+    vector_append(&rp->keyframes, &k);
+    rp->dirty = 1;
+}
+
+static void replay_seek_controllers(game_state *gs, unsigned int tick) {
+    for(int i = 0; i < game_state_num_players(gs); i++) {
+        controller *c = game_player_get_ctrl(game_state_get_player(gs, i));
+        if(c != NULL && c->type == CTRL_TYPE_REC) {
+            rec_controller_seek(c, tick);
+        }
+    }
+}
+
+int replay_seek(game_state *gs, unsigned int tick) {
+    if(rp == NULL || !is_arena(gs->this_id) || gs->this_id != gs->next_id) {
+        return 1;
+    }
+    DEBUG("Replay: Seeking from tick %u to %u.", gs->tick, tick);
+
+    // Find the last keyframe at or before the target
+    keyframe *best = NULL;
+    iterator it;
+    keyframe *k;
+    vector_iter_begin(&rp->keyframes, &it);
+    while((k = iter_next(&it)) != NULL && k->tick <= tick) {
+        best = k;
+    }
+
+    if(best != NULL && (tick < gs->tick || best->tick > gs->tick)) {
+        game_state_restore(gs, &best->data);
+        arena_unserialize(gs->sc, &best->data);
+        maybe_install_har_hooks(gs->sc);
+        replay_seek_controllers(gs, gs->tick);
+    } else if(tick < gs->tick) {
+        // Nothing to jump back to; start over from the beginning of the fight
+        rand_seed(rp->start_seed);
+        if(game_load_new(gs, rp->scene_id)) {
+            PERROR("Replay: Unable to restart the recording.");
+            gs->run = 0;
+            return 1;
+        }
+        replay_seek_controllers(gs, 0);
+    }
+
+    // Simulate the rest of the way. This also fills in any missing keyframes.
+    while(gs->tick < tick && gs->run && gs->this_id == gs->next_id) {
+        game_state_dynamic_tick(gs);
+        replay_tick(gs);
+    }
+    return 0;
+}
+
+int replay_verify(const char *rec_file, uint32_t *hash, unsigned int *ticks) {
+    sd_rec_file rec;
+    sd_rec_create(&rec);
+    if(sd_rec_load(&rec, rec_file) != SD_SUCCESS) {
+        PERROR("Replay: Unable to load recording '%s'.", rec_file);
+        sd_rec_free(&rec);
+        return 1;
+    }
+    unsigned int max_tick = (rec.move_count > 0) ? rec.moves[rec.move_count-1].tick : 0;
+
+    video_init_headless();
+    if(lang_init()) {
+        goto error_0;
+    }
+    if(fonts_init()) {
+        goto error_1;
+    }
+    if(altpals_init()) {
+        goto error_2;
+    }
+
+    engine_init_flags flags;
+    memset(&flags, 0, sizeof(engine_init_flags));
+    flags.net_mode = NET_MODE_NONE;
+    game_state *gs = malloc(sizeof(game_state));
+    game_state_create_headless(gs, &flags);
+    game_state_setup_rec(gs, &rec);
+
+    // Same as the normal playback; the arena ID is not read from the file yet
+    if(game_load_new(gs, SCENE_ARENA0)) {
+        PERROR("Replay: Unable to load arena.");
+        goto error_3;
+    }
+
+    // Run static and dynamic ticks in the same ratio as the engine would.
+    // The recording closes the arena once it runs out of moves.
+    unsigned int start = SDL_GetTicks();
+    int dynamic_wait = 0;
+    while(gs->run && gs->next_id == gs->this_id && gs->tick <= max_tick + REPLAY_KEYFRAME_INTERVAL) {
+        game_state_tick_controllers(gs);
+        game_state_static_tick(gs);
+        dynamic_wait += 10;
+        while(dynamic_wait > game_state_ms_per_dyntick(gs) && gs->next_id == gs->this_id) {
+            game_state_dynamic_tick(gs);
+            dynamic_wait -= game_state_ms_per_dyntick(gs);
+        }
+    }
+    *hash = statehash_compute(gs);
+    *ticks = gs->tick;
+    INFO("Replay: Verified '%s' in %u ms.", rec_file, SDL_GetTicks() - start);
+
+    game_state_free(gs);
+    free(gs);
+    sd_rec_free(&rec);
+    altpals_close();
+    fonts_close();
+    lang_close();
+    return 0;
+
+error_3:
+    game_state_free(gs);
+    free(gs);
+    altpals_close();
+error_2:
+    fonts_close();
+error_1:
+    lang_close();
+error_0:
+    sd_rec_free(&rec);
+    return 1;
+}
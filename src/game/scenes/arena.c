@@ -12,14 +12,16 @@
 #include "audio/music.h"
 #include "game/utils/settings.h"
 #include "game/objects/har.h"
-#include "game/objects/scrap.h"
 #include "game/objects/hazard.h"
 #include "game/objects/arena_constraints.h"
 #include "game/protos/object.h"
 #include "game/utils/score.h"
 #include "game/game_player.h"
 #include "game/game_state.h"
+#include "game/particles.h"
+#include "game/spectate.h"
 #include "game/utils/ticktimer.h"
+#include "game/utils/rec_writer.h"
 #include "game/gui/text_render.h"
 #include "resources/languages.h"
 #include "game/gui/menu.h"
@@ -33,6 +35,7 @@
 #include "game/gui/progressbar.h"
 #include "controller/controller.h"
 #include "controller/net_controller.h"
+#include "controller/net_relay.h"
 #include "resources/ids.h"
 #include "utils/log.h"
 #include "utils/random.h"
@@ -64,8 +67,10 @@ typedef struct arena_local_t {
 
     int rein_enabled;
 
-    sd_rec_file *rec;
+    rec_writer *rec;
     int rec_last[2];
+
+    net_relay *relay; // Spectators of a network match we host
 } arena_local;
 
 void arena_maybe_sync(scene *scene, int need_sync);
@@ -120,7 +125,7 @@ void scene_fight_anim_start(void *userdata) {
     game_state *gs = userdata;
     scene *scene = game_state_get_scene(gs);
     animation *fight_ani = &bk_get_info(&scene->bk_data, 10)->ani;
-    object *fight = malloc(sizeof(object));
+    object *fight = object_alloc();
     object_create(fight, gs, fight_ani->start_pos, vec2f_create(0,0));
     object_set_stl(fight, bk_get_stl(&scene->bk_data));
     object_set_animation(fight, fight_ani);
@@ -149,7 +154,7 @@ void scene_youwin_anim_start(void *userdata) {
     game_state *gs = userdata;
     scene *scene = game_state_get_scene(gs);
     animation *youwin_ani = &bk_get_info(&scene->bk_data, 9)->ani;
-    object *youwin = malloc(sizeof(object));
+    object *youwin = object_alloc();
     object_create(youwin, gs, youwin_ani->start_pos, vec2f_create(0,0));
     object_set_stl(youwin, bk_get_stl(&scene->bk_data));
     object_set_animation(youwin, youwin_ani);
@@ -171,7 +176,7 @@ void scene_youlose_anim_start(void *userdata) {
     game_state *gs = userdata;
     scene *scene = game_state_get_scene(gs);
     animation *youlose_ani = &bk_get_info(&scene->bk_data, 8)->ani;
-    object *youlose = malloc(sizeof(object));
+    object *youlose = object_alloc();
     object_create(youlose, gs, youlose_ani->start_pos, vec2f_create(0,0));
     object_set_stl(youlose, bk_get_stl(&scene->bk_data));
     object_set_animation(youlose, youlose_ani);
@@ -291,7 +296,7 @@ void arena_reset(scene *sc) {
     sc->bk_data.sound_translation_table[3] = 23 + local->round; // NUMBER
     // ROUND animation
     animation *round_ani = &bk_get_info(&sc->bk_data, 6)->ani;
-    object *round = malloc(sizeof(object));
+    object *round = object_alloc();
     object_create(round, sc->gs, round_ani->start_pos, vec2f_create(0,0));
     object_set_stl(round, sc->bk_data.sound_translation_table);
     object_set_animation(round, round_ani);
@@ -300,7 +305,7 @@ void arena_reset(scene *sc) {
 
     // Round number
     animation *number_ani = &bk_get_info(&sc->bk_data, 7)->ani;
-    object *number = malloc(sizeof(object));
+    object *number = object_alloc();
     object_create(number, sc->gs, number_ani->start_pos, vec2f_create(0,0));
     object_set_stl(number, sc->bk_data.sound_translation_table);
     object_set_animation(number, number_ani);
@@ -420,7 +425,7 @@ void arena_har_hit_wall_hook(int player_id, int wall, scene *scene) {
 
         // Spawn wall animation
         bk_info *info = bk_get_info(&scene->bk_data, 20+wall);
-        object *obj = malloc(sizeof(object));
+        object *obj = object_alloc();
         object_create(obj, scene->gs, info->ani.start_pos, vec2f_create(0,0));
         object_set_stl(obj, scene->bk_data.sound_translation_table);
         object_set_animation(obj, &info->ani);
@@ -429,7 +434,7 @@ void arena_har_hit_wall_hook(int player_id, int wall, scene *scene) {
             // spawn the electricity on top of the HAR
             // TODO this doesn't track the har's position well...
             info = bk_get_info(&scene->bk_data, 22);
-            object *obj2 = malloc(sizeof(object));
+            object *obj2 = object_alloc();
             object_create(obj2, scene->gs, vec2i_create(o_har->pos.x, o_har->pos.y), vec2f_create(0, 0));
             object_set_stl(obj2, scene->bk_data.sound_translation_table);
             object_set_animation(obj2, &info->ani);
@@ -438,7 +443,7 @@ void arena_har_hit_wall_hook(int player_id, int wall, scene *scene) {
             game_state_add_object(scene->gs, obj2, RENDER_LAYER_TOP, 0, 0);
         } else {
             object_free(obj);
-            free(obj);
+            object_dealloc(obj);
         }
         return;
     }
@@ -458,14 +463,14 @@ void arena_har_hit_wall_hook(int player_id, int wall, scene *scene) {
 
         // desert always shows the 'hit' animation when you touch the wall
         bk_info *info = bk_get_info(&scene->bk_data, 20+wall);
-        object *obj = malloc(sizeof(object));
+        object *obj = object_alloc();
         object_create(obj, scene->gs, info->ani.start_pos, vec2f_create(0,0));
         object_set_stl(obj, scene->bk_data.sound_translation_table);
         object_set_animation(obj, &info->ani);
         object_set_custom_string(obj, "brwA1-brwB1-brwD1-brwE0-brwD4-brwC2-brwB2-brwA2");
         if(game_state_add_object(scene->gs, obj, RENDER_LAYER_BOTTOM, 1, 0) != 0) {
             object_free(obj);
-            free(obj);
+            object_dealloc(obj);
         }
     }
 
@@ -490,7 +495,7 @@ void arena_har_hit_wall_hook(int player_id, int wall, scene *scene) {
             DEBUG("XXX anim = %d, variance = %d", anim_no, variance);
             int pos_y = o_har->pos.y - object_get_size(o_har).y + variance + i*25;
             vec2i coord = vec2i_create(o_har->pos.x, pos_y);
-            object *dust = malloc(sizeof(object));
+            object *dust = object_alloc();
             object_create(dust, scene->gs, coord, vec2f_create(0,0));
             object_set_stl(dust, scene->bk_data.sound_translation_table);
             object_set_animation(dust, &bk_get_info(&scene->bk_data, anim_no)->ani);
@@ -500,7 +505,9 @@ void arena_har_hit_wall_hook(int player_id, int wall, scene *scene) {
         // Wallhit sound
         float d = ((float)o_har->pos.x) / 640.0f;
         float pos_pan = d - 0.25f;
-        sound_play(68, 1.0f, pos_pan, 2.0f);
+        if(!scene->gs->headless) {
+            sound_play(68, 1.0f, pos_pan, 2.0f);
+        }
     }
 
     /**
@@ -724,9 +731,11 @@ void arena_free(scene *scene) {
 
     if (local->rec) {
         write_rec_move(scene, game_state_get_player(scene->gs, 0), ACT_STOP);
-        sd_rec_save(local->rec, scene->gs->init_flags->rec_file);
-        sd_rec_free(local->rec);
-        free(local->rec);
+        rec_writer_close(local->rec);
+    }
+    if (local->relay) {
+        net_relay_end(local->relay, scene->gs->tick);
+        net_relay_free(local->relay);
     }
 
     for(int i = 0; i < 2; i++) {
@@ -737,7 +746,7 @@ void arena_free(scene *scene) {
 
         for (int j = 0; j < 4; j++) {
             if (j < ceil(local->rounds / 2.0f)) {
-                free(local->player_rounds[i][j]);
+                object_dealloc(local->player_rounds[i][j]);
             }
         }
     }
@@ -761,7 +770,7 @@ void arena_free(scene *scene) {
 void write_rec_move(scene *scene, game_player *player, int action) {
     arena_local *local = scene_get_userdata(scene);
     sd_rec_move move;
-    if (!local->rec) {
+    if (!local->rec && !local->relay) {
         return;
     }
 
@@ -803,11 +812,14 @@ void write_rec_move(scene *scene, game_player *player, int action) {
     }
     local->rec_last[move.player_id] = move.action;
 
-    int ret;
-
-    if ((ret = sd_rec_insert_action(local->rec, local->rec->move_count, &move)) != SD_SUCCESS) {
-        DEBUG("recoding move failed %d", ret);
+    if (local->relay) {
+        net_relay_add(local->relay, move.tick, move.player_id, move.action);
     }
+    if (!local->rec) {
+        return;
+    }
+
+    rec_writer_add(local->rec, &move);
 }
 
 int arena_handle_events(scene *scene, game_player *player, ctrl_event *i) {
@@ -851,7 +863,7 @@ int arena_handle_events(scene *scene, game_player *player, ctrl_event *i) {
                 }
             } else if (i->type == EVENT_TYPE_SYNC) {
                 DEBUG("sync");
-                game_state_unserialize(scene->gs, i->event_data.ser, player->ctrl->rtt);
+                game_state_unserialize(scene->gs, i->event_data.ser, net_controller_catchup(player->ctrl));
                 maybe_install_har_hooks(scene);
             } else if (i->type == EVENT_TYPE_CLOSE) {
                 if (player->ctrl->type == CTRL_TYPE_REC) {
@@ -867,10 +879,6 @@ int arena_handle_events(scene *scene, game_player *player, ctrl_event *i) {
 }
 
 void arena_spawn_hazard(scene *scene) {
-    iterator it;
-    hashmap_iter_begin(&scene->bk_data.infos, &it);
-    hashmap_pair *pair = NULL;
-
     if (is_netplay(scene) && scene->gs->role == ROLE_CLIENT) {
         // only the server spawns hazards
         return;
@@ -878,12 +886,13 @@ void arena_spawn_hazard(scene *scene) {
 
     int changed = 0;
 
-    while((pair = iter_next(&it)) != NULL) {
-        bk_info *info = (bk_info*)pair->val;
-        if(info->probability > 1) {
+    // Go by id, so that the random draws come in the same order every time
+    for(int id = 0; id < BK_MAX_INFOS; id++) {
+        bk_info *info = bk_get_info(&scene->bk_data, id);
+        if(info != NULL && info->probability > 1) {
             if (rand_int(info->probability) == 1) {
                 // TODO don't spawn it if we already have this animation running
-                object *obj = malloc(sizeof(object));
+                object *obj = object_alloc();
                 object_create(obj, scene->gs, info->ani.start_pos, vec2f_create(0,0));
                 object_set_stl(obj, scene->bk_data.sound_translation_table);
                 object_set_animation(obj, &info->ani);
@@ -918,7 +927,7 @@ void arena_spawn_hazard(scene *scene) {
                     changed++;
                 } else {
                     object_free(obj);
-                    free(obj);
+                    object_dealloc(obj);
                 }
             }
         }
@@ -956,9 +965,9 @@ void arena_dynamic_tick(scene *scene, int paused) {
             component_tick(local->endurance_bars[i]);
         }
 
-        // RTT stuff
-        hars[0]->delay = ceil(player2->ctrl->rtt / 2.0f);
-        hars[1]->delay = ceil(player1->ctrl->rtt / 2.0f);
+        // Hold our moves back for as long as they take to reach the peer
+        hars[0]->delay = (player2->ctrl->type == CTRL_TYPE_NETWORK) ? net_controller_input_delay(player2->ctrl) : 0;
+        hars[1]->delay = (player1->ctrl->type == CTRL_TYPE_NETWORK) ? net_controller_input_delay(player1->ctrl) : 0;
 
         // Endings and beginnings
         if(local->state != ARENA_STATE_ENDING && local->state != ARENA_STATE_STARTING) {
@@ -1005,18 +1014,9 @@ void arena_dynamic_tick(scene *scene, int paused) {
                     // (to prevent floating scrap objects)
                     if(vely < 0.1 && vely > -0.1) vely += 0.21;
 
-                    // Create the object
-                    object *scrap = malloc(sizeof(object));
                     int anim_no = rand_int(3) + ANIM_SCRAP_METAL;
-                    object_create(scrap, gs, pos, vec2f_create(velx, vely));
-                    object_set_animation(scrap, &af_get_move(h->af_data, anim_no)->ani);
-                    object_set_gravity(scrap, 0.4f);
-                    object_set_pal_offset(scrap, object_get_pal_offset(h_obj));
-                    object_set_layers(scrap, LAYER_SCRAP);
-                    object_set_shadow(scrap, 1);
-                    object_dynamic_tick(scrap);
-                    scrap_create(scrap);
-                    game_state_add_object(gs, scrap, RENDER_LAYER_TOP, 0, 0);
+                    particles_spawn(gs->particles, &af_get_move(h->af_data, anim_no)->ani,
+                                    pos, vec2f_create(velx, vely), 0.4f, object_get_pal_offset(h_obj), 1, RENDER_LAYER_TOP);
                 }
             }
         }
@@ -1027,6 +1027,10 @@ void arena_dynamic_tick(scene *scene, int paused) {
     need_sync += arena_handle_events(scene, player1, player1->ctrl->extra_events);
     need_sync += arena_handle_events(scene, player2, player2->ctrl->extra_events);
     arena_maybe_sync(scene, need_sync);
+
+    if (local->relay) {
+        net_relay_flush(local->relay, scene->gs->tick);
+    }
 }
 
 void arena_static_tick(scene *scene, int paused) {
@@ -1152,6 +1156,22 @@ void arena_set_state(scene *scene, int state) {
     local->state = state;
 }
 
+void arena_serialize(scene *scene, serial *ser) {
+    arena_local *local = scene_get_userdata(scene);
+    serial_write_int8(ser, local->state);
+    serial_write_int8(ser, local->round);
+    serial_write_int8(ser, local->over);
+    serial_write_int32(ser, local->ending_ticks);
+}
+
+void arena_unserialize(scene *scene, serial *ser) {
+    arena_local *local = scene_get_userdata(scene);
+    local->state = serial_read_int8(ser);
+    local->round = serial_read_int8(ser);
+    local->over = serial_read_int8(ser);
+    local->ending_ticks = serial_read_int32(ser);
+}
+
 void arena_toggle_rein(scene *scene) {
     arena_local *local = scene_get_userdata(scene);
     local->rein_enabled = !local->rein_enabled;
@@ -1179,18 +1199,20 @@ int arena_create(scene *scene) {
     // Load up settings
     setting = settings_get();
 
-    // Initialize Demo
-    if(is_demoplay(scene)) {
+    // Initialize Demo. Headless runs have their players set up already.
+    if(is_demoplay(scene) && !scene->gs->headless) {
         game_state_init_demo(scene->gs);
     }
 
     // Handle music playback
-    switch(scene->bk_data.file_id) {
-        case 8:   music_play(PSM_ARENA0); break;
-        case 16:  music_play(PSM_ARENA1); break;
-        case 32:  music_play(PSM_ARENA2); break;
-        case 64:  music_play(PSM_ARENA3); break;
-        case 128: music_play(PSM_ARENA4); break;
+    if(!scene->gs->headless) {
+        switch(scene->bk_data.file_id) {
+            case 8:   music_play(PSM_ARENA0); break;
+            case 16:  music_play(PSM_ARENA1); break;
+            case 32:  music_play(PSM_ARENA2); break;
+            case 64:  music_play(PSM_ARENA3); break;
+            case 128: music_play(PSM_ARENA4); break;
+        }
     }
 
     // Initialize local struct
@@ -1232,7 +1254,7 @@ int arena_create(scene *scene) {
     for(int i = 0; i < 2; i++) {
         // Declare some vars
         game_player *player = game_state_get_player(scene->gs, i);
-        object *obj = malloc(sizeof(object));
+        object *obj = object_alloc();
 
         // load the player's colors into the palette
         palette *base_pal = video_get_base_palette();
@@ -1245,7 +1267,7 @@ int arena_create(scene *scene) {
         // Errors are unlikely here, but check anyway.
 
         if (scene_load_har(scene, i, player->har_id)) {
-            free(obj);
+            object_dealloc(obj);
             return 1;
         }
 
@@ -1264,7 +1286,7 @@ int arena_create(scene *scene) {
         // Create round tokens
         for (int j = 0; j < 4; j++) {
             if (j < ceil(local->rounds / 2.0f)) {
-                local->player_rounds[i][j] = malloc(sizeof(object));
+                local->player_rounds[i][j] = object_alloc();
                 int xoff = 110 + 9 * j + 3 + j;
                 if (i == 1) {
                     xoff = 210 - 9 * j - 3 - j;
@@ -1379,7 +1401,7 @@ int arena_create(scene *scene) {
     if (local->rounds == 1) {
         // Start READY animation
         animation *ready_ani = &bk_get_info(&scene->bk_data, 11)->ani;
-        object *ready = malloc(sizeof(object));
+        object *ready = object_alloc();
         object_create(ready, scene->gs, ready_ani->start_pos, vec2f_create(0,0));
         object_set_stl(ready, scene->bk_data.sound_translation_table);
         object_set_animation(ready, ready_ani);
@@ -1388,7 +1410,7 @@ int arena_create(scene *scene) {
     } else {
         // ROUND
         animation *round_ani = &bk_get_info(&scene->bk_data, 6)->ani;
-        object *round = malloc(sizeof(object));
+        object *round = object_alloc();
         object_create(round, scene->gs, round_ani->start_pos, vec2f_create(0,0));
         object_set_stl(round, scene->bk_data.sound_translation_table);
         object_set_animation(round, round_ani);
@@ -1397,7 +1419,7 @@ int arena_create(scene *scene) {
 
         // Number
         animation *number_ani = &bk_get_info(&scene->bk_data, 7)->ani;
-        object *number = malloc(sizeof(object));
+        object *number = object_alloc();
         object_create(number, scene->gs, number_ani->start_pos, vec2f_create(0,0));
         object_set_stl(number, scene->bk_data.sound_translation_table);
         object_set_animation(number, number_ani);
@@ -1419,23 +1441,40 @@ int arena_create(scene *scene) {
 
     // initalize recording, if enabled
     if (scene->gs->init_flags->record == 1) {
-        local->rec = malloc(sizeof(sd_rec_file));
-        sd_rec_create(local->rec);
+        sd_rec_file rec;
+        sd_rec_create(&rec);
         for(int i = 0; i < 2; i++) {
             // Declare some vars
             game_player *player = game_state_get_player(scene->gs, i);
             DEBUG("player %d using har %d", i, player->har_id);
-            local->rec->pilots[i].info.har_id = (unsigned char)player->har_id;
-            local->rec->pilots[i].info.pilot_id = player->pilot_id;
-            local->rec->pilots[i].info.color_1 = player->colors[2];
-            local->rec->pilots[i].info.color_2 = player->colors[1];
-            local->rec->pilots[i].info.color_3 = player->colors[0];
-            memcpy(local->rec->pilots[i].info.name, lang_get(player->pilot_id+20), 18);
+            rec.pilots[i].info.har_id = (unsigned char)player->har_id;
+            rec.pilots[i].info.pilot_id = player->pilot_id;
+            rec.pilots[i].info.color_1 = player->colors[2];
+            rec.pilots[i].info.color_2 = player->colors[1];
+            rec.pilots[i].info.color_3 = player->colors[0];
+            memcpy(rec.pilots[i].info.name, lang_get(player->pilot_id+20), 18);
         }
+        // Moves are streamed to the file as the match goes on
+        local->rec = rec_writer_open(scene->gs->init_flags->rec_file, &rec);
+        sd_rec_free(&rec);
     } else{
         local->rec = NULL;
     }
 
+    // Let spectators watch, if we are hosting a network match
+    local->relay = NULL;
+    int relay_port = settings_get()->net.net_relay_port;
+    controller *ctrl1 = game_player_get_ctrl(game_state_get_player(scene->gs, 0));
+    controller *ctrl2 = game_player_get_ctrl(game_state_get_player(scene->gs, 1));
+    if (relay_port > 0 && scene->gs->role == ROLE_SERVER
+        && (ctrl1->type == CTRL_TYPE_NETWORK || ctrl2->type == CTRL_TYPE_NETWORK)) {
+        serial header;
+        serial_create(&header);
+        spectate_write_header(&header, scene->gs, scene->id);
+        local->relay = net_relay_create(relay_port, settings_get()->net.net_relay_spectators, &header);
+        serial_free(&header);
+    }
+
     // All done!
     return 0;
 }
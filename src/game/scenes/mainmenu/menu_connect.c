@@ -1,5 +1,4 @@
 #include <enet/enet.h>
-#include <time.h>
 
 #include "game/scenes/mainmenu/menu_connect.h"
 #include "game/scenes/mainmenu/menu_widget_ids.h"
@@ -8,12 +7,15 @@
 #include "game/utils/settings.h"
 #include "game/protos/scene.h"
 #include "game/game_state.h"
+#include "game/match_start.h"
+#include "resources/ids.h"
 #include "utils/compat.h"
+#include "utils/random.h"
 #include "utils/log.h"
 
 typedef struct {
-    time_t connect_start;
-    ENetHost *host;
+    net_thread *thread;
+    controller *net_ctrl;
     component *addr_input;
     component *connect_button;
     component *cancel_button;
@@ -22,16 +24,13 @@ typedef struct {
 
 void menu_connect_free(component *c) {
     connect_menu_data *local = menu_get_userdata(c);
-    if(local->host) {
-        enet_host_destroy(local->host);
-    }
+    net_thread_free(local->thread);
     free(local);
 }
 
 void menu_connect_start(component *c, void *userdata) {
     scene *s = userdata;
     connect_menu_data *local = menu_get_userdata(c->parent);
-    ENetAddress address;
     const char *addr = textinput_value(local->addr_input);
     s->gs->role = ROLE_CLIENT;
 
@@ -39,9 +38,9 @@ void menu_connect_start(component *c, void *userdata) {
     free(settings_get()->net.net_connect_ip);
     settings_get()->net.net_connect_ip = strdup(addr);
 
-    // Set up enet host
-    local->host = enet_host_create(NULL, 1, 2, 0, 0);
-    if(local->host == NULL) {
+    // Connect in the background; the tick picks up the result
+    local->thread = net_controller_connect(addr, settings_get()->net.net_connect_port, ROLE_CLIENT);
+    if(local->thread == NULL) {
         DEBUG("Failed to initialize ENet client");
         return;
     }
@@ -50,41 +49,56 @@ void menu_connect_start(component *c, void *userdata) {
     component_disable(local->connect_button, 1);
     component_disable(local->addr_input, 1);
     menu_select(c->parent, local->cancel_button);
-
-    // Set address
-    enet_address_set_host(&address, addr);
-    address.port = settings_get()->net.net_connect_port;
-
-    ENetPeer *peer = enet_host_connect(local->host, &address, 2, 0);
-    if(peer == NULL) {
-        DEBUG("Unable to connect to %s", addr);
-        enet_host_destroy(local->host);
-        local->host = NULL;
-    }
-    time(&local->connect_start);
 }
 
 void menu_connect_cancel(component *c, void *userdata) {
     menu *m = sizer_get_obj(c->parent);
     m->finished = 1;
 
-    // Clean up host
+    // Doesn't wait for the connection attempt to wind down
     connect_menu_data *local = menu_get_userdata(c->parent);
-    if(local->host) {
-        enet_host_destroy(local->host);
-        local->host = NULL;
+    net_thread_free(local->thread);
+    local->thread = NULL;
+}
+
+// Nothing to do until the host has told us where the match begins
+static int menu_connect_get_start(controller *ctrl, match_start *start) {
+    serial ser;
+    serial_create(&ser);
+    int got = net_controller_get_start(ctrl, &ser) && match_start_read(&ser, start);
+    serial_free(&ser);
+    return got;
+}
+
+// A match server has picked the arena and the HARs already
+static void menu_connect_setup_match(game_state *gs, const match_start *start) {
+    // Our keyboard plays the slot we were given, the host plays the other one
+    if(start->slot == 0) {
+        game_player *p1 = game_state_get_player(gs, 0);
+        game_player *p2 = game_state_get_player(gs, 1);
+        controller *ctrl = p1->ctrl;
+        p1->ctrl = p2->ctrl;
+        p2->ctrl = ctrl;
+    }
+    for(int i = 0; i < 2; i++) {
+        game_player *player = game_state_get_player(gs, i);
+        player->har_id = start->players[i].har_id;
+        player->pilot_id = start->players[i].pilot_id;
+        for(int k = 0; k < 3; k++) {
+            player->colors[k] = start->players[i].colors[k];
+        }
+        game_player_set_selectable(player, 1);
     }
+    rand_seed(start->seed);
 }
 
 void menu_connect_tick(component *c) {
     connect_menu_data *local = menu_get_userdata(c);
     game_state *gs = local->s->gs;
-    if(local->host) {
-        ENetEvent event;
-        if(enet_host_service(local->host, &event, 0) > 0 && event.type == ENET_EVENT_TYPE_CONNECT) {
-            ENetPacket * packet = enet_packet_create("0", 2, ENET_PACKET_FLAG_RELIABLE);
-            enet_peer_send(event.peer, 0, packet);
-            enet_host_flush(local->host);
+    if(local->thread) {
+        int state = net_thread_get_state(local->thread);
+        if(state == NET_THREAD_CONNECTED) {
+            net_thread_send(local->thread, 0, "0", 2, ENET_PACKET_FLAG_RELIABLE);
 
             DEBUG("connected to server!");
             controller *player1_ctrl, *player2_ctrl;
@@ -108,7 +122,9 @@ void menu_connect_tick(component *c) {
             player2_ctrl->har = p2->har;
 
             // Player 1 controller -- Network
-            net_controller_create(player1_ctrl, local->host, event.peer, ROLE_CLIENT);
+            net_controller_create(player1_ctrl, local->thread, ROLE_CLIENT);
+            local->thread = NULL; // The net controller owns the thread from here on
+            local->net_ctrl = player1_ctrl;
             game_player_set_ctrl(p1, player1_ctrl);
 
             // Player 2 controller -- Keyboard
@@ -132,21 +148,22 @@ void menu_connect_tick(component *c) {
             chr_score_set_difficulty(game_player_get_score(game_state_get_player(gs, 0)), AI_DIFFICULTY_CHAMPION);
             chr_score_set_difficulty(game_player_get_score(game_state_get_player(gs, 1)), AI_DIFFICULTY_CHAMPION);
 
-        } else {
-            if(difftime(time(NULL), local->connect_start) > 5.0) {
-                DEBUG("connection timed out");
-                menu_connect_cancel(local->cancel_button, local->s);
-            }
+        } else if(state == NET_THREAD_CLOSED) {
+            DEBUG("connection failed or timed out");
+            menu_connect_cancel(local->cancel_button, local->s);
         }
-        game_player *p1 = game_state_get_player(gs, 0);
-        controller *c1 = game_player_get_ctrl(p1);
-        if (c1->type == CTRL_TYPE_NETWORK && net_controller_ready(c1) == 1) {
-            DEBUG("network peer is ready, tick offset is %d and rtt is %d", net_controller_tick_offset(c1), c1->rtt);
-            local->host = NULL;
-            gs->tick += net_controller_tick_offset(c1);
-            gs->int_tick = gs->tick;
-            game_state_set_next(gs, SCENE_MELEE);
+    }
+    controller *c1 = local->net_ctrl;
+    match_start start;
+    if (c1 != NULL && net_controller_ready(c1) == 1 && menu_connect_get_start(c1, &start)) {
+        DEBUG("network peer is ready, tick offset is %d and rtt is %d", net_controller_tick_offset(c1), c1->rtt);
+        local->net_ctrl = NULL;
+        gs->tick += net_controller_tick_offset(c1);
+        gs->int_tick = gs->tick;
+        if(is_arena(start.scene_id)) {
+            menu_connect_setup_match(gs, &start);
         }
+        game_state_set_next(gs, start.scene_id);
     }
 }
 
@@ -1,5 +1,4 @@
 #include <enet/enet.h>
-#include <time.h>
 
 #include "game/scenes/mainmenu/menu_listen.h"
 
@@ -7,31 +6,48 @@
 #include "game/utils/settings.h"
 #include "game/protos/scene.h"
 #include "game/game_state.h"
+#include "game/match_start.h"
 #include "utils/log.h"
 
 typedef struct {
-    ENetHost *host;
+    net_thread *thread;
+    controller *net_ctrl;
     component *cancel_button;
     scene *s;
 } listen_menu_data;
 
 void menu_listen_free(component *c) {
     listen_menu_data *local = menu_get_userdata(c);
-    if(local->host) {
-        enet_host_destroy(local->host);
-    }
+    net_thread_free(local->thread);
     free(local);
 }
 
+void menu_listen_cancel(component *c, void *userdata) {
+    menu *m = sizer_get_obj(c->parent);
+    m->finished = 1;
+
+    // Stops listening without waiting for it
+    listen_menu_data *local = menu_get_userdata(c->parent);
+    net_thread_free(local->thread);
+    local->thread = NULL;
+}
+
 void menu_listen_tick(component *c) {
     listen_menu_data *local = menu_get_userdata(c);
     game_state *gs = local->s->gs;
-    if(local->host) {
-        ENetEvent event;
-        if(enet_host_service(local->host, &event, 0) > 0 && event.type == ENET_EVENT_TYPE_CONNECT) {
-            ENetPacket * packet = enet_packet_create("0", 2,  ENET_PACKET_FLAG_RELIABLE);
-            enet_peer_send(event.peer, 0, packet);
-            enet_host_flush(local->host);
+    if(local->thread) {
+        int state = net_thread_get_state(local->thread);
+        if(state == NET_THREAD_CONNECTED) {
+            // The client plays player 2, and the HARs are picked in the melee screen
+            match_start start;
+            serial ser;
+            memset(&start, 0, sizeof(match_start));
+            start.slot = 1;
+            start.scene_id = SCENE_MELEE;
+            serial_create(&ser);
+            match_start_write(&ser, &start);
+            net_thread_send(local->thread, 1, ser.data, ser.len, ENET_PACKET_FLAG_RELIABLE);
+            serial_free(&ser);
 
             DEBUG("client connected!");
             controller *player1_ctrl, *player2_ctrl;
@@ -72,54 +88,41 @@ void menu_listen_tick(component *c) {
             game_player_set_ctrl(p1, player1_ctrl);
 
             // Player 2 controller -- Network
-            net_controller_create(player2_ctrl, local->host, event.peer, ROLE_SERVER);
+            net_controller_create(player2_ctrl, local->thread, ROLE_SERVER);
+            local->thread = NULL; // The net controller owns the thread from here on
+            local->net_ctrl = player2_ctrl;
             game_player_set_ctrl(p2, player2_ctrl);
             game_player_set_selectable(p2, 1);
 
             chr_score_set_difficulty(game_player_get_score(game_state_get_player(gs, 0)), AI_DIFFICULTY_CHAMPION);
             chr_score_set_difficulty(game_player_get_score(game_state_get_player(gs, 1)), AI_DIFFICULTY_CHAMPION);
 
-        }
-        game_player *p2 = game_state_get_player(gs, 1);
-        controller *c2 = game_player_get_ctrl(p2);
-        if (c2->type == CTRL_TYPE_NETWORK && net_controller_ready(c2) == 1) {
-            DEBUG("network peer is ready, tick offset is %d and rtt is %d", net_controller_tick_offset(c2), c2->rtt);
-            local->host = NULL;
-            game_state_set_next(gs, SCENE_MELEE);
+        } else if(state == NET_THREAD_CLOSED) {
+            DEBUG("Failed to initialize ENet server");
+            menu_listen_cancel(local->cancel_button, local->s);
         }
     }
-}
-
-void menu_listen_cancel(component *c, void *userdata) {
-    menu *m = sizer_get_obj(c->parent);
-    m->finished = 1;
-
-    // Clean up host
-    listen_menu_data *local = menu_get_userdata(c->parent);
-    if(local->host) {
-        enet_host_destroy(local->host);
-        local->host = NULL;
+    controller *c2 = local->net_ctrl;
+    if (c2 != NULL && net_controller_ready(c2) == 1) {
+        DEBUG("network peer is ready, tick offset is %d and rtt is %d", net_controller_tick_offset(c2), c2->rtt);
+        local->net_ctrl = NULL;
+        game_state_set_next(gs, SCENE_MELEE);
     }
 }
 
 component* menu_listen_create(scene *s) {
     listen_menu_data *local = malloc(sizeof(listen_menu_data));
+    local->net_ctrl = NULL;
     s->gs->role = ROLE_SERVER;
     local->s = s;
 
-    // Form address (host)
-    ENetAddress address;
-    address.host = ENET_HOST_ANY;
-    address.port = settings_get()->net.net_listen_port;
-
-    // Set up host
-    local->host = enet_host_create(&address, 1, 2, 0, 0);
-    if(local->host == NULL) {
+    // Listen in the background; the tick picks up the peer
+    local->thread = net_controller_listen(settings_get()->net.net_listen_port, ROLE_SERVER);
+    if(local->thread == NULL) {
         DEBUG("Failed to initialize ENet server");
         free(local);
         return NULL;
     }
-    enet_socket_set_option(local->host->socket, ENET_SOCKOPT_REUSEADDR, 1);
 
     // Text config
     text_settings tconf;
@@ -317,12 +317,12 @@ void handle_action(scene *scene, int player, int action) {
                         } else {
                             // pick an opponent we have not yet beaten
                             while(1) {
-                                int i = rand_int(10);
+                                int i = random_int(rand_stream(RAND_STREAM_MENU), 10);
                                 if ((2 << i) & player1->sp_wins || i == player1->pilot_id) {
                                     continue;
                                 }
                                 player2->pilot_id = i;
-                                player2->har_id = rand_int(10);
+                                player2->har_id = random_int(rand_stream(RAND_STREAM_MENU), 10);
                                 break;
                             }
                         }
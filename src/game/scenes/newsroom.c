@@ -251,12 +251,12 @@ void newsroom_input_tick(scene *scene) {
                                 } else {
                                     // pick an opponent we have not yet beaten
                                     while(1) {
-                                        int i = rand_int(10);
+                                        int i = random_int(rand_stream(RAND_STREAM_MENU), 10);
                                         if ((2 << i) & p1->sp_wins || i == p1->pilot_id) {
                                             continue;
                                         }
                                         p2->pilot_id = i;
-                                        p2->har_id = rand_int(10);
+                                        p2->har_id = random_int(rand_stream(RAND_STREAM_MENU), 10);
                                         break;
                                     }
                                 }
@@ -311,7 +311,7 @@ void newsroom_startup(scene *scene, int id, int *m_load, int *m_repeat) {
 int newsroom_create(scene *scene) {
     newsroom_local *local = malloc(sizeof(newsroom_local));
 
-    local->news_id = rand_int(24)*2;
+    local->news_id = random_int(rand_stream(RAND_STREAM_MENU), 24)*2;
     local->screen = 0;
     menu_background_create(&local->news_bg, 280, 50);
     str_create(&local->news_str);
@@ -336,13 +336,13 @@ int newsroom_create(scene *scene) {
     DEBUG("health is %d", health);
 
     if (health > 40 && local->won == 1) {
-        local->news_id = rand_int(6)*2;
+        local->news_id = random_int(rand_stream(RAND_STREAM_MENU), 6)*2;
     } else if (local->won == 1) {
-        local->news_id = 12+rand_int(6)*2;
+        local->news_id = 12+random_int(rand_stream(RAND_STREAM_MENU), 6)*2;
     } else if (health < 40 && local->won == 0) {
-        local->news_id = 38+rand_int(5)*2;
+        local->news_id = 38+random_int(rand_stream(RAND_STREAM_MENU), 5)*2;
     } else {
-        local->news_id = 24+rand_int(7)*2;
+        local->news_id = 24+random_int(rand_stream(RAND_STREAM_MENU), 7)*2;
     }
 
     // XXX TODO get the real sex of pilot
@@ -54,7 +54,7 @@ vec2i spawn_position(int index, int scientist) {
             if (scientist) {
                 return vec2i_create(90,80);
             }
-            switch (rand_int(3)) {
+            switch (random_int(rand_stream(RAND_STREAM_MENU), 3)) {
                 case 0:
                     // middle
                     return vec2i_create(90,80);
@@ -71,7 +71,7 @@ vec2i spawn_position(int index, int scientist) {
             if (scientist) {
                 return vec2i_create(230,80);
             }
-            switch (rand_int(3)) {
+            switch (random_int(rand_stream(RAND_STREAM_MENU), 3)) {
                 case 0:
                     // middle
                     return vec2i_create(230,80);
@@ -110,7 +110,7 @@ void cb_vs_spawn_object(object *parent, int id, vec2i pos, int g, void *userdata
     // Get next animation
     bk_info *info = bk_get_info(&s->bk_data, id);
     if(info != NULL) {
-        object *obj = malloc(sizeof(object));
+        object *obj = object_alloc();
         object_create(obj, parent->gs, vec2i_add(pos, vec2f_to_i(parent->pos)), vec2f_create(0,0));
         object_set_stl(obj, object_get_stl(parent));
         object_set_animation(obj, &info->ani);
@@ -363,7 +363,7 @@ int vs_create(scene *scene) {
 	local->arena = 0;
     } else {
         // pick a random arena for 1 player mode
-        local->arena = rand_int(5); // srand was done in melee
+        local->arena = random_int(rand_stream(RAND_STREAM_MENU), 5); // srand was done in melee
     }
 
     // Arena
@@ -376,14 +376,14 @@ int vs_create(scene *scene) {
 
 
     // SCIENTIST
-    int scientistpos = rand_int(4);
+    int scientistpos = random_int(rand_stream(RAND_STREAM_MENU), 4);
     vec2i scientistcoord = spawn_position(scientistpos, 1);
     if (scientistpos % 2) {
         scientistcoord.x += 50;
     } else {
         scientistcoord.x -= 50;
     }
-    object *o_scientist = malloc(sizeof(object));
+    object *o_scientist = object_alloc();
     ani = &bk_get_info(&scene->bk_data, 8)->ani;
     object_create(o_scientist, scene->gs, scientistcoord, vec2f_create(0, 0));
     object_set_animation(o_scientist, ani);
@@ -392,14 +392,14 @@ int vs_create(scene *scene) {
     game_state_add_object(scene->gs, o_scientist, RENDER_LAYER_MIDDLE, 0, 0);
 
     // WELDER
-    int welderpos = rand_int(6);
+    int welderpos = random_int(rand_stream(RAND_STREAM_MENU), 6);
     // welder can't be on the same gantry or the same *side* as the scientist
     // he also can't be on the same 'level'
     // but he has 10 possible starting positions
     while ((welderpos % 2)  == (scientistpos % 2) || (scientistpos < 2 && welderpos < 2) || (scientistpos > 1 && welderpos > 1 && welderpos < 4)) {
-        welderpos = rand_int(6);
+        welderpos = random_int(rand_stream(RAND_STREAM_MENU), 6);
     }
-    object *o_welder = malloc(sizeof(object));
+    object *o_welder = object_alloc();
     ani = &bk_get_info(&scene->bk_data, 7)->ani;
     object_create(o_welder, scene->gs, spawn_position(welderpos, 0), vec2f_create(0, 0));
     object_set_animation(o_welder, ani);
@@ -410,14 +410,14 @@ int vs_create(scene *scene) {
     game_state_add_object(scene->gs, o_welder, RENDER_LAYER_MIDDLE, 0, 0);
 
     // GANTRIES
-    object *o_gantry_a = malloc(sizeof(object));
+    object *o_gantry_a = object_alloc();
     ani = &bk_get_info(&scene->bk_data, 11)->ani;
     object_create(o_gantry_a, scene->gs, vec2i_create(0,0), vec2f_create(0, 0));
     object_set_animation(o_gantry_a, ani);
     object_select_sprite(o_gantry_a, 0);
     game_state_add_object(scene->gs, o_gantry_a, RENDER_LAYER_TOP, 0, 0);
 
-    object *o_gantry_b = malloc(sizeof(object));
+    object *o_gantry_b = object_alloc();
     object_create(o_gantry_b, scene->gs, vec2i_create(320,0), vec2f_create(0, 0));
     object_set_animation(o_gantry_b, ani);
     object_select_sprite(o_gantry_b, 0);
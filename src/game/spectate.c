@@ -0,0 +1,253 @@
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include <enet/enet.h>
+#include "game/spectate.h"
+#include "game/game_player.h"
+#include "controller/net_relay.h"
+#include "controller/rec_controller.h"
+#include "game/utils/settings.h"
+#include "utils/vector.h"
+#include "utils/log.h"
+
+typedef struct spectate_player_t {
+    int har_id;
+    int pilot_id;
+    int colors[3];
+} spectate_player;
+
+typedef struct spectate_t {
+    ENetHost *host;
+    ENetPeer *peer;
+    int scene_id;
+    uint32_t seed;
+    settings_gameplay gameplay; // The host's
+    settings_gameplay user_gameplay; // Ours, put back on close
+    int gameplay_set;
+    spectate_player players[2];
+    vector moves; // net_relay_move, waiting for the controllers
+    uint32_t upto;
+    int ended;
+    int stalled;
+} spectate;
+
+static spectate *sp = NULL;
+
+void spectate_write_header(serial *ser, game_state *gs, int scene_id) {
+    settings_gameplay *g = &settings_get()->gameplay;
+    serial_write_int8(ser, scene_id);
+    serial_write_int32(ser, gs->scene_seed);
+    serial_write_int8(ser, g->speed);
+    serial_write_int8(ser, g->fight_mode);
+    serial_write_int8(ser, g->power1);
+    serial_write_int8(ser, g->power2);
+    serial_write_int8(ser, g->hazards_on);
+    serial_write_int8(ser, g->rounds);
+    for(int i = 0; i < 2; i++) {
+        game_player *player = game_state_get_player(gs, i);
+        serial_write_int8(ser, player->har_id);
+        serial_write_int8(ser, player->pilot_id);
+        for(int k = 0; k < 3; k++) {
+            serial_write_int8(ser, player->colors[k]);
+        }
+    }
+}
+
+static void spectate_read_header(serial *ser) {
+    settings_gameplay *g = &sp->gameplay;
+    sp->scene_id = serial_read_int8(ser);
+    sp->seed = serial_read_int32(ser);
+    g->speed = serial_read_int8(ser);
+    g->fight_mode = serial_read_int8(ser);
+    g->power1 = serial_read_int8(ser);
+    g->power2 = serial_read_int8(ser);
+    g->hazards_on = serial_read_int8(ser);
+    g->rounds = serial_read_int8(ser);
+    for(int i = 0; i < 2; i++) {
+        sp->players[i].har_id = serial_read_int8(ser);
+        sp->players[i].pilot_id = serial_read_int8(ser);
+        for(int k = 0; k < 3; k++) {
+            sp->players[i].colors[k] = serial_read_int8(ser);
+        }
+    }
+}
+
+// Returns 1 once the header has been read
+static int spectate_receive(ENetPacket *packet) {
+    serial ser, header;
+    int got_header = 0;
+    int type;
+    serial_create(&ser);
+    serial_create(&header);
+    serial_write(&ser, (const char*)packet->data, packet->dataLength);
+    while((type = net_relay_read(&ser, &header, &sp->moves, &sp->upto)) != 0) {
+        if(type == NET_RELAY_HEADER) {
+            spectate_read_header(&header);
+            got_header = 1;
+        } else if(type == NET_RELAY_END) {
+            DEBUG("Spectate: The match is over at tick %u.", sp->upto);
+            sp->ended = 1;
+        }
+    }
+    serial_free(&header);
+    serial_free(&ser);
+    return got_header;
+}
+
+int spectate_init(const char *host, int port) {
+    ENetAddress address;
+    ENetEvent event;
+    sp = malloc(sizeof(spectate));
+    memset(sp, 0, sizeof(spectate));
+    vector_create(&sp->moves, sizeof(net_relay_move));
+    if((sp->host = enet_host_create(NULL, 1, 1, 0, 0)) == NULL) {
+        PERROR("Spectate: Unable to create a network host.");
+        goto error_0;
+    }
+    enet_address_set_host(&address, host);
+    address.port = port;
+    if((sp->peer = enet_host_connect(sp->host, &address, 1, 0)) == NULL) {
+        PERROR("Spectate: Unable to connect to %s:%d.", host, port);
+        goto error_1;
+    }
+
+    // Nothing to show until we know whose match it is
+    int connected = 0;
+    unsigned int start = SDL_GetTicks();
+    while(SDL_GetTicks() - start < SPECTATE_CONNECT_MS) {
+        if(enet_host_service(sp->host, &event, 10) <= 0) {
+            continue;
+        }
+        if(event.type == ENET_EVENT_TYPE_CONNECT) {
+            connected = 1;
+        } else if(event.type == ENET_EVENT_TYPE_DISCONNECT) {
+            break;
+        } else if(event.type == ENET_EVENT_TYPE_RECEIVE) {
+            int got_header = spectate_receive(event.packet);
+            enet_packet_destroy(event.packet);
+            if(got_header) {
+                INFO("Spectate: Watching the match at %s:%d.", host, port);
+                return 0;
+            }
+        }
+    }
+    PERROR("Spectate: %s %s:%d.", connected ? "No match header from" : "Unable to connect to", host, port);
+    enet_peer_reset(sp->peer);
+error_1:
+    enet_host_destroy(sp->host);
+error_0:
+    vector_free(&sp->moves);
+    free(sp);
+    sp = NULL;
+    return 1;
+}
+
+void spectate_close() {
+    ENetEvent event;
+    if(sp == NULL) {
+        return;
+    }
+    if(sp->peer != NULL) {
+        enet_peer_disconnect(sp->peer, 0);
+        while(enet_host_service(sp->host, &event, 100) > 0) {
+            if(event.type == ENET_EVENT_TYPE_RECEIVE) {
+                enet_packet_destroy(event.packet);
+            } else if(event.type == ENET_EVENT_TYPE_DISCONNECT) {
+                break;
+            }
+        }
+    }
+    enet_host_destroy(sp->host);
+    if(sp->gameplay_set) {
+        settings_get()->gameplay = sp->user_gameplay;
+    }
+    vector_free(&sp->moves);
+    free(sp);
+    sp = NULL;
+}
+
+int spectate_is_active() {
+    return (sp != NULL);
+}
+
+int spectate_get_scene() {
+    return sp->scene_id;
+}
+
+uint32_t spectate_get_seed() {
+    return sp->seed;
+}
+
+void spectate_setup(game_state *gs) {
+    // Play by the host's rules for as long as we watch
+    settings_gameplay *g = &settings_get()->gameplay;
+    if(!sp->gameplay_set) {
+        sp->user_gameplay = *g;
+        sp->gameplay_set = 1;
+    }
+    g->speed = sp->gameplay.speed;
+    g->fight_mode = sp->gameplay.fight_mode;
+    g->power1 = sp->gameplay.power1;
+    g->power2 = sp->gameplay.power2;
+    g->hazards_on = sp->gameplay.hazards_on;
+    g->rounds = sp->gameplay.rounds;
+    gs->speed = g->speed + 5;
+
+    for(int i = 0; i < 2; i++) {
+        game_player *player = game_state_get_player(gs, i);
+        player->har_id = sp->players[i].har_id;
+        player->pilot_id = sp->players[i].pilot_id;
+        for(int k = 0; k < 3; k++) {
+            player->colors[k] = sp->players[i].colors[k];
+        }
+        controller *ctrl = malloc(sizeof(controller));
+        controller_init(ctrl);
+        rec_controller_create_live(ctrl, i);
+        game_player_set_ctrl(player, ctrl);
+    }
+}
+
+int spectate_poll(game_state *gs) {
+    ENetEvent event;
+    while(sp->peer != NULL && enet_host_service(sp->host, &event, 0) > 0) {
+        if(event.type == ENET_EVENT_TYPE_RECEIVE) {
+            spectate_receive(event.packet);
+            enet_packet_destroy(event.packet);
+        } else if(event.type == ENET_EVENT_TYPE_DISCONNECT) {
+            DEBUG("Spectate: Lost the relay at tick %u.", sp->upto);
+            sp->peer = NULL;
+            sp->ended = 1;
+        }
+    }
+
+    // Hand the moves to the players' controllers
+    iterator it;
+    net_relay_move *m;
+    vector_iter_begin(&sp->moves, &it);
+    while((m = iter_next(&it)) != NULL) {
+        controller *ctrl = game_player_get_ctrl(game_state_get_player(gs, m->player_id & 1));
+        if(ctrl != NULL && ctrl->type == CTRL_TYPE_REC) {
+            rec_controller_add(ctrl, m->tick, m->action);
+        }
+    }
+    vector_clear(&sp->moves);
+
+    if(sp->ended) {
+        for(int i = 0; i < 2; i++) {
+            controller *ctrl = game_player_get_ctrl(game_state_get_player(gs, i));
+            if(ctrl != NULL && ctrl->type == CTRL_TYPE_REC) {
+                rec_controller_set_end(ctrl, sp->upto);
+            }
+        }
+        return -1;
+    }
+
+    // Wait for a little buffer once we've run dry, rather than stutter from batch to batch
+    int ready = (sp->upto > gs->tick) ? (int)(sp->upto - gs->tick) : 0;
+    if(ready == 0) {
+        sp->stalled = 1;
+    } else if(sp->stalled && ready >= SPECTATE_BUFFER_TICKS) {
+        sp->stalled = 0;
+    }
+    return sp->stalled ? 0 : ready;
+}
@@ -0,0 +1,353 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "game/tournament.h"
+#include "game/game_state.h"
+#include "game/game_player.h"
+#include "game/common_defines.h"
+#include "game/objects/har.h"
+#include "controller/ai_controller.h"
+#include "resources/ids.h"
+#include "resources/pilots.h"
+#include "resources/languages.h"
+#include "resources/fonts.h"
+#include "resources/palette.h"
+#include "video/video.h"
+#include "utils/random.h"
+#include "utils/log.h"
+#include "utils/mem_pool.h"
+#include "utils/mem_arena.h"
+
+#define MAX_ROUNDS 8
+#define MAX_MOVES 70
+#define NUMBER_OF_ARENAS 5
+
+typedef struct match_result_t {
+    uint32_t seed;
+    int arena;
+    int difficulty;
+    int har[2];
+    int pilot[2];
+
+    int failed;
+    int winner; // Player index, or -1 for none (timeout)
+    int rounds;
+    int ticks;
+    int round_ticks[MAX_ROUNDS];
+    unsigned int moves[2][MAX_MOVES];
+} match_result;
+
+typedef struct tournament_t {
+    tournament_config *conf;
+    match_result *matches;
+    int match_count;
+    SDL_atomic_t next;
+    SDL_atomic_t done;
+} tournament;
+
+static void tournament_har_hook(har_event event, void *data) {
+    match_result *m = data;
+    if(event.type == HAR_EVENT_ATTACK && event.move->id >= 0 && event.move->id < MAX_MOVES) {
+        m->moves[event.player_id][event.move->id]++;
+    }
+}
+
+static void tournament_play(tournament *t, match_result *m) {
+    engine_init_flags flags;
+    memset(&flags, 0, sizeof(engine_init_flags));
+    flags.net_mode = NET_MODE_NONE;
+
+    // Everything random in this match derives from its own seed
+    rand_seed_streams(m->seed);
+
+    game_state *gs = malloc(sizeof(game_state));
+    game_state_create_headless(gs, &flags);
+
+    for(int i = 0; i < 2; i++) {
+        game_player *player = game_state_get_player(gs, i);
+        controller *ctrl = malloc(sizeof(controller));
+        controller_init(ctrl);
+        ai_controller_create(ctrl, m->difficulty);
+        game_player_set_ctrl(player, ctrl);
+        player->har_id = m->har[i];
+        player->pilot_id = m->pilot[i];
+        chr_score_reset(&player->score, 1);
+
+        pilot pilot_info;
+        pilot_get_info(&pilot_info, player->pilot_id);
+        player->colors[0] = pilot_info.colors[0];
+        player->colors[1] = pilot_info.colors[1];
+        player->colors[2] = pilot_info.colors[2];
+    }
+
+    if(game_load_new(gs, m->arena)) {
+        PERROR("Tournament: Unable to load arena for match with seed %u.", m->seed);
+        m->failed = 1;
+        goto exit_0;
+    }
+    for(int i = 0; i < 2; i++) {
+        har *h = object_get_userdata(game_state_get_player(gs, i)->har);
+        har_install_hook(h, &tournament_har_hook, m);
+    }
+
+    // Fake the engine loop; every pass is one static tick worth of time.
+    // The match is over when the arena asks for the next scene.
+    chr_score *score[2];
+    score[0] = game_player_get_score(game_state_get_player(gs, 0));
+    score[1] = game_player_get_score(game_state_get_player(gs, 1));
+    int dynamic_wait = 0;
+    int last_round_tick = 0;
+    while(gs->run && gs->next_id == gs->this_id && gs->tick < t->conf->max_ticks) {
+        game_state_tick_controllers(gs);
+        game_state_static_tick(gs);
+        dynamic_wait += 10;
+        while(dynamic_wait > game_state_ms_per_dyntick(gs) && gs->next_id == gs->this_id) {
+            game_state_dynamic_tick(gs);
+            dynamic_wait -= game_state_ms_per_dyntick(gs);
+        }
+
+        int rounds = score[0]->rounds + score[1]->rounds;
+        if(rounds != m->rounds && m->rounds < MAX_ROUNDS) {
+            m->round_ticks[m->rounds] = gs->tick - last_round_tick;
+            last_round_tick = gs->tick;
+            m->rounds = rounds;
+        }
+    }
+
+    m->ticks = gs->tick;
+    m->winner = -1;
+    for(int i = 0; i < 2; i++) {
+        if(score[i]->wins > 0) {
+            m->winner = i;
+        }
+    }
+
+exit_0:
+    game_state_free(gs);
+    free(gs);
+}
+
+static int tournament_worker(void *userdata) {
+    tournament *t = userdata;
+    int index;
+    while((index = SDL_AtomicAdd(&t->next, 1)) < t->match_count) {
+        tournament_play(t, &t->matches[index]);
+        int done = SDL_AtomicAdd(&t->done, 1) + 1;
+        if(done % 100 == 0) {
+            INFO("Tournament: %d/%d matches done.", done, t->match_count);
+        }
+    }
+    return 0;
+}
+
+static int tournament_thread(void *userdata) {
+    tournament_worker(userdata);
+
+    // Pools are per thread
+    mem_pool_shared_close();
+    mem_arena_scene_close();
+    return 0;
+}
+
+static void tournament_write_moves(FILE *fp, unsigned int *moves, const char *sep, const char *fmt) {
+    int first = 1;
+    for(int i = 0; i < MAX_MOVES; i++) {
+        if(moves[i] > 0) {
+            fprintf(fp, fmt, first ? "" : sep, i, moves[i]);
+            first = 0;
+        }
+    }
+}
+
+static int tournament_write_csv(tournament *t, FILE *fp) {
+    fprintf(fp, "match,seed,arena,difficulty,har1,pilot1,har2,pilot2,winner,rounds,ticks,round_ticks,moves1,moves2\n");
+    for(int i = 0; i < t->match_count; i++) {
+        match_result *m = &t->matches[i];
+        if(m->failed) {
+            continue;
+        }
+        fprintf(fp, "%d,%u,%d,%s,%s,%s,%s,%s,%d,%d,%d,",
+                i, m->seed, m->arena - SCENE_ARENA0,
+                ai_difficulty_get_name(m->difficulty),
+                har_get_name(m->har[0]), pilot_get_name(m->pilot[0]),
+                har_get_name(m->har[1]), pilot_get_name(m->pilot[1]),
+                m->winner + 1, m->rounds, m->ticks);
+        for(int r = 0; r < m->rounds && r < MAX_ROUNDS; r++) {
+            fprintf(fp, "%s%d", (r > 0) ? ";" : "", m->round_ticks[r]);
+        }
+        for(int p = 0; p < 2; p++) {
+            fprintf(fp, ",");
+            tournament_write_moves(fp, m->moves[p], ";", "%s%d:%u");
+        }
+        fprintf(fp, "\n");
+    }
+    return 0;
+}
+
+static int tournament_write_json(tournament *t, FILE *fp, int *har_matches, int *har_wins) {
+    fprintf(fp, "{\n  \"matches\": [\n");
+    int first = 1;
+    for(int i = 0; i < t->match_count; i++) {
+        match_result *m = &t->matches[i];
+        if(m->failed) {
+            continue;
+        }
+        fprintf(fp, "%s    {\"match\": %d, \"seed\": %u, \"arena\": %d, \"difficulty\": \"%s\", ",
+                first ? "" : ",\n", i, m->seed, m->arena - SCENE_ARENA0,
+                ai_difficulty_get_name(m->difficulty));
+        fprintf(fp, "\"players\": [");
+        for(int p = 0; p < 2; p++) {
+            fprintf(fp, "%s{\"har\": \"%s\", \"pilot\": \"%s\", \"moves\": {",
+                    (p > 0) ? ", " : "", har_get_name(m->har[p]), pilot_get_name(m->pilot[p]));
+            tournament_write_moves(fp, m->moves[p], ", ", "%s\"%d\": %u");
+            fprintf(fp, "}}");
+        }
+        fprintf(fp, "], \"winner\": %d, \"rounds\": %d, \"ticks\": %d, \"round_ticks\": [",
+                m->winner + 1, m->rounds, m->ticks);
+        for(int r = 0; r < m->rounds && r < MAX_ROUNDS; r++) {
+            fprintf(fp, "%s%d", (r > 0) ? ", " : "", m->round_ticks[r]);
+        }
+        fprintf(fp, "]}");
+        first = 0;
+    }
+    fprintf(fp, "\n  ],\n  \"hars\": [\n");
+    for(int i = 0; i < NUMBER_OF_HAR_TYPES; i++) {
+        fprintf(fp, "    {\"har\": \"%s\", \"matches\": %d, \"wins\": %d, \"win_rate\": %.4f}%s\n",
+                har_get_name(i), har_matches[i], har_wins[i],
+                har_matches[i] ? (float)har_wins[i] / har_matches[i] : 0.0f,
+                (i < NUMBER_OF_HAR_TYPES - 1) ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    return 0;
+}
+
+static int tournament_write_report(tournament *t) {
+    // Per-HAR win rates for the log and the JSON summary
+    int har_matches[NUMBER_OF_HAR_TYPES];
+    int har_wins[NUMBER_OF_HAR_TYPES];
+    memset(har_matches, 0, sizeof(har_matches));
+    memset(har_wins, 0, sizeof(har_wins));
+    for(int i = 0; i < t->match_count; i++) {
+        match_result *m = &t->matches[i];
+        if(m->failed) {
+            continue;
+        }
+        for(int p = 0; p < 2; p++) {
+            har_matches[m->har[p]]++;
+            if(m->winner == p) {
+                har_wins[m->har[p]]++;
+            }
+        }
+    }
+    INFO("Tournament results:");
+    for(int i = 0; i < NUMBER_OF_HAR_TYPES; i++) {
+        INFO(" * %-10s %5d/%5d wins", har_get_name(i), har_wins[i], har_matches[i]);
+    }
+
+    const char *filename = t->conf->report_file;
+    if(filename[0] == 0) {
+        return 0;
+    }
+    FILE *fp = fopen(filename, "w");
+    if(fp == NULL) {
+        PERROR("Tournament: Unable to open report file '%s'.", filename);
+        return 1;
+    }
+    size_t len = strlen(filename);
+    if(len > 5 && strcmp(filename + len - 5, ".json") == 0) {
+        tournament_write_json(t, fp, har_matches, har_wins);
+    } else {
+        tournament_write_csv(t, fp);
+    }
+    fclose(fp);
+    INFO("Tournament: Report written to '%s'.", filename);
+    return 0;
+}
+
+int tournament_run(tournament_config *conf) {
+    tournament t;
+    t.conf = conf;
+    SDL_AtomicSet(&t.next, 0);
+    SDL_AtomicSet(&t.done, 0);
+
+    // Build the schedule up front, so that results don't depend on thread timing
+    int diff_first = (conf->difficulty < 0) ? 0 : conf->difficulty;
+    int diff_last = (conf->difficulty < 0) ? NUMBER_OF_AI_DIFFICULTY_TYPES - 1 : conf->difficulty;
+    int repeats = (conf->repeats > 0) ? conf->repeats : 1;
+    t.match_count = NUMBER_OF_HAR_TYPES * NUMBER_OF_HAR_TYPES * (diff_last - diff_first + 1) * repeats;
+    t.matches = malloc(sizeof(match_result) * t.match_count);
+    memset(t.matches, 0, sizeof(match_result) * t.match_count);
+
+    struct random_t sched;
+    random_seed(&sched, conf->seed);
+    int n = 0;
+    for(int d = diff_first; d <= diff_last; d++) {
+        for(int h1 = 0; h1 < NUMBER_OF_HAR_TYPES; h1++) {
+            for(int h2 = 0; h2 < NUMBER_OF_HAR_TYPES; h2++) {
+                for(int r = 0; r < repeats; r++) {
+                    match_result *m = &t.matches[n++];
+                    m->seed = random_intmax(&sched);
+                    m->arena = SCENE_ARENA0 + random_int(&sched, NUMBER_OF_ARENAS);
+                    m->difficulty = d;
+                    m->har[0] = HAR_JAGUAR + h1;
+                    m->har[1] = HAR_JAGUAR + h2;
+                    m->pilot[0] = random_int(&sched, 10);
+                    m->pilot[1] = random_int(&sched, 10);
+                }
+            }
+        }
+    }
+
+    // Shared resources are only read by the workers
+    video_init_headless();
+    if(lang_init()) {
+        goto error_0;
+    }
+    if(fonts_init()) {
+        goto error_1;
+    }
+    if(altpals_init()) {
+        goto error_2;
+    }
+
+    int threads = (conf->threads > 0) ? conf->threads : SDL_GetCPUCount();
+    INFO("Tournament: Running %d matches on %d threads.", t.match_count, threads);
+    unsigned int start = SDL_GetTicks();
+
+    SDL_Thread **workers = malloc(sizeof(SDL_Thread*) * threads);
+    for(int i = 0; i < threads; i++) {
+        workers[i] = SDL_CreateThread(tournament_thread, "tournament worker", &t);
+        if(workers[i] == NULL) {
+            PERROR("Tournament: Unable to start worker thread: %s", SDL_GetError());
+        }
+    }
+    for(int i = 0; i < threads; i++) {
+        if(workers[i] != NULL) {
+            SDL_WaitThread(workers[i], NULL);
+        }
+    }
+    free(workers);
+
+    // If no workers could be started, play on this thread
+    if(SDL_AtomicGet(&t.done) == 0) {
+        tournament_worker(&t);
+    }
+    INFO("Tournament: %d matches done in %u ms.", SDL_AtomicGet(&t.done), SDL_GetTicks() - start);
+
+    int ret = tournament_write_report(&t);
+
+    altpals_close();
+    fonts_close();
+    lang_close();
+    free(t.matches);
+    return ret;
+
+error_2:
+    fonts_close();
+error_1:
+    lang_close();
+error_0:
+    free(t.matches);
+    return 1;
+}
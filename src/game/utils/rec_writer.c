@@ -0,0 +1,191 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#include "game/utils/rec_writer.h"
+#include "utils/log.h"
+
+typedef struct rec_chunk_t {
+    sd_rec_move *moves;
+    unsigned int count;
+    unsigned int size;
+} rec_chunk;
+
+struct rec_writer_t {
+    FILE *fp;
+    char part_file[260]; // Scratch file the chunks are encoded into
+    long part_header; // Header bytes in front of the moves in the scratch file
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    SDL_cond *cond;
+    int running;
+
+    // The game thread fills chunks[cur], the writer has the other one. Guarded by the lock.
+    rec_chunk chunks[2];
+    int cur;
+    unsigned int moves;
+};
+
+static long rec_writer_file_size(const char *filename) {
+    FILE *fp = fopen(filename, "rb");
+    if(fp == NULL) {
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fclose(fp);
+    return size;
+}
+
+// Has libShadowDive encode the moves, and appends everything after the header to our file
+static int rec_writer_encode(rec_writer *w, rec_chunk *chunk) {
+    sd_rec_file rec;
+    FILE *fp = NULL;
+    char buf[1024];
+    size_t len;
+    int ret = 1;
+    sd_rec_create(&rec);
+    for(unsigned int i = 0; i < chunk->count; i++) {
+        if(sd_rec_insert_action(&rec, rec.move_count, &chunk->moves[i]) != SD_SUCCESS) {
+            goto exit_0;
+        }
+    }
+    if(sd_rec_save(&rec, w->part_file) != SD_SUCCESS) {
+        goto exit_0;
+    }
+    fp = fopen(w->part_file, "rb");
+    if(fp == NULL || fseek(fp, w->part_header, SEEK_SET) != 0) {
+        goto exit_1;
+    }
+    while((len = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        if(fwrite(buf, 1, len, w->fp) != len) {
+            goto exit_1;
+        }
+    }
+    // Whole chunks only, so the file on disk always ends on a move
+    ret = (fflush(w->fp) != 0);
+
+exit_1:
+    if(fp != NULL) {
+        fclose(fp);
+    }
+exit_0:
+    sd_rec_free(&rec);
+    return ret;
+}
+
+static int rec_writer_run(void *userdata) {
+    rec_writer *w = userdata;
+    int running = 1;
+    while(running) {
+        SDL_LockMutex(w->lock);
+        if(w->running && w->chunks[w->cur].count < REC_WRITER_CHUNK_MOVES) {
+            SDL_CondWaitTimeout(w->cond, w->lock, REC_WRITER_FLUSH_MS);
+        }
+        running = w->running;
+
+        // Take the chunk the game has been filling, and give it the empty one
+        rec_chunk *chunk = &w->chunks[w->cur];
+        w->cur = !w->cur;
+        SDL_UnlockMutex(w->lock);
+
+        if(chunk->count > 0 && rec_writer_encode(w, chunk)) {
+            PERROR("Recording: Failed to write %u moves!", chunk->count);
+        }
+        chunk->count = 0;
+    }
+    return 0;
+}
+
+rec_writer* rec_writer_open(const char *filename, const sd_rec_file *rec) {
+    sd_rec_file empty;
+    rec_writer *w = malloc(sizeof(rec_writer));
+    memset(w, 0, sizeof(rec_writer));
+    snprintf(w->part_file, sizeof(w->part_file), "%s.part", filename);
+
+    // The header goes out as is. Moves are appended to it from here on.
+    sd_rec_file header = *rec;
+    header.move_count = 0;
+    if(sd_rec_save(&header, filename) != SD_SUCCESS) {
+        PERROR("Recording: Unable to write '%s'.", filename);
+        goto error_0;
+    }
+    sd_rec_create(&empty);
+    int ret = sd_rec_save(&empty, w->part_file);
+    sd_rec_free(&empty);
+    if(ret != SD_SUCCESS || (w->part_header = rec_writer_file_size(w->part_file)) < 0) {
+        PERROR("Recording: Unable to write '%s'.", w->part_file);
+        goto error_0;
+    }
+    if((w->fp = fopen(filename, "ab")) == NULL) {
+        PERROR("Recording: Unable to open '%s' for writing.", filename);
+        goto error_1;
+    }
+
+    w->lock = SDL_CreateMutex();
+    w->cond = SDL_CreateCond();
+    w->running = 1;
+    w->thread = SDL_CreateThread(rec_writer_run, "rec writer", w);
+    if(w->thread == NULL) {
+        PERROR("Recording: Unable to start writer thread: %s", SDL_GetError());
+        goto error_2;
+    }
+    DEBUG("Recording to '%s'.", filename);
+    return w;
+
+error_2:
+    SDL_DestroyCond(w->cond);
+    SDL_DestroyMutex(w->lock);
+    fclose(w->fp);
+error_1:
+    remove(w->part_file);
+error_0:
+    free(w);
+    return NULL;
+}
+
+void rec_writer_add(rec_writer *w, const sd_rec_move *move) {
+    SDL_LockMutex(w->lock);
+    rec_chunk *chunk = &w->chunks[w->cur];
+    if(chunk->count >= chunk->size) {
+        // Doubles, so this only happens until the chunk is big enough for the writer's pace
+        chunk->size = (chunk->size == 0) ? REC_WRITER_CHUNK_MOVES : chunk->size * 2;
+        chunk->moves = realloc(chunk->moves, chunk->size * sizeof(sd_rec_move));
+    }
+    chunk->moves[chunk->count++] = *move;
+    w->moves++;
+    if(chunk->count == REC_WRITER_CHUNK_MOVES) {
+        SDL_CondSignal(w->cond);
+    }
+    SDL_UnlockMutex(w->lock);
+}
+
+void rec_writer_close(rec_writer *w) {
+    if(w == NULL) {
+        return;
+    }
+
+    // The writer takes the last chunk on its way out
+    SDL_LockMutex(w->lock);
+    w->running = 0;
+    SDL_CondSignal(w->cond);
+    SDL_UnlockMutex(w->lock);
+    SDL_WaitThread(w->thread, NULL);
+
+    DEBUG("Recording finished with %u moves.", w->moves);
+    fclose(w->fp);
+    remove(w->part_file);
+    SDL_DestroyCond(w->cond);
+    SDL_DestroyMutex(w->lock);
+    free(w->chunks[0].moves);
+    free(w->chunks[1].moves);
+    free(w);
+}
+
+unsigned int rec_writer_get_moves(rec_writer *w) {
+    SDL_LockMutex(w->lock);
+    unsigned int moves = w->moves;
+    SDL_UnlockMutex(w->lock);
+    return moves;
+}
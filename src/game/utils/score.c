@@ -2,6 +2,7 @@
 #include "game/utils/formatting.h"
 #include "video/surface.h"
 #include "utils/log.h"
+#include "utils/mem_pool.h"
 #include <stdio.h>
 #include <math.h>
 
@@ -27,7 +28,8 @@ float multipliers[] = {
     0.8, // world class
     1.0, // champion
     1.2, // deadly
-    1.4  // ultimate
+    1.4, // ultimate
+    1.6  // lookahead
 };
 
 vec2i interpolate(vec2i start, vec2i end, float fraction) {
@@ -41,7 +43,7 @@ void chr_score_create(chr_score *score) {
     score->x = 0;
     score->y = 0;
     score->direction = OBJECT_FACE_RIGHT;
-    list_create(&score->texts);
+    list_create_with_allocator(&score->texts, mem_pool_allocator());
     chr_score_reset(score, 1);
     chr_score_reset_wins(score);
 }
@@ -301,7 +303,7 @@ void chr_score_unserialize(chr_score *score, serial *ser) {
 
     // clean it out
     chr_score_free(score);
-    list_create(&score->texts);
+    list_create_with_allocator(&score->texts, mem_pool_allocator());
 
     for (int i = 0; i < count; i++) {
         text_len = serial_read_int8(ser);
@@ -27,22 +27,26 @@ float ntohf(float val) {
     return val;
 }
 
-// TODO we should probably have some reasonable initial size, so we don't realloc like crazy
+#define SERIAL_MIN_SIZE 64
+
 void serial_create(serial *s) {
     s->len = 0;
     s->rpos = 0;
+    s->wsize = 0;
     s->data = NULL;
 }
 
-// TODO: Optimize writing
 void serial_write(serial *s, const char *buf, int len) {
-    if(s->data == NULL) {
-        s->data = malloc(len);
-        memcpy(s->data, buf, len);
-    } else {
-        s->data = realloc(s->data, s->len + len);
-        memcpy(s->data + s->len, buf, len);
+    // Grow geometrically, so that serializing many small fields stays cheap
+    if(s->len + len > s->wsize) {
+        size_t size = (s->wsize > 0) ? s->wsize * 2 : SERIAL_MIN_SIZE;
+        while(size < s->len + len) {
+            size *= 2;
+        }
+        s->data = realloc(s->data, size);
+        s->wsize = size;
     }
+    memcpy(s->data + s->len, buf, len);
     s->len += len;
 }
 
@@ -71,9 +75,16 @@ void serial_free(serial *s) {
         s->data = NULL;
         s->len = 0;
         s->rpos = 0;
+        s->wsize = 0;
     }
 }
 
+// Empties the buffer but keeps the allocation around for reuse
+void serial_reset(serial *s) {
+    s->len = 0;
+    s->rpos = 0;
+}
+
 size_t serial_len(serial *s) {
     return s->len;
 }
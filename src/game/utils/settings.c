@@ -63,6 +63,7 @@ const field f_sound[] = {
     F_INT(settings_sound,  sound_vol,         5),
     F_INT(settings_sound,  music_vol,         5),
     F_INT(settings_sound,  music_frequency,   44100),
+    F_INT(settings_sound,  music_cache_size,  0),
 #if USE_DUMB
     F_INT(settings_sound, music_library,      0),
     F_INT(settings_sound, music_resampler,    2),
@@ -144,7 +145,15 @@ const field f_keyboard[] = {
 const field f_net[] = {
     F_STRING(settings_network, net_connect_ip,   "localhost"),
     F_INT(settings_network,    net_connect_port, 2097),
-    F_INT(settings_network,    net_listen_port, 2097)
+    F_INT(settings_network,    net_listen_port, 2097),
+    F_INT(settings_network,    net_emu_latency, 0),
+    F_INT(settings_network,    net_emu_jitter, 0),
+    F_INT(settings_network,    net_emu_loss, 0),
+    F_INT(settings_network,    net_emu_duplicate, 0),
+    F_INT(settings_network,    net_emu_reorder, 0),
+    F_INT(settings_network,    net_emu_seed, 0),
+    F_INT(settings_network,    net_relay_port, 0),
+    F_INT(settings_network,    net_relay_spectators, 32)
 };
 
 // Map struct to field
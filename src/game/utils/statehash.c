@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "game/utils/statehash.h"
+#include "game/utils/serial.h"
+#include "game/game_player.h"
+#include "resources/ids.h"
+#include "utils/flatmap.h"
+#include "utils/log.h"
+
+#define FNV_32_PRIME ((uint32_t)0x01000193)
+#define FNV1_32_INIT ((uint32_t)2166136261)
+
+typedef struct statehash_t {
+    int mode;
+    int interval;
+    FILE *fp;
+    flatmap reference;
+    unsigned int checked;
+    unsigned int last_match;
+    int divergent_tick;
+} statehash;
+
+static statehash *sh = NULL;
+
+uint32_t statehash_data(const char *buf, unsigned int len) {
+    uint32_t hval = FNV1_32_INIT;
+    for(unsigned int i = 0; i < len; i++) {
+        hval ^= (uint8_t)buf[i];
+        hval *= FNV_32_PRIME;
+    }
+    return hval;
+}
+
+static int statehash_load_reference(const char *filename) {
+    FILE *fp = fopen(filename, "r");
+    if(fp == NULL) {
+        PERROR("Statehash: Unable to open reference file '%s'.", filename);
+        return 1;
+    }
+    unsigned int tick;
+    uint32_t hash;
+    unsigned int count = 0;
+    while(fscanf(fp, "%u %x", &tick, &hash) == 2) {
+        flatmap_iput(&sh->reference, tick, &hash);
+        count++;
+    }
+    fclose(fp);
+    DEBUG("Statehash: Loaded %u reference hashes from '%s'.", count, filename);
+    return 0;
+}
+
+int statehash_init(int mode, const char *filename, int interval) {
+    if(mode == STATEHASH_OFF) {
+        return 0;
+    }
+    sh = malloc(sizeof(statehash));
+    sh->mode = mode;
+    sh->interval = (interval > 0) ? interval : STATEHASH_DEFAULT_INTERVAL;
+    sh->fp = NULL;
+    sh->checked = 0;
+    sh->last_match = 0;
+    sh->divergent_tick = -1;
+    flatmap_create(&sh->reference, sizeof(unsigned int), sizeof(uint32_t));
+
+    if(mode == STATEHASH_LOG) {
+        sh->fp = fopen(filename, "w");
+        if(sh->fp == NULL) {
+            PERROR("Statehash: Unable to open '%s' for writing.", filename);
+            goto error_0;
+        }
+    } else if(statehash_load_reference(filename)) {
+        goto error_0;
+    }
+
+    INFO("Statehash: %s state hashes every %d ticks.",
+         (mode == STATEHASH_LOG) ? "Logging" : "Verifying",
+         sh->interval);
+    return 0;
+
+error_0:
+    flatmap_free(&sh->reference);
+    free(sh);
+    sh = NULL;
+    return 1;
+}
+
+uint32_t statehash_compute(game_state *gs) {
+    serial ser;
+    serial_create(&ser);
+    game_state_serialize(gs, &ser);
+    uint32_t hash = statehash_data(ser.data, ser.len);
+    serial_free(&ser);
+    return hash;
+}
+
+void statehash_tick(game_state *gs) {
+    if(sh == NULL) {
+        return;
+    }
+
+    // State can only be serialized while both HARs exist
+    if(!is_arena(gs->this_id)
+        || game_state_get_player(gs, 0)->har == NULL
+        || game_state_get_player(gs, 1)->har == NULL) {
+        return;
+    }
+
+    unsigned int tick = game_state_get_tick(gs);
+    if(tick % sh->interval != 0) {
+        return;
+    }
+
+    uint32_t hash = statehash_compute(gs);
+    if(sh->mode == STATEHASH_LOG) {
+        fprintf(sh->fp, "%u %08x\n", tick, hash);
+        return;
+    }
+
+    uint32_t *expected = flatmap_iget(&sh->reference, tick);
+    if(expected == NULL) {
+        return;
+    }
+    sh->checked++;
+    if(*expected == hash) {
+        sh->last_match = tick;
+    } else if(sh->divergent_tick == -1) {
+        sh->divergent_tick = tick;
+        PERROR("Statehash: State diverged at tick %u (last match at tick %u): expected %08x, got %08x.",
+               tick, sh->last_match, *expected, hash);
+    }
+}
+
+int statehash_divergent_tick() {
+    return (sh != NULL) ? sh->divergent_tick : -1;
+}
+
+void statehash_close() {
+    if(sh == NULL) {
+        return;
+    }
+    if(sh->mode == STATEHASH_VERIFY) {
+        if(sh->divergent_tick == -1) {
+            INFO("Statehash: %u hashes checked, no divergence.", sh->checked);
+        } else {
+            INFO("Statehash: %u hashes checked, first divergence at tick %d.", sh->checked, sh->divergent_tick);
+        }
+    }
+    if(sh->fp) {
+        fclose(sh->fp);
+    }
+    flatmap_free(&sh->reference);
+    free(sh);
+    sh = NULL;
+}
@@ -15,12 +15,20 @@
 #include "utils/msgbox.h"
 #include "game/game_state.h"
 #include "game/utils/settings.h"
+#include "game/utils/statehash.h"
+#include "game/tournament.h"
+#include "game/match_server.h"
+#include "game/replay.h"
 #include "resources/pathmanager.h"
 #include "resources/ids.h"
 #include "resources/sgmanager.h"
+#include "video/render_report.h"
+#include "controller/net_emu.h"
+#include "controller/net_thread.h"
 #include "plugins/plugins.h"
 #include "controller/gamecontrollerdb.h"
 #include "utils/compat.h"
+#include "utils/memtrack.h"
 
 #ifndef SHA1_HASH
     const char *git_sha1_hash = "";
@@ -28,15 +36,33 @@
     const char *git_sha1_hash = SHA1_HASH;
 #endif
 
+// Lets ENet packets and peers show up in the memory accounting
+static void* net_malloc(size_t size) {
+    return MEM_ALLOC(MEM_TAG_NET, size);
+}
+
+static void net_free(void *ptr) {
+    MEM_FREE(ptr);
+}
+
 int main(int argc, char *argv[]) {
     // Set up initial state for misc things
     char *ip = NULL;
     unsigned short connect_port = 0;
     unsigned short listen_port = 0;
+    unsigned short relay_port = 0;
     engine_init_flags init_flags;
     init_flags.net_mode = NET_MODE_NONE;
     init_flags.record = 0;
     memset(init_flags.rec_file, 0, 255);
+    memset(init_flags.capture_file, 0, 255);
+    init_flags.hash_mode = STATEHASH_OFF;
+    init_flags.hash_interval = STATEHASH_DEFAULT_INTERVAL;
+    memset(init_flags.hash_file, 0, 255);
+    memset(init_flags.trace_file, 0, 255);
+    memset(init_flags.render_report, 0, 255);
+    init_flags.render_frames = 0;
+    init_flags.render_scene_count = 0;
     int ret = 0;
 
     // Path manager
@@ -53,8 +79,28 @@ int main(int argc, char *argv[]) {
     struct arg_int *port = arg_int0("p", "port", "<port>","Port to connect or listen (default: 2097)");
     struct arg_file *play = arg_file0("P", "play", "<file>", "Play an existing recfile");
     struct arg_file *rec = arg_file0("R", "rec", "<file>", "Record a new recfile");
+    struct arg_file *capture = arg_file0("C", "capture", "<file>", "Capture rendered frames to a file, or to images if the name has a %u in it");
+    struct arg_file *hashlog = arg_file0(NULL, "hashlog", "<file>", "Log game state hashes to a file");
+    struct arg_file *hashcheck = arg_file0(NULL, "hashcheck", "<file>", "Verify game state hashes against a hashlog");
+    struct arg_int *hashint = arg_int0(NULL, "hashinterval", "<ticks>", "Ticks between state hashes (default: 10)");
+    struct arg_int *seed = arg_int0(NULL, "seed", "<seed>", "Random seed (default: current time)");
+    struct arg_int *tourney = arg_int0(NULL, "tournament", "<n>", "Run a headless AI tournament, n matches per HAR pairing");
+    struct arg_int *tdiff = arg_int0(NULL, "difficulty", "<n>", "Tournament AI difficulty 0-6 (default: all)");
+    struct arg_int *threads = arg_int0(NULL, "threads", "<n>", "Tournament or server worker threads (default: one per core)");
+    struct arg_file *report = arg_file0(NULL, "report", "<file>", "Tournament report file (.csv or .json), or server match report (.csv)");
+    struct arg_file *verify = arg_file0(NULL, "verify", "<file>", "Play a recfile headless and print the final state hash");
+    struct arg_file *trace = arg_file0(NULL, "trace", "<file>", "Write a Chrome trace of profiler zones (profiler builds only)");
+    struct arg_file *offscreen = arg_file0(NULL, "offscreen", "<file>", "Render without a window; write frame times and hashes to a file (.csv or .json)");
+    struct arg_str *scenes = arg_str0(NULL, "scenes", "<ids>", "Offscreen: comma separated scene ids to render in order");
+    struct arg_int *frames = arg_int0(NULL, "frames", "<n>", "Offscreen: frames to render per scene (default: 300) or from a recording");
+    struct arg_str *netemu = arg_str0(NULL, "netemu", "<spec>", "Emulate network conditions, eg. latency=80,jitter=20,loss=5,duplicate=1,reorder=2,seed=1");
+    struct arg_str *spectate = arg_str0(NULL, "spectate", "<host>", "Watch a network game relayed by a remote host");
+    struct arg_int *relay = arg_int0(NULL, "relay", "<port>", "Relay hosted network games to spectators on this port");
+    struct arg_int *matches = arg_int0(NULL, "matches", "<n>", "Server: most matches at once (default: 64)");
     struct arg_end *end = arg_end(30);
-    void* argtable[] = {help, vers, listen, connect, port, play, rec, end};
+    void* argtable[] = {help, vers, listen, connect, port, play, rec, capture, hashlog, hashcheck, hashint, seed,
+                        tourney, tdiff, threads, report, verify, trace, offscreen, scenes, frames, netemu,
+                        spectate, relay, matches, end};
     const char* progname = "openomf";
 
     // Make sure everything got allocated
@@ -105,6 +151,13 @@ int main(int argc, char *argv[]) {
             listen_port = port->ival[0] & 0xFFFF;
         }
     }
+    else if(spectate->count > 0) {
+        init_flags.net_mode = NET_MODE_SPECTATOR;
+        ip = strdup(spectate->sval[0]);
+        if(port->count > 0) {
+            relay_port = port->ival[0] & 0xFFFF;
+        }
+    }
     else if(play->count > 0) {
         strncpy(init_flags.rec_file, play->filename[0], 254);
     }
@@ -112,6 +165,58 @@ int main(int argc, char *argv[]) {
         init_flags.record = 1;
         strncpy(init_flags.rec_file, rec->filename[0], 254);
     }
+    if(capture->count > 0) {
+        strncpy(init_flags.capture_file, capture->filename[0], 254);
+    }
+    if(hashlog->count > 0) {
+        init_flags.hash_mode = STATEHASH_LOG;
+        strncpy(init_flags.hash_file, hashlog->filename[0], 254);
+    }
+    else if(hashcheck->count > 0) {
+        init_flags.hash_mode = STATEHASH_VERIFY;
+        strncpy(init_flags.hash_file, hashcheck->filename[0], 254);
+    }
+    if(trace->count > 0) {
+        strncpy(init_flags.trace_file, trace->filename[0], 254);
+    }
+    if(hashint->count > 0) {
+        init_flags.hash_interval = hashint->ival[0];
+    }
+    if(offscreen->count > 0) {
+        strncpy(init_flags.render_report, offscreen->filename[0], 254);
+        if(scenes->count > 0) {
+            char *ids = strdup(scenes->sval[0]);
+            for(char *tok = strtok(ids, ","); tok != NULL; tok = strtok(NULL, ",")) {
+                int id = atoi(tok);
+                if(!is_scene(id) || init_flags.render_scene_count >= MAX_RENDER_SCENES) {
+                    fprintf(stderr, "Error: Invalid scene list '%s'.\n", scenes->sval[0]);
+                    free(ids);
+                    goto exit_0;
+                }
+                init_flags.render_scenes[init_flags.render_scene_count++] = id;
+            }
+            free(ids);
+        }
+        // Recordings play to the end unless a frame count is given
+        if(frames->count > 0) {
+            init_flags.render_frames = frames->ival[0];
+        } else if(play->count == 0 || scenes->count > 0) {
+            init_flags.render_frames = RENDER_REPORT_DEFAULT_FRAMES;
+        }
+        if(init_flags.render_frames <= 0 && init_flags.render_scene_count > 0) {
+            fprintf(stderr, "Error: Frames per scene must be positive.\n");
+            goto exit_0;
+        }
+    }
+
+    if(netemu->count > 0) {
+        net_emu_config conf;
+        memset(&conf, 0, sizeof(net_emu_config));
+        if(net_emu_config_parse(&conf, netemu->sval[0])) {
+            fprintf(stderr, "Error: Invalid network emulation spec '%s'.\n", netemu->sval[0]);
+            goto exit_0;
+        }
+    }
 
     // Init log
 #if defined(DEBUGMODE) || defined(STANDALONE_SERVER)
@@ -137,8 +242,15 @@ int main(int argc, char *argv[]) {
     // Dump pathmanager log
     pm_log();
 
-    // Random seed
-    rand_seed(time(NULL));
+    // Random seed. Runs that are compared by state hashes need a fixed seed.
+    if(seed->count > 0) {
+        rand_seed_streams(seed->ival[0]);
+    } else if(init_flags.hash_mode != STATEHASH_OFF || verify->count > 0) {
+        INFO("No random seed given for state hashing, using 0.");
+        rand_seed_streams(0);
+    } else {
+        rand_seed_streams(time(NULL));
+    }
 
     // Init config
     if(settings_init(pm_get_local_path(CONFIG_PATH))) {
@@ -168,11 +280,34 @@ int main(int argc, char *argv[]) {
         DEBUG("Listen Port overridden to %u", listen_port&0xFFFF);
         settings_get()->net.net_listen_port = listen_port;
     }
+    if(relay->count > 0) {
+        relay_port = relay->ival[0] & 0xFFFF;
+    }
+    if(relay_port > 0 && relay_port < 0xFFFF) {
+        DEBUG("Relay Port overridden to %u", relay_port&0xFFFF);
+        settings_get()->net.net_relay_port = relay_port;
+    }
+    if(netemu->count > 0) {
+        // Keys that aren't given keep their settings values
+        settings_network *net = &settings_get()->net;
+        net_emu_config conf = {net->net_emu_latency, net->net_emu_jitter, net->net_emu_loss,
+                               net->net_emu_duplicate, net->net_emu_reorder, net->net_emu_seed};
+        net_emu_config_parse(&conf, netemu->sval[0]);
+        DEBUG("Network emulation overridden to %s", netemu->sval[0]);
+        net->net_emu_latency = conf.latency;
+        net->net_emu_jitter = conf.jitter;
+        net->net_emu_loss = conf.loss;
+        net->net_emu_duplicate = conf.duplicate;
+        net->net_emu_reorder = conf.reorder;
+        net->net_emu_seed = conf.seed;
+    }
 
     // Init SDL2
     unsigned int sdl_flags = SDL_INIT_TIMER;
 #ifndef STANDALONE_SERVER
-    sdl_flags |= SDL_INIT_VIDEO;
+    if(tourney->count == 0 && verify->count == 0 && offscreen->count == 0) {
+        sdl_flags |= SDL_INIT_VIDEO;
+    }
 #endif
     if(SDL_Init(sdl_flags)) {
         err_msgbox("SDL2 Initialization failed: %s", SDL_GetError());
@@ -233,14 +368,59 @@ int main(int argc, char *argv[]) {
 
 #endif // STANDALONE_SERVER
 
+    // Headless tournament mode skips the engine entirely
+    if(tourney->count > 0) {
+        tournament_config tconf;
+        memset(&tconf, 0, sizeof(tournament_config));
+        tconf.repeats = tourney->ival[0];
+        tconf.difficulty = (tdiff->count > 0) ? tdiff->ival[0] : -1;
+        tconf.threads = (threads->count > 0) ? threads->ival[0] : 0;
+        tconf.max_ticks = TOURNAMENT_DEFAULT_MAX_TICKS;
+        tconf.seed = (seed->count > 0) ? seed->ival[0] : time(NULL);
+        if(report->count > 0) {
+            strncpy(tconf.report_file, report->filename[0], 254);
+        }
+        tournament_run(&tconf);
+        goto exit_3;
+    }
+
+    // Headless recording check; prints the hash so that runs can be compared
+    if(verify->count > 0) {
+        uint32_t hash;
+        unsigned int ticks;
+        if(replay_verify(verify->filename[0], &hash, &ticks)) {
+            ret = 1;
+        } else {
+            printf("%s: tick %u, state hash %08x\n", verify->filename[0], ticks, hash);
+        }
+        goto exit_3;
+    }
+
     // Init enet
-    if(enet_initialize() != 0) {
+    ENetCallbacks enet_callbacks = {net_malloc, net_free, NULL};
+    if(enet_initialize_with_callbacks(ENET_VERSION, &enet_callbacks) != 0) {
         err_msgbox("Failed to initialize enet");
         goto exit_3;
     }
 
+#ifdef STANDALONE_SERVER
+    // The server hosts matches until it is interrupted; there is no engine
+    match_server_config sconf;
+    memset(&sconf, 0, sizeof(match_server_config));
+    sconf.port = (port->count > 0) ? (port->ival[0] & 0xFFFF) : settings_get()->net.net_listen_port;
+    sconf.max_matches = (matches->count > 0) ? matches->ival[0] : MATCH_SERVER_DEFAULT_MATCHES;
+    sconf.threads = (threads->count > 0) ? threads->ival[0] : 0;
+    sconf.max_ticks = MATCH_SERVER_DEFAULT_MAX_TICKS;
+    sconf.seed = (seed->count > 0) ? seed->ival[0] : time(NULL);
+    if(report->count > 0) {
+        strncpy(sconf.report_file, report->filename[0], 254);
+    }
+    ret = match_server_run(&sconf);
+    goto exit_4;
+#endif // STANDALONE_SERVER
+
     // Initialize engine
-    if(engine_init()) {
+    if(engine_init(&init_flags)) {
         err_msgbox("Failed to initialize game engine.");
         goto exit_4;
     }
@@ -251,7 +431,15 @@ int main(int argc, char *argv[]) {
     // Close everything
     engine_close();
 exit_4:
+    // Give connections that are still saying goodbye a chance to finish.
+    // The rest are cut short; no network thread may outlive ENet or the log.
+    if(net_thread_wait_closed(NET_THREAD_DISCONNECT_MS) > 0) {
+        DEBUG("Some network connections were not closed cleanly.");
+    }
     enet_deinitialize();
+
+    // Only now is everything that could hold tracked memory gone
+    memtrack_report();
 exit_3:
     SDL_Quit();
 exit_2:
@@ -1,5 +1,7 @@
 #include "resources/af_loader.h"
 #include "resources/pathmanager.h"
+#include "utils/profiler.h"
+#include "utils/memtrack.h"
 #include <shadowdive/shadowdive.h>
 
 int load_af_file(af *a, int id) {
@@ -11,13 +13,18 @@ int load_af_file(af *a, int id) {
     if(sd_af_create(&tmp) != SD_SUCCESS) {
         return 1;
     }
+    PROFILE_BEGIN("af load");
     if(sd_af_load(&tmp, filename) != SD_SUCCESS) {
+        PROFILE_END();
         sd_af_free(&tmp);
         return 1;
     }
 
     // Convert
+    MEM_SCOPE_BEGIN(MEM_TAG_RESOURCES);
     af_create(a, &tmp);
+    MEM_SCOPE_END();
     sd_af_free(&tmp);
+    PROFILE_END();
     return 0;
 }
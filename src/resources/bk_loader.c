@@ -1,5 +1,7 @@
 #include "resources/bk_loader.h"
 #include "resources/pathmanager.h"
+#include "utils/profiler.h"
+#include "utils/memtrack.h"
 #include <shadowdive/shadowdive.h>
 
 int load_bk_file(bk *b, int id) {
@@ -11,13 +13,18 @@ int load_bk_file(bk *b, int id) {
     if(sd_bk_create(&tmp) != SD_SUCCESS) {
         return 1;
     }
+    PROFILE_BEGIN("bk load");
     if(sd_bk_load(&tmp, filename) != SD_SUCCESS) {
+        PROFILE_END();
         sd_bk_free(&tmp);
         return 1;
     }
 
     // Convert
+    MEM_SCOPE_BEGIN(MEM_TAG_RESOURCES);
     bk_create(b, &tmp);
+    MEM_SCOPE_END();
     sd_bk_free(&tmp);
+    PROFILE_END();
     return 0;
 }
@@ -2,6 +2,7 @@
 
 #include "utils/log.h"
 #include "utils/vector.h"
+#include "utils/memtrack.h"
 #include "video/surface.h"
 #include "resources/ids.h"
 #include "resources/fonts.h"
@@ -74,6 +75,7 @@ int fonts_init() {
     font_create(&font_small);
     font_create(&font_large);
     const char *filename = NULL;
+    MEM_SCOPE_BEGIN(MEM_TAG_RESOURCES);
 
     // Load small font
     filename = pm_get_resource_path(DAT_CHARSMAL);
@@ -92,6 +94,7 @@ int fonts_init() {
     INFO("Loaded font file '%s'", filename);
 
     // All done.
+    MEM_SCOPE_END();
     fonts_loaded = 1;
     return 0;
 
@@ -99,6 +102,7 @@ error_2:
     font_free(&font_small);
 error_1:
     font_free(&font_large);
+    MEM_SCOPE_END();
     return 1;
 }
 
@@ -49,6 +49,10 @@ int sounds_loader_get(int id, char **buffer, int *len) {
     return 0; // Success
 }
 
+int sounds_loader_count() {
+    return (sound_data != NULL) ? SD_SOUNDS_MAX : 0;
+}
+
 void sounds_loader_close() {
     if(sound_data != NULL) {
         sd_sounds_free(sound_data);
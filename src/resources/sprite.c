@@ -2,11 +2,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include "resources/sprite.h"
+#include "video/video.h"
 
 void sprite_create_custom(sprite *sp, vec2i pos, surface *data) {
     sp->id = -1;
     sp->pos = pos;
     sp->data = data;
+    memset(sp->shadows, 0, sizeof(sp->shadows));
 }
 
 void sprite_create(sprite *sp, void *src, int id) {
@@ -14,6 +16,7 @@ void sprite_create(sprite *sp, void *src, int id) {
     sp->id = id;
     sp->pos = vec2i_create(sdsprite->pos_x, sdsprite->pos_y);
     sp->data = malloc(sizeof(surface));
+    memset(sp->shadows, 0, sizeof(sp->shadows));
 
     // Load data
     sd_vga_image raw;
@@ -27,6 +30,13 @@ void sprite_free(sprite *sp) {
     surface_free(sp->data);
     free(sp->data);
     sp->data = NULL;
+    for(int i = 0; i < 4; i++) {
+        if(sp->shadows[i] != NULL) {
+            surface_free(sp->shadows[i]);
+            free(sp->shadows[i]);
+            sp->shadows[i] = NULL;
+        }
+    }
 }
 
 vec2i sprite_get_size(sprite *sp) {
@@ -36,12 +46,29 @@ vec2i sprite_get_size(sprite *sp) {
     return vec2i_create(0,0);
 }
 
+surface* sprite_get_shadow(sprite *sp, unsigned int flip_mode) {
+    int h = sp->data->h * SPRITE_SHADOW_SCALE;
+    if(h == 0) {
+        return NULL;
+    }
+    int i = flip_mode & (FLIP_HORIZONTAL|FLIP_VERTICAL);
+    if(sp->shadows[i] == NULL) {
+        SDL_RendererFlip flip = 0;
+        if(flip_mode & FLIP_HORIZONTAL) flip |= SDL_FLIP_HORIZONTAL;
+        if(flip_mode & FLIP_VERTICAL) flip |= SDL_FLIP_VERTICAL;
+        sp->shadows[i] = malloc(sizeof(surface));
+        surface_create_shadow(sp->shadows[i], sp->data, h, flip, SPRITE_SHADOW_OPACITY);
+    }
+    return sp->shadows[i];
+}
+
 sprite* sprite_copy(sprite *src) {
     if(src == NULL) return NULL;
 
     sprite *new = malloc(sizeof(sprite));
     new->pos = src->pos;
     new->id = src->id;
+    memset(new->shadows, 0, sizeof(new->shadows));
 
     // Copy surface
     new->data = malloc(sizeof(surface));
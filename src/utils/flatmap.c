@@ -0,0 +1,409 @@
+#include "utils/flatmap.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FLATMAP_MIN_CAPACITY 16
+#define ROTL32(x, r) (((x) << (r)) | ((x) >> (32 - (r))))
+#define ALIGN8(x) (((x) + 7) & ~7u)
+
+// Every slot starts with this header, followed by the key and the value.
+// Probe distance is counted from 1, so a distance of 0 marks an empty slot.
+typedef struct flatmap_slot_t {
+    uint32_t dist;
+    uint32_t hash;
+} flatmap_slot;
+
+#define SLOT(fm, i) ((flatmap_slot*)((fm)->slots + (size_t)(i) * (fm)->slotlen))
+#define SLOT_KEY(s) ((char*)(s) + sizeof(flatmap_slot))
+#define SLOT_VAL(fm, s) ((char*)(s) + (fm)->valoffset)
+
+// Spare slots after the table, used for swapping entries around while inserting
+#define SCRATCH(fm, n) SLOT(fm, (fm)->capacity + (n))
+
+static uint32_t flatmap_hash_int(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+static uint32_t flatmap_hash_word(uint32_t k) {
+    k *= 0xcc9e2d51;
+    k = ROTL32(k, 15);
+    return k * 0x1b873593;
+}
+
+// Murmur3; hashes a word at a time instead of a byte at a time like FNV
+static uint32_t flatmap_hash(const flatmap *fm, const void *key) {
+    if(fm->keylen == sizeof(unsigned int)) {
+        unsigned int k;
+        memcpy(&k, key, sizeof(unsigned int));
+        return flatmap_hash_int(k);
+    }
+    const unsigned char *bp = key;
+    unsigned int words = fm->keylen / 4;
+    uint32_t h = 0;
+    uint32_t k;
+    for(unsigned int i = 0; i < words; i++) {
+        memcpy(&k, bp + i * 4, 4);
+        h ^= flatmap_hash_word(k);
+        h = ROTL32(h, 13);
+        h = h * 5 + 0xe6546b64;
+    }
+    k = 0;
+    for(unsigned int i = words * 4; i < fm->keylen; i++) {
+        k = (k << 8) | bp[i];
+    }
+    h ^= flatmap_hash_word(k);
+    h ^= fm->keylen;
+    return flatmap_hash_int(h);
+}
+
+static void flatmap_alloc_slots(flatmap *fm, unsigned int capacity) {
+    size_t size = (size_t)(capacity + 2) * fm->slotlen;
+    fm->slots = fm->alloc.cmalloc(size);
+    memset(fm->slots, 0, size);
+    fm->capacity = capacity;
+}
+
+// Places an entry that is known not to be in the map yet. The slot must have its
+// hash set, and its distance set to 1. Returns the slot the entry ended up in.
+static flatmap_slot* flatmap_insert_new(flatmap *fm, flatmap_slot *in) {
+    unsigned int mask = fm->capacity - 1;
+    unsigned int index = in->hash & mask;
+    flatmap_slot *carry = SCRATCH(fm, 0);
+    flatmap_slot *tmp = SCRATCH(fm, 1);
+    flatmap_slot *placed = NULL;
+    if(in != carry) {
+        memcpy(carry, in, fm->slotlen);
+    }
+    fm->reserved++;
+    for(;;) {
+        flatmap_slot *s = SLOT(fm, index);
+        if(s->dist == 0) {
+            memcpy(s, carry, fm->slotlen);
+            return (placed != NULL) ? placed : s;
+        }
+
+        // Robin Hood: take the place of any entry that is closer to its home slot,
+        // and carry on inserting that one instead.
+        if(s->dist < carry->dist) {
+            memcpy(tmp, s, fm->slotlen);
+            memcpy(s, carry, fm->slotlen);
+            memcpy(carry, tmp, fm->slotlen);
+            if(placed == NULL) {
+                placed = s;
+            }
+        }
+        carry->dist++;
+        index = (index + 1) & mask;
+    }
+}
+
+static void flatmap_resize(flatmap *fm, unsigned int capacity) {
+    char *old = fm->slots;
+    unsigned int old_capacity = fm->capacity;
+    flatmap_alloc_slots(fm, capacity);
+    fm->reserved = 0;
+    for(unsigned int i = 0; i < old_capacity; i++) {
+        flatmap_slot *s = (flatmap_slot*)(old + (size_t)i * fm->slotlen);
+        if(s->dist != 0) {
+            s->dist = 1;
+            flatmap_insert_new(fm, s);
+        }
+    }
+    fm->alloc.cfree(old);
+}
+
+static flatmap_slot* flatmap_find(const flatmap *fm, const void *key, uint32_t hash) {
+    unsigned int mask = fm->capacity - 1;
+    unsigned int index = hash & mask;
+    for(uint32_t dist = 1;; dist++) {
+        flatmap_slot *s = SLOT(fm, index);
+
+        // An entry this far from home would have taken this slot
+        if(s->dist < dist) {
+            return NULL;
+        }
+        if(s->hash == hash && memcmp(SLOT_KEY(s), key, fm->keylen) == 0) {
+            return s;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+static flatmap_slot* flatmap_ifind(const flatmap *fm, unsigned int key) {
+    uint32_t hash = flatmap_hash_int(key);
+    unsigned int mask = fm->capacity - 1;
+    unsigned int index = hash & mask;
+    for(uint32_t dist = 1;; dist++) {
+        flatmap_slot *s = SLOT(fm, index);
+        if(s->dist < dist) {
+            return NULL;
+        }
+        if(s->hash == hash && *(unsigned int*)SLOT_KEY(s) == key) {
+            return s;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+// Removes the entry in the slot, and shifts the entries after it back by one
+static void flatmap_remove(flatmap *fm, flatmap_slot *s) {
+    unsigned int mask = fm->capacity - 1;
+    unsigned int index = ((char*)s - fm->slots) / fm->slotlen;
+    for(;;) {
+        unsigned int next = (index + 1) & mask;
+        flatmap_slot *n = SLOT(fm, next);
+        if(n->dist <= 1) {
+            SLOT(fm, index)->dist = 0;
+            break;
+        }
+        memcpy(SLOT(fm, index), n, fm->slotlen);
+        SLOT(fm, index)->dist--;
+        index = next;
+    }
+    fm->reserved--;
+}
+
+static void* flatmap_put_hashed(flatmap *fm, const void *key, uint32_t hash, const void *val) {
+    flatmap_slot *s = flatmap_find(fm, key, hash);
+    if(s != NULL) {
+        memcpy(SLOT_VAL(fm, s), val, fm->vallen);
+        return SLOT_VAL(fm, s);
+    }
+    if((fm->reserved + 1) * 8 > fm->capacity * 7) {
+        flatmap_resize(fm, fm->capacity * 2);
+    }
+    flatmap_slot *in = SCRATCH(fm, 0);
+    in->dist = 1;
+    in->hash = hash;
+    memcpy(SLOT_KEY(in), key, fm->keylen);
+    memcpy(SLOT_VAL(fm, in), val, fm->vallen);
+    return SLOT_VAL(fm, flatmap_insert_new(fm, in));
+}
+
+/** \brief Creates a new flatmap with an allocator
+  *
+  * \param fm Allocated flatmap pointer
+  * \param keylen Size of every key in bytes
+  * \param vallen Size of every value in bytes
+  * \param alloc Allocation functions
+  */
+void flatmap_create_with_allocator(flatmap *fm, unsigned int keylen, unsigned int vallen, allocator alloc) {
+    fm->alloc = alloc;
+    fm->keylen = keylen;
+    fm->vallen = vallen;
+    fm->valoffset = ALIGN8(sizeof(flatmap_slot) + keylen);
+    fm->slotlen = ALIGN8(fm->valoffset + vallen);
+    fm->reserved = 0;
+    fm->cursor.keylen = keylen;
+    fm->cursor.vallen = vallen;
+    fm->cursor.key = NULL;
+    fm->cursor.val = NULL;
+    flatmap_alloc_slots(fm, FLATMAP_MIN_CAPACITY);
+}
+
+/** \brief Creates a new flatmap
+  *
+  * Creates a new flatmap for keys and values of a fixed size. Both are copied
+  * into the map. Maps with keys of sizeof(unsigned int) can use the faster
+  * flatmap_iput, flatmap_iget and flatmap_idel functions.
+  *
+  * \param fm Allocated flatmap pointer
+  * \param keylen Size of every key in bytes
+  * \param vallen Size of every value in bytes
+  */
+void flatmap_create(flatmap *fm, unsigned int keylen, unsigned int vallen) {
+    allocator alloc;
+    alloc.cmalloc = malloc;
+    alloc.crealloc = realloc;
+    alloc.cfree = free;
+    flatmap_create_with_allocator(fm, keylen, vallen, alloc);
+}
+
+/** \brief Free flatmap
+  *
+  * Frees the flatmap. Any use of the flatmap after this will lead to undefined behaviour.
+  *
+  * \param fm Flatmap to free
+  */
+void flatmap_free(flatmap *fm) {
+    fm->alloc.cfree(fm->slots);
+    fm->slots = NULL;
+    fm->capacity = 0;
+    fm->reserved = 0;
+}
+
+/** \brief Clears flatmap entries
+  *
+  * Removes all entries from the flatmap. The capacity is kept.
+  *
+  * \param fm Flatmap to clear
+  */
+void flatmap_clear(flatmap *fm) {
+    for(unsigned int i = 0; i < fm->capacity; i++) {
+        SLOT(fm, i)->dist = 0;
+    }
+    fm->reserved = 0;
+}
+
+/** \brief Grows the flatmap to fit an amount of entries
+  *
+  * Use this before putting a known amount of entries, to avoid resizing in between.
+  *
+  * \param fm Flatmap
+  * \param count Amount of entries the map should fit
+  */
+void flatmap_reserve(flatmap *fm, unsigned int count) {
+    unsigned int capacity = fm->capacity;
+    while(count * 8 > capacity * 7) {
+        capacity *= 2;
+    }
+    if(capacity != fm->capacity) {
+        flatmap_resize(fm, capacity);
+    }
+}
+
+/** \brief Gets flatmap size
+  *
+  * \param fm Flatmap
+  * \return Amount of slots in the flatmap
+  */
+unsigned int flatmap_size(const flatmap *fm) {
+    return fm->capacity;
+}
+
+/** \brief Gets flatmap reserved slots
+  *
+  * \param fm Flatmap
+  * \return Amount of entries in the flatmap
+  */
+unsigned int flatmap_reserved(const flatmap *fm) {
+    return fm->reserved;
+}
+
+/** \brief Puts an item to the flatmap
+  *
+  * Puts an item to the flatmap, or replaces the value if the key already exists.
+  * The contents of the key and value memory blocks are copied.
+  *
+  * \param fm Flatmap
+  * \param key Pointer to key memory block
+  * \param val Pointer to value memory block
+  * \return Returns a pointer to the value in the flatmap.
+  */
+void* flatmap_put(flatmap *fm, const void *key, const void *val) {
+    return flatmap_put_hashed(fm, key, flatmap_hash(fm, key), val);
+}
+
+/** \brief Gets an item from the flatmap
+  *
+  * \param fm Flatmap
+  * \param key Pointer to key memory block
+  * \return Returns a pointer to the value in the flatmap, or NULL if not found.
+  */
+void* flatmap_get(const flatmap *fm, const void *key) {
+    flatmap_slot *s = flatmap_find(fm, key, flatmap_hash(fm, key));
+    return (s != NULL) ? SLOT_VAL(fm, s) : NULL;
+}
+
+/** \brief Deletes an item from the flatmap
+  *
+  * Deletes an item from the flatmap. Use flatmap_delete inside an iterator instead.
+  *
+  * \param fm Flatmap
+  * \param key Pointer to key memory block
+  * \return Returns 0 on success, 1 on error (not found).
+  */
+int flatmap_del(flatmap *fm, const void *key) {
+    flatmap_slot *s = flatmap_find(fm, key, flatmap_hash(fm, key));
+    if(s == NULL) {
+        return 1;
+    }
+    flatmap_remove(fm, s);
+    return 0;
+}
+
+void* flatmap_iput(flatmap *fm, unsigned int key, const void *val) {
+    return flatmap_put_hashed(fm, &key, flatmap_hash_int(key), val);
+}
+
+void* flatmap_iget(const flatmap *fm, unsigned int key) {
+    flatmap_slot *s = flatmap_ifind(fm, key);
+    return (s != NULL) ? SLOT_VAL(fm, s) : NULL;
+}
+
+int flatmap_idel(flatmap *fm, unsigned int key) {
+    flatmap_slot *s = flatmap_ifind(fm, key);
+    if(s == NULL) {
+        return 1;
+    }
+    flatmap_remove(fm, s);
+    return 0;
+}
+
+/** \brief Deletes an item from the flatmap by iterator key
+  *
+  * Deletes the item last returned by the iterator. Entries after it are shifted
+  * back, and the iterator is rewound so that it will still visit them.
+  *
+  * \param fm Flatmap
+  * \param iter Iterator
+  * \return Returns 0 on success, 1 on error (no current item).
+  */
+int flatmap_delete(flatmap *fm, iterator *iter) {
+    if(iter->ended || fm->cursor.key == NULL) {
+        return 1;
+    }
+    char *prev = (iter->vnow == fm->slots)
+        ? fm->slots + (size_t)(fm->capacity - 1) * fm->slotlen
+        : (char*)iter->vnow - fm->slotlen;
+    flatmap_remove(fm, (flatmap_slot*)prev);
+    fm->cursor.key = NULL;
+    fm->cursor.val = NULL;
+    iter->vnow = prev;
+    iter->inow++;
+    return 0;
+}
+
+// The iterator walks all slots once, starting after an empty one. Deletes never
+// shift entries over an empty slot, so no entry can wrap around to a slot that
+// was already visited.
+void* flatmap_iter_next(iterator *iter) {
+    flatmap *fm = (flatmap*)iter->data;
+    char *end = fm->slots + (size_t)fm->capacity * fm->slotlen;
+    while(iter->inow > 0) {
+        flatmap_slot *s = iter->vnow;
+        char *next = (char*)s + fm->slotlen;
+        iter->vnow = (next == end) ? fm->slots : next;
+        iter->inow--;
+        if(s->dist != 0) {
+            fm->cursor.key = SLOT_KEY(s);
+            fm->cursor.val = SLOT_VAL(fm, s);
+            return &fm->cursor;
+        }
+    }
+    fm->cursor.key = NULL;
+    fm->cursor.val = NULL;
+    iter->ended = 1;
+    return NULL;
+}
+
+void flatmap_iter_begin(flatmap *fm, iterator *iter) {
+    unsigned int start = 0;
+    while(SLOT(fm, start)->dist != 0) {
+        start++;
+    }
+    fm->cursor.key = NULL;
+    fm->cursor.val = NULL;
+    iter->data = fm;
+    iter->vnow = SLOT(fm, (start + 1) & (fm->capacity - 1));
+    iter->inow = fm->capacity - 1;
+    iter->next = flatmap_iter_next;
+    iter->prev = NULL;
+    iter->ended = (fm->reserved == 0);
+}
@@ -186,7 +186,7 @@ int hashmap_resize(hashmap *hm, int n_size) {
     }
 
     // Free old bucket list and assign new list and size of the hashmap
-    free(hm->buckets);
+    hm->alloc.cfree(hm->buckets);
     hm->buckets = new_buckets;
     hm->buckets_x = n_size;
     return 0;
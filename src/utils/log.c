@@ -1,10 +1,107 @@
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
+#include <SDL2/SDL.h>
 #include "utils/log.h"
 
+#define LOG_RING_SIZE 1024 // Lines; must be a power of two
+#define LOG_LINE_MAX 512
+#define LOG_DRAIN_MS 10
+#define LOG_MAX_MUTES 16
+#define LOG_MUTE_LEN 32
+#define LOG_ERROR_RETRIES 20 // Milliseconds an error may wait for a free slot
+
+// Bounded multi-producer ring. A slot is free for position p when its sequence
+// is p, and holds a finished line for the writer when its sequence is p+1.
+typedef struct log_slot_t {
+    SDL_atomic_t seq;
+    char line[LOG_LINE_MAX];
+} log_slot;
+
 FILE *handle = 0;
 unsigned int _log_tick = 0;
 
+static log_slot *ring = NULL;
+static SDL_atomic_t ring_head;
+static unsigned int ring_tail = 0; // Writer thread only
+static SDL_atomic_t dropped;
+static SDL_atomic_t running;
+static SDL_sem *wake = NULL;
+static SDL_Thread *writer = NULL;
+
+// Filters. Only changed from the main thread; other threads may see changes late.
+static char min_level = 'D';
+static char mutes[LOG_MAX_MUTES][LOG_MUTE_LEN];
+static int mute_count = 0;
+
+static int log_level_rank(char mode) {
+    switch(mode) {
+        case 'D': return 0;
+        case 'I': return 1;
+        case 'E': return 2;
+    }
+    return 1;
+}
+
+static int log_is_muted(const char *fn) {
+    if(fn == NULL) {
+        return 0;
+    }
+    for(int i = 0; i < mute_count; i++) {
+        if(strncmp(fn, mutes[i], strlen(mutes[i])) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void log_drain() {
+    int lines = 0;
+    for(;;) {
+        log_slot *s = &ring[ring_tail & (LOG_RING_SIZE - 1)];
+        if((unsigned int)SDL_AtomicGet(&s->seq) != ring_tail + 1) {
+            break;
+        }
+        fputs(s->line, handle);
+        SDL_AtomicSet(&s->seq, ring_tail + LOG_RING_SIZE);
+        ring_tail++;
+        lines++;
+    }
+    int lost = SDL_AtomicSet(&dropped, 0);
+    if(lost > 0) {
+        fprintf(handle, "[%7u][E] Log buffer full; dropped %d lines.\n", _log_tick, lost);
+    }
+    if(lines > 0 || lost > 0) {
+        fflush(handle);
+    }
+}
+
+static int log_writer(void *data) {
+    while(SDL_AtomicGet(&running)) {
+        SDL_SemWaitTimeout(wake, LOG_DRAIN_MS);
+        log_drain();
+    }
+    log_drain();
+    return 0;
+}
+
+static log_slot* log_claim(unsigned int *pos_out) {
+    unsigned int pos = SDL_AtomicGet(&ring_head);
+    for(;;) {
+        log_slot *s = &ring[pos & (LOG_RING_SIZE - 1)];
+        int diff = (int)((unsigned int)SDL_AtomicGet(&s->seq) - pos);
+        if(diff == 0) {
+            if(SDL_AtomicCAS(&ring_head, pos, pos + 1)) {
+                *pos_out = pos;
+                return s;
+            }
+        } else if(diff < 0) {
+            return NULL; // Full
+        }
+        pos = SDL_AtomicGet(&ring_head);
+    }
+}
+
 int log_init(const char *filename) {
     if(handle)
         return 1;
@@ -17,27 +114,130 @@ int log_init(const char *filename) {
             return 1;
         }
     }
+
+    // Start the writer. If that fails, lines are written directly instead.
+    ring = malloc(sizeof(log_slot) * LOG_RING_SIZE);
+    for(int i = 0; i < LOG_RING_SIZE; i++) {
+        SDL_AtomicSet(&ring[i].seq, i);
+    }
+    ring_tail = 0;
+    SDL_AtomicSet(&ring_head, 0);
+    SDL_AtomicSet(&dropped, 0);
+    SDL_AtomicSet(&running, 1);
+    wake = SDL_CreateSemaphore(0);
+    if(wake != NULL) {
+        writer = SDL_CreateThread(log_writer, "log writer", NULL);
+    }
+    if(writer == NULL) {
+        if(wake != NULL) {
+            SDL_DestroySemaphore(wake);
+            wake = NULL;
+        }
+        free(ring);
+        ring = NULL;
+    }
     return 0;
 }
 
 void log_close() {
+    if(writer != NULL) {
+        SDL_AtomicSet(&running, 0);
+        SDL_SemPost(wake);
+        SDL_WaitThread(writer, NULL);
+        SDL_DestroySemaphore(wake);
+        free(ring);
+        writer = NULL;
+        wake = NULL;
+        ring = NULL;
+    }
     if(handle != stdout && handle != 0) {
         fclose(handle);
     }
+    handle = 0;
+}
+
+void log_set_level(char mode) {
+    min_level = mode;
+}
+
+char log_get_level() {
+    return min_level;
+}
+
+int log_mute(const char *prefix) {
+    if(mute_count >= LOG_MAX_MUTES || strlen(prefix) >= LOG_MUTE_LEN) {
+        return 1;
+    }
+    strcpy(mutes[mute_count++], prefix);
+    return 0;
+}
+
+int log_unmute(const char *prefix) {
+    for(int i = 0; i < mute_count; i++) {
+        if(strcmp(mutes[i], prefix) == 0) {
+            mute_count--;
+            memmove(mutes[i], mutes[i+1], (mute_count - i) * LOG_MUTE_LEN);
+            return 0;
+        }
+    }
+    return 1;
 }
 
 void log_print(char mode, const char *fn, const char *fmt, ...) {
     if(handle == 0)
         return;
+    if(log_level_rank(mode) < log_level_rank(min_level) || log_is_muted(fn))
+        return;
+
+    va_list args;
+    va_start(args, fmt);
+    if(ring == NULL) {
+        if(fn != NULL) {
+            fprintf(handle, "[%7u][%c] %s(): ", _log_tick, mode, fn);
+        } else {
+            fprintf(handle, "[%7u][%c] ", _log_tick, mode);
+        }
+        vfprintf(handle, fmt, args);
+        va_end(args);
+        fprintf(handle, "\n");
+        fflush(handle);
+        return;
+    }
+
+    // Format straight into a ring slot; the writer thread does the file I/O.
+    // Errors wait a little for room rather than getting dropped.
+    unsigned int pos;
+    log_slot *s = log_claim(&pos);
+    for(int i = 0; s == NULL && mode == 'E' && i < LOG_ERROR_RETRIES; i++) {
+        SDL_SemPost(wake);
+        SDL_Delay(1);
+        s = log_claim(&pos);
+    }
+    if(s == NULL) {
+        va_end(args);
+        SDL_AtomicIncRef(&dropped);
+        return;
+    }
+    int len;
     if(fn != NULL) {
-        fprintf(handle, "[%7u][%c] %s(): ", _log_tick, mode, fn);
+        len = snprintf(s->line, LOG_LINE_MAX, "[%7u][%c] %s(): ", _log_tick, mode, fn);
     } else {
-        fprintf(handle, "[%7u][%c] ", _log_tick, mode);
+        len = snprintf(s->line, LOG_LINE_MAX, "[%7u][%c] ", _log_tick, mode);
     }
-    va_list args;
-    va_start(args, fmt);
-    vfprintf(handle, fmt, args);
+    if(len > LOG_LINE_MAX - 2) {
+        len = LOG_LINE_MAX - 2;
+    }
+    int ret = vsnprintf(s->line + len, LOG_LINE_MAX - 1 - len, fmt, args);
     va_end(args);
-    fprintf(handle, "\n");
-    fflush(handle);
+    if(ret > 0) {
+        len += (ret > LOG_LINE_MAX - 2 - len) ? LOG_LINE_MAX - 2 - len : ret;
+    }
+    s->line[len] = '\n';
+    s->line[len+1] = 0;
+    SDL_AtomicSet(&s->seq, pos + 1);
+
+    // Don't keep errors waiting
+    if(mode == 'E') {
+        SDL_SemPost(wake);
+    }
 }
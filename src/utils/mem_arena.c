@@ -0,0 +1,156 @@
+#include <stdlib.h>
+#include <string.h>
+#include "utils/mem_arena.h"
+
+#define ALIGN8(x) (((x) + 7) & ~(size_t)7)
+#define SCENE_CHUNK_SIZE (64*1024)
+
+struct mem_arena_chunk_t {
+    mem_arena_chunk *next;
+    size_t size;
+    size_t used;
+    size_t pad; // Keeps the data 8 byte aligned on 32bit
+    char data[];
+};
+
+static _Thread_local mem_arena *scene_arena = NULL;
+
+static mem_arena_chunk* mem_arena_add_chunk(mem_arena *arena, size_t size) {
+    mem_arena_chunk *c = malloc(sizeof(mem_arena_chunk) + size);
+    c->size = size;
+    c->used = 0;
+    c->next = arena->chunks;
+    arena->chunks = c;
+    arena->stats.reserved += sizeof(mem_arena_chunk) + size;
+    return c;
+}
+
+void mem_arena_create(mem_arena *arena, size_t chunk_size) {
+    arena->chunks = NULL;
+    arena->chunk_size = chunk_size;
+    memset(&arena->stats, 0, sizeof(mem_stats));
+}
+
+void mem_arena_free(mem_arena *arena) {
+    mem_arena_chunk *c = arena->chunks;
+    while(c != NULL) {
+        mem_arena_chunk *next = c->next;
+        free(c);
+        c = next;
+    }
+    arena->chunks = NULL;
+    arena->stats.reserved = 0;
+    arena->stats.in_use = 0;
+}
+
+void* mem_arena_alloc(mem_arena *arena, size_t size) {
+    size = ALIGN8(size);
+    mem_arena_chunk *c = arena->chunks;
+    if(size > arena->chunk_size) {
+        // Oversized allocations get a chunk of their own, behind the current one
+        c = mem_arena_add_chunk(arena, size);
+        if(c->next != NULL) {
+            arena->chunks = c->next;
+            c->next = arena->chunks->next;
+            arena->chunks->next = c;
+        }
+    } else if(c == NULL || c->size - c->used < size) {
+        c = mem_arena_add_chunk(arena, arena->chunk_size);
+    }
+    void *ptr = c->data + c->used;
+    c->used += size;
+    arena->stats.allocs++;
+    if(++arena->stats.in_use > arena->stats.peak) {
+        arena->stats.peak = arena->stats.in_use;
+    }
+    return ptr;
+}
+
+void mem_arena_reset(mem_arena *arena) {
+    // Keep one normal sized chunk for the next round
+    mem_arena_chunk *keep = NULL;
+    mem_arena_chunk *c = arena->chunks;
+    while(c != NULL) {
+        mem_arena_chunk *next = c->next;
+        if(keep == NULL && c->size == arena->chunk_size) {
+            keep = c;
+        } else {
+            arena->stats.reserved -= sizeof(mem_arena_chunk) + c->size;
+            free(c);
+        }
+        c = next;
+    }
+    if(keep != NULL) {
+        keep->used = 0;
+        keep->next = NULL;
+    }
+    arena->chunks = keep;
+    arena->stats.frees += arena->stats.in_use;
+    arena->stats.in_use = 0;
+}
+
+const mem_stats* mem_arena_get_stats(const mem_arena *arena) {
+    return &arena->stats;
+}
+
+// The allocator keeps the size in front of each allocation, for realloc
+static void* mem_scene_malloc(size_t size) {
+    if(scene_arena == NULL) {
+        scene_arena = malloc(sizeof(mem_arena));
+        mem_arena_create(scene_arena, SCENE_CHUNK_SIZE);
+    }
+    size_t *ptr = mem_arena_alloc(scene_arena, size + sizeof(size_t));
+    *ptr = size;
+    return ptr + 1;
+}
+
+static void mem_scene_free(void *ptr) {}
+
+static void* mem_scene_realloc(void *ptr, size_t size) {
+    if(ptr == NULL) {
+        return mem_scene_malloc(size);
+    }
+    size_t old_size = ((size_t*)ptr)[-1];
+    if(size <= old_size) {
+        return ptr;
+    }
+    void *moved = mem_scene_malloc(size);
+    memcpy(moved, ptr, old_size);
+    return moved;
+}
+
+allocator mem_arena_scene_allocator() {
+    allocator alloc;
+    alloc.cmalloc = mem_scene_malloc;
+    alloc.cfree = mem_scene_free;
+    alloc.crealloc = mem_scene_realloc;
+    return alloc;
+}
+
+void mem_arena_scene_reset() {
+    if(scene_arena != NULL) {
+        mem_arena_reset(scene_arena);
+    }
+}
+
+void mem_arena_scene_stats(mem_stats *stats) {
+    if(scene_arena == NULL) {
+        memset(stats, 0, sizeof(mem_stats));
+        return;
+    }
+    *stats = scene_arena->stats;
+}
+
+mem_arena* mem_arena_scene_swap(mem_arena *arena) {
+    mem_arena *old = scene_arena;
+    scene_arena = arena;
+    return old;
+}
+
+void mem_arena_scene_close() {
+    if(scene_arena != NULL) {
+        mem_arena_free(scene_arena);
+        free(scene_arena);
+        scene_arena = NULL;
+    }
+}
@@ -0,0 +1,212 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "utils/mem_pool.h"
+#include "utils/memtrack.h"
+
+#define ALIGN8(x) (((x) + 7) & ~7u)
+#define NODE_HEADER 8 // Keeps the owning pool of a node allocation, and its alignment
+#define NODE_MALLOC 0xFF
+#define NODE_PER_BLOCK 256
+
+static const char *shared_names[] = {
+    "object",
+    "ctrl_event",
+    "node 32",
+    "node 64",
+    "node 128",
+};
+
+static _Thread_local mem_pool *shared[MEM_POOL_COUNT];
+
+void mem_pool_create(mem_pool *pool, unsigned int item_size, unsigned int per_block) {
+    // Free items hold the free list link
+    if(item_size < sizeof(void*)) {
+        item_size = sizeof(void*);
+    }
+    pool->item_size = ALIGN8(item_size);
+    pool->per_block = (per_block > 0) ? per_block : 1;
+    pool->free_list = NULL;
+    pool->blocks = NULL;
+    pool->block_count = 0;
+    pool->tag = MEM_TAG_OTHER;
+    memset(&pool->stats, 0, sizeof(mem_stats));
+}
+
+void mem_pool_free(mem_pool *pool) {
+    for(unsigned int i = 0; i < pool->block_count; i++) {
+        MEM_FREE(pool->blocks[i]);
+    }
+    free(pool->blocks);
+    pool->blocks = NULL;
+    pool->block_count = 0;
+    pool->free_list = NULL;
+    pool->stats.reserved = 0;
+    pool->stats.in_use = 0;
+}
+
+static void mem_pool_grow(mem_pool *pool) {
+    size_t size = (size_t)pool->item_size * pool->per_block;
+    char *block = MEM_ALLOC(pool->tag, size);
+    pool->blocks = realloc(pool->blocks, sizeof(char*) * (pool->block_count + 1));
+    pool->blocks[pool->block_count++] = block;
+    pool->stats.reserved += size;
+
+    // Link the new items up in address order
+    for(unsigned int i = pool->per_block; i > 0; i--) {
+        void **item = (void**)(block + (size_t)(i - 1) * pool->item_size);
+        *item = pool->free_list;
+        pool->free_list = item;
+    }
+}
+
+void* mem_pool_alloc(mem_pool *pool) {
+    if(pool->free_list == NULL) {
+        mem_pool_grow(pool);
+    }
+    void **item = pool->free_list;
+    pool->free_list = *item;
+    pool->stats.allocs++;
+    if(++pool->stats.in_use > pool->stats.peak) {
+        pool->stats.peak = pool->stats.in_use;
+    }
+    return item;
+}
+
+int mem_pool_owns(const mem_pool *pool, const void *ptr) {
+    size_t size = (size_t)pool->item_size * pool->per_block;
+    for(unsigned int i = 0; i < pool->block_count; i++) {
+        if((const char*)ptr >= pool->blocks[i] && (const char*)ptr < pool->blocks[i] + size) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void mem_pool_release(mem_pool *pool, void *ptr) {
+    if(ptr == NULL) {
+        return;
+    }
+    if(!mem_pool_owns(pool, ptr)) {
+        free(ptr);
+        return;
+    }
+    void **item = ptr;
+    *item = pool->free_list;
+    pool->free_list = item;
+    pool->stats.frees++;
+    pool->stats.in_use--;
+}
+
+const mem_stats* mem_pool_get_stats(const mem_pool *pool) {
+    return &pool->stats;
+}
+
+mem_pool* mem_pool_shared(int id, unsigned int item_size) {
+    if(shared[id] == NULL) {
+        shared[id] = malloc(sizeof(mem_pool));
+        if(id == MEM_POOL_OBJECT) {
+            mem_pool_create(shared[id], item_size, 64);
+            shared[id]->tag = MEM_TAG_OBJECTS;
+        } else {
+            mem_pool_create(shared[id], item_size, NODE_PER_BLOCK);
+        }
+    }
+    return shared[id];
+}
+
+void mem_pool_shared_stats(int id, mem_stats *stats) {
+    if(shared[id] == NULL) {
+        memset(stats, 0, sizeof(mem_stats));
+        return;
+    }
+    *stats = shared[id]->stats;
+}
+
+const char* mem_pool_shared_name(int id) {
+    return shared_names[id];
+}
+
+void mem_pool_shared_close() {
+    for(int i = 0; i < MEM_POOL_COUNT; i++) {
+        if(shared[i] != NULL) {
+            mem_pool_free(shared[i]);
+            free(shared[i]);
+            shared[i] = NULL;
+        }
+    }
+}
+
+static int mem_node_class(size_t size) {
+    size += NODE_HEADER;
+    if(size <= 32) return MEM_POOL_NODE_32;
+    if(size <= 64) return MEM_POOL_NODE_64;
+    if(size <= 128) return MEM_POOL_NODE_128;
+    return NODE_MALLOC;
+}
+
+static unsigned int mem_node_class_size(int cls) {
+    return 32u << (cls - MEM_POOL_NODE_32);
+}
+
+static unsigned int mem_node_size(mem_pool *pool) {
+    return pool->item_size - NODE_HEADER;
+}
+
+static void* mem_node_malloc(size_t size) {
+    int cls = mem_node_class(size);
+    mem_pool *pool = NULL;
+    mem_pool **base;
+    if(cls == NODE_MALLOC) {
+        base = malloc(size + NODE_HEADER);
+    } else {
+        pool = mem_pool_shared(cls, mem_node_class_size(cls));
+        base = mem_pool_alloc(pool);
+    }
+    // Nodes go back to the pool they came from, not the shared table of the freeing thread
+    base[0] = pool;
+    return (uint8_t*)base + NODE_HEADER;
+}
+
+static void mem_node_free(void *ptr) {
+    if(ptr == NULL) {
+        return;
+    }
+    mem_pool **base = (mem_pool**)((uint8_t*)ptr - NODE_HEADER);
+    if(base[0] == NULL) {
+        free(base);
+    } else {
+        mem_pool_release(base[0], base);
+    }
+}
+
+static void* mem_node_realloc(void *ptr, size_t size) {
+    if(ptr == NULL) {
+        return mem_node_malloc(size);
+    }
+    mem_pool **base = (mem_pool**)((uint8_t*)ptr - NODE_HEADER);
+    mem_pool *pool = base[0];
+    if(pool == NULL) {
+        if(mem_node_class(size) == NODE_MALLOC) {
+            base = realloc(base, size + NODE_HEADER);
+            return (uint8_t*)base + NODE_HEADER;
+        }
+    } else if(mem_node_class(size) != NODE_MALLOC && mem_node_class_size(mem_node_class(size)) == pool->item_size) {
+        return ptr;
+    }
+
+    // Changes size class
+    void *moved = mem_node_malloc(size);
+    size_t old_size = (pool == NULL) ? size : mem_node_size(pool);
+    memcpy(moved, ptr, (old_size < size) ? old_size : size);
+    mem_node_free(ptr);
+    return moved;
+}
+
+allocator mem_pool_allocator() {
+    allocator alloc;
+    alloc.cmalloc = mem_node_malloc;
+    alloc.cfree = mem_node_free;
+    alloc.crealloc = mem_node_realloc;
+    return alloc;
+}
@@ -0,0 +1,155 @@
+#include <stdlib.h>
+#include <stddef.h>
+#include <SDL2/SDL.h>
+#include "utils/memtrack.h"
+#include "utils/log.h"
+
+#define MEMTRACK_MAX_SCOPES 8
+
+// Keeps the size and tag of a block; sized to keep malloc alignment
+typedef union memtrack_header_t {
+    struct {
+        size_t size;
+        int tag;
+    } info;
+    max_align_t align;
+} memtrack_header;
+
+typedef struct memtrack_counter_t {
+    SDL_atomic_t live;
+    SDL_atomic_t peak;
+    SDL_atomic_t allocs;
+    SDL_atomic_t frees;
+} memtrack_counter;
+
+static const char *tag_names[] = {
+    "other",
+    "video",
+    "textures",
+    "resources",
+    "audio",
+    "objects",
+    "gui",
+    "net",
+};
+
+static memtrack_counter counters[MEM_TAG_COUNT];
+static _Thread_local int scopes[MEMTRACK_MAX_SCOPES];
+static _Thread_local int scope_depth = 0;
+
+static int memtrack_resolve(int tag) {
+    if(tag == MEM_TAG_SCOPE) {
+        if(scope_depth == 0) {
+            return MEM_TAG_VIDEO;
+        }
+        // Scopes nested deeper than the stack charge the deepest one kept
+        int depth = (scope_depth < MEMTRACK_MAX_SCOPES) ? scope_depth : MEMTRACK_MAX_SCOPES;
+        return scopes[depth-1];
+    }
+    return tag;
+}
+
+static void memtrack_add(int tag, long delta) {
+    memtrack_counter *c = &counters[tag];
+    int bytes = (int)delta;
+    int live = SDL_AtomicAdd(&c->live, bytes) + bytes;
+    int peak = SDL_AtomicGet(&c->peak);
+    while(live > peak && !SDL_AtomicCAS(&c->peak, peak, live)) {
+        peak = SDL_AtomicGet(&c->peak);
+    }
+}
+
+void* memtrack_malloc(int tag, size_t size) {
+    memtrack_header *h = malloc(sizeof(memtrack_header) + size);
+    if(h == NULL) {
+        return NULL;
+    }
+    h->info.size = size;
+    h->info.tag = memtrack_resolve(tag);
+    SDL_AtomicIncRef(&counters[h->info.tag].allocs);
+    memtrack_add(h->info.tag, size);
+    return h + 1;
+}
+
+void* memtrack_realloc(int tag, void *ptr, size_t size) {
+    if(ptr == NULL) {
+        return memtrack_malloc(tag, size);
+    }
+    // Stays under the tag it was first allocated with
+    memtrack_header *h = (memtrack_header*)ptr - 1;
+    size_t old_size = h->info.size;
+    h = realloc(h, sizeof(memtrack_header) + size);
+    if(h == NULL) {
+        return NULL;
+    }
+    h->info.size = size;
+    memtrack_add(h->info.tag, (long)size - (long)old_size);
+    return h + 1;
+}
+
+void memtrack_free(void *ptr) {
+    if(ptr == NULL) {
+        return;
+    }
+    memtrack_header *h = (memtrack_header*)ptr - 1;
+    SDL_AtomicIncRef(&counters[h->info.tag].frees);
+    SDL_AtomicAdd(&counters[h->info.tag].live, -(int)h->info.size);
+    free(h);
+}
+
+void memtrack_external(int tag, long bytes) {
+    SDL_AtomicIncRef(bytes >= 0 ? &counters[tag].allocs : &counters[tag].frees);
+    memtrack_add(tag, bytes);
+}
+
+void memtrack_scope_begin(int tag) {
+    if(scope_depth < MEMTRACK_MAX_SCOPES) {
+        scopes[scope_depth] = tag;
+    }
+    scope_depth++;
+}
+
+void memtrack_scope_end() {
+    if(scope_depth > 0) {
+        scope_depth--;
+    }
+}
+
+int memtrack_enabled() {
+#ifdef USE_MEMTRACK
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+const char* memtrack_tag_name(int tag) {
+    return tag_names[tag];
+}
+
+void memtrack_get_stats(int tag, memtrack_stats *stats) {
+    stats->live = SDL_AtomicGet(&counters[tag].live);
+    stats->peak = SDL_AtomicGet(&counters[tag].peak);
+    stats->allocs = SDL_AtomicGet(&counters[tag].allocs);
+    stats->frees = SDL_AtomicGet(&counters[tag].frees);
+}
+
+void memtrack_report() {
+    if(!memtrack_enabled()) {
+        return;
+    }
+    int leaks = 0;
+    memtrack_stats stats;
+    for(int i = 0; i < MEM_TAG_COUNT; i++) {
+        memtrack_get_stats(i, &stats);
+        DEBUG("Memory: %-9s peak %ld bytes in %u allocations.", tag_names[i], stats.peak, stats.allocs);
+        if(stats.live != 0) {
+            PERROR("Memory: %-9s leaked %ld bytes in %u allocations.",
+                tag_names[i], stats.live, stats.allocs - stats.frees);
+            leaks++;
+        }
+    }
+    if(leaks == 0) {
+        INFO("Memory: No leaks in tracked allocations.");
+    }
+}
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <SDL2/SDL.h>
+#include "utils/profiler.h"
+#include "utils/log.h"
+
+#define PROFILER_MAX_FRAME_EVENTS 4096
+#define PROFILER_MAX_TRACE_EVENTS 4000000
+
+typedef struct zone_t {
+    const char *name;
+    int depth;
+    uint64_t frame_ticks;
+    uint64_t window_ticks;
+    uint64_t window_max;
+} zone;
+
+typedef struct open_zone_t {
+    int zone;
+    uint64_t start;
+} open_zone;
+
+typedef struct trace_event_t {
+    const char *name;
+    uint64_t start;
+    uint64_t end;
+} trace_event;
+
+typedef struct profiler_t {
+    uint64_t freq;
+    uint64_t origin;
+    zone zones[PROFILER_MAX_ZONES];
+    int zone_count;
+    open_zone stack[PROFILER_MAX_DEPTH];
+    int depth;
+    int overflow; // Zones begun past the maximum depth, and not on the stack
+    int frames;
+    profiler_zone_stats stats[PROFILER_MAX_ZONES];
+    int stats_count;
+
+    // Chrome trace output. Events are buffered for a frame, and written out between frames.
+    FILE *trace;
+    trace_event events[PROFILER_MAX_FRAME_EVENTS];
+    int event_count;
+    unsigned int trace_count;
+} profiler;
+
+static profiler *prof = NULL;
+static _Thread_local int profiler_thread = 0;
+
+static int profiler_zone(const char *name) {
+    for(int i = 0; i < prof->zone_count; i++) {
+        if(prof->zones[i].name == name) {
+            return i;
+        }
+    }
+    if(prof->zone_count >= PROFILER_MAX_ZONES) {
+        return -1;
+    }
+    zone *z = &prof->zones[prof->zone_count];
+    memset(z, 0, sizeof(zone));
+    z->name = name;
+    z->depth = prof->depth;
+    return prof->zone_count++;
+}
+
+void profiler_begin(const char *name) {
+    if(!profiler_thread) {
+        return;
+    }
+    if(prof->depth >= PROFILER_MAX_DEPTH) {
+        prof->overflow++;
+        return;
+    }
+    int z = profiler_zone(name);
+    open_zone *o = &prof->stack[prof->depth++];
+    o->zone = z;
+    o->start = SDL_GetPerformanceCounter();
+}
+
+void profiler_end() {
+    if(!profiler_thread) {
+        return;
+    }
+    if(prof->overflow > 0) {
+        // Ends one of the zones that didn't fit, not the one under them
+        prof->overflow--;
+        return;
+    }
+    if(prof->depth <= 0) {
+        return;
+    }
+    uint64_t now = SDL_GetPerformanceCounter();
+    open_zone *o = &prof->stack[--prof->depth];
+    if(o->zone < 0) {
+        return;
+    }
+    zone *z = &prof->zones[o->zone];
+    z->frame_ticks += now - o->start;
+    if(prof->trace != NULL && prof->event_count < PROFILER_MAX_FRAME_EVENTS) {
+        trace_event *e = &prof->events[prof->event_count++];
+        e->name = z->name;
+        e->start = o->start;
+        e->end = now;
+    }
+}
+
+static void profiler_write_trace() {
+    double us = 1000000.0 / prof->freq;
+    for(int i = 0; i < prof->event_count; i++) {
+        trace_event *e = &prof->events[i];
+        fprintf(prof->trace,
+                "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1},\n",
+                e->name,
+                (e->start - prof->origin) * us,
+                (e->end - e->start) * us);
+    }
+    prof->trace_count += prof->event_count;
+    prof->event_count = 0;
+    if(prof->trace_count >= PROFILER_MAX_TRACE_EVENTS) {
+        INFO("Profiler: Trace is full; no more events are recorded.");
+        fprintf(prof->trace, "{}]}\n");
+        fclose(prof->trace);
+        prof->trace = NULL;
+    }
+}
+
+void profiler_frame() {
+    if(!profiler_thread) {
+        return;
+    }
+
+    // Zones left open by an early return end here
+    prof->overflow = 0;
+    while(prof->depth > 0) {
+        profiler_end();
+    }
+    if(prof->trace != NULL) {
+        profiler_write_trace();
+    }
+
+    for(int i = 0; i < prof->zone_count; i++) {
+        zone *z = &prof->zones[i];
+        z->window_ticks += z->frame_ticks;
+        if(z->frame_ticks > z->window_max) {
+            z->window_max = z->frame_ticks;
+        }
+        z->frame_ticks = 0;
+    }
+    if(++prof->frames < PROFILER_WINDOW) {
+        return;
+    }
+
+    double ms = 1000.0 / prof->freq;
+    for(int i = 0; i < prof->zone_count; i++) {
+        zone *z = &prof->zones[i];
+        profiler_zone_stats *s = &prof->stats[i];
+        s->name = z->name;
+        s->depth = z->depth;
+        s->avg_ms = z->window_ticks * ms / prof->frames;
+        s->max_ms = z->window_max * ms;
+        z->window_ticks = 0;
+        z->window_max = 0;
+    }
+    prof->stats_count = prof->zone_count;
+    prof->frames = 0;
+}
+
+int profiler_get_stats(const profiler_zone_stats **stats) {
+    if(prof == NULL) {
+        return 0;
+    }
+    *stats = prof->stats;
+    return prof->stats_count;
+}
+
+int profiler_init(const char *trace_file) {
+    prof = malloc(sizeof(profiler));
+    memset(prof, 0, sizeof(profiler));
+    prof->freq = SDL_GetPerformanceFrequency();
+    prof->origin = SDL_GetPerformanceCounter();
+    if(trace_file != NULL && trace_file[0] != 0) {
+        prof->trace = fopen(trace_file, "w");
+        if(prof->trace == NULL) {
+            PERROR("Profiler: Unable to open '%s' for writing.", trace_file);
+            free(prof);
+            prof = NULL;
+            return 1;
+        }
+        fprintf(prof->trace, "{\"traceEvents\":[\n");
+    }
+    profiler_thread = 1;
+    return 0;
+}
+
+void profiler_close() {
+    if(prof == NULL) {
+        return;
+    }
+    if(prof->trace != NULL) {
+        profiler_write_trace();
+    }
+    if(prof->trace != NULL) {
+        fprintf(prof->trace, "{}]}\n");
+        fclose(prof->trace);
+        INFO("Profiler: Wrote %u trace events.", prof->trace_count);
+    }
+    profiler_thread = 0;
+    free(prof);
+    prof = NULL;
+}
@@ -3,7 +3,9 @@
 
 // A simple psuedorandom number generator
 
-static struct random_t rand_state = { 1 };
+// Streams are per thread, so that parallel simulations don't share a sequence
+static _Thread_local struct random_t rand_streams[RAND_STREAM_COUNT] = { { 1 }, { 2 }, { 3 } };
+#define rand_state (&rand_streams[RAND_STREAM_GAME])
 
 void random_seed(struct random_t *r, uint32_t seed) {
     r->seed = seed;
@@ -26,8 +28,21 @@ float random_float(struct random_t *r) {
     return (float)random_intmax(r) / UINT_MAX;
 }
 
-void rand_seed(uint32_t seed) { random_seed(&rand_state, seed); }
-uint32_t rand_get_seed(void) { return random_get_seed(&rand_state); }
-uint32_t rand_int(uint32_t upperbound) { return random_int(&rand_state, upperbound); }
-uint32_t rand_intmax(void) { return random_intmax(&rand_state);  }
-float rand_float(void) { return random_float(&rand_state); }
+struct random_t* rand_stream(int stream) {
+    return &rand_streams[stream];
+}
+
+void rand_seed_streams(uint32_t seed) {
+    // Derive a different seed for every stream, so they don't mirror each other
+    struct random_t r;
+    random_seed(&r, seed);
+    for(int i = 0; i < RAND_STREAM_COUNT; i++) {
+        random_seed(&rand_streams[i], random_intmax(&r));
+    }
+}
+
+void rand_seed(uint32_t seed) { random_seed(rand_state, seed); }
+uint32_t rand_get_seed(void) { return random_get_seed(rand_state); }
+uint32_t rand_int(uint32_t upperbound) { return random_int(rand_state, upperbound); }
+uint32_t rand_intmax(void) { return random_intmax(rand_state);  }
+float rand_float(void) { return random_float(rand_state); }
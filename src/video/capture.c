@@ -0,0 +1,382 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <SDL2/SDL.h>
+
+// zlib is pulled in together with libpng
+#ifdef USE_PNG
+#include <zlib.h>
+#endif
+
+#include "video/capture.h"
+#include "video/image.h"
+#include "video/video.h"
+#include "utils/log.h"
+
+#define FRAME_BYTES (NATIVE_W * NATIVE_H * 3)
+
+typedef struct __attribute__ ((__packed__)) capture_header_t {
+    char magic[8];
+    uint16_t width;
+    uint16_t height;
+    uint8_t bpp;
+    uint8_t compression;
+    uint16_t keyframe_interval;
+} capture_header;
+
+typedef struct __attribute__ ((__packed__)) capture_frame_header_t {
+    uint32_t frame;
+    uint32_t timestamp;
+    uint8_t type;
+    uint32_t len;
+} capture_frame_header;
+
+typedef struct capture_slot_t {
+    char *data;
+    unsigned int frame;
+    unsigned int timestamp;
+    unsigned int drops_before;
+} capture_slot;
+
+typedef struct capture_t {
+    FILE *fp; // NULL when dumping images
+    char pattern[256];
+    image img;
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    SDL_cond *cond;
+    int running;
+
+    // Bounded frame queue. Producer is the render thread, consumer is the writer.
+    capture_slot slots[CAPTURE_QUEUE_SIZE];
+    unsigned int head;
+    unsigned int tail;
+    unsigned int count;
+
+    // Render thread side
+    char *readback;
+    int readback_scale;
+    unsigned int frames;
+    unsigned int pending_drops;
+    unsigned int dropped;
+
+    // Writer thread side
+    char *prev;
+    char *delta;
+    char *packed;
+    unsigned long packed_size;
+    unsigned int written;
+} capture;
+
+static capture *cap = NULL;
+
+static int capture_write_record(unsigned int frame, unsigned int timestamp, int type, const char *data, unsigned int len) {
+    capture_frame_header fh;
+    fh.frame = frame;
+    fh.timestamp = timestamp;
+    fh.type = type;
+    fh.len = len;
+    if(fwrite(&fh, sizeof(capture_frame_header), 1, cap->fp) != 1) {
+        return 1;
+    }
+    if(len > 0 && fwrite(data, len, 1, cap->fp) != 1) {
+        return 1;
+    }
+    return 0;
+}
+
+// Writes the frame as its own image, with the same writers as screenshots
+static int capture_dump(capture_slot *slot) {
+    char filename[300];
+    snprintf(filename, sizeof(filename), cap->pattern, slot->frame);
+    const char *s = slot->data;
+    char *d = cap->img.data;
+    for(int i = 0; i < NATIVE_W * NATIVE_H; i++) {
+        d[0] = s[0];
+        d[1] = s[1];
+        d[2] = s[2];
+        d[3] = (char)0xFF;
+        s += 3;
+        d += 4;
+    }
+    if(image_supports_png()) {
+        return image_write_png(&cap->img, filename);
+    }
+    return image_write_tga(&cap->img, filename);
+}
+
+// Returns 1 if the file name is a pattern with exactly one frame number in it
+static int capture_is_pattern(const char *filename) {
+    const char *p = strchr(filename, '%');
+    if(p == NULL) {
+        return 0;
+    }
+    p++;
+    while(*p >= '0' && *p <= '9') {
+        p++;
+    }
+    return (*p == 'u' && strchr(p, '%') == NULL);
+}
+
+static int capture_encode(capture_slot *slot) {
+    if(cap->fp == NULL) {
+        // Dropped frames are left out of the numbering
+        return capture_dump(slot);
+    }
+
+    // Frames we had to drop before this one get an empty marker record each
+    for(unsigned int i = 0; i < slot->drops_before; i++) {
+        unsigned int dropped_frame = slot->frame - slot->drops_before + i;
+        if(capture_write_record(dropped_frame, slot->timestamp, CAPTURE_FRAME_DROPPED, NULL, 0)) {
+            return 1;
+        }
+    }
+
+    // Keyframes are stored as-is, others as an XOR against the previous frame.
+    // Static parts of the screen then turn to zeroes and compress to nearly nothing.
+    int type = CAPTURE_FRAME_KEY;
+    const char *src = slot->data;
+    if(cap->written % CAPTURE_KEYFRAME_INTERVAL != 0 && slot->drops_before == 0) {
+        type = CAPTURE_FRAME_DELTA;
+        for(int i = 0; i < FRAME_BYTES; i++) {
+            cap->delta[i] = slot->data[i] ^ cap->prev[i];
+        }
+        src = cap->delta;
+    }
+    memcpy(cap->prev, slot->data, FRAME_BYTES);
+    cap->written++;
+
+#ifdef USE_PNG
+    uLongf packed_len = cap->packed_size;
+    if(compress2((Bytef*)cap->packed, &packed_len, (const Bytef*)src, FRAME_BYTES, Z_BEST_SPEED) != Z_OK) {
+        return 1;
+    }
+    return capture_write_record(slot->frame, slot->timestamp, type, cap->packed, packed_len);
+#else
+    return capture_write_record(slot->frame, slot->timestamp, type, src, FRAME_BYTES);
+#endif
+}
+
+static int capture_writer(void *userdata) {
+    while(1) {
+        SDL_LockMutex(cap->lock);
+        while(cap->count == 0 && cap->running) {
+            SDL_CondWait(cap->cond, cap->lock);
+        }
+        if(cap->count == 0 && !cap->running) {
+            SDL_UnlockMutex(cap->lock);
+            break;
+        }
+        capture_slot *slot = &cap->slots[cap->head];
+        SDL_UnlockMutex(cap->lock);
+
+        // Encode outside the lock; the slot stays reserved until we release it below.
+        if(capture_encode(slot)) {
+            PERROR("Capture: Failed to write frame %u!", slot->frame);
+        }
+
+        SDL_LockMutex(cap->lock);
+        cap->head = (cap->head + 1) % CAPTURE_QUEUE_SIZE;
+        cap->count--;
+        SDL_UnlockMutex(cap->lock);
+    }
+    return 0;
+}
+
+int capture_start(const char *filename) {
+    if(cap != NULL) {
+        PERROR("Capture: Already capturing!");
+        return 1;
+    }
+
+    cap = malloc(sizeof(capture));
+    memset(cap, 0, sizeof(capture));
+    if(strchr(filename, '%') != NULL) {
+        if(!capture_is_pattern(filename) || strlen(filename) >= sizeof(cap->pattern)) {
+            PERROR("Capture: '%s' should have one frame number (eg. %%06u) in it.", filename);
+            goto error_0;
+        }
+        strcpy(cap->pattern, filename);
+        image_create(&cap->img, NATIVE_W, NATIVE_H);
+        goto start_writer;
+    }
+    cap->fp = fopen(filename, "wb");
+    if(cap->fp == NULL) {
+        PERROR("Capture: Unable to open '%s' for writing.", filename);
+        goto error_0;
+    }
+
+    // Write stream header
+    capture_header header;
+    memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+    header.width = NATIVE_W;
+    header.height = NATIVE_H;
+    header.bpp = 3;
+#ifdef USE_PNG
+    header.compression = CAPTURE_COMPRESSION_DEFLATE;
+#else
+    header.compression = CAPTURE_COMPRESSION_NONE;
+#endif
+    header.keyframe_interval = CAPTURE_KEYFRAME_INTERVAL;
+    if(fwrite(&header, sizeof(capture_header), 1, cap->fp) != 1) {
+        PERROR("Capture: Unable to write stream header.");
+        goto error_1;
+    }
+
+start_writer:
+    // Preallocate everything, so that grabbing a frame never allocates
+    for(int i = 0; i < CAPTURE_QUEUE_SIZE; i++) {
+        cap->slots[i].data = malloc(FRAME_BYTES);
+    }
+    cap->prev = malloc(FRAME_BYTES);
+    cap->delta = malloc(FRAME_BYTES);
+    memset(cap->prev, 0, FRAME_BYTES);
+#ifdef USE_PNG
+    cap->packed_size = compressBound(FRAME_BYTES);
+#else
+    cap->packed_size = FRAME_BYTES;
+#endif
+    cap->packed = malloc(cap->packed_size);
+
+    // Start up the writer
+    cap->lock = SDL_CreateMutex();
+    cap->cond = SDL_CreateCond();
+    cap->running = 1;
+    cap->thread = SDL_CreateThread(capture_writer, "capture writer", NULL);
+    if(cap->thread == NULL) {
+        PERROR("Capture: Unable to start writer thread: %s", SDL_GetError());
+        goto error_2;
+    }
+
+    INFO("Capturing gameplay to '%s'.", filename);
+    return 0;
+
+error_2:
+    SDL_DestroyCond(cap->cond);
+    SDL_DestroyMutex(cap->lock);
+    for(int i = 0; i < CAPTURE_QUEUE_SIZE; i++) {
+        free(cap->slots[i].data);
+    }
+    free(cap->prev);
+    free(cap->delta);
+    free(cap->packed);
+error_1:
+    if(cap->fp != NULL) {
+        fclose(cap->fp);
+    }
+    image_free(&cap->img);
+error_0:
+    free(cap);
+    cap = NULL;
+    return 1;
+}
+
+void capture_stop() {
+    if(cap == NULL) {
+        return;
+    }
+
+    // Let the writer drain the queue and quit
+    SDL_LockMutex(cap->lock);
+    cap->running = 0;
+    SDL_CondSignal(cap->cond);
+    SDL_UnlockMutex(cap->lock);
+    SDL_WaitThread(cap->thread, NULL);
+
+    INFO("Capture finished:");
+    INFO(" * Frames:  %u", cap->frames);
+    INFO(" * Dropped: %u", cap->dropped);
+
+    if(cap->fp != NULL) {
+        // Mark any drops that happened after the last queued frame
+        for(unsigned int i = 0; i < cap->pending_drops; i++) {
+            capture_write_record(cap->frames - cap->pending_drops + i, SDL_GetTicks(), CAPTURE_FRAME_DROPPED, NULL, 0);
+        }
+        fclose(cap->fp);
+    }
+    image_free(&cap->img);
+    SDL_DestroyCond(cap->cond);
+    SDL_DestroyMutex(cap->lock);
+    for(int i = 0; i < CAPTURE_QUEUE_SIZE; i++) {
+        free(cap->slots[i].data);
+    }
+    free(cap->readback);
+    free(cap->prev);
+    free(cap->delta);
+    free(cap->packed);
+    free(cap);
+    cap = NULL;
+}
+
+int capture_is_running() {
+    return (cap != NULL);
+}
+
+unsigned int capture_get_frames() {
+    return (cap != NULL) ? cap->frames : 0;
+}
+
+unsigned int capture_get_dropped() {
+    return (cap != NULL) ? cap->dropped : 0;
+}
+
+// Called from the render thread with the native render target still bound.
+void capture_grab(SDL_Renderer *renderer, int scale_factor) {
+    if(cap == NULL) {
+        return;
+    }
+
+    unsigned int frame = cap->frames++;
+
+    // If the writer can't keep up, drop the frame instead of waiting for it.
+    SDL_LockMutex(cap->lock);
+    int full = (cap->count >= CAPTURE_QUEUE_SIZE);
+    SDL_UnlockMutex(cap->lock);
+    if(full) {
+        cap->pending_drops++;
+        cap->dropped++;
+        if(cap->dropped == 1 || cap->dropped % 100 == 0) {
+            DEBUG("Capture: Writer is falling behind; %u frames dropped so far.", cap->dropped);
+        }
+        return;
+    }
+
+    // Make sure the readback buffer matches the current render target size
+    if(cap->readback == NULL || cap->readback_scale != scale_factor) {
+        free(cap->readback);
+        cap->readback = malloc(NATIVE_W * NATIVE_H * 4 * scale_factor * scale_factor);
+        cap->readback_scale = scale_factor;
+    }
+    int pitch = NATIVE_W * scale_factor * 4;
+    if(SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_ABGR8888, cap->readback, pitch) != 0) {
+        PERROR("Capture: Unable to read pixels from rendertarget: %s", SDL_GetError());
+        cap->pending_drops++;
+        cap->dropped++;
+        return;
+    }
+
+    // Only this thread ever touches the tail slot, so no need to lock for the copy.
+    // Pick one pixel per scaler block to get back to native resolution.
+    capture_slot *slot = &cap->slots[cap->tail];
+    char *dst = slot->data;
+    for(int y = 0; y < NATIVE_H; y++) {
+        const char *row = cap->readback + y * scale_factor * pitch;
+        for(int x = 0; x < NATIVE_W; x++) {
+            const char *px = row + x * scale_factor * 4;
+            *dst++ = px[0];
+            *dst++ = px[1];
+            *dst++ = px[2];
+        }
+    }
+    slot->frame = frame;
+    slot->timestamp = SDL_GetTicks();
+    slot->drops_before = cap->pending_drops;
+    cap->pending_drops = 0;
+
+    SDL_LockMutex(cap->lock);
+    cap->tail = (cap->tail + 1) % CAPTURE_QUEUE_SIZE;
+    cap->count++;
+    SDL_CondSignal(cap->cond);
+    SDL_UnlockMutex(cap->lock);
+}
@@ -194,6 +194,7 @@ int image_write_png(image *img, const char *filename) {
     // End
     setjmp(png_jmpbuf(png_ptr));
     png_write_end(png_ptr, NULL);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
 
     // Free file
     fclose(fp);
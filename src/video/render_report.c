@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "video/render_report.h"
+#include "game/utils/statehash.h"
+#include "utils/vector.h"
+#include "utils/log.h"
+#include "utils/compat.h"
+
+typedef struct render_frame_t {
+    unsigned int scene_id;
+    unsigned int tick;
+    double render_ms;
+    uint32_t hash;
+} render_frame;
+
+typedef struct render_report_t {
+    char *filename;
+    vector frames;
+} render_report;
+
+static render_report *rr = NULL;
+
+int render_report_start(const char *filename) {
+    rr = malloc(sizeof(render_report));
+    rr->filename = strdup(filename);
+    vector_create(&rr->frames, sizeof(render_frame));
+    INFO("Render report: Recording frames for '%s'.", filename);
+    return 0;
+}
+
+void render_report_frame(unsigned int scene_id, unsigned int tick, double render_ms, uint32_t hash) {
+    if(rr == NULL) {
+        return;
+    }
+    render_frame f;
+    f.scene_id = scene_id;
+    f.tick = tick;
+    f.render_ms = render_ms;
+    f.hash = hash;
+    vector_append(&rr->frames, &f);
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void render_report_write_csv(FILE *fp) {
+    fprintf(fp, "frame,scene,tick,render_ms,hash\n");
+    for(unsigned int i = 0; i < vector_size(&rr->frames); i++) {
+        render_frame *f = vector_get(&rr->frames, i);
+        fprintf(fp, "%u,%u,%u,%.4f,%08x\n", i, f->scene_id, f->tick, f->render_ms, f->hash);
+    }
+}
+
+static void render_report_write_json(FILE *fp, double *sorted, unsigned int count, uint32_t seq_hash) {
+    double total = 0;
+    for(unsigned int i = 0; i < count; i++) {
+        total += sorted[i];
+    }
+    render_frame *last = vector_get(&rr->frames, count - 1);
+    fprintf(fp, "{\n  \"frames\": %u,\n  \"sequence_hash\": \"%08x\",\n  \"last_hash\": \"%08x\",\n",
+            count, seq_hash, last->hash);
+    fprintf(fp, "  \"render_ms\": {\"mean\": %.4f, \"min\": %.4f, \"median\": %.4f, \"p95\": %.4f, \"max\": %.4f},\n",
+            total / count, sorted[0], sorted[count / 2], sorted[count * 95 / 100], sorted[count - 1]);
+    fprintf(fp, "  \"per_frame\": [\n");
+    for(unsigned int i = 0; i < count; i++) {
+        render_frame *f = vector_get(&rr->frames, i);
+        fprintf(fp, "    {\"frame\": %u, \"scene\": %u, \"tick\": %u, \"render_ms\": %.4f, \"hash\": \"%08x\"}%s\n",
+                i, f->scene_id, f->tick, f->render_ms, f->hash, (i < count - 1) ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+}
+
+void render_report_stop() {
+    if(rr == NULL) {
+        return;
+    }
+    unsigned int count = vector_size(&rr->frames);
+    if(count == 0) {
+        PERROR("Render report: No frames were rendered.");
+        goto exit_0;
+    }
+
+    // Sequence hash and sorted render times for the summary
+    uint32_t *hashes = malloc(count * sizeof(uint32_t));
+    double *sorted = malloc(count * sizeof(double));
+    for(unsigned int i = 0; i < count; i++) {
+        render_frame *f = vector_get(&rr->frames, i);
+        hashes[i] = f->hash;
+        sorted[i] = f->render_ms;
+    }
+    uint32_t seq_hash = statehash_data((const char*)hashes, count * sizeof(uint32_t));
+    qsort(sorted, count, sizeof(double), cmp_double);
+    INFO("Render report: %u frames, render time median %.3f ms, max %.3f ms, sequence hash %08x",
+         count, sorted[count / 2], sorted[count - 1], seq_hash);
+
+    FILE *fp = fopen(rr->filename, "w");
+    if(fp == NULL) {
+        PERROR("Render report: Unable to open '%s' for writing.", rr->filename);
+        goto exit_1;
+    }
+    size_t len = strlen(rr->filename);
+    if(len > 5 && strcmp(rr->filename + len - 5, ".json") == 0) {
+        render_report_write_json(fp, sorted, count, seq_hash);
+    } else {
+        render_report_write_csv(fp);
+    }
+    fclose(fp);
+    INFO("Render report: Written to '%s'.", rr->filename);
+
+exit_1:
+    free(sorted);
+    free(hashes);
+exit_0:
+    vector_free(&rr->frames);
+    free(rr->filename);
+    free(rr);
+    rr = NULL;
+}
@@ -1,15 +1,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <utils/log.h>
+#include <utils/memtrack.h>
 #include "video/surface.h"
 
 void surface_create(surface *sur, int type, int w, int h) {
     if(type == SURFACE_TYPE_RGBA) {
-        sur->data = malloc(w*h*4);
+        sur->data = MEM_ALLOC(MEM_TAG_SCOPE, w*h*4);
         sur->stencil = NULL;
     } else {
-        sur->data = malloc(w*h);
-        sur->stencil = malloc(w*h);
+        sur->data = MEM_ALLOC(MEM_TAG_SCOPE, w*h);
+        sur->stencil = MEM_ALLOC(MEM_TAG_SCOPE, w*h);
     }
     sur->w = w;
     sur->h = h;
@@ -45,8 +46,8 @@ int surface_to_image(surface *sur, image *img) {
 }
 
 void surface_free(surface *sur) {
-    free(sur->data);
-    free(sur->stencil);
+    MEM_FREE(sur->data);
+    MEM_FREE(sur->stencil);
     sur->stencil = NULL;
     sur->data = NULL;
 }
@@ -63,6 +64,42 @@ void surface_clear(surface *sur) {
     }
 }
 
+// Builds a soft shadow from the shape of src, as an RGBA surface that is one
+// pixel larger each way. The shape is squashed to h rows, flipped, and laid
+// over itself with a one pixel diagonal offset. Pixels covered once get the
+// given alpha, pixels covered twice the alpha of two such layers blended.
+void surface_create_shadow(surface *dst, const surface *src, int h, SDL_RendererFlip flip, uint8_t alpha) {
+    int w = src->w;
+    uint8_t twice = alpha + alpha * (255 - alpha) / 255;
+    char *shape = malloc(w * h);
+    for(int y = 0; y < h; y++) {
+        // Sample from the middle of the rows each pixel covers, like the renderer would
+        int sy = ((2 * y + 1) * src->h) / (2 * h);
+        if(flip & SDL_FLIP_VERTICAL) {
+            sy = src->h - 1 - sy;
+        }
+        for(int x = 0; x < w; x++) {
+            int i = sy * w + ((flip & SDL_FLIP_HORIZONTAL) ? w - 1 - x : x);
+            if(src->type == SURFACE_TYPE_RGBA) {
+                shape[y * w + x] = (src->data[i * 4 + 3] != 0);
+            } else {
+                shape[y * w + x] = (src->stencil[i] == 1);
+            }
+        }
+    }
+
+    surface_create(dst, SURFACE_TYPE_RGBA, w + 1, h + 1);
+    surface_clear(dst);
+    for(int y = 0; y <= h; y++) {
+        for(int x = 0; x <= w; x++) {
+            int a = (x < w && y < h) ? shape[y * w + x] : 0;
+            int b = (x > 0 && y > 0) ? shape[(y - 1) * w + x - 1] : 0;
+            dst->data[(y * (w + 1) + x) * 4 + 3] = (a && b) ? twice : ((a || b) ? alpha : 0);
+        }
+    }
+    free(shape);
+}
+
 // Fills the whole surface with color
 void surface_fill(surface *sur, color c) {
     // Only for RGBA for now
@@ -247,12 +284,12 @@ void surface_convert_to_rgba(surface *sur, screen_palette *pal, int pal_offset)
         return;
     }
 
-    char *pixels = malloc(sur->w * sur->h * 4);
+    char *pixels = MEM_ALLOC(MEM_TAG_SCOPE, sur->w * sur->h * 4);
     surface_to_rgba(sur, pixels, pal, NULL, pal_offset);
 
     // Free old data
-    free(sur->data);
-    free(sur->stencil);
+    MEM_FREE(sur->data);
+    MEM_FREE(sur->stencil);
     sur->data = pixels;
     sur->stencil = NULL;
     sur->type = SURFACE_TYPE_RGBA;
@@ -1,7 +1,9 @@
 #include <stdlib.h>
 #include "video/tcache.h"
-#include "utils/hashmap.h"
+#include "utils/flatmap.h"
 #include "utils/log.h"
+#include "utils/profiler.h"
+#include "utils/memtrack.h"
 
 #define CACHE_LIFETIME 300
 
@@ -16,10 +18,11 @@ typedef struct tcache_entry_value_t {
     SDL_Texture *tex;
     unsigned int age;
     unsigned int pal_version;
+    unsigned int bytes; // Estimated texture memory
 } tcache_entry_value;
 
 typedef struct tcache_t {
-    hashmap entries;
+    flatmap entries;
     unsigned int hits;
     unsigned int misses;
     unsigned int old_frees;
@@ -32,24 +35,17 @@ static tcache *cache = NULL;
 
 // Helper method for getting cache entry
 tcache_entry_value* tcache_add_entry(tcache_entry_key *key, tcache_entry_value *val) {
-    return hashmap_put(&cache->entries,
-                      (void*)key, sizeof(tcache_entry_key),
-                      (void*)val, sizeof(tcache_entry_value));
+    return flatmap_put(&cache->entries, key, val);
 }
 
 // Helper method for setting cache entry
 tcache_entry_value* tcache_get_entry(tcache_entry_key *key) {
-    tcache_entry_value *val = NULL;
-    unsigned int tmp_size;
-    hashmap_get(&cache->entries,
-                (void*)key, sizeof(tcache_entry_key),
-                (void**)&val, &tmp_size);
-    return val;
+    return flatmap_get(&cache->entries, key);
 }
 
 void tcache_init(SDL_Renderer *renderer, int scale_factor, scaler_plugin *scaler) {
     cache = malloc(sizeof(tcache));
-    hashmap_create(&cache->entries, 6);
+    flatmap_create(&cache->entries, sizeof(tcache_entry_key), sizeof(tcache_entry_value));
     cache->renderer = renderer;
     cache->scaler = scaler;
     cache->scale_factor = scale_factor;
@@ -67,26 +63,31 @@ void tcache_reinit(SDL_Renderer *renderer, int scale_factor, scaler_plugin *scal
 }
 
 void tcache_clear() {
+    if(cache == NULL) {
+        return;
+    }
     iterator it;
-    hashmap_iter_begin(&cache->entries, &it);
-    hashmap_pair *pair;
+    flatmap_iter_begin(&cache->entries, &it);
+    flatmap_pair *pair;
     while((pair = iter_next(&it)) != NULL) {
         tcache_entry_value *entry = pair->val;
         SDL_DestroyTexture(entry->tex);
+        MEM_EXTERNAL(MEM_TAG_TEXTURES, -(long)entry->bytes);
     }
-    hashmap_clear(&cache->entries);
+    flatmap_clear(&cache->entries);
 }
 
 void tcache_tick() {
     iterator it;
-    hashmap_iter_begin(&cache->entries, &it);
-    hashmap_pair *pair;
+    flatmap_iter_begin(&cache->entries, &it);
+    flatmap_pair *pair;
     while((pair = iter_next(&it)) != NULL) {
         tcache_entry_value *entry = pair->val;
         entry->age++;
         if(entry->age > CACHE_LIFETIME) {
             SDL_DestroyTexture(entry->tex);
-            hashmap_delete(&cache->entries, &it);
+            MEM_EXTERNAL(MEM_TAG_TEXTURES, -(long)entry->bytes);
+            flatmap_delete(&cache->entries, &it);
             cache->old_frees++;
         }
     }
@@ -98,7 +99,7 @@ void tcache_close() {
     DEBUG(" * Hits:      %d", cache->hits);
     DEBUG(" * Old frees: %d", cache->old_frees);
     tcache_clear();
-    hashmap_free(&cache->entries);
+    flatmap_free(&cache->entries);
     free(cache);
 }
 
@@ -143,6 +144,7 @@ SDL_Texture* tcache_get(surface *sur,
         tcache_entry_value new_entry;
         new_entry.age = 0;
         new_entry.pal_version = pal->version;
+        new_entry.bytes = sur->w * cache->scale_factor * sur->h * cache->scale_factor * 4;
         new_entry.tex = SDL_CreateTexture(cache->renderer,
                                           SDL_PIXELFORMAT_ABGR8888,
                                           SDL_TEXTUREACCESS_STREAMING,
@@ -150,11 +152,13 @@ SDL_Texture* tcache_get(surface *sur,
                                           sur->h * cache->scale_factor);
         SDL_SetTextureBlendMode(new_entry.tex, SDL_BLENDMODE_BLEND);
         val = tcache_add_entry(&key, &new_entry);
+        MEM_EXTERNAL(MEM_TAG_TEXTURES, new_entry.bytes);
     }
 
     // We have a texture either from the cache, or we just created one.
     // Either one, it needs to be updated. Let's do it now.
     // Also, scale surface if necessary
+    PROFILE_BEGIN("tcache convert");
     if(cache->scale_factor > 1) {
         char *raw = malloc(sur->w * sur->h * 4);
         surface scaled;
@@ -164,13 +168,16 @@ SDL_Texture* tcache_get(surface *sur,
                        sur->h * cache->scale_factor);
 
         surface_to_rgba(sur, raw, pal, remap_table, pal_offset);
+        PROFILE_BEGIN("scaler");
         scaler_scale(cache->scaler, raw, scaled.data, sur->w, sur->h, cache->scale_factor);
+        PROFILE_END();
         surface_to_texture(&scaled, val->tex, pal, remap_table, pal_offset);
         surface_free(&scaled);
         free(raw);
     } else {
         surface_to_texture(sur, val->tex, pal, remap_table, pal_offset);
     }
+    PROFILE_END();
 
     // Set correct age and palette version
     val->age = 0;
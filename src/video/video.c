@@ -12,10 +12,20 @@
 #include "video/video_state.h"
 #include "video/video_hw.h"
 #include "video/video_soft.h"
+#include "video/capture.h"
 #include "plugins/plugins.h"
+#include "game/utils/statehash.h"
 
 static video_state state;
 
+// In headless mode there is no window or renderer. Simulations running on
+// worker threads may still poke at the palette, so each thread gets its own.
+static int headless = 0;
+static _Thread_local palette headless_palette;
+
+// In offscreen mode the renderer draws into this surface instead of a window
+static SDL_Surface *offscreen = NULL;
+
 void reset_targets() {
     if(state.target != NULL) {
         SDL_DestroyTexture(state.target);
@@ -48,14 +58,10 @@ int video_load_scaler(const char* name, int scale_factor) {
     return 0;
 }
 
-int video_init(int window_w,
-               int window_h,
-               int fullscreen,
-               int vsync,
-               const char* scaler_name,
-               int scale_factor) {
-    state.w = window_w;
-    state.h = window_h;
+// Sets up the state that is shared by the windowed and offscreen renderers
+static void video_init_state(int w, int h, int fullscreen, int vsync, const char* scaler_name, int scale_factor) {
+    state.w = w;
+    state.h = h;
     state.fs = fullscreen;
     state.vsync = vsync;
     state.fade = 1.0f;
@@ -79,6 +85,33 @@ int video_init(int window_w,
     state.base_palette = malloc(sizeof(palette));
     memset(state.cur_palette, 0, sizeof(screen_palette));
     state.cur_palette->version = 1;
+}
+
+// Sets up rendertargets, texture cache and the renderer callbacks for state.renderer
+static void video_init_targets() {
+    // Default resolution for renderer. This will them get scaled up to screen size.
+    SDL_RenderSetLogicalSize(state.renderer,
+                             NATIVE_W * state.scale_factor,
+                             NATIVE_H * state.scale_factor);
+
+    // Set rendertargets
+    reset_targets();
+
+    // Init texture cache
+    tcache_init(state.renderer, state.scale_factor, &state.scaler);
+
+    // Init hardware renderer
+    state.cur_renderer = VIDEO_RENDERER_HW;
+    video_hw_init(&state);
+}
+
+int video_init(int window_w,
+               int window_h,
+               int fullscreen,
+               int vsync,
+               const char* scaler_name,
+               int scale_factor) {
+    video_init_state(window_w, window_h, fullscreen, vsync, scaler_name, scale_factor);
 
     // Form title string
     char title[32];
@@ -124,23 +157,10 @@ int video_init(int window_w,
         return 1;
     }
 
-    // Default resolution for renderer. This will them get scaled up to screen size.
-    SDL_RenderSetLogicalSize(state.renderer,
-                             NATIVE_W * state.scale_factor,
-                             NATIVE_H * state.scale_factor);
-
     // Disable screensaver :/
     SDL_DisableScreenSaver();
 
-    // Set rendertargets
-    reset_targets();
-
-    // Init texture cache
-    tcache_init(state.renderer, state.scale_factor, &state.scaler);
-
-    // Init hardware renderer
-    state.cur_renderer = VIDEO_RENDERER_HW;
-    video_hw_init(&state);
+    video_init_targets();
 
     // Get renderer data
     SDL_RendererInfo rinfo;
@@ -156,7 +176,38 @@ int video_init(int window_w,
     return 0;
 }
 
+int video_init_offscreen(const char* scaler_name, int scale_factor) {
+    video_init_state(0, 0, 0, 0, scaler_name, scale_factor);
+    state.w = NATIVE_W * state.scale_factor;
+    state.h = NATIVE_H * state.scale_factor;
+    state.window = NULL;
+
+    // The software renderer draws straight into our own surface, so no display is needed.
+    offscreen = SDL_CreateRGBSurfaceWithFormat(0, state.w, state.h, 32, SDL_PIXELFORMAT_ABGR8888);
+    if(offscreen == NULL) {
+        PERROR("Could not create offscreen surface: %s", SDL_GetError());
+        return 1;
+    }
+    state.renderer = SDL_CreateSoftwareRenderer(offscreen);
+    if(state.renderer == NULL) {
+        PERROR("Could not create offscreen renderer: %s", SDL_GetError());
+        SDL_FreeSurface(offscreen);
+        offscreen = NULL;
+        return 1;
+    }
+
+    video_init_targets();
+
+    INFO("Video Init OK");
+    INFO(" * Renderer: offscreen software, %dx%d", state.w, state.h);
+    return 0;
+}
+
 void video_reinit_renderer() {
+    if(offscreen != NULL) {
+        return;
+    }
+
     // Clear old texture cache entries
     tcache_clear();
 
@@ -185,6 +236,11 @@ int video_reinit(int window_w,
                  const char* scaler_name,
                  int scale_factor) {
 
+    // The offscreen surface is fixed for the whole run
+    if(offscreen != NULL) {
+        return 0;
+    }
+
     // Tells if something has changed in video settings
     int changed = 0;
 
@@ -251,7 +307,15 @@ int video_reinit(int window_w,
     return 0;
 }
 
+void video_init_headless() {
+    headless = 1;
+    INFO("Video running headless.");
+}
+
 void video_move_target(int x, int y) {
+    if(headless) {
+        return;
+    }
     state.target_move_x = x * state.scale_factor;
     state.target_move_y = y * state.scale_factor;
 }
@@ -272,7 +336,7 @@ void video_get_state(int *w, int *h, int *fs, int *vsync) {
 }
 
 void video_select_renderer(int renderer) {
-    if(renderer == state.cur_renderer) {
+    if(headless || renderer == state.cur_renderer) {
         return;
     }
     state.cb.render_close(&state);
@@ -288,6 +352,9 @@ void video_select_renderer(int renderer) {
 }
 
 void video_set_fade(float fade) {
+    if(headless) {
+        return;
+    }
     state.fade = fade;
 }
 
@@ -302,6 +369,9 @@ int video_screenshot(image *img) {
 }
 
 int video_area_capture(surface *sur, int x, int y, int w, int h) {
+    if(headless) {
+        return 1;
+    }
     float scale_x = (float)state.w / NATIVE_W;
     float scale_y = (float)state.h / NATIVE_H;
 
@@ -327,21 +397,34 @@ int video_area_capture(surface *sur, int x, int y, int w, int h) {
 }
 
 void video_force_pal_refresh() {
+    if(headless) {
+        return;
+    }
     memcpy(state.cur_palette->data, state.base_palette->data, 768);
     state.cur_palette->version++;
 }
 
 void video_set_base_palette(const palette *src) {
+    if(headless) {
+        memcpy(&headless_palette, src, sizeof(palette));
+        return;
+    }
     memcpy(state.base_palette, src, sizeof(palette));
     memcpy(state.cur_palette->data, state.base_palette->data, 768);
     state.cur_palette->version++;
 }
 
 palette *video_get_base_palette() {
+    if(headless) {
+        return &headless_palette;
+    }
     return state.base_palette;
 }
 
 void video_copy_pal_range(const palette *src, int src_start, int dst_start, int amount) {
+    if(headless) {
+        return;
+    }
     memcpy(state.cur_palette->data + dst_start * 3,
            src->data + src_start * 3,
            amount * 3);
@@ -512,6 +595,11 @@ void video_render_finish() {
     // Tell software/hardware renderer to finish up whatever it was doing
     state.cb.render_finish(&state);
 
+    // Grab the finished frame before the target is composited to the screen
+    if(capture_is_running()) {
+        capture_grab(state.renderer, state.scale_factor);
+    }
+
     // Set our rendertarget to screen buffer.
     SDL_SetRenderTarget(state.renderer, NULL);
 
@@ -536,17 +624,37 @@ void video_render_finish() {
 
     // Flip buffers. If vsync is off, we should sleep here
     // so hat our main loop doesn't eat up all cpu :)
+    // Offscreen, this only flushes the queued draws to the surface.
     SDL_RenderPresent(state.renderer);
-    if(!state.vsync) {
+    if(!state.vsync && offscreen == NULL) {
         SDL_Delay(1);
     }
 }
 
+int video_is_offscreen() {
+    return offscreen != NULL;
+}
+
+uint32_t video_offscreen_hash() {
+    if(offscreen == NULL) {
+        return 0;
+    }
+    SDL_LockSurface(offscreen);
+    uint32_t hash = statehash_data(offscreen->pixels, offscreen->pitch * offscreen->h);
+    SDL_UnlockSurface(offscreen);
+    return hash;
+}
+
 void video_close() {
     state.cb.render_close(&state);
     SDL_DestroyTexture(state.target);
     SDL_DestroyRenderer(state.renderer);
-    SDL_DestroyWindow(state.window);
+    if(offscreen != NULL) {
+        SDL_FreeSurface(offscreen);
+        offscreen = NULL;
+    } else {
+        SDL_DestroyWindow(state.window);
+    }
     free(state.cur_palette);
     free(state.base_palette);
     tcache_close();
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include "video/video_soft.h"
 #include "utils/log.h"
+#include "utils/profiler.h"
 
 /*
 * This is a software renderer for the special cases where the hardware renderer
@@ -64,7 +65,9 @@ void soft_render_finish(video_state *state) {
     if(state->scale_factor > 1) {
         int nw = 320 * state->scale_factor;
         int nh = 200 * state->scale_factor;
+        PROFILE_BEGIN("scaler");
         scaler_scale(&state->scaler, sr->tmp_normal, sr->tmp_scaling, 320, 200, state->scale_factor);
+        PROFILE_END();
         low_s = surface_from_pixels(sr->tmp_scaling, nw, nh);
     } else {
         low_s = surface_from_pixels(sr->tmp_normal, 320, 200);
@@ -0,0 +1,315 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <utils/flatmap.h>
+#include <utils/hashmap.h>
+#include <utils/iterator.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#define TEST_VAL_COUNT 1000
+#define BENCH_COUNT 1000
+#define BENCH_ROUNDS 2000
+#define BENCH_KEY(i) (((i) * 7919) % BENCH_COUNT) // Looks up the keys out of insertion order
+
+typedef struct test_key_t {
+    void *ptr;
+    unsigned short w, h;
+    unsigned char c;
+} test_key;
+
+flatmap test_fmap;
+unsigned int test_fvalues[TEST_VAL_COUNT];
+
+void test_flatmap_create(void) {
+    flatmap_create(&test_fmap, sizeof(unsigned int), sizeof(unsigned int));
+    CU_ASSERT_PTR_NOT_NULL(test_fmap.slots);
+    CU_ASSERT(flatmap_reserved(&test_fmap) == 0);
+    CU_ASSERT(flatmap_size(&test_fmap) == 16);
+}
+
+void test_flatmap_insert(void) {
+    unsigned int i, k;
+    unsigned int *v;
+    for(i = 0; i < TEST_VAL_COUNT; i++) {
+        k = TEST_VAL_COUNT - i;
+        v = flatmap_iput(&test_fmap, i, &k);
+        CU_ASSERT_PTR_NOT_NULL(v);
+        CU_ASSERT(*v == k);
+        test_fvalues[i] = k;
+    }
+    CU_ASSERT(flatmap_reserved(&test_fmap) == TEST_VAL_COUNT);
+    CU_ASSERT(flatmap_size(&test_fmap) == 2048);
+
+    // Re-adding with a key already in the map replaces the value
+    i = TEST_VAL_COUNT / 2;
+    k = 12345;
+    v = flatmap_put(&test_fmap, &i, &k);
+    CU_ASSERT(*v == 12345);
+    CU_ASSERT(flatmap_reserved(&test_fmap) == TEST_VAL_COUNT);
+    k = test_fvalues[i];
+    flatmap_iput(&test_fmap, i, &k);
+}
+
+void test_flatmap_get(void) {
+    for(unsigned int i = 0; i < TEST_VAL_COUNT; i++) {
+        unsigned int *val = flatmap_iget(&test_fmap, i);
+        CU_ASSERT_FATAL(val != NULL);
+        CU_ASSERT(*val == test_fvalues[i]);
+        CU_ASSERT(flatmap_get(&test_fmap, &i) == val);
+    }
+    CU_ASSERT_PTR_NULL(flatmap_iget(&test_fmap, TEST_VAL_COUNT));
+}
+
+void test_flatmap_delete(void) {
+    int removed = 0;
+    for(unsigned int i = 0; i < TEST_VAL_COUNT; i += 10) {
+        CU_ASSERT(flatmap_idel(&test_fmap, i) == 0);
+        CU_ASSERT(flatmap_del(&test_fmap, &i) == 1);
+        CU_ASSERT_PTR_NULL(flatmap_iget(&test_fmap, i));
+        test_fvalues[i] = 0;
+        removed++;
+    }
+    CU_ASSERT(flatmap_reserved(&test_fmap) == TEST_VAL_COUNT - removed);
+
+    // Everything else must still be reachable after the shifts
+    for(unsigned int i = 0; i < TEST_VAL_COUNT; i++) {
+        if(test_fvalues[i] > 0) {
+            unsigned int *val = flatmap_iget(&test_fmap, i);
+            CU_ASSERT_FATAL(val != NULL);
+            CU_ASSERT(*val == test_fvalues[i]);
+        }
+    }
+}
+
+void test_flatmap_iterator(void) {
+    iterator it;
+    flatmap_pair *pair;
+    flatmap_iter_begin(&test_fmap, &it);
+    while((pair = iter_next(&it)) != NULL) {
+        unsigned int *key = pair->key;
+        unsigned int *val = pair->val;
+        CU_ASSERT(pair->keylen == sizeof(int));
+        CU_ASSERT(pair->vallen == sizeof(int));
+        CU_ASSERT(*key == (TEST_VAL_COUNT - *val));
+        CU_ASSERT(test_fvalues[*key] > 0);
+        test_fvalues[*key] = 0;
+    }
+    for(unsigned int i = 0; i < TEST_VAL_COUNT; i++) {
+        CU_ASSERT(test_fvalues[i] == 0);
+    }
+}
+
+void test_flatmap_iter_del(void) {
+    // Delete every other entry while iterating; all entries must be seen once
+    unsigned int seen[TEST_VAL_COUNT] = {0};
+    unsigned int count = flatmap_reserved(&test_fmap);
+    unsigned int visits = 0;
+    int odd = 0;
+    iterator it;
+    flatmap_pair *pair;
+    flatmap_iter_begin(&test_fmap, &it);
+    while((pair = iter_next(&it)) != NULL) {
+        seen[*(unsigned int*)pair->key]++;
+        visits++;
+        if((odd = !odd)) {
+            CU_ASSERT(flatmap_delete(&test_fmap, &it) == 0);
+            CU_ASSERT(flatmap_delete(&test_fmap, &it) == 1);
+        }
+    }
+    CU_ASSERT(visits == count);
+    CU_ASSERT(flatmap_reserved(&test_fmap) == count / 2);
+    for(unsigned int i = 0; i < TEST_VAL_COUNT; i++) {
+        CU_ASSERT(seen[i] <= 1);
+    }
+
+    flatmap_iter_begin(&test_fmap, &it);
+    while((pair = iter_next(&it)) != NULL) {
+        CU_ASSERT(flatmap_delete(&test_fmap, &it) == 0);
+    }
+    CU_ASSERT(flatmap_reserved(&test_fmap) == 0);
+}
+
+void test_flatmap_clear(void) {
+    for(unsigned int i = 0; i < TEST_VAL_COUNT; i++) {
+        flatmap_iput(&test_fmap, i, &i);
+    }
+    flatmap_clear(&test_fmap);
+    CU_ASSERT(flatmap_reserved(&test_fmap) == 0);
+    CU_ASSERT_PTR_NULL(flatmap_iget(&test_fmap, 1));
+}
+
+void test_flatmap_free(void) {
+    flatmap_free(&test_fmap);
+    CU_ASSERT_PTR_NULL(test_fmap.slots);
+    CU_ASSERT(test_fmap.reserved == 0);
+    CU_ASSERT(test_fmap.capacity == 0);
+}
+
+void test_flatmap_struct_key(void) {
+    flatmap map;
+    test_key key;
+    double val;
+    flatmap_create(&map, sizeof(test_key), sizeof(double));
+    memset(&key, 0, sizeof(test_key));
+    for(unsigned int i = 0; i < TEST_VAL_COUNT; i++) {
+        key.ptr = &test_fvalues[i];
+        key.w = i;
+        val = i * 0.5;
+        flatmap_put(&map, &key, &val);
+    }
+    for(unsigned int i = 0; i < TEST_VAL_COUNT; i++) {
+        key.ptr = &test_fvalues[i];
+        key.w = i;
+        double *v = flatmap_get(&map, &key);
+        CU_ASSERT_FATAL(v != NULL);
+        CU_ASSERT_DOUBLE_EQUAL(*v, i * 0.5, 0.001);
+        CU_ASSERT(((size_t)v & 7) == 0);
+    }
+    key.h = 1;
+    CU_ASSERT_PTR_NULL(flatmap_get(&map, &key));
+    flatmap_free(&map);
+}
+
+static double bench_ms(clock_t start) {
+    return (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+// Integer keys and small values, like the BK infos and audio streams
+void test_flatmap_bench(void) {
+    hashmap hm;
+    flatmap fm;
+    unsigned int sum_h = 0, sum_f = 0;
+    unsigned int *val, len;
+    clock_t start;
+    double h_put, h_get, h_del, f_put, f_get, f_del;
+
+    hashmap_create(&hm, 8);
+    hashmap_set_opts(&hm, HASHMAP_AUTO_INC, 0.25, 0.75, 8, 20);
+    start = clock();
+    for(unsigned int i = 0; i < BENCH_COUNT; i++) {
+        hashmap_iput(&hm, i * 7, &i, sizeof(unsigned int));
+    }
+    h_put = bench_ms(start);
+    start = clock();
+    for(int r = 0; r < BENCH_ROUNDS; r++) {
+        for(unsigned int k = 0; k < BENCH_COUNT; k++) {
+            unsigned int i = BENCH_KEY(k);
+            if(hashmap_iget(&hm, i * 7, (void**)&val, &len) == 0) {
+                sum_h += *val;
+            }
+        }
+    }
+    h_get = bench_ms(start);
+    start = clock();
+    for(unsigned int i = 0; i < BENCH_COUNT; i++) {
+        hashmap_idel(&hm, i * 7);
+    }
+    h_del = bench_ms(start);
+    hashmap_free(&hm);
+
+    flatmap_create(&fm, sizeof(unsigned int), sizeof(unsigned int));
+    start = clock();
+    for(unsigned int i = 0; i < BENCH_COUNT; i++) {
+        flatmap_iput(&fm, i * 7, &i);
+    }
+    f_put = bench_ms(start);
+    start = clock();
+    for(int r = 0; r < BENCH_ROUNDS; r++) {
+        for(unsigned int k = 0; k < BENCH_COUNT; k++) {
+            unsigned int i = BENCH_KEY(k);
+            if((val = flatmap_iget(&fm, i * 7)) != NULL) {
+                sum_f += *val;
+            }
+        }
+    }
+    f_get = bench_ms(start);
+    start = clock();
+    for(unsigned int i = 0; i < BENCH_COUNT; i++) {
+        flatmap_idel(&fm, i * 7);
+    }
+    f_del = bench_ms(start);
+    CU_ASSERT(flatmap_reserved(&fm) == 0);
+    flatmap_free(&fm);
+
+    CU_ASSERT(sum_h == sum_f);
+    printf("\n      %d int keys    put      get x%d   del\n", BENCH_COUNT, BENCH_ROUNDS);
+    printf("      hashmap   %8.2fms %8.2fms %8.2fms\n", h_put, h_get, h_del);
+    printf("      flatmap   %8.2fms %8.2fms %8.2fms\n", f_put, f_get, f_del);
+}
+
+// Struct keys, like the texture cache
+void test_flatmap_bench_struct(void) {
+    hashmap hm;
+    flatmap fm;
+    test_key key;
+    unsigned int hits_h = 0, hits_f = 0;
+    unsigned int *val, len;
+    clock_t start;
+    double h_put, h_get, f_put, f_get;
+
+    memset(&key, 0, sizeof(test_key));
+    hashmap_create(&hm, 8);
+    hashmap_set_opts(&hm, HASHMAP_AUTO_INC, 0.25, 0.75, 8, 20);
+    start = clock();
+    for(unsigned int i = 0; i < BENCH_COUNT; i++) {
+        key.ptr = (void*)(uintptr_t)(i * 64);
+        key.w = i;
+        hashmap_put(&hm, &key, sizeof(test_key), &i, sizeof(unsigned int));
+    }
+    h_put = bench_ms(start);
+    start = clock();
+    for(int r = 0; r < BENCH_ROUNDS; r++) {
+        for(unsigned int k = 0; k < BENCH_COUNT; k++) {
+            unsigned int i = BENCH_KEY(k);
+            key.ptr = (void*)(uintptr_t)(i * 64);
+            key.w = i;
+            hits_h += (hashmap_get(&hm, &key, sizeof(test_key), (void**)&val, &len) == 0);
+        }
+    }
+    h_get = bench_ms(start);
+    hashmap_free(&hm);
+
+    flatmap_create(&fm, sizeof(test_key), sizeof(unsigned int));
+    start = clock();
+    for(unsigned int i = 0; i < BENCH_COUNT; i++) {
+        key.ptr = (void*)(uintptr_t)(i * 64);
+        key.w = i;
+        flatmap_put(&fm, &key, &i);
+    }
+    f_put = bench_ms(start);
+    start = clock();
+    for(int r = 0; r < BENCH_ROUNDS; r++) {
+        for(unsigned int k = 0; k < BENCH_COUNT; k++) {
+            unsigned int i = BENCH_KEY(k);
+            key.ptr = (void*)(uintptr_t)(i * 64);
+            key.w = i;
+            hits_f += (flatmap_get(&fm, &key) != NULL);
+        }
+    }
+    f_get = bench_ms(start);
+    flatmap_free(&fm);
+
+    CU_ASSERT(hits_h == BENCH_COUNT * BENCH_ROUNDS);
+    CU_ASSERT(hits_f == hits_h);
+    printf("\n      %d struct keys put      get x%d\n", BENCH_COUNT, BENCH_ROUNDS);
+    printf("      hashmap   %8.2fms %8.2fms\n", h_put, h_get);
+    printf("      flatmap   %8.2fms %8.2fms\n", f_put, f_get);
+}
+
+void flatmap_test_suite(CU_pSuite suite) {
+    // Add tests
+    if(CU_add_test(suite, "Test for flatmap create", test_flatmap_create) == NULL) { return; }
+    if(CU_add_test(suite, "Test for flatmap insert operation", test_flatmap_insert) == NULL) { return; }
+    if(CU_add_test(suite, "Test for flatmap get operation", test_flatmap_get) == NULL) { return; }
+    if(CU_add_test(suite, "Test for flatmap delete operation", test_flatmap_delete) == NULL) { return; }
+    if(CU_add_test(suite, "Test for flatmap iterator", test_flatmap_iterator) == NULL) { return; }
+    if(CU_add_test(suite, "Test for flatmap insert operation", test_flatmap_insert) == NULL) { return; }
+    if(CU_add_test(suite, "Test for flatmap iterator delete operation", test_flatmap_iter_del) == NULL) { return; }
+    if(CU_add_test(suite, "Test for flatmap clear operation", test_flatmap_clear) == NULL) { return; }
+    if(CU_add_test(suite, "Test for flatmap free operation", test_flatmap_free) == NULL) { return; }
+    if(CU_add_test(suite, "Test for flatmap struct keys", test_flatmap_struct_key) == NULL) { return; }
+    if(CU_add_test(suite, "Benchmark flatmap against hashmap, int keys", test_flatmap_bench) == NULL) { return; }
+    if(CU_add_test(suite, "Benchmark flatmap against hashmap, struct keys", test_flatmap_bench_struct) == NULL) { return; }
+}
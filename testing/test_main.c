@@ -3,10 +3,23 @@
 
 void str_test_suite(CU_pSuite suite);
 void hashmap_test_suite(CU_pSuite suite);
+void flatmap_test_suite(CU_pSuite suite);
 void vector_test_suite(CU_pSuite suite);
 void list_test_suite(CU_pSuite suite);
 void array_test_suite(CU_pSuite suite);
 void text_render_test_suite(CU_pSuite suite);
+void mixer_test_suite(CU_pSuite suite);
+void mem_pool_test_suite(CU_pSuite suite);
+void net_thread_test_suite(CU_pSuite suite);
+void net_input_test_suite(CU_pSuite suite);
+void net_emu_test_suite(CU_pSuite suite);
+void net_clock_test_suite(CU_pSuite suite);
+void net_relay_test_suite(CU_pSuite suite);
+void net_mux_test_suite(CU_pSuite suite);
+void match_start_test_suite(CU_pSuite suite);
+void rec_writer_test_suite(CU_pSuite suite);
+void particles_test_suite(CU_pSuite suite);
+void surface_test_suite(CU_pSuite suite);
 
 int main(int argc, char **argv) {
     if(CU_initialize_registry() != CUE_SUCCESS) {
@@ -22,6 +35,10 @@ int main(int argc, char **argv) {
     if(hashmap_suite == NULL) goto end;
     hashmap_test_suite(hashmap_suite);
 
+    CU_pSuite flatmap_suite = CU_add_suite("Flatmap", NULL, NULL);
+    if(flatmap_suite == NULL) goto end;
+    flatmap_test_suite(flatmap_suite);
+
     CU_pSuite vector_suite = CU_add_suite("Vector", NULL, NULL);
     if(vector_suite == NULL) goto end;
     vector_test_suite(vector_suite);
@@ -38,6 +55,54 @@ int main(int argc, char **argv) {
     if(text_render_suite == NULL) goto end;
     text_render_test_suite(text_render_suite);
 
+    CU_pSuite mixer_suite = CU_add_suite("Mixer", NULL, NULL);
+    if(mixer_suite == NULL) goto end;
+    mixer_test_suite(mixer_suite);
+
+    CU_pSuite mem_pool_suite = CU_add_suite("Memory pools", NULL, NULL);
+    if(mem_pool_suite == NULL) goto end;
+    mem_pool_test_suite(mem_pool_suite);
+
+    CU_pSuite net_thread_suite = CU_add_suite("Net thread", NULL, NULL);
+    if(net_thread_suite == NULL) goto end;
+    net_thread_test_suite(net_thread_suite);
+
+    CU_pSuite net_input_suite = CU_add_suite("Net input", NULL, NULL);
+    if(net_input_suite == NULL) goto end;
+    net_input_test_suite(net_input_suite);
+
+    CU_pSuite net_emu_suite = CU_add_suite("Net emulator", NULL, NULL);
+    if(net_emu_suite == NULL) goto end;
+    net_emu_test_suite(net_emu_suite);
+
+    CU_pSuite net_clock_suite = CU_add_suite("Net clock", NULL, NULL);
+    if(net_clock_suite == NULL) goto end;
+    net_clock_test_suite(net_clock_suite);
+
+    CU_pSuite net_relay_suite = CU_add_suite("Net relay", NULL, NULL);
+    if(net_relay_suite == NULL) goto end;
+    net_relay_test_suite(net_relay_suite);
+
+    CU_pSuite net_mux_suite = CU_add_suite("Net mux", NULL, NULL);
+    if(net_mux_suite == NULL) goto end;
+    net_mux_test_suite(net_mux_suite);
+
+    CU_pSuite match_start_suite = CU_add_suite("Match start", NULL, NULL);
+    if(match_start_suite == NULL) goto end;
+    match_start_test_suite(match_start_suite);
+
+    CU_pSuite rec_writer_suite = CU_add_suite("Rec writer", NULL, NULL);
+    if(rec_writer_suite == NULL) goto end;
+    rec_writer_test_suite(rec_writer_suite);
+
+    CU_pSuite particles_suite = CU_add_suite("Particles", NULL, NULL);
+    if(particles_suite == NULL) goto end;
+    particles_test_suite(particles_suite);
+
+    CU_pSuite surface_suite = CU_add_suite("Surface", NULL, NULL);
+    if(surface_suite == NULL) goto end;
+    surface_test_suite(surface_suite);
+
     // Run tests
     CU_basic_set_mode(CU_BRM_VERBOSE);
     CU_basic_run_tests();
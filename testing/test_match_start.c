@@ -0,0 +1,206 @@
+#include <string.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <SDL2/SDL.h>
+#include <enet/enet.h>
+#include <controller/net_controller.h>
+#include <controller/net_mux.h>
+#include <game/match_start.h>
+#include <game/common_defines.h>
+#include <game/game_state_type.h>
+#include <game/utils/serial.h>
+#include "test_net_util.h"
+
+#define TEST_PORT 22103
+#define TEST_SEED 0xC0FFEE
+#define TEST_SYNC "state"
+
+net_mux *mux;
+net_link *links[2];
+controller servers[2]; // Like the match server sets them up
+controller clients[2]; // Like the connect menu sets them up
+ctrl_event *server_events[2];
+ctrl_event *client_events[2];
+int ticks;
+
+static void test_fill_start(match_start *start, int slot) {
+    memset(start, 0, sizeof(match_start));
+    start->slot = slot;
+    start->scene_id = SCENE_ARENA2;
+    start->seed = TEST_SEED;
+    start->players[0].har_id = HAR_THORN;
+    start->players[0].pilot_id = 3;
+    start->players[1].har_id = HAR_NOVA;
+    start->players[1].colors[2] = 200;
+}
+
+// Ticks every controller of the match once; their events pile up until cleared
+static void test_tick() {
+    for(int i = 0; i < 2; i++) {
+        controller_tick(&servers[i], ticks, &server_events[i]);
+        controller_tick(&clients[i], ticks, &client_events[i]);
+    }
+    ticks++;
+}
+
+static void test_clear_events() {
+    for(int i = 0; i < 2; i++) {
+        controller_free_chain(server_events[i]);
+        controller_free_chain(client_events[i]);
+        server_events[i] = NULL;
+        client_events[i] = NULL;
+    }
+}
+
+// Ticks the match until one of the events is of the type
+static ctrl_event* test_wait_event(ctrl_event **events, int type) {
+    unsigned int start = SDL_GetTicks();
+    while(SDL_GetTicks() - start < TEST_NET_TIMEOUT) {
+        test_tick();
+        for(ctrl_event *ev = *events; ev != NULL; ev = ev->next) {
+            if(ev->type == type) {
+                return ev;
+            }
+        }
+        SDL_Delay(1);
+    }
+    return NULL;
+}
+
+static int test_get_start(controller *ctrl, match_start *start) {
+    serial ser;
+    serial_create(&ser);
+    int got = net_controller_get_start(ctrl, &ser) && match_start_read(&ser, start);
+    serial_free(&ser);
+    return got;
+}
+
+void test_match_start_message(void) {
+    match_start start, got;
+    serial ser;
+    test_fill_start(&start, 1);
+    serial_create(&ser);
+    match_start_write(&ser, &start);
+    CU_ASSERT(match_start_read(&ser, &got));
+    CU_ASSERT(memcmp(&start, &got, sizeof(match_start)) == 0);
+
+    // Anything else is turned down
+    serial_read_reset(&ser);
+    ser.len--;
+    CU_ASSERT(!match_start_read(&ser, &got));
+    serial_reset(&ser);
+    start.slot = 2;
+    match_start_write(&ser, &start);
+    CU_ASSERT(!match_start_read(&ser, &got));
+    serial_reset(&ser);
+    start.slot = 0;
+    start.scene_id = SCENE_MENU;
+    match_start_write(&ser, &start);
+    CU_ASSERT(!match_start_read(&ser, &got));
+    serial_free(&ser);
+}
+
+void test_match_start_connect(void) {
+    CU_ASSERT_FATAL(enet_initialize() == 0);
+    mux = net_mux_create(TEST_PORT, 2, ROLE_SERVER);
+    CU_ASSERT_FATAL(mux != NULL);
+    for(int i = 0; i < 2; i++) {
+        net_thread *thread = test_net_client(TEST_PORT, ROLE_CLIENT, NULL);
+        CU_ASSERT_FATAL(thread != NULL);
+        controller_init(&clients[i]);
+        net_controller_create(&clients[i], thread, ROLE_CLIENT);
+
+        // The first client in plays player 1
+        unsigned int start = SDL_GetTicks();
+        while((links[i] = net_mux_accept(mux)) == NULL && SDL_GetTicks() - start < TEST_NET_TIMEOUT) {
+            SDL_Delay(1);
+        }
+        CU_ASSERT_FATAL(links[i] != NULL);
+        controller_init(&servers[i]);
+        net_controller_create_link(&servers[i], links[i], ROLE_SERVER);
+    }
+
+    // The clients stay put until the server has set up the match
+    match_start start, got;
+    serial ser;
+    for(int i = 0; i < 30; i++) {
+        test_tick();
+        SDL_Delay(1);
+    }
+    CU_ASSERT(!test_get_start(&clients[0], &got));
+    for(int i = 0; i < 2; i++) {
+        test_fill_start(&start, i);
+        serial_create(&ser);
+        match_start_write(&ser, &start);
+        net_link_send(links[i], 1, ser.data, ser.len, ENET_PACKET_FLAG_RELIABLE);
+        serial_free(&ser);
+    }
+    for(int i = 0; i < 2; i++) {
+        unsigned int wait = SDL_GetTicks();
+        while(!(net_controller_ready(&clients[i]) && test_get_start(&clients[i], &got))
+              && SDL_GetTicks() - wait < TEST_NET_TIMEOUT) {
+            test_tick();
+            SDL_Delay(1);
+        }
+        CU_ASSERT_FATAL(net_controller_ready(&clients[i]));
+        CU_ASSERT_FATAL(test_get_start(&clients[i], &got));
+        test_fill_start(&start, i);
+        CU_ASSERT(memcmp(&start, &got, sizeof(match_start)) == 0);
+    }
+    test_clear_events();
+}
+
+void test_match_start_play(void) {
+    serial ser;
+    ctrl_event *ev;
+
+    // A client's moves go to its own player on the server, and only there
+    net_controller_har_hook(ACT_PUNCH, &clients[1]);
+    net_controller_har_hook(ACT_FLUSH, &clients[1]);
+    ev = test_wait_event(&server_events[1], EVENT_TYPE_ACTION);
+    CU_ASSERT_FATAL(ev != NULL);
+    CU_ASSERT(ev->event_data.action == ACT_PUNCH);
+    CU_ASSERT(server_events[0] == NULL);
+    test_clear_events();
+
+    // The server's state gets to both clients
+    serial_create(&ser);
+    serial_write(&ser, TEST_SYNC, sizeof(TEST_SYNC));
+    for(int i = 0; i < 2; i++) {
+        controller_update(&servers[i], &ser);
+    }
+    serial_free(&ser);
+    for(int i = 0; i < 2; i++) {
+        ev = test_wait_event(&client_events[i], EVENT_TYPE_SYNC);
+        CU_ASSERT_FATAL(ev != NULL);
+        CU_ASSERT(ev->event_data.ser->len == sizeof(TEST_SYNC) + 1);
+        CU_ASSERT(strcmp(ev->event_data.ser->data + 1, TEST_SYNC) == 0);
+    }
+    test_clear_events();
+}
+
+void test_match_start_end(void) {
+    // The server lets go of the links when the match is over
+    for(int i = 0; i < 2; i++) {
+        net_controller_free(&servers[i]);
+        servers[i].tick_fun = NULL;
+    }
+    for(int i = 0; i < 2; i++) {
+        CU_ASSERT(test_wait_event(&client_events[i], EVENT_TYPE_CLOSE) != NULL);
+    }
+    test_clear_events();
+    for(int i = 0; i < 2; i++) {
+        net_controller_free(&clients[i]);
+    }
+    net_mux_free(mux);
+    CU_ASSERT(net_thread_wait_closed(TEST_NET_TIMEOUT) == 0);
+    enet_deinitialize();
+}
+
+void match_start_test_suite(CU_pSuite suite) {
+    // Add tests
+    if(CU_add_test(suite, "Test for match start message", test_match_start_message) == NULL) { return; }
+    if(CU_add_test(suite, "Test for match start over a server link", test_match_start_connect) == NULL) { return; }
+    if(CU_add_test(suite, "Test for match moves and syncs", test_match_start_play) == NULL) { return; }
+    if(CU_add_test(suite, "Test for match end", test_match_start_end) == NULL) { return; }
+}
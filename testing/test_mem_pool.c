@@ -0,0 +1,203 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <utils/mem_pool.h>
+#include <utils/mem_arena.h>
+#include <utils/list.h>
+#include <utils/hashmap.h>
+#include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define TEST_ITEMS 100
+
+void test_mem_pool_alloc(void) {
+    mem_pool pool;
+    void *items[TEST_ITEMS];
+    mem_pool_create(&pool, 24, 16);
+    for(int i = 0; i < TEST_ITEMS; i++) {
+        items[i] = mem_pool_alloc(&pool);
+        CU_ASSERT_PTR_NOT_NULL(items[i]);
+        CU_ASSERT(((uintptr_t)items[i] & 7) == 0);
+        CU_ASSERT(mem_pool_owns(&pool, items[i]));
+        memset(items[i], i, 24);
+    }
+    CU_ASSERT(pool.block_count == 7);
+    CU_ASSERT(mem_pool_get_stats(&pool)->in_use == TEST_ITEMS);
+    for(int i = 0; i < TEST_ITEMS; i++) {
+        CU_ASSERT(((unsigned char*)items[i])[23] == i);
+    }
+
+    // Released items are used again before the pool grows
+    mem_pool_release(&pool, items[10]);
+    mem_pool_release(&pool, items[20]);
+    CU_ASSERT(mem_pool_alloc(&pool) == items[20]);
+    CU_ASSERT(mem_pool_alloc(&pool) == items[10]);
+    CU_ASSERT(pool.block_count == 7);
+
+    const mem_stats *stats = mem_pool_get_stats(&pool);
+    CU_ASSERT(stats->allocs == TEST_ITEMS + 2);
+    CU_ASSERT(stats->frees == 2);
+    CU_ASSERT(stats->peak == TEST_ITEMS);
+    CU_ASSERT(stats->reserved == 7 * 16 * 24);
+
+    // Memory from elsewhere goes back to free()
+    void *other = malloc(24);
+    CU_ASSERT(!mem_pool_owns(&pool, other));
+    mem_pool_release(&pool, other);
+    CU_ASSERT(mem_pool_get_stats(&pool)->frees == 2);
+    mem_pool_free(&pool);
+    CU_ASSERT_PTR_NULL(pool.blocks);
+}
+
+void test_mem_arena_alloc(void) {
+    mem_arena arena;
+    mem_arena_create(&arena, 1024);
+    char *a = mem_arena_alloc(&arena, 10);
+    char *b = mem_arena_alloc(&arena, 10);
+    CU_ASSERT(b == a + 16);
+
+    // Larger than a chunk; must not waste the rest of the current one
+    char *big = mem_arena_alloc(&arena, 4000);
+    char *c = mem_arena_alloc(&arena, 8);
+    CU_ASSERT_PTR_NOT_NULL(big);
+    CU_ASSERT(c == b + 16);
+    memset(big, 0, 4000);
+    CU_ASSERT(mem_arena_get_stats(&arena)->in_use == 4);
+
+    mem_arena_reset(&arena);
+    CU_ASSERT(mem_arena_get_stats(&arena)->in_use == 0);
+    CU_ASSERT(mem_arena_get_stats(&arena)->frees == 4);
+    CU_ASSERT(mem_arena_alloc(&arena, 10) == a);
+    mem_arena_free(&arena);
+}
+
+void test_mem_pool_allocator(void) {
+    list l;
+    iterator it;
+    char big[300];
+    int *val;
+    list_create_with_allocator(&l, mem_pool_allocator());
+    for(int i = 0; i < TEST_ITEMS; i++) {
+        list_append(&l, &i, sizeof(int));
+    }
+    memset(big, 7, sizeof(big));
+    list_append(&l, big, sizeof(big));
+    int i = 0;
+    list_iter_begin(&l, &it);
+    while((val = iter_next(&it)) != NULL && i < TEST_ITEMS) {
+        CU_ASSERT(*val == i++);
+    }
+    mem_stats stats;
+    mem_pool_shared_stats(MEM_POOL_NODE_32, &stats);
+    CU_ASSERT(stats.in_use == TEST_ITEMS * 2 + 1); // Nodes and their data
+    list_free(&l);
+    mem_pool_shared_stats(MEM_POOL_NODE_32, &stats);
+    CU_ASSERT(stats.in_use == 0);
+
+    // Values that change size class on realloc
+    hashmap hm;
+    hashmap_create_with_allocator(&hm, 4, mem_pool_allocator());
+    unsigned int key = 1;
+    hashmap_put(&hm, &key, sizeof(key), big, 16);
+    char *v = hashmap_put(&hm, &key, sizeof(key), big, sizeof(big));
+    CU_ASSERT(v[sizeof(big) - 1] == 7);
+    v = hashmap_put(&hm, &key, sizeof(key), big, 4);
+    CU_ASSERT(v[3] == 7);
+    hashmap_free(&hm);
+    mem_pool_shared_stats(MEM_POOL_NODE_64, &stats);
+    CU_ASSERT(stats.in_use == 0);
+    mem_pool_shared_close();
+}
+
+static int free_list_thread(void *data) {
+    list_free(data);
+    return 0;
+}
+
+// A list built here and freed on a thread that never made pools of its own
+void test_mem_pool_allocator_thread(void) {
+    list l;
+    char big[300];
+    mem_stats stats;
+    list_create_with_allocator(&l, mem_pool_allocator());
+    for(int i = 0; i < TEST_ITEMS; i++) {
+        list_append(&l, &i, sizeof(int));
+    }
+    memset(big, 7, sizeof(big));
+    list_append(&l, big, sizeof(big));
+
+    SDL_Thread *thread = SDL_CreateThread(free_list_thread, "test free", &l);
+    CU_ASSERT_FATAL(thread != NULL);
+    SDL_WaitThread(thread, NULL);
+    mem_pool_shared_stats(MEM_POOL_NODE_32, &stats);
+    CU_ASSERT(stats.in_use == 0);
+    CU_ASSERT(stats.frees == stats.allocs);
+    mem_pool_shared_close();
+}
+
+void test_mem_arena_scene(void) {
+    list l;
+    list_create_with_allocator(&l, mem_arena_scene_allocator());
+    for(int i = 0; i < TEST_ITEMS; i++) {
+        list_append(&l, &i, sizeof(int));
+    }
+    CU_ASSERT(*(int*)list_get(&l, TEST_ITEMS - 1) == TEST_ITEMS - 1);
+    list_free(&l);
+
+    mem_stats stats;
+    mem_arena_scene_stats(&stats);
+    CU_ASSERT(stats.in_use == TEST_ITEMS * 2);
+    mem_arena_scene_reset();
+    mem_arena_scene_stats(&stats);
+    CU_ASSERT(stats.in_use == 0);
+    mem_arena_scene_close();
+}
+
+// Same as the AI lookahead: a second game state is loaded and freed on
+// the thread while the real one keeps its HAR hooks in the scene arena.
+void test_mem_arena_scene_swap(void) {
+    list hooks;
+    list shadow_hooks;
+    iterator it;
+    int *val;
+    mem_stats stats;
+    list_create_with_allocator(&hooks, mem_arena_scene_allocator());
+    for(int i = 0; i < TEST_ITEMS; i++) {
+        list_append(&hooks, &i, sizeof(int));
+    }
+
+    for(int round = 0; round < 3; round++) {
+        mem_arena *live = mem_arena_scene_swap(NULL);
+        list_create_with_allocator(&shadow_hooks, mem_arena_scene_allocator());
+        for(int i = 0; i < TEST_ITEMS; i++) {
+            int junk = -1;
+            list_append(&shadow_hooks, &junk, sizeof(int));
+        }
+        mem_arena_scene_reset(); // game_state_free
+        mem_arena_scene_stats(&stats);
+        CU_ASSERT(stats.in_use == 0);
+        mem_arena_scene_close();
+        CU_ASSERT(mem_arena_scene_swap(live) == NULL);
+    }
+
+    mem_arena_scene_stats(&stats);
+    CU_ASSERT(stats.in_use == TEST_ITEMS * 2);
+    int i = 0;
+    list_iter_begin(&hooks, &it);
+    while((val = iter_next(&it)) != NULL) {
+        CU_ASSERT(*val == i++);
+    }
+    CU_ASSERT(i == TEST_ITEMS);
+    list_free(&hooks);
+    mem_arena_scene_close();
+}
+
+void mem_pool_test_suite(CU_pSuite suite) {
+    if(CU_add_test(suite, "Test for memory pool alloc and release", test_mem_pool_alloc) == NULL) { return; }
+    if(CU_add_test(suite, "Test for memory arena alloc and reset", test_mem_arena_alloc) == NULL) { return; }
+    if(CU_add_test(suite, "Test for pool allocator", test_mem_pool_allocator) == NULL) { return; }
+    if(CU_add_test(suite, "Test for freeing pool nodes on another thread", test_mem_pool_allocator_thread) == NULL) { return; }
+    if(CU_add_test(suite, "Test for scene arena allocator", test_mem_arena_scene) == NULL) { return; }
+    if(CU_add_test(suite, "Test for swapping the scene arena", test_mem_arena_scene_swap) == NULL) { return; }
+}
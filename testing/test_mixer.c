@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <string.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <audio/sink.h>
+#include <audio/sinks/mixer.h>
+#include <audio/sources/raw_source.h>
+
+#define TEST_FREQUENCY 16000
+#define TEST_DATA_LEN 800 // 0.1s at 8kHz; 1600 frames of output
+
+audio_sink test_sink;
+char test_data[TEST_DATA_LEN];
+int16_t test_out[4096*2];
+
+void test_mixer_create(void) {
+    memset(test_data, 0xFF, TEST_DATA_LEN);
+    sink_init(&test_sink);
+    CU_ASSERT(mixer_sink_init(&test_sink, TEST_FREQUENCY, NULL, NULL) == 0);
+    CU_ASSERT(sink_has_samples(&test_sink));
+    CU_ASSERT(mixer_get_frequency(mixer_sink_get(&test_sink)) == TEST_FREQUENCY);
+}
+
+void test_mixer_silence(void) {
+    memset(test_out, 0x55, sizeof(test_out));
+    mixer_render(mixer_sink_get(&test_sink), test_out, 1000);
+    for(int i = 0; i < 1000*2; i++) {
+        CU_ASSERT_FATAL(test_out[i] == 0);
+    }
+}
+
+void test_mixer_sample(void) {
+    CU_ASSERT(sink_upload_sample(&test_sink, 1, test_data, TEST_DATA_LEN) == 0);
+    sink_play_sample(&test_sink, 1, 1.0f, -1.0f, 1.0f);
+    CU_ASSERT(sink_is_sample_playing(&test_sink, 1));
+
+    // Panned all the way left
+    mixer_render(mixer_sink_get(&test_sink), test_out, 1000);
+    CU_ASSERT(test_out[500*2] > 32000);
+    CU_ASSERT(test_out[500*2+1] == 0);
+    CU_ASSERT(sink_is_sample_playing(&test_sink, 1));
+
+    // Runs out after 1600 frames
+    mixer_render(mixer_sink_get(&test_sink), test_out, 1000);
+    CU_ASSERT(test_out[(1600-1000-10)*2] > 32000);
+    CU_ASSERT(test_out[(1600-1000+10)*2] == 0);
+    CU_ASSERT(!sink_is_sample_playing(&test_sink, 1));
+}
+
+void test_mixer_stream(void) {
+    audio_source *src = malloc(sizeof(audio_source));
+    source_init(src);
+    raw_source_init(src, test_data, TEST_DATA_LEN);
+    sink_play(&test_sink, src, 1, 0.5f, 0.0f, 1.0f);
+    CU_ASSERT(sink_is_playing(&test_sink, 1));
+
+    // Centered at half volume
+    mixer_render(mixer_sink_get(&test_sink), test_out, 1000);
+    CU_ASSERT(test_out[500*2] > 16000 && test_out[500*2] < 16500);
+    CU_ASSERT(test_out[500*2] == test_out[500*2+1]);
+    sink_render(&test_sink, 0);
+    CU_ASSERT(sink_is_playing(&test_sink, 1));
+
+    // Stream is dropped on the next sink update once the source has run out
+    mixer_render(mixer_sink_get(&test_sink), test_out, 1000);
+    sink_render(&test_sink, 0);
+    CU_ASSERT(!sink_is_playing(&test_sink, 1));
+}
+
+void test_mixer_free(void) {
+    sink_free(&test_sink);
+    CU_ASSERT_PTR_NULL(sink_get_userdata(&test_sink));
+}
+
+void mixer_test_suite(CU_pSuite suite) {
+    // Add tests
+    if(CU_add_test(suite, "Test for mixer create", test_mixer_create) == NULL) { return; }
+    if(CU_add_test(suite, "Test for mixer silence", test_mixer_silence) == NULL) { return; }
+    if(CU_add_test(suite, "Test for mixer sample playback", test_mixer_sample) == NULL) { return; }
+    if(CU_add_test(suite, "Test for mixer stream playback", test_mixer_stream) == NULL) { return; }
+    if(CU_add_test(suite, "Test for mixer free", test_mixer_free) == NULL) { return; }
+}
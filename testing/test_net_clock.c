@@ -0,0 +1,163 @@
+#include <stdlib.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <SDL2/SDL.h>
+#include <enet/enet.h>
+#include <controller/net_clock.h>
+#include <controller/net_thread.h>
+#include <controller/net_emu.h>
+#include <controller/controller.h>
+#include <game/utils/serial.h>
+#include <utils/random.h>
+#include "test_net_util.h"
+
+#define TEST_PORT 22098
+#define PEER_OFFSET 500
+
+// A heartbeat that takes out ticks to get to the peer and back ticks to return
+static void add_trip(net_clock *c, int sent, int out, int back, float rate) {
+    int peer_tick = (int)((sent + out) * rate) + PEER_OFFSET;
+    net_clock_add(c, sent, sent + out + back, peer_tick);
+}
+
+void test_net_clock_constant(void) {
+    net_clock c;
+    net_clock_create(&c);
+    for(int i = 0; i < NET_CLOCK_READY; i++) {
+        CU_ASSERT(net_clock_ready(&c) == 0);
+        add_trip(&c, i * 20, 3, 3, 1.0f);
+    }
+    CU_ASSERT(net_clock_ready(&c) == 1);
+    CU_ASSERT(c.rtt_median == 6 && c.rtt_p95 == 6);
+    CU_ASSERT(net_clock_peer_tick(&c, 1000) == 1000 + PEER_OFFSET);
+    CU_ASSERT(net_clock_oneway(&c) == 3);
+    CU_ASSERT(c.input_delay == 3 + NET_CLOCK_DELAY_MARGIN);
+}
+
+void test_net_clock_jitter(void) {
+    net_clock c;
+    struct random_t r;
+    net_clock_create(&c);
+    random_seed(&r, 1);
+    for(int i = 0; i < NET_CLOCK_SAMPLES; i++) {
+        add_trip(&c, i * 20, 2 + random_int(&r, 6), 2 + random_int(&r, 6), 1.0f);
+    }
+    // The least delayed trips pin the offset down despite the jitter
+    CU_ASSERT(abs(net_clock_peer_tick(&c, 1300) - (1300 + PEER_OFFSET)) <= 1);
+    CU_ASSERT(c.drift == 0);
+    CU_ASSERT(c.rtt_min >= 4 && c.rtt_p95 <= 14 && c.rtt_median <= c.rtt_p95);
+    CU_ASSERT(c.input_delay >= (c.rtt_p95 + 1) / 2);
+}
+
+void test_net_clock_drift(void) {
+    net_clock c;
+    net_clock_create(&c);
+    for(int i = 0; i < NET_CLOCK_SAMPLES * 2; i++) {
+        add_trip(&c, i * 100, 3, 3, 1.002f);
+    }
+    CU_ASSERT(c.drift > 1.5f && c.drift < 2.5f);
+    int local = 127 * 100 + 3 + 1000;
+    CU_ASSERT(abs(net_clock_peer_tick(&c, local) - ((int)(local * 1.002f) + PEER_OFFSET)) <= 1);
+}
+
+void test_net_clock_delay_hold(void) {
+    net_clock c;
+    int tick = 0;
+    net_clock_create(&c);
+    for(int i = 0; i < NET_CLOCK_SAMPLES; i++, tick += 20) {
+        add_trip(&c, tick, 10, 10, 1.0f);
+    }
+    int delay = c.input_delay;
+    CU_ASSERT(delay == 10 + NET_CLOCK_DELAY_MARGIN);
+
+    // Once the connection calms down, the delay comes down a tick at a time
+    for(int i = 0; i < NET_CLOCK_SAMPLES * 8; i++, tick += 20) {
+        add_trip(&c, tick, 1, 1, 1.0f);
+        CU_ASSERT(c.input_delay == delay || c.input_delay == delay - 1);
+        delay = c.input_delay;
+    }
+    CU_ASSERT(c.input_delay == 1 + NET_CLOCK_DELAY_MARGIN);
+}
+
+void test_net_clock_catchup(void) {
+    net_clock c;
+    net_clock_create(&c);
+    for(int i = 0; i < NET_CLOCK_READY; i++) {
+        add_trip(&c, i * 20, 3, 3, 1.0f);
+    }
+    CU_ASSERT(net_clock_catchup(&c, 0) == 3);
+    CU_ASSERT(net_clock_catchup(&c, 2) == 5);
+
+    // A message that waited in the queue for ages is only caught up on so far
+    CU_ASSERT(net_clock_catchup(&c, 500) == NET_CLOCK_MAX_DELAY);
+    CU_ASSERT(net_clock_catchup(&c, -500) == 3);
+}
+
+// Heartbeats over a real loopback connection with delay from the network emulator
+void test_net_clock_loopback(void) {
+    net_emu_config emu = {40, 0, 0, 0, 0, 1};
+    net_thread *server;
+    net_thread *client;
+    CU_ASSERT_FATAL(enet_initialize() == 0);
+    CU_ASSERT_FATAL(test_net_pair(TEST_PORT, &server, 1, &client, 2, &emu));
+
+    // Both ends tick every 10ms, the server PEER_OFFSET ticks ahead
+    net_clock c;
+    net_msg msg;
+    serial ser;
+    net_clock_create(&c);
+    unsigned int start = SDL_GetTicks();
+    int last_sent = -1;
+    while(!net_clock_ready(&c) && SDL_GetTicks() - start < TEST_NET_TIMEOUT) {
+        int tick = (SDL_GetTicks() - start) / 10;
+        net_thread_set_tick(server, tick + PEER_OFFSET);
+        if(tick != last_sent) {
+            serial_create(&ser);
+            serial_write_int8(&ser, EVENT_TYPE_HB);
+            serial_write_int8(&ser, 2);
+            serial_write_int32(&ser, tick);
+            net_thread_send(client, 0, ser.data, ser.len, ENET_PACKET_FLAG_UNSEQUENCED);
+            serial_free(&ser);
+            last_sent = tick;
+        }
+        while(net_thread_recv(client, &msg)) {
+            serial_create(&ser);
+            serial_write(&ser, msg.data, msg.len);
+            serial_read_int8(&ser);
+            serial_read_int8(&ser);
+            int sent = serial_read_int32(&ser);
+            int peer_tick = serial_read_int32(&ser);
+            net_clock_add(&c, sent, (msg.timestamp - start) / 10, peer_tick);
+            serial_free(&ser);
+            net_msg_free(&msg);
+        }
+        SDL_Delay(1);
+    }
+    CU_ASSERT(net_clock_ready(&c));
+    CU_ASSERT(c.rtt_median >= 8 && c.rtt_median <= 10);
+    CU_ASSERT(abs(net_clock_peer_tick(&c, last_sent) - (last_sent + PEER_OFFSET)) <= 1);
+
+    // Let the last heartbeats land before closing
+    SDL_Delay(emu.latency * 4);
+    while(net_thread_recv(client, &msg)) {
+        net_msg_free(&msg);
+    }
+    net_thread_free(client);
+    start = SDL_GetTicks();
+    while(net_thread_is_connected(server) && SDL_GetTicks() - start < TEST_NET_TIMEOUT) {
+        SDL_Delay(1);
+    }
+    net_thread_free(server);
+    CU_ASSERT(net_thread_wait_closed(TEST_NET_TIMEOUT) == 0);
+    enet_deinitialize();
+}
+
+void net_clock_test_suite(CU_pSuite suite) {
+    // Add tests
+    if(CU_add_test(suite, "Test for net clock with a steady connection", test_net_clock_constant) == NULL) { return; }
+    if(CU_add_test(suite, "Test for net clock with jitter", test_net_clock_jitter) == NULL) { return; }
+    if(CU_add_test(suite, "Test for net clock drift", test_net_clock_drift) == NULL) { return; }
+    if(CU_add_test(suite, "Test for net clock input delay hold", test_net_clock_delay_hold) == NULL) { return; }
+    if(CU_add_test(suite, "Test for net clock catchup", test_net_clock_catchup) == NULL) { return; }
+    if(CU_add_test(suite, "Test for net clock over loopback", test_net_clock_loopback) == NULL) { return; }
+}
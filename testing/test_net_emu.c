@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include <string.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <controller/net_emu.h>
+
+#define TEST_MESSAGES 200
+
+static net_msg make_msg(int seq, unsigned int flags) {
+    net_msg msg;
+    msg.type = NET_MSG_RECEIVE;
+    msg.timestamp = 0;
+    msg.channel = 0;
+    msg.flags = flags;
+    msg.len = sizeof(int);
+    msg.data = malloc(sizeof(int));
+    memcpy(msg.data, &seq, sizeof(int));
+    return msg;
+}
+
+// Runs messages through an emulator, one per millisecond, and records the order they come out in
+static int run(const net_emu_config *conf, unsigned int flags, int *out) {
+    net_emu *e = net_emu_create(conf, 0);
+    net_msg msg;
+    int count = 0;
+    for(uint32_t now = 0; now < 1000; now++) {
+        if(now < TEST_MESSAGES) {
+            msg = make_msg(now, flags);
+            net_emu_push(e, &msg, now);
+        }
+        while(net_emu_pop(e, &msg, now)) {
+            out[count++] = *(int*)msg.data;
+            net_msg_free(&msg);
+        }
+    }
+    net_emu_free(e);
+    return count;
+}
+
+void test_net_emu_parse(void) {
+    net_emu_config conf;
+    memset(&conf, 0, sizeof(net_emu_config));
+    CU_ASSERT(net_emu_config_enabled(&conf) == 0);
+    CU_ASSERT(net_emu_config_parse(&conf, "latency=80,loss=5,seed=3") == 0);
+    CU_ASSERT(conf.latency == 80 && conf.loss == 5 && conf.seed == 3 && conf.jitter == 0);
+    CU_ASSERT(net_emu_config_enabled(&conf) == 1);
+    CU_ASSERT(net_emu_config_parse(&conf, "latency=80,bandwidth=5") != 0);
+    CU_ASSERT(net_emu_config_parse(&conf, "latency") != 0);
+}
+
+void test_net_emu_deterministic(void) {
+    net_emu_config conf = {20, 10, 10, 10, 10, 42};
+    int a[TEST_MESSAGES * 2], b[TEST_MESSAGES * 2];
+    int count = run(&conf, ENET_PACKET_FLAG_UNSEQUENCED, a);
+    CU_ASSERT(count == run(&conf, ENET_PACKET_FLAG_UNSEQUENCED, b));
+    CU_ASSERT(memcmp(a, b, count * sizeof(int)) == 0);
+
+    // Unsequenced messages get lost, duplicated and reordered
+    int reordered = 0;
+    for(int i = 1; i < count; i++) {
+        reordered += (a[i] < a[i-1]);
+    }
+    CU_ASSERT(count != TEST_MESSAGES);
+    CU_ASSERT(reordered > 0);
+}
+
+void test_net_emu_reliable(void) {
+    net_emu_config conf = {20, 10, 10, 10, 10, 42};
+    int out[TEST_MESSAGES * 2];
+
+    // Reliable messages all arrive, once and in order
+    CU_ASSERT_FATAL(run(&conf, ENET_PACKET_FLAG_RELIABLE, out) == TEST_MESSAGES);
+    for(int i = 0; i < TEST_MESSAGES; i++) {
+        CU_ASSERT(out[i] == i);
+    }
+}
+
+void net_emu_test_suite(CU_pSuite suite) {
+    // Add tests
+    if(CU_add_test(suite, "Test for net emulator spec parsing", test_net_emu_parse) == NULL) { return; }
+    if(CU_add_test(suite, "Test for net emulator determinism", test_net_emu_deterministic) == NULL) { return; }
+    if(CU_add_test(suite, "Test for net emulator reliable ordering", test_net_emu_reliable) == NULL) { return; }
+}
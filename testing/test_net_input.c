@@ -0,0 +1,76 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <controller/net_input.h>
+#include <controller/controller.h>
+
+net_input sender;
+net_input receiver;
+
+// Reads a packet like the net controller does, past the event type
+static int deliver(net_input *in, serial *packet, int *actions) {
+    packet->rpos = 0;
+    CU_ASSERT_FATAL(serial_read_int8(packet) == EVENT_TYPE_INPUT);
+    return net_input_read(in, packet, actions, 64);
+}
+
+void test_net_input_create(void) {
+    serial ser;
+    serial_create(&ser);
+    net_input_create(&sender);
+    net_input_create(&receiver);
+    CU_ASSERT(net_input_write(&sender, &ser) == 0);
+    serial_free(&ser);
+}
+
+void test_net_input_lost_packet(void) {
+    serial lost, ser;
+    int actions[64];
+
+    // Three frames go out in a packet that gets lost
+    serial_create(&lost);
+    for(int i = 1; i <= 3; i++) {
+        net_input_add(&sender, i);
+        net_input_commit(&sender);
+    }
+    CU_ASSERT(net_input_write(&sender, &lost) == 1);
+    serial_free(&lost);
+
+    // The next packet carries them again, in order
+    serial_create(&ser);
+    net_input_add(&sender, 4);
+    net_input_commit(&sender);
+    CU_ASSERT(net_input_write(&sender, &ser) == 1);
+    CU_ASSERT_FATAL(deliver(&receiver, &ser, actions) == 4);
+    for(int i = 0; i < 4; i++) {
+        CU_ASSERT(actions[i] == i + 1);
+    }
+
+    // A duplicate brings nothing new
+    CU_ASSERT(deliver(&receiver, &ser, actions) == 0);
+    serial_free(&ser);
+}
+
+void test_net_input_ack(void) {
+    serial ser;
+    int actions[64];
+
+    // The receiver acks without any input of its own
+    serial_create(&ser);
+    CU_ASSERT(net_input_write(&receiver, &ser) == 1);
+    CU_ASSERT(deliver(&sender, &ser, actions) == 0);
+    serial_free(&ser);
+    CU_ASSERT(sender.acked == 4);
+
+    // Everything is acked, so there is nothing left to send
+    serial_create(&ser);
+    CU_ASSERT(net_input_write(&sender, &ser) == 0);
+    CU_ASSERT(net_input_write(&receiver, &ser) == 0);
+    serial_free(&ser);
+}
+
+void net_input_test_suite(CU_pSuite suite) {
+    // Add tests
+    if(CU_add_test(suite, "Test for net input create", test_net_input_create) == NULL) { return; }
+    if(CU_add_test(suite, "Test for net input lost packet", test_net_input_lost_packet) == NULL) { return; }
+    if(CU_add_test(suite, "Test for net input ack", test_net_input_ack) == NULL) { return; }
+}
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <string.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <SDL2/SDL.h>
+#include <enet/enet.h>
+#include <controller/net_mux.h>
+#include <controller/net_thread.h>
+#include <controller/controller.h>
+#include <game/utils/serial.h>
+#include "test_net_util.h"
+
+#define TEST_PORT 22100
+#define TEST_CLIENTS 4
+#define SERVER_ID 1
+#define CLIENT_ID 2
+
+net_mux *mux;
+net_thread *clients[TEST_CLIENTS];
+net_link *links[TEST_CLIENTS];
+
+static int wait_link(net_link *l, net_msg *msg) {
+    unsigned int start = SDL_GetTicks();
+    while(SDL_GetTicks() - start < TEST_NET_TIMEOUT) {
+        if(net_link_recv(l, msg)) {
+            return 1;
+        }
+        SDL_Delay(1);
+    }
+    return 0;
+}
+
+void test_net_mux_accept(void) {
+    CU_ASSERT_FATAL(enet_initialize() == 0);
+    mux = net_mux_create(TEST_PORT, TEST_CLIENTS, SERVER_ID);
+    CU_ASSERT_FATAL(mux != NULL);
+    CU_ASSERT(net_mux_accept(mux) == NULL);
+    for(int i = 0; i < TEST_CLIENTS; i++) {
+        clients[i] = test_net_client(TEST_PORT, CLIENT_ID, NULL);
+        CU_ASSERT_FATAL(clients[i] != NULL);
+    }
+
+    // Every peer shows up once, in the order they came in
+    int accepted = 0;
+    unsigned int start = SDL_GetTicks();
+    while(accepted < TEST_CLIENTS && SDL_GetTicks() - start < TEST_NET_TIMEOUT) {
+        if((links[accepted] = net_mux_accept(mux)) != NULL) {
+            CU_ASSERT(net_link_is_connected(links[accepted]));
+            accepted++;
+        } else {
+            SDL_Delay(1);
+        }
+    }
+    CU_ASSERT_FATAL(accepted == TEST_CLIENTS);
+    CU_ASSERT(net_mux_accept(mux) == NULL);
+    CU_ASSERT(net_mux_links(mux) == TEST_CLIENTS);
+}
+
+void test_net_mux_message(void) {
+    net_msg msg;
+    char buf[8];
+
+    // Each link only hears its own peer
+    for(int i = 0; i < TEST_CLIENTS; i++) {
+        sprintf(buf, "peer %d", i);
+        CU_ASSERT(net_thread_send(clients[i], 1, buf, strlen(buf) + 1, ENET_PACKET_FLAG_RELIABLE) == 0);
+    }
+    for(int i = 0; i < TEST_CLIENTS; i++) {
+        sprintf(buf, "peer %d", i);
+        CU_ASSERT_FATAL(wait_link(links[i], &msg));
+        CU_ASSERT(msg.type == NET_MSG_RECEIVE);
+        CU_ASSERT(msg.channel == 1);
+        CU_ASSERT(strcmp(msg.data, buf) == 0);
+        net_msg_free(&msg);
+    }
+
+    // And the other way around
+    CU_ASSERT(net_link_send(links[2], 1, "hello", 6, ENET_PACKET_FLAG_RELIABLE) == 0);
+    CU_ASSERT_FATAL(test_net_wait_msg(clients[2], &msg));
+    CU_ASSERT(strcmp(msg.data, "hello") == 0);
+    net_msg_free(&msg);
+    CU_ASSERT(net_thread_recv(clients[1], &msg) == 0);
+}
+
+void test_net_mux_heartbeat(void) {
+    net_msg msg;
+    serial ser;
+    serial_create(&ser);
+    serial_write_int8(&ser, EVENT_TYPE_HB);
+    serial_write_int8(&ser, CLIENT_ID);
+    serial_write_int32(&ser, 100);
+    net_link_set_tick(links[1], 1234);
+    net_link_set_tick(links[3], 999);
+    CU_ASSERT(net_thread_send(clients[1], 0, ser.data, ser.len, ENET_PACKET_FLAG_UNSEQUENCED) == 0);
+    serial_free(&ser);
+
+    // The mux answers by itself, with the tick of that peer's link
+    CU_ASSERT_FATAL(test_net_wait_msg(clients[1], &msg));
+    CU_ASSERT_FATAL(msg.len == 10);
+    serial_create(&ser);
+    serial_write(&ser, msg.data, msg.len);
+    CU_ASSERT(serial_read_int8(&ser) == EVENT_TYPE_HB);
+    CU_ASSERT(serial_read_int8(&ser) == CLIENT_ID);
+    CU_ASSERT(serial_read_int32(&ser) == 100);
+    CU_ASSERT(serial_read_int32(&ser) == 1234);
+    serial_free(&ser);
+    net_msg_free(&msg);
+    CU_ASSERT(net_link_recv(links[1], &msg) == 0);
+}
+
+void test_net_mux_close(void) {
+    net_msg msg;
+
+    // A peer that leaves shows up on its link
+    net_thread_free(clients[0]);
+    CU_ASSERT_FATAL(wait_link(links[0], &msg));
+    CU_ASSERT(msg.type == NET_MSG_DISCONNECT);
+    CU_ASSERT(!net_link_is_connected(links[0]));
+    net_link_close(links[0]);
+
+    // Closing a link disconnects its peer
+    net_link_close(links[1]);
+    CU_ASSERT_FATAL(test_net_wait_msg(clients[1], &msg));
+    CU_ASSERT(msg.type == NET_MSG_DISCONNECT);
+    net_thread_free(clients[1]);
+
+    unsigned int start = SDL_GetTicks();
+    while(net_mux_links(mux) > 2 && SDL_GetTicks() - start < TEST_NET_TIMEOUT) {
+        SDL_Delay(1);
+    }
+    CU_ASSERT(net_mux_links(mux) == 2);
+
+    // The rest go when the mux does
+    net_mux_free(mux);
+    for(int i = 2; i < TEST_CLIENTS; i++) {
+        CU_ASSERT(test_net_wait_msg(clients[i], &msg));
+        CU_ASSERT(msg.type == NET_MSG_DISCONNECT);
+        net_thread_free(clients[i]);
+    }
+    CU_ASSERT(net_thread_wait_closed(TEST_NET_TIMEOUT) == 0);
+    enet_deinitialize();
+}
+
+void net_mux_test_suite(CU_pSuite suite) {
+    // Add tests
+    if(CU_add_test(suite, "Test for net mux accept", test_net_mux_accept) == NULL) { return; }
+    if(CU_add_test(suite, "Test for net mux messages", test_net_mux_message) == NULL) { return; }
+    if(CU_add_test(suite, "Test for net mux heartbeat bounce", test_net_mux_heartbeat) == NULL) { return; }
+    if(CU_add_test(suite, "Test for net mux close", test_net_mux_close) == NULL) { return; }
+}
@@ -0,0 +1,192 @@
+#include <string.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <SDL2/SDL.h>
+#include <enet/enet.h>
+#include <controller/net_relay.h>
+#include <controller/net_thread.h>
+#include <game/utils/serial.h>
+#include <utils/vector.h>
+#include "test_net_util.h"
+
+#define TEST_PORT 22099
+#define TEST_SPECTATORS 24
+#define TEST_LATE_TICK 30
+#define TEST_END_TICK 60
+
+typedef struct test_spectator_t {
+    ENetHost *host;
+    ENetPeer *peer;
+    int connected;
+    int ended;
+    serial header;
+    vector moves;
+    uint32_t upto;
+} test_spectator;
+
+net_relay *relay;
+test_spectator spectators[TEST_SPECTATORS + 1]; // The last one joins late
+
+// Every few ticks, both players do something
+static int test_has_move(uint32_t tick) {
+    return (tick % 3) == 0;
+}
+
+static void test_add_tick(uint32_t tick) {
+    if(test_has_move(tick)) {
+        net_relay_add(relay, tick, 0, tick & 0xFF);
+        net_relay_add(relay, tick, 1, (tick * 7) & 0xFF);
+    }
+    net_relay_flush(relay, tick);
+}
+
+static void test_service(test_spectator *s) {
+    ENetEvent event;
+    while(enet_host_service(s->host, &event, 0) > 0) {
+        if(event.type == ENET_EVENT_TYPE_CONNECT) {
+            s->connected = 1;
+        } else if(event.type == ENET_EVENT_TYPE_DISCONNECT) {
+            s->connected = 0;
+        } else if(event.type == ENET_EVENT_TYPE_RECEIVE) {
+            serial ser;
+            int type;
+            serial_create(&ser);
+            serial_write(&ser, (const char*)event.packet->data, event.packet->dataLength);
+            while((type = net_relay_read(&ser, &s->header, &s->moves, &s->upto)) != 0) {
+                if(type == NET_RELAY_END) {
+                    s->ended = 1;
+                }
+            }
+            serial_free(&ser);
+            enet_packet_destroy(event.packet);
+        }
+    }
+}
+
+// Services the spectators in [first, last) until check holds for all of them
+static int test_wait(int first, int last, int (*check)(test_spectator *s)) {
+    unsigned int start = SDL_GetTicks();
+    while(SDL_GetTicks() - start < TEST_NET_TIMEOUT) {
+        int done = 1;
+        for(int i = first; i < last; i++) {
+            test_service(&spectators[i]);
+            done &= check(&spectators[i]);
+        }
+        if(done) {
+            return 1;
+        }
+        SDL_Delay(1);
+    }
+    return 0;
+}
+
+static int test_is_connected(test_spectator *s) {
+    return s->connected;
+}
+
+static int test_is_ended(test_spectator *s) {
+    return s->ended;
+}
+
+static int test_is_gone(test_spectator *s) {
+    return !s->connected;
+}
+
+static void test_join(test_spectator *s) {
+    memset(s, 0, sizeof(test_spectator));
+    serial_create(&s->header);
+    vector_create(&s->moves, sizeof(net_relay_move));
+    s->host = test_net_host_connect(TEST_PORT, 1, &s->peer);
+    CU_ASSERT_FATAL(s->host != NULL);
+}
+
+void test_net_relay_create(void) {
+    serial header;
+    CU_ASSERT_FATAL(enet_initialize() == 0);
+    serial_create(&header);
+    serial_write(&header, "match", 5);
+    relay = net_relay_create(TEST_PORT, TEST_SPECTATORS + 1, &header);
+    serial_free(&header);
+    CU_ASSERT_FATAL(relay != NULL);
+    CU_ASSERT(net_relay_spectators(relay) == 0);
+
+    for(int i = 0; i < TEST_SPECTATORS; i++) {
+        test_join(&spectators[i]);
+    }
+    CU_ASSERT_FATAL(test_wait(0, TEST_SPECTATORS, test_is_connected));
+    unsigned int start = SDL_GetTicks();
+    while(net_relay_spectators(relay) < TEST_SPECTATORS && SDL_GetTicks() - start < TEST_NET_TIMEOUT) {
+        SDL_Delay(1);
+    }
+    CU_ASSERT(net_relay_spectators(relay) == TEST_SPECTATORS);
+}
+
+void test_net_relay_late_join(void) {
+    for(uint32_t tick = 0; tick < TEST_LATE_TICK; tick++) {
+        test_add_tick(tick);
+    }
+    // Let the first batches go out before the latecomer arrives
+    SDL_Delay(NET_RELAY_SERVICE_MS * 4);
+    test_join(&spectators[TEST_SPECTATORS]);
+    CU_ASSERT_FATAL(test_wait(TEST_SPECTATORS, TEST_SPECTATORS + 1, test_is_connected));
+    for(uint32_t tick = TEST_LATE_TICK; tick < TEST_END_TICK; tick++) {
+        test_add_tick(tick);
+    }
+    net_relay_end(relay, TEST_END_TICK);
+    CU_ASSERT(test_wait(0, TEST_SPECTATORS + 1, test_is_ended));
+}
+
+void test_net_relay_moves(void) {
+    for(int i = 0; i < TEST_SPECTATORS + 1; i++) {
+        test_spectator *s = &spectators[i];
+        CU_ASSERT(s->header.len == 5 && memcmp(s->header.data, "match", 5) == 0);
+        CU_ASSERT(s->upto == TEST_END_TICK);
+
+        // Every move exactly once and in order, the late spectator included
+        iterator it;
+        net_relay_move *m;
+        int bad = 0;
+        uint32_t tick = 0;
+        vector_iter_begin(&s->moves, &it);
+        for(int player = 0; (m = iter_next(&it)) != NULL; player ^= 1) {
+            while(!test_has_move(tick)) {
+                tick++;
+            }
+            uint8_t action = (player == 0) ? (tick & 0xFF) : ((tick * 7) & 0xFF);
+            bad |= (m->tick != tick || m->player_id != player || m->action != action);
+            if(player == 1) {
+                tick++;
+            }
+        }
+        CU_ASSERT(!bad);
+        CU_ASSERT(vector_size(&s->moves) == 2 * ((TEST_END_TICK + 2) / 3));
+    }
+}
+
+void test_net_relay_free(void) {
+    for(int i = 0; i < TEST_SPECTATORS + 1; i++) {
+        enet_peer_disconnect(spectators[i].peer, 0);
+    }
+    CU_ASSERT(test_wait(0, TEST_SPECTATORS + 1, test_is_gone));
+    unsigned int start = SDL_GetTicks();
+    while(net_relay_spectators(relay) > 0 && SDL_GetTicks() - start < TEST_NET_TIMEOUT) {
+        SDL_Delay(1);
+    }
+    CU_ASSERT(net_relay_spectators(relay) == 0);
+    net_relay_free(relay);
+    CU_ASSERT(net_thread_wait_closed(TEST_NET_TIMEOUT) == 0);
+    for(int i = 0; i < TEST_SPECTATORS + 1; i++) {
+        enet_host_destroy(spectators[i].host);
+        serial_free(&spectators[i].header);
+        vector_free(&spectators[i].moves);
+    }
+    enet_deinitialize();
+}
+
+void net_relay_test_suite(CU_pSuite suite) {
+    // Add tests
+    if(CU_add_test(suite, "Test for net relay spectators connect", test_net_relay_create) == NULL) { return; }
+    if(CU_add_test(suite, "Test for net relay late join", test_net_relay_late_join) == NULL) { return; }
+    if(CU_add_test(suite, "Test for net relay move stream", test_net_relay_moves) == NULL) { return; }
+    if(CU_add_test(suite, "Test for net relay free", test_net_relay_free) == NULL) { return; }
+}
@@ -0,0 +1,130 @@
+#include <string.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <SDL2/SDL.h>
+#include <enet/enet.h>
+#include <controller/net_thread.h>
+#include <controller/controller.h>
+#include <game/utils/serial.h>
+#include "test_net_util.h"
+
+#define TEST_PORT 22097
+#define LISTEN_PORT 22101
+#define UNUSED_PORT 22102
+#define TEST_QUICK 100 // Well under a frame's worth of waiting, even on a slow machine
+#define SERVER_ID 1
+#define CLIENT_ID 2
+
+net_thread *server;
+net_thread *client;
+
+void test_net_thread_connect(void) {
+    CU_ASSERT_FATAL(enet_initialize() == 0);
+    CU_ASSERT_FATAL(test_net_pair(TEST_PORT, &server, SERVER_ID, &client, CLIENT_ID, NULL));
+    CU_ASSERT(net_thread_is_connected(server));
+    CU_ASSERT(net_thread_is_connected(client));
+}
+
+void test_net_thread_message(void) {
+    net_msg msg;
+    unsigned int sent = SDL_GetTicks();
+    CU_ASSERT(net_thread_send(client, 1, "hello", 6, ENET_PACKET_FLAG_RELIABLE) == 0);
+    CU_ASSERT_FATAL(test_net_wait_msg(server, &msg));
+    CU_ASSERT(msg.type == NET_MSG_RECEIVE);
+    CU_ASSERT(msg.channel == 1);
+    CU_ASSERT(msg.len == 6);
+    CU_ASSERT(strcmp(msg.data, "hello") == 0);
+    CU_ASSERT(msg.timestamp >= sent && msg.timestamp <= SDL_GetTicks());
+    net_msg_free(&msg);
+}
+
+void test_net_thread_heartbeat(void) {
+    net_msg msg;
+    serial ser;
+    serial_create(&ser);
+    serial_write_int8(&ser, EVENT_TYPE_HB);
+    serial_write_int8(&ser, CLIENT_ID);
+    serial_write_int32(&ser, 100);
+    net_thread_set_tick(server, 1234);
+    CU_ASSERT(net_thread_send(client, 0, ser.data, ser.len, ENET_PACKET_FLAG_UNSEQUENCED) == 0);
+    serial_free(&ser);
+
+    // The server thread answers by itself with its last published tick
+    CU_ASSERT_FATAL(test_net_wait_msg(client, &msg));
+    CU_ASSERT_FATAL(msg.len == 10);
+    serial_create(&ser);
+    serial_write(&ser, msg.data, msg.len);
+    CU_ASSERT(serial_read_int8(&ser) == EVENT_TYPE_HB);
+    CU_ASSERT(serial_read_int8(&ser) == CLIENT_ID);
+    CU_ASSERT(serial_read_int32(&ser) == 100);
+    CU_ASSERT(serial_read_int32(&ser) == 1234);
+    serial_free(&ser);
+    net_msg_free(&msg);
+    CU_ASSERT(net_thread_recv(server, &msg) == 0);
+}
+
+void test_net_thread_free(void) {
+    net_msg msg;
+
+    // The goodbye happens in the background
+    unsigned int start = SDL_GetTicks();
+    net_thread_free(client);
+    CU_ASSERT(SDL_GetTicks() - start < TEST_QUICK);
+    CU_ASSERT_FATAL(test_net_wait_msg(server, &msg));
+    CU_ASSERT(msg.type == NET_MSG_DISCONNECT);
+    CU_ASSERT(!net_thread_is_connected(server));
+    CU_ASSERT(net_thread_get_state(server) == NET_THREAD_CLOSED);
+    net_thread_free(server);
+    CU_ASSERT(net_thread_wait_closed(TEST_NET_TIMEOUT) == 0);
+}
+
+void test_net_thread_listen(void) {
+    net_msg msg;
+    server = net_thread_listen(LISTEN_PORT, SERVER_ID, NULL);
+    CU_ASSERT_FATAL(server != NULL);
+    CU_ASSERT(net_thread_get_state(server) == NET_THREAD_LISTENING);
+    client = net_thread_connect("127.0.0.1", LISTEN_PORT, CLIENT_ID, NULL);
+    CU_ASSERT_FATAL(client != NULL);
+
+    // Both ends get there by themselves, like the network menus poll them
+    unsigned int start = SDL_GetTicks();
+    while(!(net_thread_is_connected(server) && net_thread_is_connected(client))
+          && SDL_GetTicks() - start < TEST_NET_TIMEOUT) {
+        SDL_Delay(1);
+    }
+    CU_ASSERT_FATAL(net_thread_is_connected(server));
+    CU_ASSERT_FATAL(net_thread_is_connected(client));
+    CU_ASSERT(net_thread_send(client, 1, "hello", 6, ENET_PACKET_FLAG_RELIABLE) == 0);
+    CU_ASSERT_FATAL(test_net_wait_msg(server, &msg));
+    CU_ASSERT(strcmp(msg.data, "hello") == 0);
+    net_msg_free(&msg);
+
+    net_thread_free(client);
+    net_thread_free(server);
+    CU_ASSERT(net_thread_wait_closed(TEST_NET_TIMEOUT) == 0);
+}
+
+void test_net_thread_cancel(void) {
+    // Nobody listens here, so the attempt is still going or has already failed
+    unsigned int start = SDL_GetTicks();
+    client = net_thread_connect("127.0.0.1", UNUSED_PORT, CLIENT_ID, NULL);
+    CU_ASSERT_FATAL(client != NULL);
+    CU_ASSERT(net_thread_get_state(client) != NET_THREAD_CONNECTED);
+    net_thread_free(client);
+    server = net_thread_listen(LISTEN_PORT, SERVER_ID, NULL);
+    CU_ASSERT_FATAL(server != NULL);
+    net_thread_free(server);
+    CU_ASSERT(SDL_GetTicks() - start < TEST_QUICK);
+    CU_ASSERT(net_thread_wait_closed(TEST_NET_TIMEOUT) == 0);
+    enet_deinitialize();
+}
+
+void net_thread_test_suite(CU_pSuite suite) {
+    // Add tests
+    if(CU_add_test(suite, "Test for net thread loopback connect", test_net_thread_connect) == NULL) { return; }
+    if(CU_add_test(suite, "Test for net thread message delivery", test_net_thread_message) == NULL) { return; }
+    if(CU_add_test(suite, "Test for net thread heartbeat bounce", test_net_thread_heartbeat) == NULL) { return; }
+    if(CU_add_test(suite, "Test for net thread free", test_net_thread_free) == NULL) { return; }
+    if(CU_add_test(suite, "Test for net thread listen and connect", test_net_thread_listen) == NULL) { return; }
+    if(CU_add_test(suite, "Test for net thread cancel", test_net_thread_cancel) == NULL) { return; }
+}
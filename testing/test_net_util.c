@@ -0,0 +1,90 @@
+#include <SDL2/SDL.h>
+#include "test_net_util.h"
+
+ENetHost* test_net_host_connect(int port, size_t channels, ENetPeer **peer) {
+    ENetAddress address;
+    enet_address_set_host(&address, "127.0.0.1");
+    address.port = port;
+    ENetHost *host = enet_host_create(NULL, 1, channels, 0, 0);
+    if(host == NULL) {
+        return NULL;
+    }
+    if((*peer = enet_host_connect(host, &address, channels, 0)) == NULL) {
+        enet_host_destroy(host);
+        return NULL;
+    }
+    return host;
+}
+
+net_thread* test_net_client(int port, int hb_id, const struct net_emu_config_t *emu) {
+    ENetEvent event;
+    ENetPeer *peer;
+    ENetHost *host = test_net_host_connect(port, 2, &peer);
+    if(host == NULL) {
+        return NULL;
+    }
+    unsigned int start = SDL_GetTicks();
+    while(SDL_GetTicks() - start < TEST_NET_TIMEOUT) {
+        if(enet_host_service(host, &event, 1) > 0 && event.type == ENET_EVENT_TYPE_CONNECT) {
+            return net_thread_create(host, peer, hb_id, emu);
+        }
+    }
+    enet_host_destroy(host);
+    return NULL;
+}
+
+int test_net_pair(int port, net_thread **server, int server_id, net_thread **client, int client_id,
+                  const struct net_emu_config_t *client_emu) {
+    ENetAddress address;
+    ENetEvent event;
+    ENetPeer *server_peer = NULL;
+    ENetPeer *client_peer;
+    ENetHost *server_host;
+    ENetHost *client_host;
+    enet_address_set_host(&address, "127.0.0.1");
+    address.port = port;
+    if((server_host = enet_host_create(&address, 1, 2, 0, 0)) == NULL) {
+        goto error_0;
+    }
+    if((client_host = test_net_host_connect(port, 2, &client_peer)) == NULL) {
+        goto error_1;
+    }
+
+    // Both ends are serviced on this thread until they see each other
+    int connected = 0;
+    unsigned int start = SDL_GetTicks();
+    while(connected < 2 && SDL_GetTicks() - start < TEST_NET_TIMEOUT) {
+        if(enet_host_service(server_host, &event, 1) > 0 && event.type == ENET_EVENT_TYPE_CONNECT) {
+            server_peer = event.peer;
+            connected++;
+        }
+        if(enet_host_service(client_host, &event, 1) > 0 && event.type == ENET_EVENT_TYPE_CONNECT) {
+            connected++;
+        }
+    }
+    if(connected < 2) {
+        goto error_2;
+    }
+
+    *server = net_thread_create(server_host, server_peer, server_id, NULL);
+    *client = net_thread_create(client_host, client_peer, client_id, client_emu);
+    return (*server != NULL && *client != NULL);
+
+error_2:
+    enet_host_destroy(client_host);
+error_1:
+    enet_host_destroy(server_host);
+error_0:
+    return 0;
+}
+
+int test_net_wait_msg(net_thread *t, net_msg *msg) {
+    unsigned int start = SDL_GetTicks();
+    while(SDL_GetTicks() - start < TEST_NET_TIMEOUT) {
+        if(net_thread_recv(t, msg)) {
+            return 1;
+        }
+        SDL_Delay(1);
+    }
+    return 0;
+}
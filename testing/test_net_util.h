@@ -0,0 +1,26 @@
+#ifndef _TEST_NET_UTIL_H
+#define _TEST_NET_UTIL_H
+
+#include <enet/enet.h>
+#include <controller/net_thread.h>
+
+/*
+ * Loopback fixtures shared by the network test suites. Everything connects to
+ * 127.0.0.1 and gives up after TEST_NET_TIMEOUT ms.
+ */
+
+#define TEST_NET_TIMEOUT 2000
+
+struct net_emu_config_t;
+
+/* Creates a client host and starts connecting it to the port. Returns NULL on failure. */
+ENetHost* test_net_host_connect(int port, size_t channels, ENetPeer **peer);
+/* Connects a client to a server that runs on its own, like the network menus do */
+net_thread* test_net_client(int port, int hb_id, const struct net_emu_config_t *emu);
+/* Listens on the port, connects a client to it and hands both ends to net threads */
+int test_net_pair(int port, net_thread **server, int server_id, net_thread **client, int client_id,
+                  const struct net_emu_config_t *client_emu);
+/* Polls the game side of a net thread like the net controller does */
+int test_net_wait_msg(net_thread *t, net_msg *msg);
+
+#endif // _TEST_NET_UTIL_H
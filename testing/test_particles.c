@@ -0,0 +1,90 @@
+#include <string.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <game/particles.h>
+#include <game/game_state_type.h>
+#include <game/objects/arena_constraints.h>
+
+#define TEST_TICKS 300
+
+particles *pool;
+animation ani;
+
+static void create_animation(const char *string) {
+    sprite sp;
+    memset(&ani, 0, sizeof(animation));
+    str_create_from_cstr(&ani.animation_string, string);
+    vector_create(&ani.collision_coords, sizeof(collision_coord));
+    vector_create(&ani.extra_strings, sizeof(str));
+    vector_create(&ani.sprites, sizeof(sprite));
+    for(int i = 0; i < 3; i++) {
+        sprite_create_custom(&sp, vec2i_create(0, 0), NULL);
+        vector_append(&ani.sprites, &sp);
+    }
+}
+
+static void free_animation() {
+    str_free(&ani.animation_string);
+    vector_free(&ani.collision_coords);
+    vector_free(&ani.extra_strings);
+    vector_free(&ani.sprites);
+}
+
+static void run_ticks(int ticks) {
+    for(int i = 0; i < ticks; i++) {
+        particles_move(pool);
+        particles_tick(pool);
+    }
+}
+
+void test_particles_spawn(void) {
+    pool = particles_create();
+    CU_ASSERT_FATAL(pool != NULL);
+
+    // Loops on the first two frames until it comes to rest, then plays out the rest
+    create_animation("A5-d1B5-C5");
+
+    // Drops what does not fit
+    for(int i = 0; i < PARTICLES_MAX; i++) {
+        CU_ASSERT(particles_spawn(pool, &ani, vec2i_create(160, 100), vec2f_create(0, 0), 0, 0, 0, RENDER_LAYER_TOP) == 0);
+    }
+    CU_ASSERT(particles_count(pool) == PARTICLES_MAX);
+    CU_ASSERT(particles_spawn(pool, &ani, vec2i_create(160, 100), vec2f_create(0, 0), 0, 0, 0, RENDER_LAYER_TOP) == 1);
+    CU_ASSERT(particles_count(pool) == PARTICLES_MAX);
+
+    particles_clear(pool);
+    CU_ASSERT(particles_count(pool) == 0);
+}
+
+void test_particles_rest(void) {
+    // Floating debris keeps rewinding
+    particles_spawn(pool, &ani, vec2i_create(160, 100), vec2f_create(0, 0), 0, 0, 0, RENDER_LAYER_TOP);
+    run_ticks(TEST_TICKS);
+    CU_ASSERT(particles_count(pool) == 1);
+    particles_clear(pool);
+
+    // Falling debris bounces off the wall and the floor, comes to rest and finishes
+    particles_spawn(pool, &ani, vec2i_create(ARENA_RIGHT_WALL - 10, 100), vec2f_create(6, -8), 1, 0, 1, RENDER_LAYER_TOP);
+    particles_spawn(pool, &ani, vec2i_create(ARENA_LEFT_WALL + 10, 50), vec2f_create(-6, -12), 0.4f, 0, 1, RENDER_LAYER_BOTTOM);
+    run_ticks(TEST_TICKS);
+    CU_ASSERT(particles_count(pool) == 0);
+}
+
+void test_particles_free(void) {
+    // Entries for the same animation are shared
+    for(int i = 0; i < PARTICLES_MAX_TRACKS * 2; i++) {
+        CU_ASSERT(particles_spawn(pool, &ani, vec2i_create(160, ARENA_FLOOR), vec2f_create(0, 0), 1, 0, 0, RENDER_LAYER_TOP) == 0);
+    }
+    CU_ASSERT(particles_count(pool) == PARTICLES_MAX_TRACKS * 2);
+    run_ticks(TEST_TICKS);
+    CU_ASSERT(particles_count(pool) == 0);
+    particles_free(pool);
+    free_animation();
+}
+
+void particles_test_suite(CU_pSuite suite) {
+    // Add tests
+    if(CU_add_test(suite, "Test for particles spawn", test_particles_spawn) == NULL) { return; }
+    if(CU_add_test(suite, "Test for particles rest", test_particles_rest) == NULL) { return; }
+    if(CU_add_test(suite, "Test for particles free", test_particles_free) == NULL) { return; }
+}
@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <string.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <SDL2/SDL.h>
+#include <shadowdive/shadowdive.h>
+#include <game/utils/rec_writer.h>
+
+#define TEST_FILE "test_rec_writer.rec"
+#define TEST_WHOLE "test_rec_writer_whole.rec"
+#define TEST_MOVES (REC_WRITER_CHUNK_MOVES * 4 + 17)
+#define TEST_TIMEOUT 2000
+
+rec_writer *writer;
+sd_rec_file whole;
+
+static void make_move(sd_rec_move *move, int i) {
+    memset(move, 0, sizeof(sd_rec_move));
+    move->tick = i * 3;
+    move->lookup_id = 2;
+    move->player_id = i % 2;
+    move->action = (i % 3 == 0) ? SD_ACT_PUNCH : SD_ACT_LEFT;
+}
+
+static unsigned int loaded_moves(const char *filename) {
+    sd_rec_file rec;
+    unsigned int count = 0;
+    sd_rec_create(&rec);
+    if(sd_rec_load(&rec, filename) == SD_SUCCESS) {
+        count = rec.move_count;
+    }
+    sd_rec_free(&rec);
+    return count;
+}
+
+void test_rec_writer_open(void) {
+    sd_rec_create(&whole);
+    whole.pilots[0].info.har_id = 3;
+    whole.pilots[1].info.har_id = 7;
+    writer = rec_writer_open(TEST_FILE, &whole);
+    CU_ASSERT_FATAL(writer != NULL);
+
+    // The header alone is already a loadable recording
+    CU_ASSERT(loaded_moves(TEST_FILE) == 0);
+}
+
+void test_rec_writer_stream(void) {
+    sd_rec_move move;
+    for(int i = 0; i < REC_WRITER_CHUNK_MOVES; i++) {
+        make_move(&move, i);
+        rec_writer_add(writer, &move);
+        CU_ASSERT(sd_rec_insert_action(&whole, whole.move_count, &move) == SD_SUCCESS);
+    }
+
+    // A full chunk goes to disk without waiting for the close
+    unsigned int start = SDL_GetTicks();
+    while(loaded_moves(TEST_FILE) < REC_WRITER_CHUNK_MOVES && SDL_GetTicks() - start < TEST_TIMEOUT) {
+        SDL_Delay(1);
+    }
+    CU_ASSERT(loaded_moves(TEST_FILE) == REC_WRITER_CHUNK_MOVES);
+
+    // So does a partial one, once it has waited long enough
+    make_move(&move, REC_WRITER_CHUNK_MOVES);
+    rec_writer_add(writer, &move);
+    CU_ASSERT(sd_rec_insert_action(&whole, whole.move_count, &move) == SD_SUCCESS);
+    start = SDL_GetTicks();
+    while(loaded_moves(TEST_FILE) <= REC_WRITER_CHUNK_MOVES && SDL_GetTicks() - start < REC_WRITER_FLUSH_MS * 2) {
+        SDL_Delay(10);
+    }
+    CU_ASSERT(loaded_moves(TEST_FILE) == REC_WRITER_CHUNK_MOVES + 1);
+}
+
+void test_rec_writer_close(void) {
+    sd_rec_move move;
+    for(int i = REC_WRITER_CHUNK_MOVES + 1; i < TEST_MOVES; i++) {
+        make_move(&move, i);
+        rec_writer_add(writer, &move);
+        CU_ASSERT(sd_rec_insert_action(&whole, whole.move_count, &move) == SD_SUCCESS);
+    }
+    CU_ASSERT(rec_writer_get_moves(writer) == TEST_MOVES);
+    rec_writer_close(writer);
+
+    // The streamed file is the same as saving the whole recording at once
+    CU_ASSERT_FATAL(sd_rec_save(&whole, TEST_WHOLE) == SD_SUCCESS);
+    FILE *a = fopen(TEST_FILE, "rb");
+    FILE *b = fopen(TEST_WHOLE, "rb");
+    CU_ASSERT_FATAL(a != NULL && b != NULL);
+    int same = 1;
+    int ca, cb;
+    do {
+        ca = fgetc(a);
+        cb = fgetc(b);
+        same &= (ca == cb);
+    } while(ca != EOF && cb != EOF);
+    CU_ASSERT(same);
+    fclose(a);
+    fclose(b);
+
+    sd_rec_file rec;
+    sd_rec_create(&rec);
+    CU_ASSERT_FATAL(sd_rec_load(&rec, TEST_FILE) == SD_SUCCESS);
+    CU_ASSERT(rec.move_count == TEST_MOVES);
+    CU_ASSERT(rec.pilots[1].info.har_id == 7);
+    CU_ASSERT(rec.moves[TEST_MOVES - 1].tick == (TEST_MOVES - 1) * 3);
+    sd_rec_free(&rec);
+    sd_rec_free(&whole);
+    remove(TEST_FILE);
+    remove(TEST_WHOLE);
+}
+
+void rec_writer_test_suite(CU_pSuite suite) {
+    // Add tests
+    if(CU_add_test(suite, "Test for rec writer open", test_rec_writer_open) == NULL) { return; }
+    if(CU_add_test(suite, "Test for rec writer streaming", test_rec_writer_stream) == NULL) { return; }
+    if(CU_add_test(suite, "Test for rec writer close", test_rec_writer_close) == NULL) { return; }
+}
@@ -0,0 +1,78 @@
+#include <string.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <video/surface.h>
+
+#define ALPHA 50
+#define ALPHA_TWICE 90
+
+static uint8_t shadow_alpha(surface *sur, int x, int y) {
+    return (uint8_t)sur->data[(y * sur->w + x) * 4 + 3];
+}
+
+// 4x8 sprite, squashed to 2 rows. The rows are sampled from source rows 2 and 6.
+static void create_sprite(surface *sur) {
+    surface_create(sur, SURFACE_TYPE_PALETTE, 4, 8);
+    memset(sur->data, 1, 4 * 8);
+    memset(sur->stencil, 0, 4 * 8);
+}
+
+void test_surface_shadow(void) {
+    surface src, shadow;
+    create_sprite(&src);
+    memset(src.stencil, 1, 4 * 8);
+    surface_create_shadow(&shadow, &src, 2, 0, ALPHA);
+    CU_ASSERT_FATAL(shadow.type == SURFACE_TYPE_RGBA);
+    CU_ASSERT_FATAL(shadow.w == 5 && shadow.h == 3);
+
+    // Where the two copies overlap, the shadow is darker
+    CU_ASSERT(shadow_alpha(&shadow, 0, 0) == ALPHA);
+    CU_ASSERT(shadow_alpha(&shadow, 1, 1) == ALPHA_TWICE);
+    CU_ASSERT(shadow_alpha(&shadow, 3, 1) == ALPHA_TWICE);
+    CU_ASSERT(shadow_alpha(&shadow, 4, 2) == ALPHA);
+    CU_ASSERT(shadow_alpha(&shadow, 4, 0) == 0);
+    CU_ASSERT(shadow_alpha(&shadow, 0, 2) == 0);
+    int black = 1;
+    for(int i = 0; i < shadow.w * shadow.h; i++) {
+        black &= (shadow.data[i * 4] == 0 && shadow.data[i * 4 + 1] == 0 && shadow.data[i * 4 + 2] == 0);
+    }
+    CU_ASSERT(black);
+    surface_free(&shadow);
+    surface_free(&src);
+}
+
+void test_surface_shadow_flip(void) {
+    surface src, shadow;
+    create_sprite(&src);
+
+    // Left column of the top half
+    for(int y = 0; y < 4; y++) {
+        src.stencil[y * 4] = 1;
+    }
+    surface_create_shadow(&shadow, &src, 2, 0, ALPHA);
+    CU_ASSERT(shadow_alpha(&shadow, 0, 0) == ALPHA);
+    CU_ASSERT(shadow_alpha(&shadow, 3, 0) == 0);
+    CU_ASSERT(shadow_alpha(&shadow, 0, 1) == 0);
+    CU_ASSERT(shadow_alpha(&shadow, 1, 1) == ALPHA);
+    surface_free(&shadow);
+
+    // The flip comes before the offset, which always goes down and right
+    surface_create_shadow(&shadow, &src, 2, SDL_FLIP_HORIZONTAL, ALPHA);
+    CU_ASSERT(shadow_alpha(&shadow, 0, 0) == 0);
+    CU_ASSERT(shadow_alpha(&shadow, 3, 0) == ALPHA);
+    CU_ASSERT(shadow_alpha(&shadow, 4, 1) == ALPHA);
+    surface_free(&shadow);
+
+    surface_create_shadow(&shadow, &src, 2, SDL_FLIP_VERTICAL, ALPHA);
+    CU_ASSERT(shadow_alpha(&shadow, 0, 0) == 0);
+    CU_ASSERT(shadow_alpha(&shadow, 0, 1) == ALPHA);
+    CU_ASSERT(shadow_alpha(&shadow, 1, 2) == ALPHA);
+    surface_free(&shadow);
+    surface_free(&src);
+}
+
+void surface_test_suite(CU_pSuite suite) {
+    // Add tests
+    if(CU_add_test(suite, "Test for surface shadow", test_surface_shadow) == NULL) { return; }
+    if(CU_add_test(suite, "Test for surface shadow flips", test_surface_shadow_flip) == NULL) { return; }
+}